@@ -0,0 +1,143 @@
+#include "bms_sim.h"
+#include "bms_analytics.h"
+#include "bms_transport_linux.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @file bms_analytics_bench.c
+ * @brief Accuracy and cost of the incremental analytics (bms_analytics.h) on a modelled pack whose truth is known.
+ * 	  Every cell follows an open circuit voltage curve plus its IR drop with its own internal resistance, one cell is weak (high resistance) and one starts losing charge
+ * 	  halfway through, the pack is cycled between 10 % and 90 % SOC with a load stepping every few refreshes and its real capacity is below the rated one.
+ * 	  The responses go through the driver decode (bms_device_store_frame()) and the cell view, and the figures are checked against the model at the end.
+ * @author Piyush
+ * @date 12/01/25
+ * @version 1.0
+ *
+ *
+ * @note usage : bms_analytics_bench [refreshes] [refresh_ms]
+ */
+
+
+// ====================================================================================================== MACROS ==========================================================================================================================
+
+#define BENCH_DEFAULT_REFRESHES		40000
+#define BENCH_DEFAULT_REFRESH_MS	1000
+#define BENCH_RATED_MAH			40000
+#define BENCH_TRUE_MAH			36000		/**< faded pack, SOH 90 %				*/
+#define BENCH_BASE_UOHM			1500		/**< internal resistance of a healthy cell		*/
+#define BENCH_WEAK_CELL			5
+#define BENCH_WEAK_UOHM			4000
+#define BENCH_LEAKY_CELL		9
+#define BENCH_LEAK_UV_PER_REFRESH	10		/**< charge lost by the leaky cell, as open circuit voltage	*/
+#define BENCH_LOAD_PERIOD		20		/**< refreshes between two load changes			*/
+
+
+//==================================================================================== ROUTINE DEFINITIONS ======================================================================================
+
+
+/**
+ * @brief Open circuit voltage of a cell, linear from 3200 mV empty to 4100 mV full.
+ */
+static double bench_ocv_mv(double soc_permille){
+	return 3200.0+soc_permille*0.9;
+}
+
+int main(int argc, char** argv){
+	uint32_t refreshes=(argc>1) ? (uint32_t)atoi(argv[1]) : BENCH_DEFAULT_REFRESHES;
+	uint32_t refresh_ms=(argc>2) ? (uint32_t)atoi(argv[2]) : BENCH_DEFAULT_REFRESH_MS;
+	if(refreshes==0){
+		refreshes=BENCH_DEFAULT_REFRESHES;
+	}
+	if(refresh_ms==0 || refresh_ms>BMS_ANALYTICS_STEP_MAX_MS){
+		refresh_ms=BENCH_DEFAULT_REFRESH_MS;
+	}
+
+	static bms_sim sim;
+	bms_sim_init(&sim, STRINGS_COUNT, TEMP_SENSOR_COUNT);
+	srand(1);
+	static RT_Battery_status stat;
+	bms_device dev;
+	bms_device_init(&dev, NULL, &stat);
+	static bms_analytics an;
+	bms_analytics_init(&an, dev.strings_count, BENCH_RATED_MAH);
+	bms_cell_view view;
+	uart_prot_packet frames[BMS_SIM_MAX_FRAMES];
+
+	uint32_t r_true[STRINGS_COUNT];
+	for(uint8_t i=0;i<STRINGS_COUNT;i++){
+		r_true[i]=(i==BENCH_WEAK_CELL) ? BENCH_WEAK_UOHM : BENCH_BASE_UOHM+i*20U;
+	}
+	double soc=500.0, leak_mv=0.0, true_mams=0.0;
+	int32_t ma=0;
+	int8_t direction=-1;
+	uint32_t steps=0, capacities=0, gaps=0;
+	uint64_t update_us=0;
+
+	for(uint32_t n=0;n<refreshes;n++){
+		if(n%BENCH_LOAD_PERIOD==0){
+			direction=(soc<100.0) ? 1 : (soc>900.0) ? -1 : direction;
+			ma=(direction>0) ? 5000+(rand()%4)*5000 : -(5000+(rand()%6)*5000);	// 5 to 20 A charge, 5 to 30 A discharge, 0.1 A multiples
+		}
+		double dq=(double)ma*refresh_ms;
+		true_mams+=dq;
+		soc+=dq/(BENCH_TRUE_MAH*3600.0);	// permille per mA.ms : 1000/(capacity*3600000)
+		if(n>=refreshes/2){
+			leak_mv+=BENCH_LEAK_UV_PER_REFRESH/1000.0;
+		}
+
+		sim.values.current=(uint16_t)(30000+ma/100);
+		sim.values.soc=(uint16_t)(soc+0.5);
+		for(uint8_t i=0;i<sim.strings_count;i++){
+			double mv=bench_ocv_mv(soc)+(double)ma*r_true[i]/1e6+(rand()%3)-1;
+			mv-=(i==BENCH_LEAKY_CELL) ? leak_mv : 0.0;
+			sim.values.cell_mv[i]=(uint16_t)(mv+0.5);
+		}
+		const uint8_t ids[2]={ SOC_TOTAL_IV, CELL_VOLTAGE };
+		for(uint8_t k=0;k<2;k++){
+			uint8_t count=bms_sim_build_response(&sim, ids[k], frames);
+			for(uint8_t f=0;f<count;f++){
+				bms_device_store_frame(&dev, &frames[f]);
+			}
+		}
+
+		uint64_t t0=bms_linux_time_us();
+		bms_cells_decode(&view, &stat, dev.strings_count, dev.temp_sensor_count);
+		uint8_t events=bms_analytics_update(&an, &stat, &view, n*refresh_ms);
+		update_us+=bms_linux_time_us()-t0;
+		steps+=(events & BMS_ANALYTICS_EV_STEP) ? 1 : 0;
+		capacities+=(events & BMS_ANALYTICS_EV_CAPACITY) ? 1 : 0;
+		gaps+=(events & BMS_ANALYTICS_EV_GAP) ? 1 : 0;
+	}
+
+	bms_pack_health pack;
+	bms_analytics_pack(&an, &pack);
+	printf("%u refreshes every %u ms, %u cells, %u steps, %u capacity windows, %u gaps, %u samples rejected\n", refreshes, refresh_ms, an.cells, steps, capacities, gaps, an.rejected);
+	printf("decode + update %.0f ns per refresh, %u bytes of state\n\n", update_us*1000.0/refreshes, (uint32_t)sizeof(bms_analytics));
+	printf("%4s %10s %10s %10s %10s %10s %10s\n", "cell", "mean (mV)", "sd (mV)", "ofs (mV)", "drift (mV)", "R (uohm)", "true R");
+	uint32_t r_bad=0;
+	for(uint8_t i=0;i<an.cells;i++){
+		bms_cell_health cell;
+		bms_analytics_cell(&an, i, &cell);
+		uint32_t err=(cell.resistance_uohm>r_true[i]) ? cell.resistance_uohm-r_true[i] : r_true[i]-cell.resistance_uohm;
+		r_bad+=(err*10U>r_true[i]) ? 1 : 0;	// within 10 %
+		printf("%4u %10.1f %10.2f %10.2f %10.2f %10u %10u\n", i, cell.mean_uv/1000.0, cell.stddev_uv/1000.0, cell.offset_uv/1000.0, cell.drift_uv/1000.0,
+			cell.resistance_uohm, r_true[i]);
+	}
+
+	int32_t true_mah=(int32_t)(true_mams/3600000.0);
+	int32_t charge_err=pack.charge_mah-true_mah;
+	bms_cell_health leaky;
+	bms_analytics_cell(&an, BENCH_LEAKY_CELL, &leaky);
+	printf("\nnet charge %d mAh (model %d), in %u mAh, out %u mAh, %u.%02u equivalent cycles\n", pack.charge_mah, true_mah, pack.charged_mah, pack.discharged_mah,
+		pack.cycles_x100/100, pack.cycles_x100%100);
+	printf("capacity %u mAh (model %u), SOH %u.%u %%, pack resistance %u uohm\n", pack.capacity_mah, BENCH_TRUE_MAH, pack.soh_permille/10, pack.soh_permille%10, pack.resistance_uohm);
+	printf("highest resistance cell %u (model %u), most drifting cell %u (model %u)\n", pack.worst_cell, BENCH_WEAK_CELL, pack.drift_cell, BENCH_LEAKY_CELL);
+
+	uint32_t cap_err=(pack.capacity_mah>BENCH_TRUE_MAH) ? pack.capacity_mah-BENCH_TRUE_MAH : BENCH_TRUE_MAH-pack.capacity_mah;
+	uint8_t ok=(r_bad==0 && pack.worst_cell==BENCH_WEAK_CELL && pack.drift_cell==BENCH_LEAKY_CELL && leaky.drift_uv<0 && cap_err*20U<=BENCH_TRUE_MAH &&
+		(uint64_t)(charge_err<0 ? -charge_err : charge_err)*1000U<=(uint64_t)pack.charged_mah+pack.discharged_mah);	// trapezoid against the model's steps
+	printf("%s\n", ok ? "figures within 10 % (resistances), 5 % (capacity) and 0.1 % of the throughput (charge) of the model" : "figures off the model");
+	return ok ? 0 : 1;
+}
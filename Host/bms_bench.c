@@ -0,0 +1,433 @@
+#include "bms_sim.h"
+#include "bms_transport_linux.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+/**
+ * @file bms_bench.c
+ * @brief Cycle time benchmark of the driver against the simulated DALY BMS.
+ * 	  Reports the latency of every data ID 0x90 to 0x98 on its own and of a full bms_read() cycle, each as min / mean / p50 / p99 / max over a number of iterations,
+ * 	  together with the pure wire time, so that the polling rate can be chosen from numbers.
+ * @author Piyush
+ * @date 12/01/25
+ * @version 1.0
+ *
+ *
+ * @note usage : bms_bench [iterations] [baudrate] [max_pending] [corrupt_permille]
+ *	 max_pending models how many requests the BMS firmware buffers while it is busy answering (see bms_sim.h), pipeline depths above max_pending can lose requests.
+ *	 The command run measures the time from bms_post_command() to its confirmation while another thread keeps calling bms_read(), against the full cycle it preempts.
+ *	 The snapshot run has the simulated cells change voltage all together while BENCH_READERS threads check that every cell they read has the same value, once reading the
+ *	 snapshot published by the driver (bms_attach_snapshot()) and once reading the plain status buffer the driver writes into.
+ *	 corrupt_permille (default 20) sets the frame error rate of the last run, where bms_read() has to complete the responses through the frame reassembly, its driver
+ *	 instrumentation (bms_stats.h) is printed per data ID : bus time taken from the wire bytes, retries, timeouts, checksum/sequence failures and latency percentiles.
+ *	 The noisy reads are then repeated with BMS_PIPELINE_MAX_DEPTH requests in flight.
+ *	 The stale frame run answers every request with a burst of BATTERY_FAILURE_STATUS frames while SOC_TOTAL_IV is read, the reads must fail within
+ *	 bms_device_worst_case_ms(), the benchmark exits with 1 otherwise.
+ */
+
+
+// ====================================================================================================== MACROS ==========================================================================================================================
+
+#define BENCH_DEFAULT_ITERATIONS	50
+#define BENCH_MAX_ITERATIONS		10000
+#define BENCH_DEFAULT_CORRUPT_PERMILLE	20
+#define BENCH_READERS			3	/**< reader tasks of the snapshot run (CAN bridge, display, logger)	*/
+#define BENCH_READERS_RUN_US		2000000
+
+
+//==================================================================================== ROUTINE DEFINITIONS ======================================================================================
+
+
+/**
+ * @brief Comparison routine for qsort().
+ */
+static int bench_cmp(const void* a, const void* b){
+	uint64_t x=*(const uint64_t*)a, y=*(const uint64_t*)b;
+	return (x>y)-(x<y);
+}
+
+/**
+ * @brief Prints one line of latency statistics.
+ * @param const char* name passes the row label.
+ * @param uint64_t* samples passes the latencies in microseconds, sorted in place.
+ * @param uint32_t n passes the number of samples.
+ * @param uint32_t wire_us passes the wire time of the transaction.
+ * @retval void
+ */
+static void bench_report(const char* name, uint64_t* samples, uint32_t n, uint32_t wire_us){
+	uint64_t sum=0;
+	qsort(samples, n, sizeof(uint64_t), bench_cmp);
+	for(uint32_t i=0;i<n;i++){
+		sum+=samples[i];
+	}
+	printf("%-26s %9.2f %9.2f %9.2f %9.2f %9.2f %9.2f\n", name, wire_us/1000.0, samples[0]/1000.0, (double)sum/n/1000.0, samples[n/2]/1000.0, samples[(n*99)/100]/1000.0, samples[n-1]/1000.0);
+}
+
+/**
+ * @brief Microsecond tick of the driver instrumentation.
+ */
+static uint32_t bench_time_us(void){
+	return (uint32_t)bms_linux_time_us();
+}
+
+/**
+ * @brief Prints one line of driver instrumentation.
+ * @param const char* name passes the row label.
+ * @param const bms_id_stats* id passes the counters.
+ * @param const bms_transport* transport passes the transport whose baud rate gives the bus time.
+ * @param uint64_t run_us passes the duration of the run.
+ * @retval void
+ */
+static void bench_stats_row(const char* name, const bms_id_stats* id, const bms_transport* transport, uint64_t run_us){
+	uint32_t bus_us=bms_transport_wire_time_us(transport, id->tx_bytes+id->rx_bytes);
+	printf("%-10s %7u %6.1f%% %5u %5u %5u %5u %5u %8.2f %8.2f %8.2f\n", name, id->requests, 100.0*bus_us/run_us, id->retries, id->timeouts, id->checksum_errors, id->sequence_errors, id->failures,
+		bms_stats_percentile_us(id, BMS_STATS_FIRST_BYTE, 500)/1000.0, bms_stats_percentile_us(id, BMS_STATS_RESPONSE, 990)/1000.0, id->response_max_us/1000.0);
+}
+
+/**
+ * @brief Runs one request/response transaction for a single data ID.
+ * @param bms_transport* transport passes the transport towards the simulator.
+ * @param uint8_t data_id passes the data ID.
+ * @param uint8_t frames passes the expected number of response frames.
+ * @retval uint8_t returns 0 on success and non zero on failure.
+ */
+static uint8_t bench_transaction(bms_transport* transport, uint8_t data_id, uint8_t frames){
+	uart_prot_packet packet2send={
+		.start_flag=START_FLAG,
+		.module_addr=UPPER_CMPTR_ADDR,
+		.data_id=data_id,
+		.data_len=MAX_DATA_SIZE,
+		.chksum=get_checksum(data_id)
+	};
+	uart_prot_packet packet2recv;
+
+	if(bms_transport_transmit(transport, (uint8_t*)&packet2send, sizeof(uart_prot_packet), 1000)!=BMS_TRANSPORT_OK){
+		return 1;
+	}
+	for(uint8_t i=0;i<frames;i++){
+		if(bms_transport_receive(transport, (uint8_t*)&packet2recv, sizeof(uart_prot_packet), 1000)!=BMS_TRANSPORT_OK){
+			return 2;
+		}
+		if(verify_checksum(&packet2recv)!=0x01 || packet2recv.data_id!=data_id){
+			return 3;
+		}
+	}
+	return 0;
+}
+
+/**
+ * @brief Responder of the stale frame run, every request is answered with BMS_SIM_MAX_FRAMES copies of the BATTERY_FAILURE_STATUS response, as a BMS replaying a late response
+ * 	  or another node talking on a shared RS485 bus would.
+ */
+static uint8_t bench_flood_responder(void* ctx, uint8_t data_id, uint8_t value, uart_prot_packet* frames){
+	(void)data_id;
+	(void)value;
+	bms_sim_build_response((const bms_sim*)ctx, BATTERY_FAILURE_STATUS, frames);
+	for(uint8_t f=1;f<BMS_SIM_MAX_FRAMES;f++){
+		frames[f]=frames[0];
+	}
+	return BMS_SIM_MAX_FRAMES;
+}
+
+static RT_Battery_status bench_poll_stat;
+
+/**
+ * @brief Polling task of the command and snapshot runs, reads the pack into bench_poll_stat (or the attached snapshot) until stop is set.
+ * @param void* arg passes the volatile uint8_t stop flag.
+ * @retval void* returns NULL.
+ */
+static void* bench_poll_main(void* arg){
+	while(!*(volatile uint8_t*)arg){
+		bms_read(&bench_poll_stat);
+	}
+	return NULL;
+}
+
+/**
+ * @brief structure of one reader task of the snapshot run.
+ */
+typedef struct {
+	const bms_snapshot* snap;	/**< snapshot read, NULL to read stat directly	*/
+	const RT_Battery_status* stat;	/**< status buffer read when snap is NULL	*/
+	volatile uint8_t* stop;
+	uint32_t reads;			/**< consistency checks done			*/
+	uint32_t retries;		/**< reads discarded by bms_snapshot_read_retry()	*/
+	uint32_t torn;			/**< reads mixing two cell voltage responses	*/
+} bench_reader;
+
+/**
+ * @brief Tells whether all the cell voltages of a status are equal, the simulator sets them all at once.
+ */
+static uint8_t bench_cells_equal(const volatile RT_Battery_status* stat){
+	for(uint8_t i=1;i<STRINGS_COUNT;i++){
+		if(stat->cell_voltages[i*MONOMER_VOLTAGE_SIZE]!=stat->cell_voltages[0] || stat->cell_voltages[i*MONOMER_VOLTAGE_SIZE+1]!=stat->cell_voltages[1]){
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/**
+ * @brief Reader task of the snapshot run.
+ * @param void* arg passes the bench_reader.
+ * @retval void* returns NULL.
+ */
+static void* bench_reader_main(void* arg){
+	bench_reader* r=(bench_reader*)arg;
+	while(!*r->stop){
+		uint8_t equal;
+		if(r->snap!=NULL){
+			const RT_Battery_status* stat;
+			uint8_t retry;
+			do{
+				uint32_t seq=bms_snapshot_read_begin(r->snap, &stat);
+				equal=bench_cells_equal(stat);
+				retry=bms_snapshot_read_retry(r->snap, seq);
+				r->retries+=retry;
+			}while(retry);
+		}
+		else{
+			equal=bench_cells_equal(r->stat);
+		}
+		r->torn+=(equal==0);
+		r->reads++;
+	}
+	return NULL;
+}
+
+/**
+ * @brief Runs the polling task, the readers and the cell voltage changes for BENCH_READERS_RUN_US.
+ * @param bms_sim* sim passes the simulator.
+ * @param const bms_snapshot* snap passes the snapshot the readers use, NULL for the plain status buffer.
+ * @param const RT_Battery_status* stat passes the plain status buffer.
+ * @retval void
+ */
+static void bench_readers_run(bms_sim* sim, const bms_snapshot* snap, const RT_Battery_status* stat){
+	volatile uint8_t stop=0, stop_poll=0;
+	bench_reader readers[BENCH_READERS];
+	pthread_t threads[BENCH_READERS], poller;
+	memset(readers, 0x00, sizeof(readers));
+
+	pthread_create(&poller, NULL, bench_poll_main, (void*)&stop_poll);
+	for(uint8_t i=0;i<BENCH_READERS;i++){
+		readers[i].snap=snap;
+		readers[i].stat=stat;
+		readers[i].stop=&stop;
+		pthread_create(&threads[i], NULL, bench_reader_main, &readers[i]);
+	}
+	uint64_t end=bms_linux_time_us()+BENCH_READERS_RUN_US;
+	for(uint16_t mv=3000;bms_linux_time_us()<end;mv=(mv>=3500) ? 3000 : mv+1){
+		pthread_mutex_lock(&sim->lock);
+		for(uint8_t i=0;i<sim->strings_count;i++){
+			sim->values.cell_mv[i]=mv;
+		}
+		pthread_mutex_unlock(&sim->lock);
+		usleep(3000);	// a few changes per 0x95 response
+	}
+	stop=1;
+	stop_poll=1;
+	uint32_t reads=0, retries=0, torn=0;
+	for(uint8_t i=0;i<BENCH_READERS;i++){
+		pthread_join(threads[i], NULL);
+		reads+=readers[i].reads;
+		retries+=readers[i].retries;
+		torn+=readers[i].torn;
+	}
+	pthread_join(poller, NULL);
+	printf("%-26s %u readers, %u reads, %u retried, %u torn\n", (snap!=NULL) ? "snapshot readers" : "plain status readers", BENCH_READERS, reads, retries, torn);
+}
+
+int main(int argc, char** argv){
+	uint32_t iterations=(argc>1) ? (uint32_t)atoi(argv[1]) : BENCH_DEFAULT_ITERATIONS;
+	uint32_t baudrate=(argc>2) ? (uint32_t)atoi(argv[2]) : UART_DEFAULT_BAUDRATE;
+	uint8_t max_pending=(argc>3) ? (uint8_t)atoi(argv[3]) : BMS_SIM_QUEUE_SIZE;
+	uint16_t corrupt_permille=(argc>4) ? (uint16_t)atoi(argv[4]) : BENCH_DEFAULT_CORRUPT_PERMILLE;
+	if(iterations==0 || iterations>BENCH_MAX_ITERATIONS){
+		iterations=BENCH_DEFAULT_ITERATIONS;
+	}
+
+	static bms_sim sim;
+	bms_sim_init(&sim, STRINGS_COUNT, TEMP_SENSOR_COUNT);
+	sim.baudrate=baudrate;
+	sim.max_pending=max_pending;
+	if(bms_sim_start(&sim)!=0){
+		fprintf(stderr, "bms_bench: cannot start the simulated BMS\n");
+		return 1;
+	}
+
+	bms_transport transport;
+	bms_linux_port port;
+	if(bms_transport_linux_open(&transport, &port, sim.slave_path, baudrate)!=BMS_TRANSPORT_OK){
+		fprintf(stderr, "bms_bench: cannot open %s\n", sim.slave_path);
+		bms_sim_stop(&sim);
+		return 1;
+	}
+	attach_transport(&transport);
+
+	static uint64_t samples[BENCH_MAX_ITERATIONS];
+	uint32_t frame_us=bms_transport_wire_time_us(&transport, sizeof(uart_prot_packet));
+	printf("simulated BMS on %s, %u bps, %u strings, %u sensors, %u us BMS processing, %u iterations\n\n", sim.slave_path, baudrate, STRINGS_COUNT, TEMP_SENSOR_COUNT, sim.response_delay_us, iterations);
+	printf("%-26s %9s %9s %9s %9s %9s %9s\n", "transaction (ms)", "wire", "min", "mean", "p50", "p99", "max");
+
+	for(uint8_t data_id=SOC_TOTAL_IV;data_id<=BATTERY_FAILURE_STATUS;data_id++){
+		uint8_t frames=1;
+		if(data_id==CELL_VOLTAGE){
+			frames=(STRINGS_COUNT+CELL_VOLTS_PER_FRAME-1)/CELL_VOLTS_PER_FRAME;
+		}
+		else if(data_id==CELL_TEMPERATURE){
+			frames=(TEMP_SENSOR_COUNT+CELL_TEMPS_PER_FRAME-1)/CELL_TEMPS_PER_FRAME;
+		}
+		for(uint32_t i=0;i<iterations;i++){
+			uint64_t t0=bms_linux_time_us();
+			if(bench_transaction(&transport, data_id, frames)!=0){
+				fprintf(stderr, "bms_bench: transaction 0x%02X failed\n", data_id);
+				return 1;
+			}
+			samples[i]=bms_linux_time_us()-t0;
+		}
+		char name[32];
+		snprintf(name, sizeof(name), "0x%02X (%u frame%s)", data_id, frames, (frames>1) ? "s" : "");
+		bench_report(name, samples, iterations, frame_us*(1+frames));
+	}
+
+	static RT_Battery_status stat;
+	uint32_t cycle_frames=0;
+	for(uint32_t i=0;i<iterations;i++){
+		uint64_t t0=bms_linux_time_us();
+		uint8_t ret=bms_read(&stat);
+		if(ret!=0){
+			fprintf(stderr, "bms_bench: bms_read() failed with code %u\n", ret);
+			return 1;
+		}
+		samples[i]=bms_linux_time_us()-t0;
+	}
+	cycle_frames=9*2+((STRINGS_COUNT+CELL_VOLTS_PER_FRAME-1)/CELL_VOLTS_PER_FRAME-1)+((TEMP_SENSOR_COUNT+CELL_TEMPS_PER_FRAME-1)/CELL_TEMPS_PER_FRAME-1);
+	bench_report("full cycle bms_read()", samples, iterations, frame_us*cycle_frames);
+
+	for(uint8_t depth=1;depth<=BMS_PIPELINE_MAX_DEPTH;depth++){
+		uint32_t ok=0;
+		for(uint32_t i=0;i<iterations;i++){
+			uint64_t t0=bms_linux_time_us();
+			if(bms_read_pipelined(&stat, depth)!=0){
+				continue;	// requests lost beyond max_pending, the stale responses are dropped by the next read
+			}
+			samples[ok++]=bms_linux_time_us()-t0;
+		}
+		char name[32];
+		snprintf(name, sizeof(name), "pipelined, depth %u", depth);
+		if(ok==0){
+			printf("%-26s failed on every cycle, the BMS drops requests at this depth\n", name);
+			continue;
+		}
+		bench_report(name, samples, ok, frame_us*(cycle_frames-8));	// requests overlap the responses, only the first one adds wire time
+		if(ok!=iterations){
+			printf("%-26s %u of %u cycles failed\n", "", iterations-ok, iterations);
+		}
+	}
+
+	volatile uint8_t stop=0;
+	pthread_t poller;
+	uint32_t ok=0;
+	pthread_create(&poller, NULL, bench_poll_main, (void*)&stop);
+	for(uint32_t i=0;i<iterations;i++){
+		usleep(20000+(i*7919U)%150000U);	// land anywhere in the polling cycle
+		uint64_t t0=bms_linux_time_us();
+		bms_post_command(DISCHRG_FET, (i&1) ? BMS_FET_ON : BMS_FET_OFF);
+		uint8_t error;
+		while(bms_command_status(&error)!=BMS_CMD_DONE){
+			usleep(100);
+		}
+		if(error==0 && sim.values.dischrg_mos_state==((i&1) ? BMS_FET_ON : BMS_FET_OFF)){
+			samples[ok++]=bms_linux_time_us()-t0;
+		}
+	}
+	stop=1;
+	pthread_join(poller, NULL);
+	if(ok!=0){
+		bench_report("command, polling running", samples, ok, frame_us*4);
+	}
+	if(ok!=iterations){
+		printf("%-26s %u of %u commands failed\n", "", iterations-ok, iterations);
+	}
+
+	static bms_snapshot snap;
+	bench_readers_run(&sim, NULL, &bench_poll_stat);
+	bms_attach_snapshot(&snap);
+	bench_readers_run(&sim, &snap, NULL);
+	bms_attach_snapshot(NULL);
+
+	static bms_stats stats;
+	bms_stats_init(&stats, bench_time_us);
+	bms_attach_stats(&stats);
+	sim.corrupt_permille=corrupt_permille;
+	sim.reorder_frames=1;
+	ok=0;
+	uint64_t run_start=bms_linux_time_us();
+	for(uint32_t i=0;i<iterations;i++){
+		uint64_t t0=bms_linux_time_us();
+		if(bms_read(&stat)!=0){
+			continue;
+		}
+		samples[ok++]=bms_linux_time_us()-t0;
+	}
+	char name[48];
+	snprintf(name, sizeof(name), "noisy bms_read(), %u%%o", corrupt_permille);
+	if(ok!=0){
+		bench_report(name, samples, ok, frame_us*cycle_frames);
+	}
+	printf("%-26s %u of %u cycles failed, %u frames corrupted, frames reordered\n", "", iterations-ok, iterations, sim.frames_corrupted);
+
+	uint64_t run_us=bms_linux_time_us()-run_start;
+	bms_attach_stats(NULL);
+	printf("\ninstrumentation of the noisy run, %u reads, %u failed, last error %u, %u stale frames dropped (latencies in ms, bucket upper bounds)\n", stats.reads, stats.failed_reads,
+		stats.last_error, stats.unexpected_ids);
+	printf("%-10s %7s %7s %5s %5s %5s %5s %5s %8s %8s %8s\n", "data ID", "req", "bus", "retry", "tmo", "chk", "seq", "fail", "1st p50", "rsp p99", "rsp max");
+	for(uint8_t data_id=SOC_TOTAL_IV;data_id<=BATTERY_FAILURE_STATUS;data_id++){
+		snprintf(name, sizeof(name), "0x%02X", data_id);
+		bench_stats_row(name, bms_stats_id(&stats, data_id), &transport, run_us);
+	}
+	bms_id_stats total;
+	bms_stats_sum(&stats, BMS_MASK_ALL, &total);
+	bench_stats_row("device", &total, &transport, run_us);
+
+	// same noise with the requests pipelined, the data IDs requested again overtake no response in flight
+	ok=0;
+	for(uint32_t i=0;i<iterations;i++){
+		uint64_t t0=bms_linux_time_us();
+		if(bms_read_pipelined(&stat, BMS_PIPELINE_MAX_DEPTH)!=0){
+			continue;
+		}
+		samples[ok++]=bms_linux_time_us()-t0;
+	}
+	snprintf(name, sizeof(name), "noisy pipelined, depth %u", BMS_PIPELINE_MAX_DEPTH);
+	printf("\n");
+	if(ok!=0){
+		bench_report(name, samples, ok, frame_us*(cycle_frames-8));
+	}
+	printf("%-26s %u of %u cycles failed\n", "", iterations-ok, iterations);
+
+	// stale frame flood, the read must fail within its watchdog bound however many frames of another data ID come in
+	bms_device dev;
+	uint32_t over_bound=0;
+	bms_device_init(&dev, &transport, &stat);
+	sim.corrupt_permille=0;
+	sim.reorder_frames=0;
+	sim.responder_ctx=&sim;
+	sim.responder=bench_flood_responder;
+	for(uint8_t depth=1;depth<=BMS_PIPELINE_MAX_DEPTH;depth++){
+		uint32_t bound_ms=bms_device_worst_case_ms(&dev, BMS_DATA_ID_MASK(SOC_TOTAL_IV), depth);	// one data ID, the bound of the read is the one of the data ID failing
+		uint64_t t0=bms_linux_time_us();
+		uint8_t ret=bms_device_read_mask(&dev, BMS_DATA_ID_MASK(SOC_TOTAL_IV), depth);
+		double took_ms=(bms_linux_time_us()-t0)/1000.0;
+		over_bound+=(ret==0 || took_ms>bound_ms) ? 1 : 0;
+		printf("%-26s depth %u : error %u after %.1f ms, bound %u ms\n", "stale frame flood", depth, ret, took_ms, bound_ms);
+	}
+	sim.responder=NULL;
+
+	bms_transport_linux_close(&port);
+	bms_sim_stop(&sim);
+	return (over_bound!=0) ? 1 : 0;
+}
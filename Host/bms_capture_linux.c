@@ -0,0 +1,432 @@
+#define _GNU_SOURCE
+#include "bms_capture_linux.h"
+#include "bms_sim.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * @file bms_capture_linux.c
+ * @brief Source code file for the capture reader declared in bms_capture_linux.h
+ * @author Piyush
+ * @date 12/01/25
+ * @version 1.0
+ */
+
+
+// ====================================================================================================== MACROS ==========================================================================================================================
+
+#define BMS_CAPTURE_BATCH		8		/**< blocks taken at once by a decode thread			*/
+
+
+//================================================================================== DECODE STRUCTURES =========================================================================================================
+
+/**
+ * @brief structure shared by the decode threads.
+ */
+typedef struct {
+	const bms_capture_file* file;
+	uint32_t next;				/**< next block to be taken, atomic				*/
+	uint32_t end;				/**< block after the range					*/
+	bms_capture_block_callback callback;
+	void* ctx;
+} bms_capture_job;
+
+/**
+ * @brief structure of one decode thread.
+ */
+typedef struct {
+	pthread_t thread;
+	bms_capture_job* job;
+	uint32_t block;				/**< block being decoded, handed to the callback		*/
+	bms_capture_stats stats;		/**< statistics of the blocks of this thread			*/
+} bms_capture_worker;
+
+
+//==================================================================================== PRIVATE ROUTINES =========================================================================================
+
+/**
+ * @brief Header of the block at an offset, 0 if no whole block starts there.
+ */
+static uint8_t bms_capture_block_at(const bms_capture_file* file, uint64_t offset, bms_capture_block_header* head){
+	if(offset>file->size || file->size-offset<sizeof(bms_capture_block_header)){
+		return 0;
+	}
+	memcpy(head, file->base+offset, sizeof(bms_capture_block_header));
+	return head->magic==BMS_CAPTURE_BLOCK_MAGIC && head->len<=file->size-offset-sizeof(bms_capture_block_header);
+}
+
+/**
+ * @brief Loads the index written by bms_capture_close().
+ * @param bms_capture_file* file passes the capture.
+ * @retval uint8_t returns 1 if the capture has a valid index.
+ */
+static uint8_t bms_capture_load_index(bms_capture_file* file){
+	bms_capture_footer footer;
+	if(file->size<file->header.header_size+sizeof(footer)){
+		return 0;
+	}
+	memcpy(&footer, file->base+file->size-sizeof(footer), sizeof(footer));
+	if(footer.magic!=BMS_CAPTURE_FOOTER_MAGIC || footer.index_offset<file->header.header_size
+	   || footer.index_offset+(uint64_t)footer.blocks*sizeof(bms_capture_index)!=file->size-sizeof(footer)){
+		return 0;
+	}
+	file->index=malloc((footer.blocks+1)*sizeof(bms_capture_index));
+	if(file->index==NULL){
+		return 0;
+	}
+	memcpy(file->index, file->base+footer.index_offset, footer.blocks*sizeof(bms_capture_index));
+	for(uint32_t b=0;b<footer.blocks;b++){
+		bms_capture_block_header head;
+		if(!bms_capture_block_at(file, file->index[b].offset, &head)){
+			free(file->index);
+			file->index=NULL;
+			return 0;
+		}
+	}
+	file->blocks=footer.blocks;
+	return 1;
+}
+
+/**
+ * @brief Rebuilds the index of a capture by walking its block headers.
+ * @param bms_capture_file* file passes the capture.
+ * @retval uint8_t returns 0 on success and 1 if the memory could not be allocated.
+ */
+static uint8_t bms_capture_scan_index(bms_capture_file* file){
+	uint32_t max=1024;
+	uint64_t offset=file->header.header_size;
+	bms_capture_block_header head;
+	file->index=malloc(max*sizeof(bms_capture_index));
+	file->blocks=0;
+	while(file->index!=NULL && bms_capture_block_at(file, offset, &head)){
+		if(file->blocks==max){
+			max*=2;
+			bms_capture_index* grown=realloc(file->index, max*sizeof(bms_capture_index));
+			if(grown==NULL){
+				free(file->index);
+				file->index=NULL;
+				break;
+			}
+			file->index=grown;
+		}
+		file->index[file->blocks].offset=offset;
+		file->index[file->blocks].time_us=head.time_us;
+		file->blocks++;
+		offset+=sizeof(head)+head.len;
+	}
+	return (file->index!=NULL) ? 0 : 1;
+}
+
+/**
+ * @brief Hands a cycle decoded by a worker to the callback of the job with its block number.
+ */
+static void bms_capture_worker_emit(void* ctx, const bms_capture_status* status){
+	bms_capture_worker* worker=(bms_capture_worker*)ctx;
+	worker->job->callback(worker->job->ctx, worker->block, status);
+}
+
+/**
+ * @brief Decode thread, takes BMS_CAPTURE_BATCH blocks at a time until the range is over.
+ * @param void* arg passes the bms_capture_worker*.
+ * @retval void* returns NULL.
+ */
+static void* bms_capture_worker_main(void* arg){
+	bms_capture_worker* worker=(bms_capture_worker*)arg;
+	bms_capture_job* job=worker->job;
+	const bms_capture_file* file=job->file;
+	while(1){
+		uint32_t b=__atomic_fetch_add(&job->next, BMS_CAPTURE_BATCH, __ATOMIC_RELAXED);
+		if(b>=job->end){
+			break;
+		}
+		uint32_t stop=(job->end-b>BMS_CAPTURE_BATCH) ? b+BMS_CAPTURE_BATCH : job->end;
+		for(;b<stop;b++){
+			uint64_t offset=file->index[b].offset;
+			worker->block=b;
+			if(bms_capture_decode_block(&file->header, file->base+offset, file->size-offset, &worker->stats,
+			                            (job->callback!=NULL) ? bms_capture_worker_emit : NULL, worker)==0){
+				worker->stats.bad_blocks++;
+			}
+		}
+	}
+	return NULL;
+}
+
+/**
+ * @brief Adds the statistics of a thread to the total.
+ */
+static void bms_capture_stats_add(bms_capture_stats* total, const bms_capture_stats* part){
+	const uint64_t* src=(const uint64_t*)part;
+	uint64_t* dst=(uint64_t*)total;
+	for(size_t i=0;i<sizeof(bms_capture_stats)/sizeof(uint64_t);i++){
+		dst[i]+=src[i];
+	}
+}
+
+/**
+ * @brief Reads the next record of a replay cursor, moving to the next block at the end of one, damaged blocks are skipped.
+ * @param const bms_capture_file* file passes the capture.
+ * @param uint32_t* block passes the block of the cursor.
+ * @param const uint8_t** pos passes the record of the cursor, NULL before the block is entered.
+ * @param const uint8_t** end passes the end of the block of the cursor.
+ * @param uint8_t* type passes the memory where the record type is stored.
+ * @param const uint8_t** body passes the memory where the record body is stored.
+ * @param uint16_t* len passes the memory where the body length is stored.
+ * @retval uint8_t returns 1 on success and 0 at the end of the capture.
+ */
+static uint8_t bms_capture_replay_next(const bms_capture_file* file, uint32_t* block, const uint8_t** pos, const uint8_t** end, uint8_t* type, const uint8_t** body, uint16_t* len){
+	while(1){
+		if(*pos!=NULL && *pos<*end){
+			uint32_t dt;
+			const uint8_t* next=bms_capture_next_record(*pos, *end, type, &dt, body, len);
+			if(next!=NULL){
+				*pos=next;
+				return 1;
+			}
+			(*block)++;
+		}
+		else if(*pos!=NULL){
+			(*block)++;
+		}
+		if(*block>=file->blocks){
+			*pos=*end;
+			return 0;
+		}
+		bms_capture_block_header head;
+		bms_capture_block_at(file, file->index[*block].offset, &head);
+		*pos=file->base+file->index[*block].offset+sizeof(head);
+		*end=*pos+head.len;
+	}
+}
+
+
+//==================================================================================== ROUTINE DEFINITIONS ======================================================================================
+
+
+/**
+ * @brief Maps a capture and loads or rebuilds its index.
+ * @param bms_capture_file* file passes the memory of the opened capture.
+ * @param const char* path passes the capture path.
+ * @retval uint8_t returns 0 on success, BMS_CAPTURE_ERR_FORMAT or BMS_CAPTURE_ERR_SINK if the file can't be read.
+ */
+uint8_t bms_capture_file_open(bms_capture_file* file, const char* path){
+	struct stat st;
+	memset(file, 0x00, sizeof(bms_capture_file));
+	file->fd=open(path, O_RDONLY | O_CLOEXEC);
+	if(file->fd<0 || fstat(file->fd, &st)!=0 || st.st_size==0){
+		if(file->fd>=0){
+			close(file->fd);
+		}
+		return BMS_CAPTURE_ERR_SINK;
+	}
+	file->size=(uint64_t)st.st_size;
+	void* map=mmap(NULL, file->size, PROT_READ, MAP_SHARED, file->fd, 0);
+	if(map==MAP_FAILED){
+		close(file->fd);
+		return BMS_CAPTURE_ERR_SINK;
+	}
+	file->base=(const uint8_t*)map;
+	if(bms_capture_check_header(file->base, file->size)!=0){
+		bms_capture_file_close(file);
+		return BMS_CAPTURE_ERR_FORMAT;
+	}
+	memcpy(&file->header, file->base, sizeof(bms_capture_header));
+
+	file->indexed=bms_capture_load_index(file);
+	if(!file->indexed && bms_capture_scan_index(file)!=0){
+		bms_capture_file_close(file);
+		return BMS_CAPTURE_ERR_SINK;
+	}
+	return 0;
+}
+
+/**
+ * @brief Unmaps a capture.
+ * @param bms_capture_file* file passes the opened capture.
+ * @retval void
+ */
+void bms_capture_file_close(bms_capture_file* file){
+	if(file->base!=NULL){
+		munmap((void*)file->base, file->size);
+		file->base=NULL;
+	}
+	if(file->fd>=0){
+		close(file->fd);
+		file->fd=-1;
+	}
+	free(file->index);
+	file->index=NULL;
+	file->blocks=0;
+}
+
+/**
+ * @brief Finds the block holding a time.
+ * @param const bms_capture_file* file passes the opened capture.
+ * @param uint64_t time_us passes the time.
+ * @retval uint32_t returns the last block starting at or before time_us, 0 if time_us is older than the capture.
+ */
+uint32_t bms_capture_file_seek(const bms_capture_file* file, uint64_t time_us){
+	uint32_t lo=0, hi=file->blocks;
+	while(hi-lo>1){
+		uint32_t mid=lo+(hi-lo)/2;
+		if(file->index[mid].time_us<=time_us){
+			lo=mid;
+		}
+		else{
+			hi=mid;
+		}
+	}
+	return lo;
+}
+
+/**
+ * @brief Decodes a range of blocks over several threads.
+ * @param const bms_capture_file* file passes the opened capture.
+ * @param uint32_t first passes the first block.
+ * @param uint32_t count passes the number of blocks, clipped to the capture.
+ * @param uint16_t threads passes the number of threads, 0 for one per online core.
+ * @param bms_capture_stats* stats passes the memory where the statistics are stored.
+ * @param bms_capture_block_callback callback passes the routine receiving the cycles, can be NULL.
+ * @param void* ctx passes the context of the callback.
+ * @retval uint8_t returns 0 on success and BMS_CAPTURE_ERR_SINK if the threads could not be started.
+ */
+uint8_t bms_capture_file_decode(const bms_capture_file* file, uint32_t first, uint32_t count, uint16_t threads, bms_capture_stats* stats, bms_capture_block_callback callback, void* ctx){
+	memset(stats, 0x00, sizeof(bms_capture_stats));
+	if(first>=file->blocks){
+		return 0;
+	}
+	if(threads==0){
+		long cores=sysconf(_SC_NPROCESSORS_ONLN);
+		threads=(cores>0) ? (uint16_t)cores : 1;
+	}
+	threads=(threads>BMS_CAPTURE_MAX_THREADS) ? BMS_CAPTURE_MAX_THREADS : threads;
+
+	bms_capture_job job={ .file=file, .next=first, .end=(count>file->blocks-first) ? file->blocks : first+count, .callback=callback, .ctx=ctx };
+	bms_capture_worker* workers=calloc(threads, sizeof(bms_capture_worker));
+	if(workers==NULL){
+		return BMS_CAPTURE_ERR_SINK;
+	}
+	uint16_t started=0;
+	for(;started<threads;started++){
+		workers[started].job=&job;
+		if(pthread_create(&workers[started].thread, NULL, bms_capture_worker_main, &workers[started])!=0){
+			break;
+		}
+	}
+	if(started==0){
+		bms_capture_worker_main(&workers[0]);	// no thread available, decode in the caller
+		bms_capture_stats_add(stats, &workers[0].stats);
+	}
+	for(uint16_t t=0;t<started;t++){
+		pthread_join(workers[t].thread, NULL);
+		bms_capture_stats_add(stats, &workers[t].stats);
+	}
+	free(workers);
+	return 0;
+}
+
+/**
+ * @brief Sink writing a capture to a file descriptor.
+ * @param void* ctx passes the pointer to the int file descriptor.
+ * @param const uint8_t* buf passes the bytes.
+ * @param uint32_t len passes the number of bytes.
+ * @retval uint8_t returns 0 on success and 1 on a write error.
+ */
+uint8_t bms_capture_fd_sink(void* ctx, const uint8_t* buf, uint32_t len){
+	int fd=*(int*)ctx;
+	while(len!=0){
+		ssize_t n=write(fd, buf, len);
+		if(n<0){
+			if(errno==EINTR){
+				continue;
+			}
+			return 1;
+		}
+		buf+=n;
+		len-=(uint32_t)n;
+	}
+	return 0;
+}
+
+/**
+ * @brief Starts a replay at the first record of a capture.
+ * @param bms_capture_replay* replay passes the memory of the replay.
+ * @param const bms_capture_file* file passes the opened capture.
+ * @retval void
+ */
+void bms_capture_replay_init(bms_capture_replay* replay, const bms_capture_file* file){
+	replay->file=file;
+	replay->block=0;
+	replay->pos=NULL;
+	replay->end=NULL;
+	replay->requests=0;
+	replay->frames=0;
+	replay->done=0;
+}
+
+/**
+ * @brief Responder of a simulated BMS (bms_sim::responder), answers a request with the frames recorded after the next recorded request of the same data ID.
+ * 	  The frames are taken as they were received, corrupted ones included, until the data ID is requested again in the capture.
+ * @param void* ctx passes the bms_capture_replay*.
+ * @param uint8_t data_id passes the requested data ID.
+ * @param uint8_t value passes data[0] of the request.
+ * @param uart_prot_packet* frames passes the memory for at least BMS_SIM_MAX_FRAMES frames.
+ * @retval uint8_t returns the number of frames, 0 once the capture holds no further request of the data ID.
+ */
+uint8_t bms_capture_replay_respond(void* ctx, uint8_t data_id, uint8_t value, uart_prot_packet* frames){
+	bms_capture_replay* replay=(bms_capture_replay*)ctx;
+	const bms_capture_file* file=replay->file;
+	uint8_t type;
+	const uint8_t* body;
+	uint16_t len;
+	(void)value;	// the recorded echo is sent back, whatever the value
+
+	if(replay->done){
+		return 0;
+	}
+	do{
+		if(!bms_capture_replay_next(file, &replay->block, &replay->pos, &replay->end, &type, &body, &len)){
+			replay->done=1;
+			return 0;
+		}
+	}while(type!=BMS_CAPTURE_REC_REQUEST || body[1]!=data_id);
+
+	uint32_t block=replay->block;
+	const uint8_t* pos=replay->pos;
+	const uint8_t* end=replay->end;
+	uint8_t count=0;
+	for(uint16_t n=0;n<BMS_CAPTURE_REPLAY_LOOKAHEAD && count<BMS_SIM_MAX_FRAMES;n++){
+		if(!bms_capture_replay_next(file, &block, &pos, &end, &type, &body, &len) || (type==BMS_CAPTURE_REC_REQUEST && body[1]==data_id)){
+			break;
+		}
+		if(type==BMS_CAPTURE_REC_FRAME && body[0]==data_id){
+			uart_prot_packet* frame=&frames[count++];
+			uint16_t sum=0;
+			frame->start_flag=START_FLAG;
+			frame->module_addr=file->header.bms_addr;
+			frame->data_id=data_id;
+			frame->data_len=MAX_DATA_SIZE;
+			memcpy(frame->data, body+1, MAX_DATA_SIZE);
+			for(uint8_t i=0;i<sizeof(uart_prot_packet)-1;i++){
+				sum+=((const uint8_t*)frame)[i];
+			}
+			frame->chksum=(uint8_t)sum;
+		}
+		else if(type==BMS_CAPTURE_REC_RX){
+			for(uint16_t at=0;at+sizeof(uart_prot_packet)<=len && count<BMS_SIM_MAX_FRAMES;at+=sizeof(uart_prot_packet)){
+				if(body[at]==START_FLAG && body[at+offsetof(uart_prot_packet, data_id)]==data_id){
+					memcpy(&frames[count++], body+at, sizeof(uart_prot_packet));	// as received, corrupted or not
+				}
+			}
+		}
+	}
+	replay->requests++;
+	replay->frames+=count;
+	return count;
+}
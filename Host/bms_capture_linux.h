@@ -0,0 +1,136 @@
+#ifndef BMS_CAPTURE_LINUX_H
+#define BMS_CAPTURE_LINUX_H
+
+#include "bms_capture.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @file bms_capture_linux.h
+ * @brief Header file for the capture reader defined in bms_capture_linux.c
+ * 	  Captures (bms_capture.h) are memory mapped and their blocks decoded by a pool of threads, each block on its own, so that a week of bus traffic decodes at the
+ * 	  speed of all the cores. The replay side answers the requests of a simulated BMS (bms_sim.h) with the recorded frames, to run the driver again on a recorded bus.
+ * @author Piyush
+ * @date 12/01/25
+ * @version 1.0
+ *
+ *
+ * @note A capture without index (the writer stopped before bms_capture_close()) is opened by walking the block headers, the bytes after the last whole block are ignored.
+ */
+
+
+// ====================================================================================================== MACROS ==========================================================================================================================
+
+#define BMS_CAPTURE_MAX_THREADS		256		/**< upper limit of the decode threads				*/
+#define BMS_CAPTURE_REPLAY_LOOKAHEAD	64		/**< records searched for the frames answering a request	*/
+
+
+//================================================================================ CAPTURE FILE STRUCTURES ======================================================================================================
+
+/**
+ * @brief structure of an opened capture.
+ */
+typedef struct {
+	int fd;
+	const uint8_t* base;		/**< capture mapped read only					*/
+	uint64_t size;			/**< capture size						*/
+	bms_capture_header header;
+	bms_capture_index* index;	/**< one entry per block, allocated				*/
+	uint32_t blocks;		/**< entries of index						*/
+	uint8_t indexed;		/**< 1 if the index was read from the capture, 0 if rebuilt	*/
+} bms_capture_file;
+
+/**
+ * @brief routine type receiving the decoded polling cycles of a block, called by several threads at once but in order within a block.
+ */
+typedef void (*bms_capture_block_callback)(void* ctx, uint32_t block, const bms_capture_status* status);
+
+/**
+ * @brief structure of a replay, a cursor on the records of a capture.
+ */
+typedef struct {
+	const bms_capture_file* file;
+	uint32_t block;			/**< block of the cursor					*/
+	const uint8_t* pos;		/**< next record						*/
+	const uint8_t* end;		/**< end of the block						*/
+	uint64_t requests;		/**< requests answered						*/
+	uint64_t frames;		/**< frames sent						*/
+	volatile uint8_t done;		/**< 1 once a request found no recorded request left		*/
+} bms_capture_replay;
+
+
+//======================================================================================== ROUTINE DECLARATION ===================================================================================================
+
+/**
+ * @brief Maps a capture and loads or rebuilds its index.
+ * @param bms_capture_file* file passes the memory of the opened capture.
+ * @param const char* path passes the capture path.
+ * @retval uint8_t returns 0 on success, BMS_CAPTURE_ERR_FORMAT or BMS_CAPTURE_ERR_SINK if the file can't be read.
+ */
+uint8_t bms_capture_file_open(bms_capture_file* file, const char* path);
+
+/**
+ * @brief Unmaps a capture.
+ * @param bms_capture_file* file passes the opened capture.
+ * @retval void
+ */
+void bms_capture_file_close(bms_capture_file* file);
+
+/**
+ * @brief Finds the block holding a time.
+ * @param const bms_capture_file* file passes the opened capture.
+ * @param uint64_t time_us passes the time.
+ * @retval uint32_t returns the last block starting at or before time_us, 0 if time_us is older than the capture.
+ */
+uint32_t bms_capture_file_seek(const bms_capture_file* file, uint64_t time_us);
+
+/**
+ * @brief Decodes a range of blocks over several threads.
+ * @param const bms_capture_file* file passes the opened capture.
+ * @param uint32_t first passes the first block.
+ * @param uint32_t count passes the number of blocks, clipped to the capture.
+ * @param uint16_t threads passes the number of threads, 0 for one per online core.
+ * @param bms_capture_stats* stats passes the memory where the statistics are stored.
+ * @param bms_capture_block_callback callback passes the routine receiving the cycles, can be NULL.
+ * @param void* ctx passes the context of the callback.
+ * @retval uint8_t returns 0 on success and BMS_CAPTURE_ERR_SINK if the threads could not be started.
+ */
+uint8_t bms_capture_file_decode(const bms_capture_file* file, uint32_t first, uint32_t count, uint16_t threads, bms_capture_stats* stats, bms_capture_block_callback callback, void* ctx);
+
+/**
+ * @brief Sink writing a capture to a file descriptor.
+ * @param void* ctx passes the pointer to the int file descriptor.
+ * @param const uint8_t* buf passes the bytes.
+ * @param uint32_t len passes the number of bytes.
+ * @retval uint8_t returns 0 on success and 1 on a write error.
+ */
+uint8_t bms_capture_fd_sink(void* ctx, const uint8_t* buf, uint32_t len);
+
+/**
+ * @brief Starts a replay at the first record of a capture.
+ * @param bms_capture_replay* replay passes the memory of the replay.
+ * @param const bms_capture_file* file passes the opened capture.
+ * @retval void
+ */
+void bms_capture_replay_init(bms_capture_replay* replay, const bms_capture_file* file);
+
+/**
+ * @brief Responder of a simulated BMS (bms_sim::responder), answers a request with the frames recorded after the next recorded request of the same data ID.
+ * 	  The frames are taken as they were received, corrupted ones included, until the data ID is requested again in the capture.
+ * @param void* ctx passes the bms_capture_replay*.
+ * @param uint8_t data_id passes the requested data ID.
+ * @param uint8_t value passes data[0] of the request.
+ * @param uart_prot_packet* frames passes the memory for at least BMS_SIM_MAX_FRAMES frames.
+ * @retval uint8_t returns the number of frames, 0 once the capture holds no further request of the data ID.
+ */
+uint8_t bms_capture_replay_respond(void* ctx, uint8_t data_id, uint8_t value, uart_prot_packet* frames);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /**< BMS_CAPTURE_LINUX_H  */
@@ -0,0 +1,417 @@
+#include "bms_analytics.h"
+#include "bms_capture_linux.h"
+#include "bms_sim.h"
+#include "bms_transport_linux.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * @file bms_capture_tool.c
+ * @brief Records, decodes and replays captures of the DALY bus (bms_capture.h).
+ * @author Piyush
+ * @date 12/01/25
+ * @version 1.0
+ *
+ *
+ * @note usage : bms_capture_tool synth  <file> <cycles> [corrupt_permille]	writes a capture of simulated cycles without waiting for the wire, for decoder tests
+ *		bms_capture_tool record <file> <cycles> [baudrate] [corrupt_permille]	polls a simulated BMS through the capture transport
+ *		bms_capture_tool decode <file> [threads] [out]			decodes on all cores (or threads), prints the rates and error counts, out receives the bms_capture_status records
+ *		bms_capture_tool analytics <file> [rated_mah]			folds the decoded cycles into the incremental analytics (bms_analytics.h) and prints the pack and cell figures
+ *		bms_capture_tool replay <file> [baudrate]			answers the driver with the recorded frames and checks it reads what the capture decodes to
+ */
+
+
+// ====================================================================================================== MACROS ==========================================================================================================================
+
+#define TOOL_CYCLE_PERIOD_US		1000000U	/**< time between two synthesized polling cycles		*/
+#define TOOL_INDEX_MIN			1024		/**< index entries allocated for short captures			*/
+#define TOOL_CYCLE_BYTES_MAX		2048		/**< capture bytes of one polling cycle, 48 strings and retries included	*/
+
+
+//==================================================================================== TOOL STRUCTURES ==========================================================================================================
+
+/**
+ * @brief structure of the cycles decoded from one block, filled by the thread decoding the block.
+ */
+typedef struct {
+	bms_capture_status* status;
+	uint32_t count;
+	uint32_t max;
+} tool_block_out;
+
+
+//==================================================================================== ROUTINE DEFINITIONS ======================================================================================
+
+static uint64_t tool_clock_us;
+
+/**
+ * @brief Clock of the synthesized captures, moved by the wire time of every frame.
+ */
+static uint64_t tool_synth_time_us(void){
+	return tool_clock_us;
+}
+
+/**
+ * @brief Moves the simulated pack between two polling cycles, cells drifting by a few mV.
+ */
+static void tool_drift(bms_sim* sim, unsigned int* seed){
+	bms_sim_values* v=&sim->values;
+	for(uint8_t i=0;i<sim->strings_count;i++){
+		v->cell_mv[i]=(uint16_t)(v->cell_mv[i]+rand_r(seed)%5-2);
+	}
+	v->current=(uint16_t)(30000-100-rand_r(seed)%50);
+	v->remain_capacity-=rand_r(seed)%3;
+	v->temp_40[rand_r(seed)%sim->temp_sensor_count]+=(uint8_t)(rand_r(seed)%3-1);
+}
+
+/**
+ * @brief Opens the capture file and starts a capture with an index sized for the cycles.
+ */
+static int tool_create(bms_capture* cap, bms_transport* inner, const char* path, int* fd, uint32_t cycles, uint64_t (*time_us)(void)){
+	*fd=open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if(*fd<0 || bms_capture_init(cap, inner, bms_capture_fd_sink, fd, time_us)!=0){
+		fprintf(stderr, "bms_capture_tool: cannot create %s\n", path);
+		return -1;
+	}
+	cap->index_max=(uint32_t)((uint64_t)cycles*TOOL_CYCLE_BYTES_MAX/BMS_CAPTURE_BLOCK_FILL)+TOOL_INDEX_MIN;
+	cap->index=malloc(cap->index_max*sizeof(bms_capture_index));
+	return (cap->index!=NULL) ? 0 : -1;
+}
+
+/**
+ * @brief Ends a capture and prints its size.
+ */
+static int tool_finish(bms_capture* cap, int fd, uint32_t cycles){
+	uint8_t ret=bms_capture_close(cap);
+	close(fd);
+	free(cap->index);
+	if(ret!=0 || cap->lost_blocks!=0){
+		fprintf(stderr, "bms_capture_tool: capture incomplete (error %u, %u blocks lost)\n", ret, cap->lost_blocks);
+		return 1;
+	}
+	printf("%u cycles, %u blocks, %llu bytes, %.1f bytes per cycle\n", cycles, cap->blocks, (unsigned long long)cap->offset, (double)cap->offset/cycles);
+	return 0;
+}
+
+/**
+ * @brief synth command, polling cycles built with the simulator's response builder and stamped with the modelled wire time.
+ */
+static int tool_synth(const char* path, uint32_t cycles, uint16_t corrupt_permille){
+	static bms_capture cap;
+	static bms_sim sim;
+	bms_device dev;
+	RT_Battery_status unused;
+	uart_prot_packet request, frames[BMS_SIM_MAX_FRAMES];
+	unsigned int seed=1;
+	int fd;
+
+	bms_sim_init(&sim, STRINGS_COUNT, TEMP_SENSOR_COUNT);
+	bms_device_init(&dev, NULL, &unused);
+	tool_clock_us=0;
+	if(tool_create(&cap, NULL, path, &fd, cycles, tool_synth_time_us)!=0){
+		return 1;
+	}
+	uint64_t frame_us=(uint64_t)sizeof(uart_prot_packet)*10U*1000000U/UART_DEFAULT_BAUDRATE;
+
+	for(uint32_t c=0;c<cycles;c++){
+		tool_clock_us=(uint64_t)c*TOOL_CYCLE_PERIOD_US;
+		for(uint8_t id=SOC_TOTAL_IV;id<=BATTERY_FAILURE_STATUS;id++){
+			if(!(bms_enabled_mask() & BMS_DATA_ID_MASK(id))){
+				continue;
+			}
+			for(uint8_t attempt=0;attempt<=BMS_FRAME_RETRIES;attempt++){	// a corrupted response is requested again, as the driver does
+				uint8_t count=bms_sim_build_response(&sim, id, frames);
+				uint8_t damaged=0;
+				bms_device_build_request(&dev, id, &request);
+				bms_capture_tx(&cap, tool_clock_us, (const uint8_t*)&request, sizeof(request));
+				tool_clock_us+=frame_us+BMS_SIM_DEFAULT_DELAY_US;
+				for(uint8_t f=0;f<count;f++){
+					if(corrupt_permille!=0 && (uint32_t)(rand_r(&seed)%1000U)<corrupt_permille){
+						frames[f].data[rand_r(&seed)%MAX_DATA_SIZE]^=(uint8_t)(1U<<(rand_r(&seed)%8U));
+						damaged=1;
+					}
+					tool_clock_us+=frame_us;
+					bms_capture_rx(&cap, tool_clock_us, (const uint8_t*)&frames[f], sizeof(uart_prot_packet));
+				}
+				if(!damaged){
+					break;
+				}
+			}
+		}
+		tool_drift(&sim, &seed);
+	}
+	return tool_finish(&cap, fd, cycles);
+}
+
+/**
+ * @brief record command, the driver polls a simulated BMS through the capture transport.
+ */
+static int tool_record(const char* path, uint32_t cycles, uint32_t baudrate, uint16_t corrupt_permille){
+	static bms_capture cap;
+	static bms_sim sim;
+	bms_linux_port port;
+	bms_transport line, capturing;
+	bms_device dev;
+	RT_Battery_status stat;
+	unsigned int seed=1;
+	int fd;
+	uint32_t failed=0;
+
+	bms_sim_init(&sim, STRINGS_COUNT, TEMP_SENSOR_COUNT);
+	sim.baudrate=baudrate;
+	sim.corrupt_permille=corrupt_permille;
+	if(bms_sim_start(&sim)!=0 || bms_transport_linux_open(&line, &port, sim.slave_path, baudrate)!=BMS_TRANSPORT_OK){
+		fprintf(stderr, "bms_capture_tool: cannot start the simulated BMS\n");
+		return 1;
+	}
+	if(tool_create(&cap, &line, path, &fd, cycles, bms_linux_time_us)!=0){
+		return 1;
+	}
+	bms_capture_transport_init(&capturing, &cap);
+	bms_device_init(&dev, &capturing, &stat);
+
+	for(uint32_t c=0;c<cycles;c++){
+		failed+=(bms_device_read_mask(&dev, BMS_MASK_ALL, 1)!=0);
+		pthread_mutex_lock(&sim.lock);
+		tool_drift(&sim, &seed);
+		pthread_mutex_unlock(&sim.lock);
+	}
+	bms_transport_linux_close(&port);
+	bms_sim_stop(&sim);
+	printf("%u reads failed, %u frames corrupted by the simulated harness\n", failed, sim.frames_corrupted);
+	return tool_finish(&cap, fd, cycles);
+}
+
+/**
+ * @brief Stores a decoded cycle in the output of its block.
+ */
+static void tool_collect(void* ctx, uint32_t block, const bms_capture_status* status){
+	tool_block_out* out=&((tool_block_out*)ctx)[block];
+	if(out->count==out->max){
+		out->max=(out->max!=0) ? out->max*2 : 32;
+		out->status=realloc(out->status, out->max*sizeof(bms_capture_status));
+		if(out->status==NULL){
+			abort();
+		}
+	}
+	out->status[out->count++]=*status;
+}
+
+/**
+ * @brief Decodes a whole capture, the cycles in order when out is not NULL.
+ */
+static tool_block_out* tool_decode(const bms_capture_file* file, uint16_t threads, bms_capture_stats* stats, uint8_t collect){
+	tool_block_out* out=NULL;
+	if(collect){
+		out=calloc(file->blocks+1, sizeof(tool_block_out));
+	}
+	bms_capture_file_decode(file, 0, file->blocks, threads, stats, (out!=NULL) ? tool_collect : NULL, out);
+	return out;
+}
+
+/**
+ * @brief Releases the cycles of tool_decode().
+ */
+static void tool_free(tool_block_out* out, uint32_t blocks){
+	for(uint32_t b=0;out!=NULL && b<blocks;b++){
+		free(out[b].status);
+	}
+	free(out);
+}
+
+/**
+ * @brief decode command.
+ */
+static int tool_decode_cmd(const char* path, uint16_t threads, const char* out_path){
+	bms_capture_file file;
+	bms_capture_stats stats;
+	if(bms_capture_file_open(&file, path)!=0){
+		fprintf(stderr, "bms_capture_tool: %s is not a readable capture\n", path);
+		return 1;
+	}
+	printf("%s : %llu bytes, %u blocks (%s), %u strings, %u sensors, %u bps\n", path, (unsigned long long)file.size, file.blocks, (file.indexed) ? "indexed" : "index rebuilt",
+	       file.header.strings_count, file.header.temp_sensor_count, file.header.baudrate);
+
+	uint64_t t0=bms_linux_time_us();
+	tool_block_out* out=tool_decode(&file, threads, &stats, out_path!=NULL);
+	uint64_t us=bms_linux_time_us()-t0;
+	if(us==0){
+		us=1;
+	}
+
+	printf("\n%-22s %14llu\n", "records", (unsigned long long)stats.records);
+	printf("%-22s %14llu\n", "requests", (unsigned long long)stats.requests);
+	printf("%-22s %14llu\n", "retries", (unsigned long long)stats.retries);
+	printf("%-22s %14llu\n", "frames", (unsigned long long)stats.frames);
+	printf("%-22s %14llu\n", "polling cycles", (unsigned long long)stats.statuses);
+	printf("%-22s %14llu\n", "checksum errors", (unsigned long long)stats.checksum_errors);
+	printf("%-22s %14llu\n", "length errors", (unsigned long long)stats.length_errors);
+	printf("%-22s %14llu\n", "sequence errors", (unsigned long long)stats.sequence_errors);
+	printf("%-22s %14llu\n", "unexpected frames", (unsigned long long)stats.unexpected);
+	printf("%-22s %14llu\n", "discarded bytes", (unsigned long long)stats.discarded);
+	printf("%-22s %14llu\n", "damaged blocks", (unsigned long long)stats.bad_blocks);
+	printf("\n%.3f s, %.2f M frames/s, %.0f MB/s of capture\n", us/1e6, stats.frames/(double)us, file.size/(double)us);
+
+	int ret=0;
+	if(out_path!=NULL){
+		FILE* f=fopen(out_path, "wb");
+		for(uint32_t b=0;f!=NULL && b<file.blocks;b++){
+			if(out[b].count!=0 && fwrite(out[b].status, sizeof(bms_capture_status), out[b].count, f)!=out[b].count){
+				break;
+			}
+		}
+		if(f==NULL || fclose(f)!=0){
+			fprintf(stderr, "bms_capture_tool: cannot write %s\n", out_path);
+			ret=1;
+		}
+	}
+	tool_free(out, file.blocks);
+	bms_capture_file_close(&file);
+	return ret;
+}
+
+/**
+ * @brief analytics command, the decoded cycles are folded in capture order into the incremental analytics (bms_analytics.h) as the MCU would fold its reads.
+ */
+static int tool_analytics(const char* path, uint32_t rated_mah){
+	bms_capture_file file;
+	bms_capture_stats stats;
+	static bms_analytics an;
+	bms_cell_view view;
+	if(bms_capture_file_open(&file, path)!=0){
+		fprintf(stderr, "bms_capture_tool: %s is not a readable capture\n", path);
+		return 1;
+	}
+	tool_block_out* out=tool_decode(&file, 0, &stats, 1);
+	uint8_t cells=(file.header.strings_count<STRINGS_COUNT) ? file.header.strings_count : STRINGS_COUNT;
+	bms_analytics_init(&an, cells, rated_mah);
+
+	uint16_t needed=BMS_DATA_ID_MASK(SOC_TOTAL_IV) | BMS_DATA_ID_MASK(CELL_VOLTAGE);
+	uint32_t used=0, skipped=0, steps=0, windows=0;
+	uint64_t t0=bms_linux_time_us();
+	for(uint32_t b=0;b<file.blocks;b++){
+		for(uint32_t i=0;i<out[b].count;i++){
+			const bms_capture_status* status=&out[b].status[i];
+			if((status->mask & needed)!=needed){
+				skipped++;
+				continue;
+			}
+			bms_cells_decode(&view, &status->stat, cells, file.header.temp_sensor_count);
+			uint8_t events=bms_analytics_update(&an, &status->stat, &view, (uint32_t)((status->time_us-file.header.start_us)/1000U));
+			steps+=(events & BMS_ANALYTICS_EV_STEP) ? 1 : 0;
+			windows+=(events & BMS_ANALYTICS_EV_CAPACITY) ? 1 : 0;
+			used++;
+		}
+	}
+	uint64_t us=bms_linux_time_us()-t0;
+
+	bms_pack_health pack;
+	bms_analytics_pack(&an, &pack);
+	printf("%u cycles folded in %.3f ms, %u incomplete skipped, %u gaps, %u current steps, %u capacity windows, %u samples rejected\n\n", used, us/1000.0, skipped, an.gaps,
+	       steps, windows, an.rejected);
+	printf("%4s %10s %10s %10s %10s %10s\n", "cell", "mean (mV)", "sd (mV)", "ofs (mV)", "drift (mV)", "R (uohm)");
+	for(uint8_t c=0;c<an.cells;c++){
+		bms_cell_health cell;
+		bms_analytics_cell(&an, c, &cell);
+		printf("%4u %10.1f %10.2f %10.2f %10.2f %10u\n", c, cell.mean_uv/1000.0, cell.stddev_uv/1000.0, cell.offset_uv/1000.0, cell.drift_uv/1000.0, cell.resistance_uohm);
+	}
+	printf("\nnet charge %d mAh, in %u mAh, out %u mAh, capacity %u mAh, SOH %u permille, pack resistance %u uohm\n", pack.charge_mah, pack.charged_mah, pack.discharged_mah,
+	       pack.capacity_mah, pack.soh_permille, pack.resistance_uohm);
+	printf("highest resistance cell %u, most drifting cell %u\n", pack.worst_cell, pack.drift_cell);
+	tool_free(out, file.blocks);
+	bms_capture_file_close(&file);
+	return 0;
+}
+
+/**
+ * @brief replay command, the driver reads a simulated BMS answering with the recorded frames, every complete read has to match the cycle decoded from the capture.
+ */
+static int tool_replay(const char* path, uint32_t baudrate){
+	static bms_sim sim;
+	bms_capture_file file;
+	bms_capture_stats stats;
+	bms_capture_replay replay;
+	bms_linux_port port;
+	bms_transport line;
+	bms_device dev;
+	RT_Battery_status stat;
+
+	if(bms_capture_file_open(&file, path)!=0){
+		fprintf(stderr, "bms_capture_tool: %s is not a readable capture\n", path);
+		return 1;
+	}
+	tool_block_out* out=tool_decode(&file, 1, &stats, 1);
+	bms_capture_replay_init(&replay, &file);
+	bms_sim_init(&sim, file.header.strings_count, file.header.temp_sensor_count);
+	sim.baudrate=(baudrate!=0) ? baudrate : file.header.baudrate;
+	sim.responder=bms_capture_replay_respond;
+	sim.responder_ctx=&replay;
+	if(bms_sim_start(&sim)!=0 || bms_transport_linux_open(&line, &port, sim.slave_path, sim.baudrate)!=BMS_TRANSPORT_OK){
+		fprintf(stderr, "bms_capture_tool: cannot start the simulated BMS\n");
+		return 1;
+	}
+	bms_device_init(&dev, &line, &stat);
+
+	uint32_t reads=0, matched=0, mismatched=0, skipped=0;
+	uint32_t b=0, i=0;
+	while(!replay.done){
+		memset(&stat, 0x00, sizeof(stat));
+		uint8_t ret=bms_device_read_mask(&dev, BMS_MASK_ALL, 1);
+		if(replay.done){
+			break;		// the capture ran out during this read
+		}
+		while(b<file.blocks && i==out[b].count){
+			b++;
+			i=0;
+		}
+		if(b==file.blocks){
+			break;
+		}
+		const bms_capture_status* recorded=&out[b].status[i++];
+		reads++;
+		if(ret!=0 || recorded->mask!=bms_enabled_mask()){
+			skipped++;
+		}
+		else if(memcmp(&stat, &recorded->stat, sizeof(stat))==0){
+			matched++;
+		}
+		else{
+			mismatched++;
+		}
+	}
+	printf("%u reads replayed, %u match the capture, %u differ, %u incomplete on either side\n", reads, matched, mismatched, skipped);
+	printf("%llu requests answered with %llu recorded frames\n", (unsigned long long)replay.requests, (unsigned long long)replay.frames);
+
+	bms_transport_linux_close(&port);
+	bms_sim_stop(&sim);
+	tool_free(out, file.blocks);
+	bms_capture_file_close(&file);
+	return (mismatched!=0) ? 1 : 0;
+}
+
+int main(int argc, char** argv){
+	if(argc>=4 && strcmp(argv[1], "synth")==0){
+		return tool_synth(argv[2], (uint32_t)strtoul(argv[3], NULL, 0), (argc>4) ? (uint16_t)atoi(argv[4]) : 0);
+	}
+	if(argc>=4 && strcmp(argv[1], "record")==0){
+		return tool_record(argv[2], (uint32_t)strtoul(argv[3], NULL, 0), (argc>4) ? (uint32_t)atoi(argv[4]) : UART_DEFAULT_BAUDRATE, (argc>5) ? (uint16_t)atoi(argv[5]) : 0);
+	}
+	if(argc>=3 && strcmp(argv[1], "decode")==0){
+		return tool_decode_cmd(argv[2], (argc>3) ? (uint16_t)atoi(argv[3]) : 0, (argc>4) ? argv[4] : NULL);
+	}
+	if(argc>=3 && strcmp(argv[1], "analytics")==0){
+		return tool_analytics(argv[2], (argc>3) ? (uint32_t)strtoul(argv[3], NULL, 0) : 0);
+	}
+	if(argc>=3 && strcmp(argv[1], "replay")==0){
+		return tool_replay(argv[2], (argc>3) ? (uint32_t)atoi(argv[3]) : 0);
+	}
+	fprintf(stderr, "usage : %s synth <file> <cycles> [corrupt_permille]\n"
+	                "        %s record <file> <cycles> [baudrate] [corrupt_permille]\n"
+	                "        %s decode <file> [threads] [out]\n"
+	                "        %s analytics <file> [rated_mah]\n"
+	                "        %s replay <file> [baudrate]\n", argv[0], argv[0], argv[0], argv[0], argv[0]);
+	return 1;
+}
@@ -0,0 +1,114 @@
+#include "bms_cells.h"
+#include "bms_transport_linux.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @file bms_cells_bench.c
+ * @brief Benchmark of the cell view kernel (bms_cells.h) against the scalar per cell loop consumers use on the raw cell_voltages bytes.
+ * 	  A rack of packs with random cell voltages is decoded over and over by both, the results are compared and the time per pack is printed.
+ * @author Piyush
+ * @date 12/01/25
+ * @version 1.0
+ *
+ *
+ * @note usage : bms_cells_bench [rounds] [packs]
+ *	 build with -DSTRINGS_COUNT=48 for the largest pack, -O2 on GCC 12+ (-O3 before) to get the vectorized kernel.
+ */
+
+
+// ====================================================================================================== MACROS ==========================================================================================================================
+
+#define BENCH_DEFAULT_ROUNDS		20000
+#define BENCH_DEFAULT_PACKS		32
+#define BENCH_MAX_PACKS			256
+
+
+//==================================================================================== ROUTINE DEFINITIONS ======================================================================================
+
+
+/**
+ * @brief Scalar reference, decodes and compares one cell at a time the way the consumers parse the raw bytes.
+ * @param bms_cell_view* view passes the memory where the view is stored.
+ * @param const RT_Battery_status* stat passes the status.
+ * @param uint8_t cells passes the cells of the pack.
+ * @retval void
+ */
+static void bench_decode_scalar(bms_cell_view* view, const RT_Battery_status* stat, uint8_t cells){
+	uint32_t sum=0;
+	view->min_mv=UINT16_MAX;
+	view->max_mv=0;
+	view->weakest=0;
+	for(uint8_t i=0;i<cells;i++){
+		uint16_t mv=(uint16_t)((stat->cell_voltages[i*MONOMER_VOLTAGE_SIZE]<<8) | stat->cell_voltages[i*MONOMER_VOLTAGE_SIZE+1]);
+		view->cell_mv[i]=mv;
+		if(mv<view->min_mv){
+			view->min_mv=mv;
+			view->weakest=i;
+		}
+		if(mv>view->max_mv){
+			view->max_mv=mv;
+		}
+		sum+=mv;
+	}
+	view->cells=cells;
+	view->mean_mv=(uint16_t)((sum+cells/2)/cells);
+	view->spread_mv=(uint16_t)(view->max_mv-view->min_mv);
+}
+
+int main(int argc, char** argv){
+	uint32_t rounds=(argc>1) ? (uint32_t)atoi(argv[1]) : BENCH_DEFAULT_ROUNDS;
+	uint32_t packs=(argc>2) ? (uint32_t)atoi(argv[2]) : BENCH_DEFAULT_PACKS;
+	if(rounds==0){
+		rounds=BENCH_DEFAULT_ROUNDS;
+	}
+	if(packs==0 || packs>BENCH_MAX_PACKS){
+		packs=BENCH_DEFAULT_PACKS;
+	}
+
+	static RT_Battery_status stats[BENCH_MAX_PACKS];
+	static bms_cell_view views[BENCH_MAX_PACKS], refs[BENCH_MAX_PACKS];
+	unsigned int seed=1;
+	for(uint32_t p=0;p<packs;p++){
+		for(uint8_t i=0;i<STRINGS_COUNT;i++){
+			uint16_t mv=(uint16_t)(3100+rand_r(&seed)%300);
+			stats[p].cell_voltages[i*MONOMER_VOLTAGE_SIZE]=(uint8_t)(mv>>8);
+			stats[p].cell_voltages[i*MONOMER_VOLTAGE_SIZE+1]=(uint8_t)(mv&0xFF);
+		}
+	}
+
+	uint64_t t0=bms_linux_time_us();
+	for(uint32_t r=0;r<rounds;r++){
+		for(uint32_t p=0;p<packs;p++){
+			bench_decode_scalar(&refs[p], &stats[p], STRINGS_COUNT);
+		}
+		__asm__ volatile("" ::: "memory");	// keep every round
+	}
+	uint64_t scalar_us=bms_linux_time_us()-t0;
+
+	t0=bms_linux_time_us();
+	for(uint32_t r=0;r<rounds;r++){
+		for(uint32_t p=0;p<packs;p++){
+			bms_cells_decode(&views[p], &stats[p], STRINGS_COUNT, TEMP_SENSOR_COUNT);
+		}
+		__asm__ volatile("" ::: "memory");
+	}
+	uint64_t kernel_us=bms_linux_time_us()-t0;
+
+	for(uint32_t p=0;p<packs;p++){
+		if(memcmp(views[p].cell_mv, refs[p].cell_mv, sizeof(refs[p].cell_mv))!=0 || views[p].min_mv!=refs[p].min_mv || views[p].max_mv!=refs[p].max_mv
+		   || views[p].mean_mv!=refs[p].mean_mv || views[p].spread_mv!=refs[p].spread_mv || views[p].weakest!=refs[p].weakest){
+			fprintf(stderr, "bms_cells_bench: kernel and scalar loop disagree on pack %u\n", p);
+			return 1;
+		}
+	}
+
+	double n=(double)rounds*packs;
+	printf("%u cells, %u packs, %u rounds\n\n", STRINGS_COUNT, packs, rounds);
+	printf("%-22s %12s %14s\n", "decode", "ns / pack", "packs / s");
+	printf("%-22s %12.1f %14.0f\n", "scalar per cell loop", scalar_us*1000.0/n, n*1e6/scalar_us);
+	printf("%-22s %12.1f %14.0f\n", "bms_cells_decode()", kernel_us*1000.0/n, n*1e6/kernel_us);
+	printf("%-22s %11.1fx\n", "speedup", (double)scalar_us/kernel_us);
+	return 0;
+}
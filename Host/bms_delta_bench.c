@@ -0,0 +1,137 @@
+#include "bms_sim.h"
+#include "bms_delta.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @file bms_delta_bench.c
+ * @brief Uplink volume of the delta publishing (bms_delta.h) against forwarding the whole RT_Battery_status on every refresh.
+ * 	  A simulated pack drifts the way a pack in service does (current moving on every refresh, cells following it with a few mV of noise, temperatures and SOC moving slowly),
+ * 	  its responses are stored through the driver with a tracker attached, and the dirty fields are sent as 8 byte CAN payloads and as one cellular message per refresh.
+ * 	  A receiver applies the messages and is checked to stay within the deadbands of the pack after every refresh.
+ * @author Piyush
+ * @date 12/01/25
+ * @version 1.0
+ *
+ *
+ * @note usage : bms_delta_bench [refreshes] [cell_deadband_mv] [current_deadband_100mA] [keyframe_period]
+ *	 keyframe_period (default 0, none) forces the whole status out every that many refreshes, as a link recovering from lost messages would.
+ */
+
+
+// ====================================================================================================== MACROS ==========================================================================================================================
+
+#define BENCH_DEFAULT_REFRESHES		10000
+#define BENCH_CAN_PAYLOAD		8
+#define BENCH_UPLINK_MESSAGE		256
+
+
+//==================================================================================== ROUTINE DEFINITIONS ======================================================================================
+
+
+/**
+ * @brief Moves the simulated pack by one refresh.
+ * @param bms_sim* sim passes the simulator.
+ * @param uint32_t n passes the refresh number.
+ * @retval void
+ */
+static void bench_step(bms_sim* sim, uint32_t n){
+	bms_sim_values* v=&sim->values;
+	int32_t amps=(int32_t)v->current-30000+(rand()%41)-20;	// 0.1 A steps, load changing on every refresh
+	amps=(amps>400) ? 400 : (amps<-400) ? -400 : amps;
+	v->current=(uint16_t)(30000+amps);
+	uint32_t sum=0;
+	for(uint8_t i=0;i<sim->strings_count;i++){
+		int32_t base=3300+amps/8+(int32_t)((n/500)%20);	// IR drop of the current and slow charge drift
+		v->cell_mv[i]=(uint16_t)(base+(int32_t)i%3+(rand()%5)-2);
+		sum+=v->cell_mv[i];
+	}
+	v->cum_total_voltage=(uint16_t)(sum/100);
+	v->gath_total_voltage=v->cum_total_voltage;
+	if(n%600==0){
+		v->soc=(uint16_t)((v->soc>0) ? v->soc-1 : 1000);
+		v->remain_capacity-=40;
+	}
+	if(n%900==0){
+		v->temp_40[rand()%sim->temp_sensor_count]+=(uint8_t)((rand()&1) ? 1 : -1);
+	}
+}
+
+int main(int argc, char** argv){
+	uint32_t refreshes=(argc>1) ? (uint32_t)atoi(argv[1]) : BENCH_DEFAULT_REFRESHES;
+	uint16_t cell_band=(argc>2) ? (uint16_t)atoi(argv[2]) : 5;
+	uint16_t current_band=(argc>3) ? (uint16_t)atoi(argv[3]) : 1;
+	uint32_t keyframe_period=(argc>4) ? (uint32_t)atoi(argv[4]) : 0;
+
+	static bms_sim sim;
+	bms_sim_init(&sim, STRINGS_COUNT, TEMP_SENSOR_COUNT);
+	srand(1);
+
+	static RT_Battery_status stat, receiver;
+	bms_device dev;
+	bms_device_init(&dev, NULL, &stat);
+	static bms_delta can, uplink, check;
+	bms_delta* trackers[2]={ &can, &uplink };
+	for(uint8_t t=0;t<2;t++){
+		bms_delta_init(trackers[t], dev.strings_count, dev.temp_sensor_count);
+		bms_delta_set_deadband(trackers[t], BMS_DELTA_TAG_CELL, dev.strings_count, cell_band);
+		bms_delta_set_deadband(trackers[t], BMS_DELTA_TAG_MIN_MAX_VOLT, 1, cell_band);
+		bms_delta_set_deadband(trackers[t], BMS_DELTA_TAG_MIN_MAX_VOLT+2, 1, cell_band);
+		bms_delta_set_deadband(trackers[t], BMS_DELTA_TAG_SOC_IV, 2, cell_band*dev.strings_count/100U);	// total voltages in 0.1 V
+		bms_delta_set_deadband(trackers[t], BMS_DELTA_TAG_CURRENT, 1, current_band);
+	}
+	bms_delta_init(&check, dev.strings_count, dev.temp_sensor_count);
+	memcpy(check.deadband, can.deadband, sizeof(check.deadband));
+
+	uint64_t can_frames=0, can_bytes=0, uplink_bytes=0;
+	uint32_t violations=0, bad_messages=0;
+	uart_prot_packet frames[BMS_SIM_MAX_FRAMES];
+	uint8_t buf[BENCH_UPLINK_MESSAGE];
+
+	for(uint32_t n=0;n<refreshes;n++){
+		bench_step(&sim, n);
+		if(keyframe_period!=0 && n%keyframe_period==0){
+			bms_delta_force(&can);
+			bms_delta_force(&uplink);
+		}
+		for(uint8_t t=0;t<2;t++){
+			bms_device_attach_delta(&dev, trackers[t]);	// same frames through both trackers
+			for(uint8_t data_id=SOC_TOTAL_IV;data_id<=BATTERY_FAILURE_STATUS;data_id++){
+				uint8_t count=bms_sim_build_response(&sim, data_id, frames);
+				for(uint8_t f=0;f<count;f++){
+					bms_device_store_frame(&dev, &frames[f]);
+				}
+			}
+		}
+
+		uint16_t len;
+		while((len=bms_delta_encode(&can, &stat, buf, BENCH_CAN_PAYLOAD))!=0){
+			can_frames++;
+			can_bytes+=len;
+			bad_messages+=(bms_delta_apply(&receiver, buf, len)!=0) ? 1 : 0;
+		}
+		uplink_bytes+=bms_delta_encode(&uplink, &stat, buf, sizeof(buf));
+		if(bms_delta_pending(&uplink)!=0){
+			fprintf(stderr, "bms_delta_bench: a refresh did not fit one %u byte message\n", BENCH_UPLINK_MESSAGE);
+			return 1;
+		}
+
+		memcpy(&check.sent, &receiver, sizeof(RT_Battery_status));	// every field of the pack within its deadband of the receiver
+		memset(check.dirty, 0x00, sizeof(check.dirty));
+		bms_delta_scan(&check, &stat);
+		violations+=(bms_delta_pending(&check)!=0) ? 1 : 0;
+	}
+
+	uint64_t full_bytes=(uint64_t)refreshes*sizeof(RT_Battery_status);
+	uint64_t full_frames=(uint64_t)refreshes*((sizeof(RT_Battery_status)+BENCH_CAN_PAYLOAD-1)/BENCH_CAN_PAYLOAD);
+	printf("%u refreshes, %u strings, %u sensors, deadbands %u mV per cell, %u x 0.1 A, keyframe every %u refreshes\n\n", refreshes, dev.strings_count, dev.temp_sensor_count,
+		cell_band, current_band, keyframe_period);
+	printf("%-28s %12s %12s %10s\n", "", "bytes", "per refresh", "reduction");
+	printf("%-28s %12llu %12.1f %10s\n", "whole status", (unsigned long long)full_bytes, (double)full_bytes/refreshes, "1.0x");
+	printf("%-28s %12llu %12.1f %9.1fx\n", "delta, one uplink message", (unsigned long long)uplink_bytes, (double)uplink_bytes/refreshes, (double)full_bytes/uplink_bytes);
+	printf("%-28s %12llu %12.1f %9.1fx\n", "delta, CAN payload bytes", (unsigned long long)can_bytes, (double)can_bytes/refreshes, (double)full_bytes/can_bytes);
+	printf("%-28s %12llu %12.2f %9.1fx\n", "CAN frames (whole / delta)", (unsigned long long)can_frames, (double)can_frames/refreshes, (double)full_frames/can_frames);
+	printf("\nreceiver out of deadband after %u of %u refreshes, %u malformed messages\n", violations, refreshes, bad_messages);
+	return (violations!=0 || bad_messages!=0) ? 1 : 0;
+}
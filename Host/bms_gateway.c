@@ -0,0 +1,323 @@
+#define _GNU_SOURCE
+#include "bms_gateway.h"
+#include "bms_transport_linux.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * @file bms_gateway.c
+ * @brief Source code file for the shared memory gateway declared in bms_gateway.h
+ * @author Piyush
+ * @date 12/01/25
+ * @version 1.0
+ */
+
+
+//==================================================================================== PRIVATE ROUTINES =========================================================================================
+
+/**
+ * @brief Sleeps until an absolute CLOCK_MONOTONIC time or until stop is set by a signal.
+ * @param uint64_t until_us passes the wake up time in microseconds.
+ * @param volatile sig_atomic_t* stop passes the stop flag of the daemon.
+ * @retval void
+ */
+static void bms_gateway_sleep_until(uint64_t until_us, volatile sig_atomic_t* stop){
+	struct timespec ts={ .tv_sec=(time_t)(until_us/1000000U), .tv_nsec=(long)((until_us%1000000U)*1000U) };
+	while(!*stop && clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL)==EINTR){
+	}
+}
+
+
+/**
+ * @brief Tells whether the segment left under a name belongs to a daemon that is still running.
+ * @param const char* name passes the shared memory name.
+ * @retval uint8_t returns 1 if the segment is open to the clients and its daemon process exists, 0 otherwise (no segment, daemon stopped or dead).
+ */
+static uint8_t bms_gateway_owner_alive(const char* name){
+	int fd=shm_open(name, O_RDONLY, 0);
+	if(fd<0){
+		return 0;
+	}
+	struct stat st;
+	uint8_t alive=0;
+	if(fstat(fd, &st)==0 && (size_t)st.st_size>=offsetof(bms_gateway_segment, pid)+sizeof(int32_t)){	// the header fields up to pid are common to every version
+		size_t len=offsetof(bms_gateway_segment, pid)+sizeof(int32_t);
+		void* map=mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+		if(map!=MAP_FAILED){
+			const bms_gateway_segment* seg=(const bms_gateway_segment*)map;
+			pid_t pid=(pid_t)seg->pid;
+			alive=(__atomic_load_n(&seg->magic, __ATOMIC_ACQUIRE)==BMS_GATEWAY_MAGIC && pid>0 && (kill(pid, 0)==0 || errno==EPERM)) ? 1 : 0;	// EPERM : the process exists under another user
+			munmap(map, len);
+		}
+	}
+	close(fd);
+	return alive;
+}
+
+
+//==================================================================================== ROUTINE DEFINITIONS ======================================================================================
+
+
+/**
+ * @brief Creates the segment of a daemon, a segment left under the same name by a daemon that stopped or died is unlinked first (its clients keep their mapping and see it stale).
+ * @param bms_gateway* gw passes the gateway to be filled.
+ * @param const char* name passes the shared memory name, "/name", BMS_GATEWAY_DEFAULT_NAME by default.
+ * @param uint8_t packs passes the packs of the rack, at most BMS_GATEWAY_MAX_PACKS.
+ * @param uint32_t period_ms passes the cycle period, published for the clients.
+ * @retval uint8_t returns BMS_GATEWAY_OK on success, BMS_GATEWAY_ERR_RUNNING if the daemon of the existing segment is still running and one of the other BMS_GATEWAY_ERR_x codes on failure.
+ */
+uint8_t bms_gateway_create(bms_gateway* gw, const char* name, uint8_t packs, uint32_t period_ms){
+	memset(gw, 0x00, sizeof(bms_gateway));
+	if(packs==0 || packs>BMS_GATEWAY_MAX_PACKS){
+		return BMS_GATEWAY_ERR_PACK;
+	}
+	snprintf(gw->name, sizeof(gw->name), "%s", name);
+	if(bms_gateway_owner_alive(gw->name)){
+		return BMS_GATEWAY_ERR_RUNNING;
+	}
+	shm_unlink(gw->name);	// never truncated in place, a client still mapping it would take a SIGBUS
+	int fd=shm_open(gw->name, O_CREAT | O_EXCL | O_RDWR, 0644);
+	if(fd<0){
+		return BMS_GATEWAY_ERR_SHM;
+	}
+	if(ftruncate(fd, sizeof(bms_gateway_segment))!=0){
+		int err=errno;
+		close(fd);
+		shm_unlink(gw->name);
+		errno=err;
+		return BMS_GATEWAY_ERR_SHM;
+	}
+	void* map=mmap(NULL, sizeof(bms_gateway_segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);	// the mapping keeps the object
+	if(map==MAP_FAILED){
+		shm_unlink(gw->name);
+		return BMS_GATEWAY_ERR_MAP;
+	}
+
+	bms_gateway_segment* seg=(bms_gateway_segment*)map;	// zero filled by ftruncate(), magic stays 0 until bms_gateway_ready()
+	seg->version=BMS_GATEWAY_VERSION;
+	seg->status_size=sizeof(RT_Battery_status);
+	seg->segment_size=sizeof(bms_gateway_segment);
+	seg->period_ms=period_ms;
+	seg->pid=(int32_t)getpid();
+	seg->packs=packs;
+	gw->seg=seg;
+	gw->owner=1;
+	return BMS_GATEWAY_OK;
+}
+
+/**
+ * @brief Publishes a pack to its place in the segment, its snapshot and instrumentation block are attached to the device.
+ * @param bms_gateway* gw passes the daemon gateway.
+ * @param uint8_t index passes the pack index, below the packs given to bms_gateway_create().
+ * @param bms_device* dev passes the initialized device of the pack.
+ * @param const char* port passes the tty of the pack, for the clients.
+ * @param uint32_t (*time_us)(void) passes the microsecond tick of the instrumentation, NULL keeps the counters only.
+ * @retval uint8_t returns BMS_GATEWAY_OK on success and BMS_GATEWAY_ERR_PACK for an index out of the rack.
+ */
+uint8_t bms_gateway_attach(bms_gateway* gw, uint8_t index, bms_device* dev, const char* port, uint32_t (*time_us)(void)){
+	if(index>=gw->seg->packs){
+		return BMS_GATEWAY_ERR_PACK;
+	}
+	bms_gateway_pack* pack=&gw->seg->pack[index];
+	bms_device_attach_snapshot(dev, &pack->snap);
+	bms_stats_init(&pack->stats, time_us);
+	bms_device_attach_stats(dev, &pack->stats);
+	pack->health=dev->health;
+	pack->module_addr=dev->module_addr;
+	pack->strings_count=dev->strings_count;
+	pack->temp_sensor_count=dev->temp_sensor_count;
+	snprintf(pack->port, sizeof(pack->port), "%s", port);
+	return BMS_GATEWAY_OK;
+}
+
+/**
+ * @brief Opens the segment to the clients once every pack is attached.
+ * @param bms_gateway* gw passes the daemon gateway.
+ * @retval void
+ */
+void bms_gateway_ready(bms_gateway* gw){
+	__atomic_store_n(&gw->seg->heartbeat_us, bms_linux_time_us(), __ATOMIC_RELAXED);	// the first cycle has its worst case to end before the clients see the daemon stale
+	__atomic_store_n(&gw->seg->magic, BMS_GATEWAY_MAGIC, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Copies the outcome of a cycle of the engine to the packs of the segment and beats the heartbeat, the pack index being the engine slot index.
+ * @param bms_gateway* gw passes the daemon gateway.
+ * @param const bms_multi* multi passes the engine, after bms_multi_run_cycle().
+ * @retval void
+ */
+void bms_gateway_update(bms_gateway* gw, const bms_multi* multi){
+	bms_gateway_segment* seg=gw->seg;
+	uint64_t now=bms_linux_time_us();
+	for(uint8_t i=0;i<multi->count && i<seg->packs;i++){
+		const bms_multi_slot* slot=&multi->slots[i];
+		bms_gateway_pack* pack=&seg->pack[i];
+		if(slot->state==BMS_MULTI_DONE){
+			__atomic_store_n(&pack->refresh_us, now, __ATOMIC_RELAXED);	// 64 bit stores are not single instructions on every Linux target
+		}
+		if(slot->state!=BMS_MULTI_SKIPPED){
+			pack->cycles++;
+			pack->failed_cycles+=(slot->state==BMS_MULTI_FAILED) ? 1 : 0;
+		}
+		pack->error=slot->error;
+		pack->health=slot->dev->health;
+	}
+	seg->cycles++;
+	__atomic_store_n(&seg->heartbeat_us, now, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Polling loop of a daemon, runs the cycles of the engine and updates the segment until stop is set or the cycles are done.
+ * @param bms_gateway* gw passes the daemon gateway, ready.
+ * @param bms_multi* multi passes the engine, one slot per pack in the order of bms_gateway_attach().
+ * @param uint16_t mask passes the data IDs read every cycle, BMS_MASK_ALL for everything enabled.
+ * @param uint32_t cycles passes the number of cycles to run, 0 to run until stop.
+ * @param volatile sig_atomic_t* stop passes the flag set by the signal handler of the daemon.
+ * @retval uint32_t returns the number of cycles run.
+ */
+uint32_t bms_gateway_run(bms_gateway* gw, bms_multi* multi, uint16_t mask, uint32_t cycles, volatile sig_atomic_t* stop){
+	uint64_t period_us=(uint64_t)gw->seg->period_ms*1000U;
+	uint64_t next=bms_linux_time_us();
+	uint32_t done=0;
+	while(!*stop && (cycles==0 || done<cycles)){
+		bms_multi_run_cycle(multi, mask);
+		bms_gateway_update(gw, multi);
+		done++;
+		if(period_us!=0){
+			uint64_t now=bms_linux_time_us();
+			next+=period_us;
+			next=(next<now) ? now : next;	// an overrun delays the next cycles instead of running them back to back to catch up
+			bms_gateway_sleep_until(next, stop);
+		}
+	}
+	return done;
+}
+
+/**
+ * @brief Maps the segment of a daemon read only.
+ * @param bms_gateway* gw passes the client gateway to be filled.
+ * @param const char* name passes the shared memory name of the daemon.
+ * @retval uint8_t returns BMS_GATEWAY_OK on success, BMS_GATEWAY_ERR_CLOSED while the daemon is starting and one of the other BMS_GATEWAY_ERR_x codes on failure.
+ */
+uint8_t bms_gateway_open(bms_gateway* gw, const char* name){
+	memset(gw, 0x00, sizeof(bms_gateway));
+	snprintf(gw->name, sizeof(gw->name), "%s", name);
+	int fd=shm_open(gw->name, O_RDONLY, 0);
+	if(fd<0){
+		return (errno==ENOENT) ? BMS_GATEWAY_ERR_CLOSED : BMS_GATEWAY_ERR_SHM;
+	}
+	struct stat st;
+	if(fstat(fd, &st)!=0){
+		close(fd);
+		return BMS_GATEWAY_ERR_SHM;
+	}
+	if(st.st_size!=(off_t)sizeof(bms_gateway_segment)){
+		close(fd);
+		return (st.st_size==0) ? BMS_GATEWAY_ERR_CLOSED : BMS_GATEWAY_ERR_VERSION;	// 0 between shm_open() and ftruncate() of the daemon
+	}
+	void* map=mmap(NULL, sizeof(bms_gateway_segment), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(map==MAP_FAILED){
+		return BMS_GATEWAY_ERR_MAP;
+	}
+
+	const bms_gateway_segment* seg=(const bms_gateway_segment*)map;
+	uint8_t ret=BMS_GATEWAY_OK;
+	if(__atomic_load_n(&seg->magic, __ATOMIC_ACQUIRE)!=BMS_GATEWAY_MAGIC){
+		ret=BMS_GATEWAY_ERR_CLOSED;
+	}
+	else if(seg->version!=BMS_GATEWAY_VERSION || seg->status_size!=sizeof(RT_Battery_status) || seg->segment_size!=sizeof(bms_gateway_segment)){
+		ret=BMS_GATEWAY_ERR_VERSION;
+	}
+	if(ret!=BMS_GATEWAY_OK){
+		munmap(map, sizeof(bms_gateway_segment));
+		return ret;
+	}
+	gw->seg=(bms_gateway_segment*)map;
+	return BMS_GATEWAY_OK;
+}
+
+/**
+ * @brief Number of packs of the rack.
+ * @param const bms_gateway* gw passes the opened gateway.
+ * @retval uint8_t returns the number of packs.
+ */
+uint8_t bms_gateway_packs(const bms_gateway* gw){
+	return gw->seg->packs;
+}
+
+/**
+ * @brief A pack of the segment, for readers working on the snapshot in place (bms_snapshot_read_begin()) or reading the instrumentation.
+ * @param const bms_gateway* gw passes the opened gateway.
+ * @param uint8_t index passes the pack index.
+ * @retval const bms_gateway_pack* returns the pack, NULL for an index out of the rack.
+ */
+const bms_gateway_pack* bms_gateway_pack_at(const bms_gateway* gw, uint8_t index){
+	return (index<gw->seg->packs) ? &gw->seg->pack[index] : NULL;
+}
+
+/**
+ * @brief Copies the latest status of a pack, without syscall nor lock.
+ * @param const bms_gateway* gw passes the opened gateway.
+ * @param uint8_t index passes the pack index.
+ * @param RT_Battery_status* stat passes the memory where the status is copied.
+ * @param bms_gateway_info* info passes the memory where the state of the pack is copied, can be NULL.
+ * @retval uint32_t returns the sequence number of the copy, 0 if the pack was never read or the index is out of the rack.
+ */
+uint32_t bms_gateway_read(const bms_gateway* gw, uint8_t index, RT_Battery_status* stat, bms_gateway_info* info){
+	const bms_gateway_pack* pack=bms_gateway_pack_at(gw, index);
+	if(pack==NULL){
+		return 0;
+	}
+	uint32_t seq=bms_snapshot_copy(&pack->snap, stat);
+	if(info!=NULL){
+		info->seq=seq;
+		info->refresh_us=__atomic_load_n(&pack->refresh_us, __ATOMIC_RELAXED);
+		info->health=pack->health;
+		info->error=pack->error;
+	}
+	return seq;
+}
+
+/**
+ * @brief Tells whether the daemon behind a segment is still running.
+ * @param const bms_gateway* gw passes the opened gateway.
+ * @param uint64_t max_age_us passes the longest time since the end of the last cycle, a few periods plus bms_multi_worst_case_ms(), 0 to skip the check.
+ * @retval uint8_t returns BMS_GATEWAY_OK, BMS_GATEWAY_ERR_CLOSED once the daemon stopped or BMS_GATEWAY_ERR_STALE if it stopped cycling.
+ */
+uint8_t bms_gateway_check(const bms_gateway* gw, uint64_t max_age_us){
+	if(__atomic_load_n(&gw->seg->magic, __ATOMIC_ACQUIRE)!=BMS_GATEWAY_MAGIC){
+		return BMS_GATEWAY_ERR_CLOSED;
+	}
+	uint64_t heartbeat=__atomic_load_n(&gw->seg->heartbeat_us, __ATOMIC_ACQUIRE);
+	if(max_age_us!=0 && bms_linux_time_us()-heartbeat>max_age_us){	// clock_gettime() goes through the vDSO, still no syscall
+		return BMS_GATEWAY_ERR_STALE;
+	}
+	return BMS_GATEWAY_OK;
+}
+
+/**
+ * @brief Unmaps a segment, the daemon also closes it to the clients and unlinks its name.
+ * @param bms_gateway* gw passes the gateway.
+ * @retval void
+ */
+void bms_gateway_close(bms_gateway* gw){
+	if(gw->seg==NULL){
+		return;
+	}
+	if(gw->owner){
+		__atomic_store_n(&gw->seg->magic, 0, __ATOMIC_RELEASE);
+		shm_unlink(gw->name);
+	}
+	munmap(gw->seg, sizeof(bms_gateway_segment));
+	gw->seg=NULL;
+}
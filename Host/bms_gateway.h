@@ -0,0 +1,215 @@
+#ifndef BMS_GATEWAY_H
+#define BMS_GATEWAY_H
+
+#include "bms_multi.h"
+#include <signal.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @file bms_gateway.h
+ * @brief Header file for the shared memory gateway defined in bms_gateway.c
+ * 	  One daemon (Host/bms_gatewayd.c) owns the ports of the rack and runs the polling cycles, every pack of the rack is published to a POSIX shared memory segment
+ * 	  that any number of local processes (dashboard, logger, charger controller ...) map read only. The driver decodes the responses straight into the bms_snapshot
+ * 	  of the pack inside the segment, so a reader gets the latest status with the seqlock of bms_snapshot_read_begin()/bms_snapshot_read_retry() : a copy of a few
+ * 	  hundred bytes, no syscall, no lock, and a reader that stalls or dies never holds back the daemon or the other readers.
+ * @author Piyush
+ * @date 12/01/25
+ * @version 1.0
+ *
+ *
+ * @note The daemon and its clients have to be built with the same access macros and STRINGS_COUNT/TEMP_SENSOR_COUNT, bms_gateway_open() checks the version and the
+ *	 sizes of the segment and refuses a daemon built otherwise.
+ *	 A restarted daemon creates a new segment under the same name, the clients still mapping the old one see it closed (bms_gateway_check()) and open the name again.
+ *	 The health, error and refresh time of a pack are written right after its snapshot is published, outside of the seqlock, they may lag the status by one cycle.
+ *
+ *	 Example (client) :
+ *		bms_gateway_open(&gw, BMS_GATEWAY_DEFAULT_NAME);
+ *		if(bms_gateway_read(&gw, 0, &stat, &info)!=0 && info.health==BMS_HEALTH_ONLINE){ ... }
+ *		if(bms_gateway_check(&gw, 5000000)!=BMS_GATEWAY_OK){ bms_gateway_close(&gw); reopen ... }
+ */
+
+
+// ====================================================================================================== MACROS ==========================================================================================================================
+
+#define BMS_GATEWAY_MAGIC		0x47534D42	/**< "BMSG", written last by the daemon once the segment is ready	*/
+#define BMS_GATEWAY_VERSION		0x0001
+#define BMS_GATEWAY_DEFAULT_NAME	"/bms_gateway"
+#define BMS_GATEWAY_MAX_PACKS		BMS_MULTI_MAX_DEVICES
+#define BMS_GATEWAY_NAME_SIZE		64		/**< shared memory names and port paths					*/
+#define BMS_GATEWAY_CACHE_LINE		64		/**< alignment of the packs, a reader of one pack never shares a line with the writes of another	*/
+
+/**
+ * @brief error codes of the gateway routines.
+ */
+#define BMS_GATEWAY_OK			0x00
+#define BMS_GATEWAY_ERR_SHM		0x01		/**< shm_open(), ftruncate() or fstat() failed, errno is kept			*/
+#define BMS_GATEWAY_ERR_MAP		0x02		/**< mmap() failed								*/
+#define BMS_GATEWAY_ERR_VERSION		0x03		/**< segment of another version or built with other access macros		*/
+#define BMS_GATEWAY_ERR_CLOSED		0x04		/**< daemon not ready yet or stopped, the name has to be opened again		*/
+#define BMS_GATEWAY_ERR_STALE		0x05		/**< no cycle ended within the age given to bms_gateway_check()		*/
+#define BMS_GATEWAY_ERR_PACK		0x06		/**< pack index out of the rack							*/
+#define BMS_GATEWAY_ERR_RUNNING		0x07		/**< another daemon is running on the name, its segment is left untouched	*/
+
+
+//================================================================================ GATEWAY STRUCTURES ===========================================================================================================
+
+/**
+ * @brief structure of one pack in the segment.
+ */
+typedef struct {
+	bms_snapshot snap;		/**< status of the pack, the driver of the daemon decodes into its back buffer		*/
+	bms_stats stats;		/**< driver instrumentation of the pack, its tick pointer is the daemon's and is never called by a client	*/
+	volatile uint64_t refresh_us;	/**< end of the last successful read, CLOCK_MONOTONIC in microseconds, 0 before the first	*/
+	volatile uint32_t cycles;	/**< cycles this pack took part in, skipped ones excluded				*/
+	volatile uint32_t failed_cycles;	/**< cycles ended with an error							*/
+	volatile uint8_t health;	/**< one of BMS_HEALTH_x of the device							*/
+	volatile uint8_t error;		/**< bms_read() error code of the last cycle, 0 if it succeeded				*/
+	uint8_t module_addr;		/**< address of the pack on its port							*/
+	uint8_t strings_count;		/**< cells of the pack, the cell voltages beyond are not refreshed			*/
+	uint8_t temp_sensor_count;	/**< sensors of the pack								*/
+	char port[BMS_GATEWAY_NAME_SIZE];	/**< tty of the pack								*/
+} __attribute__((aligned(BMS_GATEWAY_CACHE_LINE))) bms_gateway_pack;
+
+/**
+ * @brief structure of the shared memory segment.
+ */
+typedef struct {
+	volatile uint32_t magic;	/**< BMS_GATEWAY_MAGIC while the daemon runs, 0 before it is ready and once it stopped	*/
+	uint16_t version;		/**< BMS_GATEWAY_VERSION								*/
+	uint16_t status_size;		/**< sizeof(RT_Battery_status) of the daemon						*/
+	uint32_t segment_size;		/**< sizeof(bms_gateway_segment) of the daemon						*/
+	uint32_t period_ms;		/**< cycle period of the daemon, 0 for back to back cycles				*/
+	int32_t pid;			/**< process of the daemon								*/
+	uint8_t packs;			/**< packs of the rack, pack[0] to pack[packs-1]					*/
+	volatile uint32_t cycles;	/**< cycles run by the daemon								*/
+	volatile uint64_t heartbeat_us;	/**< end of the last cycle, CLOCK_MONOTONIC in microseconds				*/
+	bms_gateway_pack pack[BMS_GATEWAY_MAX_PACKS];
+} bms_gateway_segment;
+
+/**
+ * @brief structure of a mapped segment, on the daemon side or on a client side.
+ */
+typedef struct {
+	bms_gateway_segment* seg;	/**< mapping, read only for the clients, NULL when closed				*/
+	uint8_t owner;			/**< 1 for the daemon, which unlinks the name on bms_gateway_close()			*/
+	char name[BMS_GATEWAY_NAME_SIZE];
+} bms_gateway;
+
+/**
+ * @brief structure of the pack state returned along with a status by bms_gateway_read().
+ */
+typedef struct {
+	uint32_t seq;			/**< publications of the status, 0 before the first read of the pack			*/
+	uint64_t refresh_us;		/**< end of the last successful read							*/
+	uint8_t health;			/**< one of BMS_HEALTH_x								*/
+	uint8_t error;			/**< bms_read() error code of the last cycle						*/
+} bms_gateway_info;
+
+
+//======================================================================================== ROUTINE DECLARATION ===================================================================================================
+
+/**
+ * @brief Creates the segment of a daemon, a segment left under the same name by a daemon that stopped or died is unlinked first (its clients keep their mapping and see it stale).
+ * @param bms_gateway* gw passes the gateway to be filled.
+ * @param const char* name passes the shared memory name, "/name", BMS_GATEWAY_DEFAULT_NAME by default.
+ * @param uint8_t packs passes the packs of the rack, at most BMS_GATEWAY_MAX_PACKS.
+ * @param uint32_t period_ms passes the cycle period, published for the clients.
+ * @retval uint8_t returns BMS_GATEWAY_OK on success, BMS_GATEWAY_ERR_RUNNING if the daemon of the existing segment is still running and one of the other BMS_GATEWAY_ERR_x codes on failure.
+ */
+uint8_t bms_gateway_create(bms_gateway* gw, const char* name, uint8_t packs, uint32_t period_ms);
+
+/**
+ * @brief Publishes a pack to its place in the segment, its snapshot and instrumentation block are attached to the device.
+ * @param bms_gateway* gw passes the daemon gateway.
+ * @param uint8_t index passes the pack index, below the packs given to bms_gateway_create().
+ * @param bms_device* dev passes the initialized device of the pack.
+ * @param const char* port passes the tty of the pack, for the clients.
+ * @param uint32_t (*time_us)(void) passes the microsecond tick of the instrumentation, NULL keeps the counters only.
+ * @retval uint8_t returns BMS_GATEWAY_OK on success and BMS_GATEWAY_ERR_PACK for an index out of the rack.
+ */
+uint8_t bms_gateway_attach(bms_gateway* gw, uint8_t index, bms_device* dev, const char* port, uint32_t (*time_us)(void));
+
+/**
+ * @brief Opens the segment to the clients once every pack is attached.
+ * @param bms_gateway* gw passes the daemon gateway.
+ * @retval void
+ */
+void bms_gateway_ready(bms_gateway* gw);
+
+/**
+ * @brief Copies the outcome of a cycle of the engine to the packs of the segment and beats the heartbeat, the pack index being the engine slot index.
+ * @param bms_gateway* gw passes the daemon gateway.
+ * @param const bms_multi* multi passes the engine, after bms_multi_run_cycle().
+ * @retval void
+ */
+void bms_gateway_update(bms_gateway* gw, const bms_multi* multi);
+
+/**
+ * @brief Polling loop of a daemon, runs the cycles of the engine and updates the segment until stop is set or the cycles are done.
+ * @param bms_gateway* gw passes the daemon gateway, ready.
+ * @param bms_multi* multi passes the engine, one slot per pack in the order of bms_gateway_attach().
+ * @param uint16_t mask passes the data IDs read every cycle, BMS_MASK_ALL for everything enabled.
+ * @param uint32_t cycles passes the number of cycles to run, 0 to run until stop.
+ * @param volatile sig_atomic_t* stop passes the flag set by the signal handler of the daemon.
+ * @retval uint32_t returns the number of cycles run.
+ */
+uint32_t bms_gateway_run(bms_gateway* gw, bms_multi* multi, uint16_t mask, uint32_t cycles, volatile sig_atomic_t* stop);
+
+/**
+ * @brief Maps the segment of a daemon read only.
+ * @param bms_gateway* gw passes the client gateway to be filled.
+ * @param const char* name passes the shared memory name of the daemon.
+ * @retval uint8_t returns BMS_GATEWAY_OK on success, BMS_GATEWAY_ERR_CLOSED while the daemon is starting and one of the other BMS_GATEWAY_ERR_x codes on failure.
+ */
+uint8_t bms_gateway_open(bms_gateway* gw, const char* name);
+
+/**
+ * @brief Number of packs of the rack.
+ * @param const bms_gateway* gw passes the opened gateway.
+ * @retval uint8_t returns the number of packs.
+ */
+uint8_t bms_gateway_packs(const bms_gateway* gw);
+
+/**
+ * @brief A pack of the segment, for readers working on the snapshot in place (bms_snapshot_read_begin()) or reading the instrumentation.
+ * @param const bms_gateway* gw passes the opened gateway.
+ * @param uint8_t index passes the pack index.
+ * @retval const bms_gateway_pack* returns the pack, NULL for an index out of the rack.
+ */
+const bms_gateway_pack* bms_gateway_pack_at(const bms_gateway* gw, uint8_t index);
+
+/**
+ * @brief Copies the latest status of a pack, without syscall nor lock.
+ * @param const bms_gateway* gw passes the opened gateway.
+ * @param uint8_t index passes the pack index.
+ * @param RT_Battery_status* stat passes the memory where the status is copied.
+ * @param bms_gateway_info* info passes the memory where the state of the pack is copied, can be NULL.
+ * @retval uint32_t returns the sequence number of the copy, 0 if the pack was never read or the index is out of the rack.
+ */
+uint32_t bms_gateway_read(const bms_gateway* gw, uint8_t index, RT_Battery_status* stat, bms_gateway_info* info);
+
+/**
+ * @brief Tells whether the daemon behind a segment is still running.
+ * @param const bms_gateway* gw passes the opened gateway.
+ * @param uint64_t max_age_us passes the longest time since the end of the last cycle, a few periods plus bms_multi_worst_case_ms(), 0 to skip the check.
+ * @retval uint8_t returns BMS_GATEWAY_OK, BMS_GATEWAY_ERR_CLOSED once the daemon stopped or BMS_GATEWAY_ERR_STALE if it stopped cycling.
+ */
+uint8_t bms_gateway_check(const bms_gateway* gw, uint64_t max_age_us);
+
+/**
+ * @brief Unmaps a segment, the daemon also closes it to the clients and unlinks its name.
+ * @param bms_gateway* gw passes the gateway.
+ * @retval void
+ */
+void bms_gateway_close(bms_gateway* gw);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /**< BMS_GATEWAY_H  */
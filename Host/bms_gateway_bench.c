@@ -0,0 +1,360 @@
+#include "bms_sim.h"
+#include "bms_gateway.h"
+#include "bms_transport_linux.h"
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * @file bms_gateway_bench.c
+ * @brief End to end test of the shared memory gateway (bms_gateway.h) against simulated DALY BMS(s), one pseudo terminal per pack.
+ * 	  A daemon process polls the packs back to back while reader processes copy the statuses out of the segment as fast as they can and the cell voltages of the packs
+ * 	  keep changing : every copy has to come from the right pack, with all its cells from the same response, and the latency of the copies is measured.
+ * 	  A second daemon created on the same name has to be refused, the daemon is then stopped and the readers have to see the segment closed.
+ * @author Piyush
+ * @date 12/01/25
+ * @version 1.0
+ *
+ *
+ * @note usage : bms_gateway_bench [packs] [readers] [seconds] [bms_gatewayd]
+ *	 With the path of a bms_gatewayd binary the daemon is that binary, otherwise a child process runs bms_gateway_run() the same way.
+ *	 The voluntary context switches of the readers are printed, a reader that never makes a syscall while copying has none.
+ */
+
+
+// ====================================================================================================== MACROS ==========================================================================================================================
+
+#define BENCH_DEFAULT_PACKS		4
+#define BENCH_DEFAULT_READERS		4
+#define BENCH_DEFAULT_SECONDS		3
+#define BENCH_MAX_READERS		32
+#define BENCH_OPEN_TIMEOUT_US		5000000U	/**< time given to the daemon to open the segment			*/
+#define BENCH_LATENCY_STEP_NS		10		/**< width of the latency histogram buckets				*/
+#define BENCH_LATENCY_BUCKETS		1000		/**< latencies above 10 us land in the last bucket			*/
+
+
+//================================================================================== BENCH STRUCTURES ===========================================================================================================
+
+/**
+ * @brief structure of the results of one reader process, in memory shared with the bench.
+ */
+typedef struct {
+	uint64_t reads;			/**< statuses copied						*/
+	uint64_t unpublished;		/**< copies of a pack never read yet				*/
+	uint64_t wrong_pack;		/**< copies carrying the SOC of another pack			*/
+	uint64_t torn;			/**< copies mixing the cells of two responses			*/
+	uint64_t updates;		/**< new publications seen, summed over the packs		*/
+	uint64_t max_ns;		/**< slowest copy						*/
+	long switches;			/**< voluntary context switches while copying			*/
+	uint8_t open_error;		/**< bms_gateway_open() error, 0 on success			*/
+	uint8_t closed_seen;		/**< 1 once bms_gateway_check() reported the daemon stopped	*/
+	uint32_t hist[BENCH_LATENCY_BUCKETS];
+} bench_result;
+
+/**
+ * @brief structure shared between the bench and its readers.
+ */
+typedef struct {
+	volatile uint8_t stop_reading;	/**< set at the end of the run				*/
+	volatile uint8_t daemon_stopped;	/**< set once the daemon exited			*/
+	bench_result results[BENCH_MAX_READERS];
+} bench_shared;
+
+
+//==================================================================================== ROUTINE DEFINITIONS ======================================================================================
+
+static volatile sig_atomic_t bench_daemon_stop;
+
+/**
+ * @brief SIGTERM handler of the in-process daemon.
+ */
+static void bench_daemon_signal(int sig){
+	(void)sig;
+	bench_daemon_stop=1;
+}
+
+/**
+ * @brief Microsecond tick of the driver instrumentation.
+ */
+static uint32_t bench_time_us(void){
+	return (uint32_t)bms_linux_time_us();
+}
+
+/**
+ * @brief Millisecond tick of the engine.
+ */
+static uint32_t bench_time_ms(void){
+	return (uint32_t)(bms_linux_time_us()/1000U);
+}
+
+/**
+ * @brief Nanosecond clock of the copy latencies.
+ */
+static uint64_t bench_time_ns(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec*1000000000U+(uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Body of the in-process daemon, the setup of bms_gatewayd with back to back cycles.
+ * @retval int returns the exit code of the process.
+ */
+static int bench_daemon(const char* name, bms_sim* sims, uint8_t packs){
+	static bms_linux_port ports[BMS_GATEWAY_MAX_PACKS];
+	static bms_transport transports[BMS_GATEWAY_MAX_PACKS];
+	static bms_device devices[BMS_GATEWAY_MAX_PACKS];
+	bms_gateway gw;
+	bms_multi rack;
+	if(bms_gateway_create(&gw, name, packs, 0)!=BMS_GATEWAY_OK || bms_multi_init(&rack, bench_time_ms)!=0){
+		return 1;
+	}
+	for(uint8_t i=0;i<packs;i++){
+		bms_device_init(&devices[i], &transports[i], NULL);
+		if(bms_transport_linux_open(&transports[i], &ports[i], sims[i].slave_path, sims[i].baudrate)!=BMS_TRANSPORT_OK || bms_multi_add(&rack, &devices[i])!=0){
+			bms_gateway_close(&gw);
+			return 1;
+		}
+		bms_gateway_attach(&gw, i, &devices[i], sims[i].slave_path, bench_time_us);
+	}
+	struct sigaction sa;
+	memset(&sa, 0x00, sizeof(sa));
+	sa.sa_handler=bench_daemon_signal;
+	sigaction(SIGTERM, &sa, NULL);
+	bms_gateway_ready(&gw);
+	bms_gateway_run(&gw, &rack, BMS_MASK_ALL, 0, &bench_daemon_stop);
+	bms_gateway_close(&gw);
+	bms_multi_close(&rack);
+	return 0;
+}
+
+/**
+ * @brief Starts the daemon process.
+ * @retval pid_t returns the process, -1 on failure.
+ */
+static pid_t bench_start_daemon(const char* path, const char* name, bms_sim* sims, uint8_t packs){
+	pid_t pid=fork();
+	if(pid!=0){
+		return pid;
+	}
+	if(path==NULL){
+		_exit(bench_daemon(name, sims, packs));
+	}
+	char* args[BMS_GATEWAY_MAX_PACKS+8];
+	uint8_t n=0;
+	args[n++]=(char*)path;
+	args[n++]="-n";
+	args[n++]=(char*)name;
+	args[n++]="-p";
+	args[n++]="0";
+	for(uint8_t i=0;i<packs;i++){
+		args[n++]=sims[i].slave_path;
+	}
+	args[n]=NULL;
+	execv(path, args);
+	_exit(127);
+}
+
+/**
+ * @brief Tells whether all the cell voltages of a status are equal, the bench sets them all at once.
+ */
+static uint8_t bench_cells_equal(const RT_Battery_status* stat){
+	for(uint8_t i=1;i<STRINGS_COUNT;i++){
+		if(stat->cell_voltages[i*MONOMER_VOLTAGE_SIZE]!=stat->cell_voltages[0] || stat->cell_voltages[i*MONOMER_VOLTAGE_SIZE+1]!=stat->cell_voltages[1]){
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/**
+ * @brief Body of a reader process, copies the packs one after the other until the end of the run, then waits for the daemon to be seen stopped.
+ */
+static void bench_reader(const char* name, bench_shared* shared, bench_result* r){
+	bms_gateway gw;
+	r->open_error=bms_gateway_open(&gw, name);
+	if(r->open_error!=BMS_GATEWAY_OK){
+		return;
+	}
+	uint8_t packs=bms_gateway_packs(&gw);
+	uint32_t last_seq[BMS_GATEWAY_MAX_PACKS];
+	memset(last_seq, 0x00, sizeof(last_seq));
+	RT_Battery_status stat;
+	struct rusage before, after;
+	getrusage(RUSAGE_SELF, &before);
+
+	for(uint8_t p=0;!shared->stop_reading;p=(uint8_t)((p+1<packs) ? p+1 : 0)){
+		uint64_t t0=bench_time_ns();
+		uint32_t seq=bms_gateway_read(&gw, p, &stat, NULL);
+		uint64_t ns=bench_time_ns()-t0;
+		r->hist[(ns/BENCH_LATENCY_STEP_NS<BENCH_LATENCY_BUCKETS) ? ns/BENCH_LATENCY_STEP_NS : BENCH_LATENCY_BUCKETS-1]++;
+		r->max_ns=(ns>r->max_ns) ? ns : r->max_ns;
+		r->reads++;
+		if(seq==0){
+			r->unpublished++;
+			continue;
+		}
+		r->updates+=(seq!=last_seq[p]) ? 1 : 0;
+		last_seq[p]=seq;
+		r->wrong_pack+=(stat.soc!=500+p) ? 1 : 0;
+		r->torn+=(bench_cells_equal(&stat)==0) ? 1 : 0;
+	}
+
+	getrusage(RUSAGE_SELF, &after);
+	r->switches=after.ru_nvcsw-before.ru_nvcsw;
+	while(!shared->daemon_stopped){
+		usleep(1000);
+	}
+	r->closed_seen=(bms_gateway_check(&gw, 0)==BMS_GATEWAY_ERR_CLOSED) ? 1 : 0;
+	bms_gateway_close(&gw);
+}
+
+/**
+ * @brief Latency below which a share of the copies lies.
+ */
+static uint64_t bench_percentile_ns(const uint64_t* hist, uint64_t count, uint16_t permille){
+	uint64_t rank=(count*permille+999)/1000, seen=0;
+	for(uint32_t b=0;b<BENCH_LATENCY_BUCKETS;b++){
+		seen+=hist[b];
+		if(seen>=rank){
+			return (uint64_t)(b+1)*BENCH_LATENCY_STEP_NS;
+		}
+	}
+	return (uint64_t)BENCH_LATENCY_BUCKETS*BENCH_LATENCY_STEP_NS;
+}
+
+int main(int argc, char** argv){
+	uint32_t packs=(argc>1) ? (uint32_t)atoi(argv[1]) : BENCH_DEFAULT_PACKS;
+	uint32_t readers=(argc>2) ? (uint32_t)atoi(argv[2]) : BENCH_DEFAULT_READERS;
+	uint32_t seconds=(argc>3) ? (uint32_t)atoi(argv[3]) : BENCH_DEFAULT_SECONDS;
+	const char* daemon_path=(argc>4) ? argv[4] : NULL;
+	if(packs==0 || packs>BMS_GATEWAY_MAX_PACKS){
+		packs=BENCH_DEFAULT_PACKS;
+	}
+	if(readers==0 || readers>BENCH_MAX_READERS){
+		readers=BENCH_DEFAULT_READERS;
+	}
+
+	static bms_sim sims[BMS_GATEWAY_MAX_PACKS];
+	for(uint32_t i=0;i<packs;i++){
+		bms_sim_init(&sims[i], STRINGS_COUNT, TEMP_SENSOR_COUNT);
+		sims[i].values.soc=(uint16_t)(500+i);
+		if(bms_sim_start(&sims[i])!=0){
+			fprintf(stderr, "bms_gateway_bench: cannot start simulated pack %u\n", i);
+			return 1;
+		}
+	}
+	char name[BMS_GATEWAY_NAME_SIZE];
+	snprintf(name, sizeof(name), "/bms_gateway_bench.%d", (int)getpid());
+	bench_shared* shared=mmap(NULL, sizeof(bench_shared), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if(shared==MAP_FAILED){
+		return 1;
+	}
+	memset(shared, 0x00, sizeof(bench_shared));
+
+	pid_t daemon=bench_start_daemon(daemon_path, name, sims, (uint8_t)packs);
+	bms_gateway gw;
+	uint8_t ret=BMS_GATEWAY_ERR_CLOSED;
+	for(uint64_t end=bms_linux_time_us()+BENCH_OPEN_TIMEOUT_US;daemon>0 && ret==BMS_GATEWAY_ERR_CLOSED && bms_linux_time_us()<end;){
+		ret=bms_gateway_open(&gw, name);
+		usleep((ret==BMS_GATEWAY_OK) ? 0 : 1000);
+	}
+	if(ret!=BMS_GATEWAY_OK){
+		fprintf(stderr, "bms_gateway_bench: the daemon did not open %s (error %u)\n", name, ret);
+		if(daemon>0){
+			kill(daemon, SIGKILL);
+		}
+		return 1;
+	}
+
+	pid_t pids[BENCH_MAX_READERS];
+	for(uint32_t r=0;r<readers;r++){
+		pids[r]=fork();
+		if(pids[r]==0){
+			bench_reader(name, shared, &shared->results[r]);
+			_exit(0);
+		}
+	}
+	uint64_t end=bms_linux_time_us()+(uint64_t)seconds*1000000U;
+	for(uint16_t mv=3000;bms_linux_time_us()<end;mv=(mv>=3500) ? 3000 : mv+1){
+		for(uint32_t i=0;i<packs;i++){
+			pthread_mutex_lock(&sims[i].lock);
+			for(uint8_t c=0;c<sims[i].strings_count;c++){
+				sims[i].values.cell_mv[c]=mv;
+			}
+			pthread_mutex_unlock(&sims[i].lock);
+		}
+		usleep(3000);	// a few changes per 0x95 response
+	}
+	shared->stop_reading=1;
+
+	printf("%u packs, %u readers, %u s, daemon %s\n\n", packs, readers, seconds, (daemon_path!=NULL) ? daemon_path : "in process");
+	printf("%6s %8s %8s %9s %7s %10s %10s %12s\n", "pack", "cycles", "failed", "health", "error", "publish", "rx bytes", "rsp p99 (ms)");
+	uint32_t cycles=gw.seg->cycles;
+	for(uint8_t i=0;i<packs;i++){
+		const bms_gateway_pack* pack=bms_gateway_pack_at(&gw, i);
+		bms_gateway_info info;
+		RT_Battery_status stat;
+		bms_gateway_read(&gw, i, &stat, &info);
+		bms_id_stats total;
+		bms_stats_sum(&pack->stats, BMS_MASK_ALL, &total);
+		printf("%6u %8u %8u %9u %7u %10u %10u %12.2f\n", i, pack->cycles, pack->failed_cycles, info.health, info.error, info.seq, total.rx_bytes,
+			bms_stats_percentile_us(&total, BMS_STATS_RESPONSE, 990)/1000.0);
+	}
+	uint8_t alive=bms_gateway_check(&gw, 0);
+	bms_gateway second;
+	uint8_t refused=bms_gateway_create(&second, name, (uint8_t)packs, 0);	// a second daemon on the name must leave the running one alone
+	if(refused==BMS_GATEWAY_OK){
+		bms_gateway_close(&second);
+	}
+
+	kill(daemon, SIGTERM);
+	int status=0;
+	waitpid(daemon, &status, 0);
+	shared->daemon_stopped=1;
+	uint8_t closed=bms_gateway_check(&gw, 0);
+	bms_gateway_close(&gw);
+	uint8_t reopened=bms_gateway_open(&gw, name);
+
+	static uint64_t hist[BENCH_LATENCY_BUCKETS];
+	uint64_t reads=0, unpublished=0, wrong=0, torn=0, updates=0, max_ns=0;
+	long switches=0;
+	uint32_t open_errors=0, closed_seen=0;
+	for(uint32_t r=0;r<readers;r++){
+		waitpid(pids[r], NULL, 0);
+		const bench_result* res=&shared->results[r];
+		open_errors+=(res->open_error!=0) ? 1 : 0;
+		closed_seen+=res->closed_seen;
+		reads+=res->reads;
+		unpublished+=res->unpublished;
+		wrong+=res->wrong_pack;
+		torn+=res->torn;
+		updates+=res->updates;
+		switches+=res->switches;
+		max_ns=(res->max_ns>max_ns) ? res->max_ns : max_ns;
+		for(uint32_t b=0;b<BENCH_LATENCY_BUCKETS;b++){
+			hist[b]+=res->hist[b];
+		}
+	}
+	for(uint32_t i=0;i<packs;i++){
+		bms_sim_stop(&sims[i]);
+	}
+
+	printf("\n%u daemon cycles, %llu copies (%.1f M/s), %llu new publications seen, %llu before the first publication\n", cycles, (unsigned long long)reads,
+		reads/(seconds*1e6), (unsigned long long)updates, (unsigned long long)unpublished);
+	printf("copy latency p50 %llu ns, p99 %llu ns, max %.1f us, %ld voluntary context switches while copying\n", (unsigned long long)bench_percentile_ns(hist, reads, 500),
+		(unsigned long long)bench_percentile_ns(hist, reads, 990), max_ns/1000.0, switches);
+	printf("%llu copies from another pack, %llu torn, %u readers failed to open, second daemon %s, daemon exit %d, closed seen by %u/%u readers and the bench %s, name %s\n",
+		(unsigned long long)wrong, (unsigned long long)torn, open_errors, (refused==BMS_GATEWAY_ERR_RUNNING) ? "refused" : "NOT refused", WIFEXITED(status) ? WEXITSTATUS(status) : -1,
+		closed_seen, readers, (closed==BMS_GATEWAY_ERR_CLOSED) ? "yes" : "no", (reopened==BMS_GATEWAY_ERR_CLOSED) ? "unlinked" : "still there");
+
+	uint8_t ok=(alive==BMS_GATEWAY_OK && refused==BMS_GATEWAY_ERR_RUNNING && wrong==0 && torn==0 && open_errors==0 && updates!=0 && WIFEXITED(status) && WEXITSTATUS(status)==0 &&
+		closed==BMS_GATEWAY_ERR_CLOSED && closed_seen==readers && reopened==BMS_GATEWAY_ERR_CLOSED);
+	return ok ? 0 : 1;
+}
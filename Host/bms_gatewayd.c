@@ -0,0 +1,160 @@
+#include "bms_gateway.h"
+#include "bms_transport_linux.h"
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * @file bms_gatewayd.c
+ * @brief Gateway daemon, owns the ports of a rack, polls every pack with the multi pack engine (bms_multi.h) and publishes the statuses to a shared memory segment
+ * 	  read by any number of local clients through bms_gateway_open()/bms_gateway_read() (bms_gateway.h).
+ * @author Piyush
+ * @date 12/01/25
+ * @version 1.0
+ *
+ *
+ * @note usage : bms_gatewayd [-n shm_name] [-p period_ms] [-b baudrate] [-c cycles] tty[:module_addr[:strings[:sensors]]] ...
+ *	 One tty per pack, in the order of the pack indexes of the clients. module_addr is hexadecimal (UPPER_CMPTR_ADDR, 0x40, by default), strings and sensors default to STRINGS_COUNT
+ *	 and TEMP_SENSOR_COUNT. period_ms 0 polls back to back, cycles 0 (default) runs until SIGINT/SIGTERM, which close the segment to the clients and unlink it.
+ */
+
+
+// ====================================================================================================== MACROS ==========================================================================================================================
+
+#define GATEWAYD_DEFAULT_PERIOD_MS	500
+
+
+//==================================================================================== ROUTINE DEFINITIONS ======================================================================================
+
+static volatile sig_atomic_t gatewayd_stop;
+
+/**
+ * @brief SIGINT/SIGTERM handler, ends the polling loop after the running cycle.
+ */
+static void gatewayd_signal(int sig){
+	(void)sig;
+	gatewayd_stop=1;
+}
+
+/**
+ * @brief Microsecond tick of the driver instrumentation.
+ */
+static uint32_t gatewayd_time_us(void){
+	return (uint32_t)bms_linux_time_us();
+}
+
+/**
+ * @brief Millisecond tick of the engine.
+ */
+static uint32_t gatewayd_time_ms(void){
+	return (uint32_t)(bms_linux_time_us()/1000U);
+}
+
+/**
+ * @brief Splits a pack argument tty[:module_addr[:strings[:sensors]]], the tty stays in arg.
+ * @retval int returns 0 on success and -1 for counts out of the build limits.
+ */
+static int gatewayd_parse_pack(char* arg, bms_device* dev){
+	char* field=strchr(arg, ':');
+	for(uint8_t n=0;field!=NULL;n++){
+		*field++='\0';
+		char* next=strchr(field, ':');
+		unsigned long value=strtoul(field, NULL, (n==0) ? 16 : 10);
+		if(n==0){
+			dev->module_addr=(uint8_t)value;
+		}
+		else if(n==1){
+			if(value==0 || value>STRINGS_COUNT){
+				return -1;
+			}
+			dev->strings_count=(uint8_t)value;
+		}
+		else if(n==2){
+			if(value==0 || value>TEMP_SENSOR_COUNT){
+				return -1;
+			}
+			dev->temp_sensor_count=(uint8_t)value;
+		}
+		field=next;
+	}
+	return 0;
+}
+
+int main(int argc, char** argv){
+	const char* name=BMS_GATEWAY_DEFAULT_NAME;
+	uint32_t period_ms=GATEWAYD_DEFAULT_PERIOD_MS;
+	uint32_t baudrate=UART_DEFAULT_BAUDRATE;
+	uint32_t cycles=0;
+	int opt;
+	while((opt=getopt(argc, argv, "n:p:b:c:"))!=-1){
+		switch(opt){
+			case 'n': name=optarg; break;
+			case 'p': period_ms=(uint32_t)atoi(optarg); break;
+			case 'b': baudrate=(uint32_t)atoi(optarg); break;
+			case 'c': cycles=(uint32_t)atoi(optarg); break;
+			default:
+				fprintf(stderr, "usage : bms_gatewayd [-n shm_name] [-p period_ms] [-b baudrate] [-c cycles] tty[:module_addr[:strings[:sensors]]] ...\n");
+				return 2;
+		}
+	}
+	int packs=argc-optind;
+	if(packs<=0 || packs>BMS_GATEWAY_MAX_PACKS){
+		fprintf(stderr, "bms_gatewayd: 1 to %u packs expected\n", BMS_GATEWAY_MAX_PACKS);
+		return 2;
+	}
+
+	static bms_linux_port ports[BMS_GATEWAY_MAX_PACKS];
+	static bms_transport transports[BMS_GATEWAY_MAX_PACKS];
+	static bms_device devices[BMS_GATEWAY_MAX_PACKS];
+	bms_gateway gw;
+	bms_multi rack;
+	uint8_t created=bms_gateway_create(&gw, name, (uint8_t)packs, period_ms);
+	if(created==BMS_GATEWAY_ERR_RUNNING){
+		fprintf(stderr, "bms_gatewayd: another daemon is running on %s\n", name);
+		return 1;
+	}
+	if(created!=BMS_GATEWAY_OK){
+		perror("bms_gatewayd: cannot create the shared memory segment");
+		return 1;
+	}
+	if(bms_multi_init(&rack, gatewayd_time_ms)!=0){
+		fprintf(stderr, "bms_gatewayd: cannot create the engine\n");
+		bms_gateway_close(&gw);
+		return 1;
+	}
+	for(int i=0;i<packs;i++){
+		char* arg=argv[optind+i];
+		bms_device_init(&devices[i], &transports[i], NULL);
+		if(gatewayd_parse_pack(arg, &devices[i])!=0){
+			fprintf(stderr, "bms_gatewayd: pack %d exceeds %u strings or %u sensors\n", i, STRINGS_COUNT, TEMP_SENSOR_COUNT);
+			bms_gateway_close(&gw);
+			return 2;
+		}
+		if(bms_transport_linux_open(&transports[i], &ports[i], arg, baudrate)!=BMS_TRANSPORT_OK || bms_multi_add(&rack, &devices[i])!=0){
+			fprintf(stderr, "bms_gatewayd: cannot open %s\n", arg);
+			bms_gateway_close(&gw);
+			return 1;
+		}
+		bms_gateway_attach(&gw, (uint8_t)i, &devices[i], arg, gatewayd_time_us);
+	}
+
+	struct sigaction sa;
+	memset(&sa, 0x00, sizeof(sa));
+	sa.sa_handler=gatewayd_signal;	// no SA_RESTART, the signal cuts the sleep between two cycles
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	bms_gateway_ready(&gw);
+	fprintf(stderr, "bms_gatewayd: %d packs on %s, period %u ms, cycle bound %u ms\n", packs, name, period_ms, bms_multi_worst_case_ms(&rack, BMS_MASK_ALL));
+	uint32_t done=bms_gateway_run(&gw, &rack, BMS_MASK_ALL, cycles, &gatewayd_stop);
+
+	bms_gateway_close(&gw);
+	bms_multi_close(&rack);
+	for(int i=0;i<packs;i++){
+		bms_transport_linux_close(&ports[i]);
+	}
+	fprintf(stderr, "bms_gatewayd: stopped after %u cycles\n", done);
+	return 0;
+}
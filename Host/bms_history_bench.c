@@ -0,0 +1,264 @@
+#include "bms_sim.h"
+#include "bms_history.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @file bms_history_bench.c
+ * @brief Regression check of the telemetry history (bms_history.h) against a reference array holding every status recorded.
+ * 	  A simulated pack drifts with a few mV of noise and now and then jumps (load steps, balancing), its responses are stored through the driver and every refresh is recorded
+ * 	  with an irregular time step (repeated times included) that crosses the 32 bit wrap of the tick. Each record is checked as soon as it is stored (range, newest record,
+ * 	  records out of range) and a long lived iterator walks behind the writer until its group is dropped. Every check period the whole range kept is swept : bms_history_get()
+ * 	  on every record, iterations from the oldest and from a random record, bms_history_find() on every time kept and the ones in between, bms_history_cell_series() of a random
+ * 	  cell. The ring wraps and drops its oldest groups many times over the run.
+ * @author Piyush
+ * @date 12/01/25
+ * @version 1.0
+ *
+ *
+ * @note usage : bms_history_bench [records] [check_period]
+ *	 run it in the default configuration and in a small one, e.g. -DSTRINGS_COUNT=48 -DTEMP_SENSOR_COUNT=16 -DBMS_HISTORY_BYTES=1024, preferably with -fsanitize=address,undefined.
+ *	 A 48S keyframe group does not fit 1 KiB twice, so that budget drops the whole history on every keyframe and never wraps, add -DBMS_HISTORY_KEYFRAME_PERIOD=4 to wrap it too.
+ */
+
+
+// ====================================================================================================== MACROS ==========================================================================================================================
+
+#define BENCH_DEFAULT_RECORDS		20000
+#define BENCH_DEFAULT_CHECK_PERIOD	97
+#define BENCH_START_MS			(UINT32_MAX-5000000U)	// the tick wraps within the first records
+#define BENCH_REPORTED_FAILURES		10
+
+
+//==================================================================================== ROUTINE DEFINITIONS ======================================================================================
+
+static RT_Battery_status* ref_stat;	/**< every status recorded, by record number	*/
+static uint32_t* ref_ms;		/**< and its time				*/
+static uint32_t failures;
+
+/**
+ * @brief Counts a failed check, the first ones are printed.
+ * @param uint8_t ok passes the result of the check.
+ * @param const char* what passes the name of the check.
+ * @param uint32_t seq passes the record concerned.
+ * @retval void
+ */
+static void bench_expect(uint8_t ok, const char* what, uint32_t seq){
+	if(!ok && failures++<BENCH_REPORTED_FAILURES){
+		printf("FAILED %s, record %u\n", what, seq);
+	}
+}
+
+/**
+ * @brief Compares a rebuilt status and its time with the reference.
+ */
+static uint8_t bench_same(uint32_t seq, const RT_Battery_status* stat, uint32_t time_ms){
+	return (memcmp(stat, &ref_stat[seq], sizeof(RT_Battery_status))==0 && time_ms==ref_ms[seq]) ? 1 : 0;
+}
+
+/**
+ * @brief Reference of bms_history_find(), linear scan of the records kept.
+ * @retval uint8_t returns the same code as bms_history_find().
+ */
+static uint8_t bench_find(uint32_t first, uint32_t count, uint32_t time_ms, uint32_t* seq){
+	if(count==0){
+		return BMS_HISTORY_ERR_NOT_YET;
+	}
+	for(uint32_t s=first+count;s-->first;){
+		if((int32_t)(time_ms-ref_ms[s])>=0){
+			*seq=s;
+			return 0;
+		}
+	}
+	return BMS_HISTORY_ERR_GONE;
+}
+
+/**
+ * @brief Moves the simulated pack by one refresh.
+ * @param bms_sim* sim passes the simulator.
+ * @param uint32_t n passes the refresh number.
+ * @retval void
+ */
+static void bench_step(bms_sim* sim, uint32_t n){
+	bms_sim_values* v=&sim->values;
+	int32_t amps=(int32_t)v->current-30000+(rand()%41)-20;
+	if(rand()%200==0){
+		amps=(rand()%801)-400;	// load step, every field moves at once
+	}
+	amps=(amps>400) ? 400 : (amps<-400) ? -400 : amps;
+	v->current=(uint16_t)(30000+amps);
+	uint32_t sum=0;
+	for(uint8_t i=0;i<sim->strings_count;i++){
+		int32_t base=3300+amps/8+(int32_t)((n/500)%20);
+		v->cell_mv[i]=(uint16_t)(base+(int32_t)i%3+(rand()%5)-2);
+		sum+=v->cell_mv[i];
+	}
+	if(rand()%300==0){
+		v->cell_mv[rand()%sim->strings_count]=(uint16_t)(2500+rand()%1700);	// wild cell, large difference
+	}
+	v->cum_total_voltage=(uint16_t)(sum/100);
+	v->gath_total_voltage=v->cum_total_voltage;
+	if(n%600==0){
+		v->soc=(uint16_t)((v->soc>0) ? v->soc-1 : 1000);
+		v->remain_capacity-=40;
+	}
+	if(n%90==0){
+		v->temp_40[rand()%sim->temp_sensor_count]+=(uint8_t)((rand()&1) ? 1 : -1);
+	}
+}
+
+/**
+ * @brief Sweeps the whole range kept with every query.
+ * @param const bms_history* hist passes the history.
+ * @retval void
+ */
+static void bench_sweep(const bms_history* hist){
+	static RT_Battery_status stat;
+	static uint16_t mv[65536];
+	static uint32_t mv_ms[65536];
+	uint32_t first, time_ms, seq;
+	uint32_t count=bms_history_count(hist, &first);
+
+	for(uint32_t s=first;s<first+count;s++){
+		bench_expect(bms_history_get(hist, s, &stat, &time_ms)==0 && bench_same(s, &stat, time_ms), "get", s);
+	}
+
+	bms_history_iter it;
+	uint32_t starts[2]={ (first>0) ? first-1 : 0, first+(uint32_t)rand()%count };	// older than the range, clamped to the oldest one
+	for(uint8_t k=0;k<2;k++){
+		uint32_t expect=(starts[k]<first) ? first : starts[k];
+		bms_history_iter_begin(hist, starts[k], &it);
+		uint8_t ret;
+		while((ret=bms_history_iter_next(&it, &stat, &time_ms))==0){
+			bench_expect(expect<first+count && bench_same(expect, &stat, time_ms), "iterator", expect);
+			expect++;
+		}
+		bench_expect(ret==BMS_HISTORY_ERR_NOT_YET && expect==first+count, "iterator end", expect);
+	}
+
+	for(uint32_t s=first;s<first+count;s++){
+		uint32_t probes[2]={ ref_ms[s], ref_ms[s]-1 };
+		for(uint8_t k=0;k<2;k++){
+			uint32_t want=0;
+			uint8_t want_ret=bench_find(first, count, probes[k], &want);
+			uint8_t ret=bms_history_find(hist, probes[k], &seq);
+			bench_expect(ret==want_ret && (ret!=0 || seq==want), "find", s);
+		}
+	}
+
+#if ((_FULL_READ_ACCESS | _CELL_VOLT_ACCESS) == 0x01)
+	uint8_t cell=(uint8_t)(rand()%STRINGS_COUNT);
+	uint32_t from=(rand()%4==0) ? 0 : first+(uint32_t)rand()%count;	// 0 starts at the oldest one
+	uint16_t max=(rand()&1) ? (uint16_t)count : (uint16_t)(1+rand()%count);	// whole tail or truncated
+	uint16_t n=bms_history_cell_series(hist, cell, from, mv, mv_ms, max);
+	from=(from<first) ? first : from;
+	uint32_t points=first+count-from;
+	bench_expect(n==((points<max) ? points : max), "cell_series length", from);
+	for(uint16_t i=0;i<n;i++){
+		const uint8_t* raw=&ref_stat[from+i].cell_voltages[cell*MONOMER_VOLTAGE_SIZE];
+		bench_expect(mv[i]==(uint16_t)((raw[0]<<8) | raw[1]) && mv_ms[i]==ref_ms[from+i], "cell_series", from+i);
+	}
+#else
+	bench_expect(bms_history_cell_series(hist, 0, first, mv, mv_ms, 1)==0, "cell_series disabled", first);
+#endif
+}
+
+int main(int argc, char** argv){
+	uint32_t records=(argc>1) ? (uint32_t)atoi(argv[1]) : BENCH_DEFAULT_RECORDS;
+	uint32_t check_period=(argc>2) ? (uint32_t)atoi(argv[2]) : BENCH_DEFAULT_CHECK_PERIOD;
+	if(records==0){
+		records=BENCH_DEFAULT_RECORDS;
+	}
+	if(check_period==0){
+		check_period=BENCH_DEFAULT_CHECK_PERIOD;
+	}
+	ref_stat=(RT_Battery_status*)calloc(records, sizeof(RT_Battery_status)+1);	// +1, RT_Battery_status is empty when every access macro is 0x00
+	ref_ms=(uint32_t*)calloc(records, sizeof(uint32_t));
+	if(ref_stat==NULL || ref_ms==NULL){
+		fprintf(stderr, "bms_history_bench: no memory for %u records\n", records);
+		return 1;
+	}
+
+	static bms_sim sim;
+	bms_sim_init(&sim, STRINGS_COUNT, TEMP_SENSOR_COUNT);
+	srand(1);
+	static RT_Battery_status stat, past;
+	bms_device dev;
+	bms_device_init(&dev, NULL, &stat);
+	static bms_history hist;
+	bms_history_init(&hist);
+	uart_prot_packet frames[BMS_SIM_MAX_FRAMES];
+
+	uint32_t time_ms=BENCH_START_MS, prev_first=0, drops=0, wraps=0, sweeps=0, iterated=0, iter_gone=0, past_ms;
+	uint64_t kept=0;
+	uint8_t wrapped=0;
+	bms_history_iter it;
+	bms_history_iter_begin(&hist, 0, &it);
+
+	for(uint32_t n=0;n<records;n++){
+		bench_step(&sim, n);
+		for(uint8_t data_id=SOC_TOTAL_IV;data_id<=BATTERY_FAILURE_STATUS;data_id++){
+			uint8_t frame_count=bms_sim_build_response(&sim, data_id, frames);
+			for(uint8_t f=0;f<frame_count;f++){
+				bms_device_store_frame(&dev, &frames[f]);
+			}
+		}
+		time_ms+=(rand()%8==0) ? 0 : (rand()%50==0) ? 60000U+(uint32_t)rand()%600000 : 1U+(uint32_t)rand()%2000;	// repeated times and gaps
+		memcpy(&ref_stat[n], &stat, sizeof(RT_Battery_status));
+		ref_ms[n]=time_ms;
+		if(bms_history_record(&hist, &stat, time_ms)!=0){
+			fprintf(stderr, "bms_history_bench: BMS_HISTORY_BYTES %u does not hold one keyframe\n", BMS_HISTORY_BYTES);
+			return 1;
+		}
+
+		uint32_t first;
+		uint32_t count=bms_history_count(&hist, &first);
+		bench_expect(count>0 && first+count==n+1 && first>=prev_first, "range", n);
+		bench_expect(bms_history_get(&hist, n, &past, &past_ms)==0 && bench_same(n, &past, past_ms), "newest", n);
+		bench_expect(bms_history_get(&hist, n+1, &past, NULL)==BMS_HISTORY_ERR_NOT_YET, "not yet", n+1);
+		if(first>0){
+			bench_expect(bms_history_get(&hist, first-1, &past, NULL)==BMS_HISTORY_ERR_GONE, "gone", first-1);
+		}
+		drops+=(first!=prev_first) ? 1 : 0;
+		wraps+=(hist.wrapped && !wrapped) ? 1 : 0;
+		wrapped=hist.wrapped;
+		prev_first=first;
+		kept+=count;
+
+		for(uint8_t step=0;step<2;step++){	// the reader walks behind the writer and catches up now and then
+			uint32_t seq=it.seq;
+			uint8_t ret=bms_history_iter_next(&it, &past, &past_ms);
+			if(ret==0){
+				bench_expect(seq>=first && bench_same(seq, &past, past_ms), "long lived iterator", seq);
+				iterated++;
+			}
+			else if(ret==BMS_HISTORY_ERR_GONE){
+				bench_expect(seq<first, "long lived iterator dropped", seq);
+				iter_gone++;
+				bms_history_iter_begin(&hist, first+count/2, &it);
+			}
+			else{
+				bench_expect(seq==n+1, "long lived iterator end", seq);
+				if(rand()%4==0){
+					bms_history_iter_begin(&hist, first, &it);
+				}
+			}
+		}
+
+		if(n%check_period==check_period-1 || n==records-1){
+			bench_sweep(&hist);
+			sweeps++;
+		}
+	}
+
+	printf("%u records, %u strings, %u sensors, history %u bytes (budget %u, keyframe %u bytes every %u records)\n", records, STRINGS_COUNT, TEMP_SENSOR_COUNT,
+		(unsigned)sizeof(bms_history), BMS_HISTORY_BYTES, (unsigned)(BMS_HISTORY_KEY_HEADER+sizeof(RT_Battery_status)), BMS_HISTORY_KEYFRAME_PERIOD);
+	printf("%.1f records kept on average (%.1f bytes per record), ring wrapped %u times, oldest group dropped %u times\n", (double)kept/records,
+		(double)BMS_HISTORY_STORE_BYTES*records/kept, wraps, drops);
+	printf("%u sweeps of the range kept, long lived iterator : %u records read, dropped under it %u times\n", sweeps, iterated, iter_gone);
+	printf("%s, %u checks failed\n", failures ? "history differs from the reference" : "every record, time and cell series identical to the reference", failures);
+	free(ref_stat);
+	free(ref_ms);
+	return (failures!=0 || drops==0) ? 1 : 0;
+}
@@ -0,0 +1,138 @@
+#include "bms_sim.h"
+#include "bms_multi.h"
+#include "bms_transport_linux.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @file bms_multi_bench.c
+ * @brief Rack refresh benchmark of the multi pack engine (bms_multi.h) against simulated DALY BMS(s), one pseudo terminal per pack.
+ * 	  For every rack size the time of one full refresh is measured twice, reading the packs one after the other with bms_device_read_mask() and with all the ports
+ * 	  in flight through bms_multi_run_cycle(), the latter has to stay flat as packs are added. The guaranteed worst case of the cycle (bms_multi_worst_case_ms()) is printed alongside.
+ * @author Piyush
+ * @date 12/01/25
+ * @version 1.0
+ *
+ *
+ * @note usage : bms_multi_bench [iterations] [baudrate] [max_packs]
+ *	 The packs carry a driver instrumentation block (bms_stats.h), the bytes, retries and response latencies of every pack over the whole run are printed at the end.
+ */
+
+
+// ====================================================================================================== MACROS ==========================================================================================================================
+
+#define BENCH_DEFAULT_ITERATIONS	5
+#define BENCH_DEFAULT_MAX_PACKS		16
+
+
+//==================================================================================== ROUTINE DEFINITIONS ======================================================================================
+
+
+/**
+ * @brief Microsecond tick of the driver instrumentation.
+ */
+static uint32_t bench_time_us(void){
+	return (uint32_t)bms_linux_time_us();
+}
+
+/**
+ * @brief Millisecond tick of the engine.
+ */
+static uint32_t bench_time_ms(void){
+	return (uint32_t)(bms_linux_time_us()/1000U);
+}
+
+int main(int argc, char** argv){
+	uint32_t iterations=(argc>1) ? (uint32_t)atoi(argv[1]) : BENCH_DEFAULT_ITERATIONS;
+	uint32_t baudrate=(argc>2) ? (uint32_t)atoi(argv[2]) : UART_DEFAULT_BAUDRATE;
+	uint32_t max_packs=(argc>3) ? (uint32_t)atoi(argv[3]) : BENCH_DEFAULT_MAX_PACKS;
+	if(iterations==0){
+		iterations=BENCH_DEFAULT_ITERATIONS;
+	}
+	if(max_packs==0 || max_packs>BMS_MULTI_MAX_DEVICES){
+		max_packs=BMS_MULTI_MAX_DEVICES;
+	}
+
+	static bms_sim sims[BMS_MULTI_MAX_DEVICES];
+	static bms_linux_port ports[BMS_MULTI_MAX_DEVICES];
+	static bms_transport transports[BMS_MULTI_MAX_DEVICES];
+	static bms_device devices[BMS_MULTI_MAX_DEVICES];
+	static RT_Battery_status stats[BMS_MULTI_MAX_DEVICES];
+	static bms_stats instr[BMS_MULTI_MAX_DEVICES];
+
+	for(uint32_t i=0;i<max_packs;i++){
+		bms_sim_init(&sims[i], STRINGS_COUNT, TEMP_SENSOR_COUNT);
+		sims[i].baudrate=baudrate;
+		sims[i].values.soc=(uint16_t)(500+i);
+		if(bms_sim_start(&sims[i])!=0 || bms_transport_linux_open(&transports[i], &ports[i], sims[i].slave_path, baudrate)!=BMS_TRANSPORT_OK){
+			fprintf(stderr, "bms_multi_bench: cannot start simulated pack %u\n", i);
+			return 1;
+		}
+		bms_device_init(&devices[i], &transports[i], &stats[i]);
+		bms_stats_init(&instr[i], bench_time_us);
+		bms_device_attach_stats(&devices[i], &instr[i]);
+	}
+
+	printf("%u bps, %u strings, %u sensors, %u iterations per rack size\n\n", baudrate, STRINGS_COUNT, TEMP_SENSOR_COUNT, iterations);
+	printf("%6s %16s %16s %9s %12s\n", "packs", "sequential (ms)", "multi (ms)", "speedup", "bound (ms)");
+
+	for(uint32_t packs=1;packs<=max_packs;packs=(packs<max_packs && packs*2>max_packs) ? max_packs : packs*2){	// doubling, always finishing on max_packs
+		uint64_t seq_us=0, multi_us=0;
+
+		for(uint32_t it=0;it<iterations;it++){
+			uint64_t t0=bms_linux_time_us();
+			for(uint32_t i=0;i<packs;i++){
+				if(bms_device_read_mask(&devices[i], BMS_MASK_ALL, 1)!=0){
+					fprintf(stderr, "bms_multi_bench: sequential read of pack %u failed\n", i);
+					return 1;
+				}
+			}
+			seq_us+=bms_linux_time_us()-t0;
+		}
+
+		bms_multi rack;
+		if(bms_multi_init(&rack, bench_time_ms)!=0){
+			fprintf(stderr, "bms_multi_bench: cannot create the engine\n");
+			return 1;
+		}
+		for(uint32_t i=0;i<packs;i++){
+			bms_multi_add(&rack, &devices[i]);
+		}
+		for(uint32_t it=0;it<iterations;it++){
+			memset(stats, 0x00, sizeof(stats));
+			uint64_t t0=bms_linux_time_us();
+			uint8_t failed=bms_multi_run_cycle(&rack, BMS_MASK_ALL);
+			multi_us+=bms_linux_time_us()-t0;
+			if(failed!=0){
+				fprintf(stderr, "bms_multi_bench: %u packs failed, first error %u\n", failed, rack.slots[0].error);
+				return 1;
+			}
+			for(uint32_t i=0;i<packs;i++){
+				if(stats[i].soc!=500+i){
+					fprintf(stderr, "bms_multi_bench: pack %u returned the data of another pack\n", i);
+					return 1;
+				}
+			}
+		}
+		uint32_t bound_ms=bms_multi_worst_case_ms(&rack, BMS_MASK_ALL);
+		bms_multi_close(&rack);
+
+		double seq_ms=seq_us/1000.0/iterations, multi_ms=multi_us/1000.0/iterations;
+		printf("%6u %16.1f %16.1f %8.1fx %12u\n", packs, seq_ms, multi_ms, seq_ms/multi_ms, bound_ms);
+	}
+
+	printf("\n%6s %8s %10s %10s %6s %9s %12s %12s\n", "pack", "reads", "tx bytes", "rx bytes", "retry", "timeouts", "rsp p99 (ms)", "rsp max (ms)");
+	for(uint32_t i=0;i<max_packs;i++){
+		bms_id_stats total;
+		bms_stats_sum(&instr[i], BMS_MASK_ALL, &total);
+		printf("%6u %8u %10u %10u %6u %9u %12.2f %12.2f\n", i, instr[i].reads, total.tx_bytes, total.rx_bytes, total.retries, total.timeouts,
+			bms_stats_percentile_us(&total, BMS_STATS_RESPONSE, 990)/1000.0, total.response_max_us/1000.0);
+	}
+
+	for(uint32_t i=0;i<max_packs;i++){
+		bms_transport_linux_close(&ports[i]);
+		bms_sim_stop(&sims[i]);
+	}
+	return 0;
+}
@@ -0,0 +1,58 @@
+#include "bms_scheduler.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * @file bms_sched_tool.c
+ * @brief Offline planner for the polling scheduler, reports whether a set of per data ID rates fits the bus and prints the interleaved command sequence.
+ * @author Piyush
+ * @date 12/01/25
+ * @version 1.0
+ *
+ *
+ * @note usage : bms_sched_tool <baudrate> <data_id>:<period_ms>:<priority> ...
+ *	 e.g.  bms_sched_tool 9600 0x90:100:3 0x98:200:3 0x95:1000:2 0x96:1000:2 0x94:60000:0
+ *	 The response frames are the ones of STRINGS_COUNT cells and TEMP_SENSOR_COUNT sensors, the data IDs disabled by the access macros are rejected.
+ */
+
+
+// ====================================================================================================== MACROS ==========================================================================================================================
+
+#define TOOL_MAX_SLOTS		64	/**< number of commands of the sequence printed	*/
+
+
+int main(int argc, char** argv){
+	if(argc<3){
+		fprintf(stderr, "usage : %s <baudrate> <data_id>:<period_ms>:<priority> ...\n", argv[0]);
+		return 1;
+	}
+
+	bms_device dev;
+	bms_device_init(&dev, NULL, NULL);	// compile time strings/sensors counts, only the frame counts are used
+	bms_scheduler sched;
+	bms_sched_init(&sched, &dev, (uint32_t)strtoul(argv[1], NULL, 0), BMS_SCHED_DEFAULT_TURNAROUND_US);
+	for(int i=2;i<argc;i++){
+		int id=0;
+		unsigned period, priority;
+		if(sscanf(argv[i], "%i:%u:%u", &id, &period, &priority)!=3 || id<SOC_TOTAL_IV || id>BATTERY_FAILURE_STATUS || bms_sched_add(&sched, (uint8_t)id, period, (uint8_t)priority)!=0){
+			fprintf(stderr, "invalid entry %s%s\n", argv[i], (id>=SOC_TOTAL_IV && id<=BATTERY_FAILURE_STATUS && (bms_enabled_mask() & BMS_DATA_ID_MASK(id))==0) ? " (data ID disabled by the access macros)" : "");
+			return 1;
+		}
+	}
+
+	bms_sched_report report;
+	bms_sched_check(&sched, &report);
+	printf("bus utilization %u.%u %%, hyperperiod %u ms, %u polls, %u deadline misses -> %s (%s policy)\n\n", report.utilization_permille/10, report.utilization_permille%10, report.hyperperiod_ms, report.polls, report.deadline_misses, (report.fits) ? "FITS" : "DOES NOT FIT", (sched.policy==BMS_SCHED_POLICY_EDF) ? "deadline" : "priority");
+	printf("%-8s %10s %9s %10s %18s\n", "data ID", "period ms", "priority", "cost ms", "worst response ms");
+	for(uint8_t i=0;i<sched.count;i++){
+		printf("0x%02X     %10u %9u %10.2f %18.2f\n", sched.entries[i].data_id, sched.entries[i].period_ms, sched.entries[i].priority, sched.entries[i].cost_us/1000.0, report.worst_response_us[i]/1000.0);
+	}
+
+	static bms_sched_slot slots[TOOL_MAX_SLOTS];
+	uint16_t n=bms_sched_build_sequence(&sched, slots, TOOL_MAX_SLOTS);
+	printf("\nfirst %u commands of the sequence :\n", n);
+	for(uint16_t i=0;i<n;i++){
+		printf("%9.2f ms  0x%02X\n", slots[i].start_us/1000.0, slots[i].data_id);
+	}
+	return 0;
+}
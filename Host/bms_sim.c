@@ -0,0 +1,411 @@
+#define _GNU_SOURCE
+#include "bms_sim.h"
+#include "bms_transport_linux.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * @file bms_sim.c
+ * @brief Source code file for the simulated DALY BMS declared in bms_sim.h
+ * @author Piyush
+ * @date 12/01/25
+ * @version 1.0
+ */
+
+
+//==================================================================================== ROUTINE DEFINITIONS ======================================================================================
+
+
+/**
+ * @brief Sleeps until an absolute monotonic timestamp.
+ * @param uint64_t t_us passes the wake up time in microseconds (bms_linux_time_us() time base).
+ * @retval void
+ */
+static void bms_sim_sleep_until(uint64_t t_us){
+	struct timespec ts={ .tv_sec=(time_t)(t_us/1000000U), .tv_nsec=(long)((t_us%1000000U)*1000U) };
+	while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL)==EINTR){
+	}
+}
+
+/**
+ * @brief Wire time of one frame at the simulated baud rate.
+ * @param const bms_sim* sim passes the pointer to the simulator.
+ * @retval uint64_t returns the time in microseconds.
+ */
+static uint64_t bms_sim_frame_time_us(const bms_sim* sim){
+	return ((uint64_t)sizeof(uart_prot_packet)*10U*1000000U+sim->baudrate-1)/sim->baudrate;
+}
+
+/**
+ * @brief Starts a response frame with header fields and a cleared data field.
+ * @param const bms_sim* sim passes the pointer to the simulator.
+ * @param uart_prot_packet* frame passes the frame to be initialized.
+ * @param uint8_t data_id passes the data ID echoed in the response.
+ * @retval void
+ */
+static void bms_sim_frame_init(const bms_sim* sim, uart_prot_packet* frame, uint8_t data_id){
+	memset(frame, 0x00, sizeof(uart_prot_packet));
+	frame->start_flag=START_FLAG;
+	frame->module_addr=sim->module_addr;
+	frame->data_id=data_id;
+	frame->data_len=MAX_DATA_SIZE;
+}
+
+/**
+ * @brief Calculates and stores the checksum of a frame.
+ * @param uart_prot_packet* frame passes the frame to be sealed.
+ * @retval void
+ */
+static void bms_sim_frame_seal(uart_prot_packet* frame){
+	uint16_t chksum=0x0000;
+	for(uint8_t cnt=0;cnt<sizeof(uart_prot_packet)-1;cnt++){
+		chksum+=((uint8_t*)frame)[cnt];
+	}
+	frame->chksum=(uint8_t)(chksum&0xFF);
+}
+
+/**
+ * @brief Stores a 16 bit value in big endian order.
+ * @param uint8_t* dst passes the destination bytes.
+ * @param uint16_t val passes the value.
+ * @retval void
+ */
+static void bms_sim_put16(uint8_t* dst, uint16_t val){
+	dst[0]=(uint8_t)(val>>8);
+	dst[1]=(uint8_t)(val&0xFF);
+}
+
+/**
+ * @brief Fills the simulator with a plausible 16S pack and the default timing.
+ * @param bms_sim* sim passes the pointer to the simulator.
+ * @param uint8_t strings_count passes the number of cells, at most MAX_BMS_STRING_COUNT.
+ * @param uint8_t temp_sensor_count passes the number of temperature sensors, at most MAX_BMS_TEMPERATURE_SENSOR_COUNT.
+ * @retval void
+ */
+void bms_sim_init(bms_sim* sim, uint8_t strings_count, uint8_t temp_sensor_count){
+	memset(sim, 0x00, sizeof(bms_sim));
+	sim->master_fd=-1;
+	sim->baudrate=UART_DEFAULT_BAUDRATE;
+	sim->response_delay_us=BMS_SIM_DEFAULT_DELAY_US;
+	sim->module_addr=BMS_MASTER_ADDR;
+	sim->max_pending=BMS_SIM_QUEUE_SIZE;
+	sim->noise_seed=1;
+	sim->strings_count=(strings_count>MAX_BMS_STRING_COUNT) ? MAX_BMS_STRING_COUNT : strings_count;
+	sim->temp_sensor_count=(temp_sensor_count>MAX_BMS_TEMPERATURE_SENSOR_COUNT) ? MAX_BMS_TEMPERATURE_SENSOR_COUNT : temp_sensor_count;
+
+	bms_sim_values* v=&sim->values;
+	uint32_t sum_mv=0;
+	for(uint8_t i=0;i<sim->strings_count;i++){
+		v->cell_mv[i]=(uint16_t)(3300+((i*7)%23));
+		sum_mv+=v->cell_mv[i];
+	}
+	for(uint8_t i=0;i<sim->temp_sensor_count;i++){
+		v->temp_40[i]=(uint8_t)(40+25+(i%3));
+	}
+	v->cum_total_voltage=(uint16_t)(sum_mv/100);
+	v->gath_total_voltage=v->cum_total_voltage;
+	v->current=30000-125;	// 12.5 A discharge
+	v->soc=805;
+	v->mos_state=MOS_DISCHARGING;
+	v->chrg_mos_state=0x01;
+	v->dischrg_mos_state=0x01;
+	v->bms_life=12;
+	v->remain_capacity=32200;
+	v->charger_status=CHARGER_STATUS_DISCONN;
+	v->load_status=LOAD_STATUS_ACCESS;
+	v->balance[0]=0x05;
+}
+
+/**
+ * @brief Builds the response frames for a data ID as the real BMS would send them.
+ * @param const bms_sim* sim passes the pointer to the simulator.
+ * @param uint8_t data_id passes the requested data ID.
+ * @param uart_prot_packet* frames passes the memory for at least BMS_SIM_MAX_FRAMES frames.
+ * @retval uint8_t returns the number of frames built, 0 for an unknown data ID.
+ */
+uint8_t bms_sim_build_response(const bms_sim* sim, uint8_t data_id, uart_prot_packet* frames){
+	const bms_sim_values* v=&sim->values;
+	uint8_t count=1;
+	uint8_t* d=frames[0].data;
+	bms_sim_frame_init(sim, &frames[0], data_id);
+
+	switch(data_id){
+		case SOC_TOTAL_IV:
+			bms_sim_put16(d+0, v->cum_total_voltage);
+			bms_sim_put16(d+2, v->gath_total_voltage);
+			bms_sim_put16(d+4, v->current);
+			bms_sim_put16(d+6, v->soc);
+			break;
+
+		case MAX_MIN_VOLTAGE:
+		case MAX_MIN_TEMPERATURE:{
+			uint8_t n=(data_id==MAX_MIN_VOLTAGE) ? sim->strings_count : sim->temp_sensor_count;
+			uint8_t max_i=0, min_i=0;
+			for(uint8_t i=1;i<n;i++){
+				uint16_t val=(data_id==MAX_MIN_VOLTAGE) ? v->cell_mv[i] : v->temp_40[i];
+				if(val>((data_id==MAX_MIN_VOLTAGE) ? v->cell_mv[max_i] : v->temp_40[max_i])){
+					max_i=i;
+				}
+				if(val<((data_id==MAX_MIN_VOLTAGE) ? v->cell_mv[min_i] : v->temp_40[min_i])){
+					min_i=i;
+				}
+			}
+			if(data_id==MAX_MIN_VOLTAGE){
+				bms_sim_put16(d+0, v->cell_mv[max_i]);
+				d[2]=max_i+1;
+				bms_sim_put16(d+3, v->cell_mv[min_i]);
+				d[5]=min_i+1;
+			}
+			else{
+				d[0]=v->temp_40[max_i];
+				d[1]=max_i+1;
+				d[2]=v->temp_40[min_i];
+				d[3]=min_i+1;
+			}
+			break;
+		}
+
+		case CHRG_DISCHRG_MOS_STATUS:
+			d[0]=v->mos_state;
+			d[1]=v->chrg_mos_state;
+			d[2]=v->dischrg_mos_state;
+			d[3]=v->bms_life;
+			d[4]=(uint8_t)(v->remain_capacity>>24);
+			d[5]=(uint8_t)(v->remain_capacity>>16);
+			d[6]=(uint8_t)(v->remain_capacity>>8);
+			d[7]=(uint8_t)(v->remain_capacity);
+			break;
+
+		case STATUS_INFO_1:
+			d[0]=sim->strings_count;
+			d[1]=sim->temp_sensor_count;
+			d[2]=v->charger_status;
+			d[3]=v->load_status;
+			d[4]=v->DI_DO_state;
+			break;
+
+		case CELL_VOLTAGE:
+			count=(uint8_t)((sim->strings_count+CELL_VOLTS_PER_FRAME-1)/CELL_VOLTS_PER_FRAME);
+			for(uint8_t f=0;f<count;f++){
+				bms_sim_frame_init(sim, &frames[f], data_id);
+				frames[f].data[0]=f;
+				for(uint8_t c=0;c<CELL_VOLTS_PER_FRAME;c++){
+					uint8_t cell=f*CELL_VOLTS_PER_FRAME+c;
+					bms_sim_put16(frames[f].data+1+c*MONOMER_VOLTAGE_SIZE, (cell<sim->strings_count) ? v->cell_mv[cell] : 0);
+				}
+			}
+			break;
+
+		case CELL_TEMPERATURE:
+			count=(uint8_t)((sim->temp_sensor_count+CELL_TEMPS_PER_FRAME-1)/CELL_TEMPS_PER_FRAME);
+			for(uint8_t f=0;f<count;f++){
+				bms_sim_frame_init(sim, &frames[f], data_id);
+				frames[f].data[0]=f;
+				for(uint8_t c=0;c<CELL_TEMPS_PER_FRAME;c++){
+					uint8_t sensor=f*CELL_TEMPS_PER_FRAME+c;
+					frames[f].data[1+c]=(sensor<sim->temp_sensor_count) ? v->temp_40[sensor] : 0;
+				}
+			}
+			break;
+
+		case CELL_BALANCE_STATE:
+			memcpy(d, v->balance, MAX_DATA_SIZE);
+			break;
+
+		case BATTERY_FAILURE_STATUS:
+			memcpy(d, v->failure, MAX_DATA_SIZE);
+			break;
+
+		case DISCHRG_FET:		// commands are echoed with the resulting MOS state, applied by the transmitting side before the response is built
+			d[0]=v->dischrg_mos_state;
+			break;
+
+		case CHRG_FET:
+			d[0]=v->chrg_mos_state;
+			break;
+
+		case BMS_RESET:
+			break;
+
+		default:
+			return 0;
+	}
+
+	for(uint8_t f=0;f<count;f++){
+		bms_sim_frame_seal(&frames[f]);
+	}
+	return count;
+}
+
+/**
+ * @brief Receiving side of the simulator, resyncs on START_FLAG and queues every valid request with its modelled arrival time.
+ * @param void* arg passes the pointer to the simulator.
+ * @retval void* returns NULL.
+ */
+static void* bms_sim_rx_main(void* arg){
+	bms_sim* sim=(bms_sim*)arg;
+	uint8_t req[sizeof(uart_prot_packet)];
+	uint8_t fill=0;
+
+	while(sim->running){
+		struct pollfd pfd={ .fd=sim->master_fd, .events=POLLIN };
+		if(poll(&pfd, 1, 20)<=0){
+			continue;
+		}
+		uint8_t buf[256];
+		ssize_t n=read(sim->master_fd, buf, sizeof(buf));
+		if(n<=0){
+			usleep(1000);	// slave side not opened yet (EIO)
+			continue;
+		}
+		uint64_t now=bms_linux_time_us();
+
+		for(ssize_t i=0;i<n;i++){
+			if(fill==0 && buf[i]!=START_FLAG){
+				continue;
+			}
+			req[fill++]=buf[i];
+			if(fill<sizeof(uart_prot_packet)){
+				continue;
+			}
+			fill=0;
+
+			uart_prot_packet* packet=(uart_prot_packet*)req;
+			pthread_mutex_lock(&sim->lock);
+			sim->rx_line_free_us=((now>sim->rx_line_free_us) ? now : sim->rx_line_free_us)+bms_sim_frame_time_us(sim);
+			if(verify_checksum(packet)!=0x01 || packet->data_len!=MAX_DATA_SIZE || sim->q_count>=sim->max_pending || sim->q_count==BMS_SIM_QUEUE_SIZE){
+				sim->requests_rejected++;
+			}
+			else{
+				bms_sim_request* slot=&sim->queue[(sim->q_head+sim->q_count)%BMS_SIM_QUEUE_SIZE];
+				slot->data_id=packet->data_id;
+				slot->value=packet->data[0];
+				slot->rx_done_us=sim->rx_line_free_us;
+				sim->q_count++;
+				pthread_cond_signal(&sim->cond);
+			}
+			pthread_mutex_unlock(&sim->lock);
+		}
+	}
+	return NULL;
+}
+
+/**
+ * @brief Transmitting side of the simulator, answers the queued requests one by one at wire speed.
+ * @param void* arg passes the pointer to the simulator.
+ * @retval void* returns NULL.
+ */
+static void* bms_sim_tx_main(void* arg){
+	bms_sim* sim=(bms_sim*)arg;
+	uart_prot_packet frames[BMS_SIM_MAX_FRAMES];
+	uint64_t tx_line_free=0;
+
+	while(1){
+		pthread_mutex_lock(&sim->lock);
+		while(sim->running && sim->q_count==0){
+			pthread_cond_wait(&sim->cond, &sim->lock);
+		}
+		if(!sim->running){
+			pthread_mutex_unlock(&sim->lock);
+			break;
+		}
+		bms_sim_request request=sim->queue[sim->q_head];
+		sim->q_head=(sim->q_head+1)%BMS_SIM_QUEUE_SIZE;
+		sim->q_count--;
+		if(request.data_id==DISCHRG_FET){
+			sim->values.dischrg_mos_state=request.value;
+		}
+		else if(request.data_id==CHRG_FET){
+			sim->values.chrg_mos_state=request.value;
+		}
+		uint8_t count=(sim->responder!=NULL) ? sim->responder(sim->responder_ctx, request.data_id, request.value, frames) : bms_sim_build_response(sim, request.data_id, frames);
+		pthread_mutex_unlock(&sim->lock);
+
+		if(count==0){
+			sim->requests_rejected++;
+			continue;
+		}
+
+		if(sim->reorder_frames){
+			for(uint8_t f=0;f+1<count;f+=2){
+				uart_prot_packet tmp=frames[f];
+				frames[f]=frames[f+1];
+				frames[f+1]=tmp;
+			}
+		}
+		for(uint8_t f=0;f<count;f++){
+			if(sim->corrupt_permille!=0 && (uint32_t)(rand_r(&sim->noise_seed)%1000U)<sim->corrupt_permille){
+				frames[f].data[rand_r(&sim->noise_seed)%MAX_DATA_SIZE]^=(uint8_t)(1U<<(rand_r(&sim->noise_seed)%8U));
+				sim->frames_corrupted++;
+			}
+		}
+
+		uint64_t t=request.rx_done_us+sim->response_delay_us;
+		if(t<tx_line_free){
+			t=tx_line_free;
+		}
+		for(uint8_t f=0;f<count;f++){
+			t+=bms_sim_frame_time_us(sim);
+			bms_sim_sleep_until(t);
+			if(write(sim->master_fd, &frames[f], sizeof(uart_prot_packet))<0){
+				break;
+			}
+		}
+		tx_line_free=t;
+		sim->requests_served++;
+	}
+	return NULL;
+}
+
+/**
+ * @brief Opens the pseudo terminal and starts answering requests.
+ * @param bms_sim* sim passes the pointer to an initialized simulator.
+ * @retval int returns 0 on success and -1 on failure.
+ */
+int bms_sim_start(bms_sim* sim){
+	sim->master_fd=posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+	if(sim->master_fd<0 || grantpt(sim->master_fd)!=0 || unlockpt(sim->master_fd)!=0 || ptsname_r(sim->master_fd, sim->slave_path, sizeof(sim->slave_path))!=0){
+		return -1;
+	}
+
+	struct termios tio;
+	if(tcgetattr(sim->master_fd, &tio)==0){
+		cfmakeraw(&tio);
+		tcsetattr(sim->master_fd, TCSANOW, &tio);
+	}
+
+	pthread_mutex_init(&sim->lock, NULL);
+	pthread_cond_init(&sim->cond, NULL);
+	sim->running=1;
+	if(pthread_create(&sim->rx_thread, NULL, bms_sim_rx_main, sim)!=0){
+		return -1;
+	}
+	if(pthread_create(&sim->tx_thread, NULL, bms_sim_tx_main, sim)!=0){
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief Stops the simulator threads and closes the pseudo terminal.
+ * @param bms_sim* sim passes the pointer to a started simulator.
+ * @retval void
+ */
+void bms_sim_stop(bms_sim* sim){
+	pthread_mutex_lock(&sim->lock);
+	sim->running=0;
+	pthread_cond_broadcast(&sim->cond);
+	pthread_mutex_unlock(&sim->lock);
+	pthread_join(sim->rx_thread, NULL);
+	pthread_join(sim->tx_thread, NULL);
+	pthread_mutex_destroy(&sim->lock);
+	pthread_cond_destroy(&sim->cond);
+	close(sim->master_fd);
+	sim->master_fd=-1;
+}
@@ -0,0 +1,149 @@
+#ifndef BMS_SIM_H
+#define BMS_SIM_H
+
+#include "bms_uart_comm.h"
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @file bms_sim.h
+ * @brief Header file for the simulated DALY BMS defined in bms_sim.c
+ * 	  The simulator owns the master side of a pseudo terminal, the driver opens the slave side through bms_transport_linux_open() exactly as it would open a real serial port.
+ * @author Piyush
+ * @date 12/01/25
+ * @version 1.0
+ *
+ *
+ * @note Every request 0x90 to 0x98 is answered with correctly checksummed uart_prot_packet frames. Wire time is modelled for both directions at the configured baud rate (10 bits per byte),
+ *	 the request is considered received only once its 13 bytes would have been clocked in, and each response frame is written only once it would have been clocked out.
+ *	 The DISCHRG_FET/CHRG_FET/BMS_RESET commands are echoed in one frame, the FET commands set the MOS state reported by CHRG_DISCHRG_MOS_STATUS.
+ *	 corrupt_permille and reorder_frames degrade the responses the way a noisy harness does, to exercise the frame reassembly of the driver.
+ *	 A responder replaces the simulated values, the capture replay (Host/bms_capture_linux.h) answers with the frames of a recorded bus through it.
+ */
+
+
+// ====================================================================================================== MACROS ==========================================================================================================================
+
+#define BMS_SIM_PATH_SIZE		64	/**< size of the buffer holding the slave tty path			*/
+#define BMS_SIM_MAX_FRAMES		16	/**< maximum number of frames of a single response (48 cell voltages)	*/
+#define BMS_SIM_QUEUE_SIZE		32	/**< requests received but not answered yet				*/
+#define BMS_SIM_DEFAULT_DELAY_US	2000	/**< default processing time of the BMS between request and response	*/
+
+
+//================================================================================ SIMULATOR STRUCTURE ==========================================================================================================
+
+/**
+ * @brief structure holding the simulated pack values, stored as they are sent on the wire.
+ */
+typedef struct {
+	uint16_t cum_total_voltage;				// cumulative total voltage (0.1 V)
+	uint16_t gath_total_voltage;				// gather total voltage (0.1 V)
+	uint16_t current;					// current (30000 offset, 0.1 A)
+	uint16_t soc;						// SOC (0.1%)
+	uint8_t mos_state;					// mos state, stationary or charging or discharging
+	uint8_t chrg_mos_state;					// charge MOS state
+	uint8_t dischrg_mos_state;				// discharge MOS state
+	uint8_t bms_life;					// BMS life (0-255 cycles)
+	uint32_t remain_capacity;				// remain capacity (mAH)
+	uint8_t charger_status;					// charger status
+	uint8_t load_status;					// load status
+	uint8_t DI_DO_state;					// DIx and DOx states
+	uint16_t cell_mv[MAX_BMS_STRING_COUNT];			// cell voltages (mV)
+	uint8_t temp_40[MAX_BMS_TEMPERATURE_SENSOR_COUNT];	// temperatures (40 offset, degree celsius)
+	uint8_t balance[MAX_DATA_SIZE];				// balance bits, 1 bit per cell
+	uint8_t failure[MAX_DATA_SIZE];				// battery failure status bytes
+} bms_sim_values;
+
+/**
+ * @brief routine type answering a request in place of the simulated values, returns the number of frames built (at most BMS_SIM_MAX_FRAMES), 0 to leave the request unanswered.
+ */
+typedef uint8_t (*bms_sim_responder)(void* ctx, uint8_t data_id, uint8_t value, uart_prot_packet* frames);
+
+/**
+ * @brief structure for one queued request.
+ */
+typedef struct {
+	uint8_t data_id;	/**< requested data ID						*/
+	uint8_t value;		/**< data[0] of the request, the MOS state of DISCHRG_FET/CHRG_FET	*/
+	uint64_t rx_done_us;	/**< time at which the last request byte was clocked in	*/
+} bms_sim_request;
+
+/**
+ * @brief structure holding the state of one simulated BMS.
+ */
+typedef struct {
+	int master_fd;					/**< master side of the pseudo terminal			*/
+	char slave_path[BMS_SIM_PATH_SIZE];		/**< slave tty path to be opened by the driver		*/
+	uint32_t baudrate;				/**< modelled line speed in bps				*/
+	uint32_t response_delay_us;			/**< modelled processing time of the BMS		*/
+	uint8_t module_addr;				/**< address used in the response frames		*/
+	uint8_t strings_count;				/**< number of cells reported				*/
+	uint8_t temp_sensor_count;			/**< number of temperature sensors reported		*/
+	uint8_t max_pending;				/**< requests the firmware buffers while busy answering, further ones are dropped	*/
+	uint16_t corrupt_permille;			/**< response frames sent with a flipped data bit, per thousand, models a noisy harness	*/
+	uint8_t reorder_frames;				/**< 1 swaps adjacent frames of multi frame responses			*/
+	unsigned int noise_seed;			/**< seed of the noise generator					*/
+	bms_sim_values values;				/**< values reported by the simulated pack		*/
+	bms_sim_responder responder;			/**< answers the requests when not NULL, the values are then unused		*/
+	void* responder_ctx;				/**< context handed to the responder					*/
+
+	volatile uint32_t requests_served;		/**< number of answered requests			*/
+	volatile uint32_t requests_rejected;		/**< requests with bad checksum or unknown ID		*/
+	volatile uint32_t frames_corrupted;		/**< response frames damaged by the noise model		*/
+
+	pthread_t rx_thread;				/**< parses incoming requests				*/
+	pthread_t tx_thread;				/**< clocks the responses out				*/
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	bms_sim_request queue[BMS_SIM_QUEUE_SIZE];
+	uint8_t q_head;
+	uint8_t q_count;
+	uint64_t rx_line_free_us;
+	volatile int running;
+} bms_sim;
+
+
+//======================================================================================== ROUTINE DECLARATION ===================================================================================================
+
+/**
+ * @brief Fills the simulator with a plausible 16S pack and the default timing.
+ * @param bms_sim* sim passes the pointer to the simulator.
+ * @param uint8_t strings_count passes the number of cells, at most MAX_BMS_STRING_COUNT.
+ * @param uint8_t temp_sensor_count passes the number of temperature sensors, at most MAX_BMS_TEMPERATURE_SENSOR_COUNT.
+ * @retval void
+ */
+void bms_sim_init(bms_sim* sim, uint8_t strings_count, uint8_t temp_sensor_count);
+
+/**
+ * @brief Opens the pseudo terminal and starts answering requests.
+ * @param bms_sim* sim passes the pointer to an initialized simulator.
+ * @retval int returns 0 on success and -1 on failure.
+ */
+int bms_sim_start(bms_sim* sim);
+
+/**
+ * @brief Stops the simulator threads and closes the pseudo terminal.
+ * @param bms_sim* sim passes the pointer to a started simulator.
+ * @retval void
+ */
+void bms_sim_stop(bms_sim* sim);
+
+/**
+ * @brief Builds the response frames for a data ID as the real BMS would send them.
+ * @param const bms_sim* sim passes the pointer to the simulator.
+ * @param uint8_t data_id passes the requested data ID.
+ * @param uart_prot_packet* frames passes the memory for at least BMS_SIM_MAX_FRAMES frames.
+ * @retval uint8_t returns the number of frames built, 0 for an unknown data ID.
+ */
+uint8_t bms_sim_build_response(const bms_sim* sim, uint8_t data_id, uart_prot_packet* frames);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /**< BMS_SIM_H  */
@@ -0,0 +1,226 @@
+#include "bms_sim.h"
+#include "bms_variant.hpp"
+#include "bms_transport_linux.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @file bms_variant_bench.cpp
+ * @brief Checks and costs the compile time front end (bms_variant.hpp) on three pack variants against the simulated DALY BMS, next to the C driver reading the same packs.
+ * 	  The first run answers through a loopback transport built on bms_sim_build_response(), with no wire and no thread, so that only the driver is timed : every request sent by
+ * 	  bms::device must be byte for byte the frame bms_device_build_request() builds, every field read must match the simulated values, and the time per read is set against
+ * 	  bms_device_read_mask() of a bms_device configured at runtime with the same counts and mask. The loopback then answers with an endless stream of valid frames of a data ID
+ * 	  no variant reads, the read must end on its first data ID with a sequence failure. The second run reads each variant through a pseudo terminal with a noisy
+ * 	  harness (corrupted and reordered frames) to exercise the frame reassembly.
+ * @author Piyush
+ * @date 12/01/25
+ * @version 1.0
+ *
+ *
+ * @note usage : bms_variant_bench [iterations] [baudrate]
+ *	 The C driver reads the variants only if they fit STRINGS_COUNT and TEMP_SENSOR_COUNT, build with -DSTRINGS_COUNT=48 -DTEMP_SENSOR_COUNT=16 to compare all three.
+ */
+
+
+// ====================================================================================================== MACROS ==========================================================================================================================
+
+#define BENCH_DEFAULT_ITERATIONS	200000
+#define BENCH_DEFAULT_BAUDRATE		115200
+#define BENCH_PTY_READS			20
+#define BENCH_CORRUPT_PERMILLE		20
+
+using pack_16s=bms::variant<16, 4>;
+using pack_24s=bms::variant<24, 8, BMS_DATA_ID_MASK(SOC_TOTAL_IV) | BMS_DATA_ID_MASK(MAX_MIN_VOLTAGE) | BMS_DATA_ID_MASK(CHRG_DISCHRG_MOS_STATUS) |
+	BMS_DATA_ID_MASK(CELL_VOLTAGE) | BMS_DATA_ID_MASK(CELL_TEMPERATURE)>;
+using pack_48s=bms::variant<48, 16, BMS_MASK_ALL, BMS_MASTER_ADDR>;
+
+
+//==================================================================================== ROUTINE DEFINITIONS ======================================================================================
+
+/**
+ * @brief structure of the loopback transport, a request is answered at once with the frames the simulator would send.
+ */
+typedef struct {
+	const bms_sim* sim;
+	const bms_device* dev;		/**< device whose bms_device_build_request() gives the expected request	*/
+	uart_prot_packet frames[BMS_SIM_MAX_FRAMES];
+	uint16_t bytes;			/**< bytes of the pending response			*/
+	uint16_t pos;			/**< bytes of it already received			*/
+	uint32_t bad_requests;		/**< requests differing from bms_device_build_request()	*/
+	uint8_t flood;			/**< 1 answers every reception with a valid frame of a data ID never requested	*/
+	uint32_t receptions;		/**< frames received while flooding			*/
+} bench_loop;
+
+static uint8_t bench_loop_transmit(void* handle, const uint8_t* buf, uint16_t len, uint32_t timeout_ms){
+	(void)timeout_ms;
+	bench_loop* loop=(bench_loop*)handle;
+	uart_prot_packet expected;
+	if(len!=sizeof(uart_prot_packet)){
+		return BMS_TRANSPORT_ERROR;
+	}
+	bms_device_build_request(loop->dev, buf[2], &expected);
+	loop->bad_requests+=(memcmp(&expected, buf, sizeof(uart_prot_packet))!=0) ? 1 : 0;
+	loop->bytes=(uint16_t)(bms_sim_build_response(loop->sim, buf[2], loop->frames)*sizeof(uart_prot_packet));
+	loop->pos=0;
+	return BMS_TRANSPORT_OK;
+}
+
+static uint8_t bench_loop_receive(void* handle, uint8_t* buf, uint16_t len, uint32_t timeout_ms){
+	(void)timeout_ms;
+	bench_loop* loop=(bench_loop*)handle;
+	if(loop->flood && len==sizeof(uart_prot_packet)){
+		uart_prot_packet* frame=(uart_prot_packet*)buf;
+		bms_sim_build_response(loop->sim, SOC_TOTAL_IV, frame);
+		frame->data_id=BATTERY_FAILURE_STATUS+1;	// valid frame, no variant requests it
+		frame->chksum=0;
+		for(uint8_t i=0;i<sizeof(uart_prot_packet)-1;i++){
+			frame->chksum+=buf[i];
+		}
+		loop->receptions++;
+		return BMS_TRANSPORT_OK;
+	}
+	if(loop->pos+len>loop->bytes){
+		return BMS_TRANSPORT_TIMEOUT;
+	}
+	memcpy(buf, (const uint8_t*)loop->frames+loop->pos, len);
+	loop->pos+=len;
+	return BMS_TRANSPORT_OK;
+}
+
+/**
+ * @brief Counts the fields of a variant status that differ from the simulated values.
+ */
+template<class V>
+static uint32_t bench_mismatches(const bms::status<V>& stat, const bms_sim_values* v){
+	uint32_t bad=0;
+	if constexpr (V::has(SOC_TOTAL_IV)){
+		bad+=(stat.cum_total_voltage!=v->cum_total_voltage || stat.gath_total_voltage!=v->gath_total_voltage || stat.current!=v->current || stat.soc!=v->soc) ? 1 : 0;
+	}
+	if constexpr (V::has(CHRG_DISCHRG_MOS_STATUS)){
+		bad+=(stat.mos_state!=v->mos_state || stat.bms_life!=v->bms_life || stat.remain_capacity!=v->remain_capacity) ? 1 : 0;
+	}
+	if constexpr (V::has(STATUS_INFO_1)){
+		bad+=(stat.battery_string_count!=V::strings || stat.temperature_count!=V::sensors || stat.charger_status!=v->charger_status) ? 1 : 0;
+	}
+	if constexpr (V::has(CELL_VOLTAGE)){
+		for(uint8_t i=0;i<V::strings;i++){
+			bad+=(stat.cell_mv[i]!=v->cell_mv[i]) ? 1 : 0;
+		}
+	}
+	if constexpr (V::has(CELL_TEMPERATURE)){
+		bad+=(memcmp(stat.cell_temperatures, v->temp_40, V::sensors)!=0) ? 1 : 0;
+	}
+	if constexpr (V::has(BATTERY_FAILURE_STATUS)){
+		bad+=(memcmp(&stat.cell_sum_volt_level, v->failure, MAX_DATA_SIZE)!=0) ? 1 : 0;
+	}
+	return bad;
+}
+
+/**
+ * @brief Runs both checks on one variant.
+ * @retval uint8_t returns 0 when every check passed.
+ */
+template<class V>
+static uint8_t bench_variant(const char* name, uint32_t iterations, uint32_t baudrate){
+	static bms_sim sim;
+	bms_sim_init(&sim, V::strings, V::sensors);
+	for(uint8_t i=0;i<V::strings;i++){
+		sim.values.cell_mv[i]=(uint16_t)(3300+i*7);	// every cell different, a misplaced frame shows
+	}
+	for(uint8_t i=0;i<V::sensors;i++){
+		sim.values.temp_40[i]=(uint8_t)(60+i);
+	}
+	static RT_Battery_status c_stat;
+	bms_device c_dev;
+	bench_loop loop;
+	memset(&loop, 0x00, sizeof(loop));
+	loop.sim=&sim;
+	loop.dev=&c_dev;
+	bms_transport loop_transport={ &loop, bench_loop_transmit, bench_loop_receive, NULL, -1, baudrate, NULL };
+	bms_device_init(&c_dev, &loop_transport, &c_stat);
+	c_dev.module_addr=V::module_addr;
+
+	bms::device<V> pack(&loop_transport);
+	bms::status<V> stat;
+	memset(&stat, 0x00, sizeof(stat));
+	uint8_t ret=0;
+	uint64_t t0=bms_linux_time_us();
+	for(uint32_t n=0;n<iterations && ret==0;n++){
+		ret=pack.read(stat);
+	}
+	uint64_t cpp_us=bms_linux_time_us()-t0;
+	uint32_t bad=bench_mismatches<V>(stat, &sim.values);
+
+	// endless stale frames, every variant reads SOC_TOTAL_IV first and must give up after the frames it waits for and report a sequence failure
+	loop.flood=1;
+	uint8_t flood_ret=pack.read(stat);
+	loop.flood=0;
+	uint8_t flood_ok=(flood_ret==BMS_ERR_BASE(SOC_TOTAL_IV)+3 && pack.unexpected_ids==loop.receptions) ? 1 : 0;
+	printf("%-8s stale frame flood : error %u after %u frames dropped\n", name, flood_ret, loop.receptions);
+
+	char c_cost[32]="C driver : no room";
+	if constexpr (V::strings<=STRINGS_COUNT && V::sensors<=TEMP_SENSOR_COUNT){
+		c_dev.strings_count=V::strings;
+		c_dev.temp_sensor_count=V::sensors;
+		uint8_t c_ret=0;
+		t0=bms_linux_time_us();
+		for(uint32_t n=0;n<iterations && c_ret==0;n++){
+			c_ret=bms_device_read_mask(&c_dev, V::mask, 1);
+		}
+		snprintf(c_cost, sizeof(c_cost), "C driver %6.0f ns", (c_ret==0) ? (bms_linux_time_us()-t0)*1000.0/iterations : 0.0);
+	}
+	printf("%-8s %2u cells %2u sensors mask 0x%03X addr 0x%02X : %2u frames, status %3u bytes (RT_Battery_status %u), read %6.0f ns, %s, worst case %u ms\n",
+		name, V::strings, V::sensors, V::mask, V::module_addr, V::response_frames, (unsigned)sizeof(stat), (unsigned)sizeof(RT_Battery_status),
+		cpp_us*1000.0/iterations, c_cost, pack.worst_case_ms());
+
+	// noisy pseudo terminal, the reassembly completes the damaged responses
+	static bms_linux_port port;
+	bms_transport transport;
+	sim.baudrate=baudrate;
+	sim.corrupt_permille=BENCH_CORRUPT_PERMILLE;
+	sim.reorder_frames=1;
+	if(bms_sim_start(&sim)!=0 || bms_transport_linux_open(&transport, &port, sim.slave_path, baudrate)!=BMS_TRANSPORT_OK){
+		printf("%-8s cannot open the simulator\n", name);
+		return 1;
+	}
+	bms::device<V> tty_pack(&transport);
+	bms::status<V> tty_stat;
+	memset(&tty_stat, 0x00, sizeof(tty_stat));
+	uint32_t failed=0;
+	t0=bms_linux_time_us();
+	for(uint32_t n=0;n<BENCH_PTY_READS;n++){
+		failed+=(tty_pack.read(tty_stat)!=0) ? 1 : 0;
+	}
+	uint64_t tty_us=bms_linux_time_us()-t0;
+	uint32_t tty_bad=bench_mismatches<V>(tty_stat, &sim.values);
+	uint32_t corrupted=sim.frames_corrupted;
+	bms_transport_linux_close(&port);
+	bms_sim_stop(&sim);
+	printf("%-8s %u reads at %u bps : %.2f ms per read, %u frames corrupted, %u reads failed\n", name, BENCH_PTY_READS, baudrate, tty_us/1000.0/BENCH_PTY_READS, corrupted, failed);
+
+	if(ret!=0 || bad!=0 || tty_bad!=0 || failed!=0 || loop.bad_requests!=0 || !flood_ok){
+		printf("%-8s FAILED : error %u, %u fields wrong, %u fields wrong on the tty, %u requests differ from bms_device_build_request(), stale frame flood %s\n", name, ret, bad, tty_bad,
+			loop.bad_requests, flood_ok ? "ok" : "not bounded");
+		return 1;
+	}
+	return 0;
+}
+
+int main(int argc, char** argv){
+	uint32_t iterations=(argc>1) ? (uint32_t)atoi(argv[1]) : BENCH_DEFAULT_ITERATIONS;
+	uint32_t baudrate=(argc>2) ? (uint32_t)atoi(argv[2]) : BENCH_DEFAULT_BAUDRATE;
+	if(iterations==0){
+		iterations=BENCH_DEFAULT_ITERATIONS;
+	}
+	if(baudrate==0){
+		baudrate=BENCH_DEFAULT_BAUDRATE;
+	}
+
+	uint8_t failed=0;
+	failed|=bench_variant<pack_16s>("16S", iterations, baudrate);
+	failed|=bench_variant<pack_24s>("24S", iterations, baudrate);
+	failed|=bench_variant<pack_48s>("48S", iterations, baudrate);
+	printf("%s\n", failed ? "variant front end differs from the driver" : "requests, fields and reassembly identical to the driver on every variant");
+	return failed;
+}
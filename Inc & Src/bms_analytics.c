@@ -0,0 +1,287 @@
+#include "bms_analytics.h"
+#include <string.h>
+
+/**
+ * @file bms_analytics.c
+ * @brief Source code file for the incremental pack analytics declared in bms_analytics.h
+ * @author Piyush
+ * @date 12/01/25
+ * @version 1.0
+ */
+
+
+#if ((_FULL_READ_ACCESS | _SOC_IV_ACCESS) == 0x01) && ((_FULL_READ_ACCESS | _CELL_VOLT_ACCESS) == 0x01)
+
+// ====================================================================================================== MACROS ==========================================================================================================================
+
+#define BMS_ANALYTICS_CAPACITY_SHIFT	2		/**< weight 1/4 of a window in capacity_mah					*/
+#define BMS_ANALYTICS_MAMS_PER_MAH	3600000		/**< mA.ms in a mAh								*/
+
+
+//==================================================================================== PRIVATE ROUTINES =========================================================================================
+
+/**
+ * @brief One step of a moving mean of weight 1/2^shift.
+ */
+static int32_t bms_analytics_ewma(int32_t avg, int32_t sample, uint8_t shift){
+	return (int32_t)(avg+((int64_t)sample-avg)/(1L<<shift));	// truncated towards 0, the fraction bits keep the bias far below the unit, lies between avg and sample
+}
+
+/**
+ * @brief Integer square root, rounded down.
+ */
+static uint32_t bms_analytics_isqrt(uint64_t x){
+	uint64_t root=0, bit=1ULL<<62;
+	while(bit>x){
+		bit>>=2;
+	}
+	while(bit!=0){
+		if(x>=root+bit){
+			x-=root+bit;
+			root=(root>>1)+bit;
+		}
+		else{
+			root>>=1;
+		}
+		bit>>=2;
+	}
+	return (uint32_t)root;
+}
+
+/**
+ * @brief Saturates to the int32 range.
+ */
+static int32_t bms_analytics_sat(int64_t x){
+	return (x>INT32_MAX) ? INT32_MAX : (x<INT32_MIN) ? INT32_MIN : (int32_t)x;
+}
+
+/**
+ * @brief Millivolts << BMS_ANALYTICS_Q of the IR drop of a current through a resistance, saturated to the int32 range.
+ */
+static int32_t bms_analytics_ir_q(int32_t ma, uint32_t r_uohm){
+	const int64_t limit=((int64_t)INT32_MAX*1000000)>>BMS_ANALYTICS_Q;	// nanovolts of the largest drop held in Q, the product below can't overflow under it
+	int64_t nv=(int64_t)ma*r_uohm;	// mA * uohm = nV, fits for any int32 current and uint32 resistance
+	if(nv>limit){
+		return INT32_MAX;
+	}
+	if(nv< -limit){
+		return INT32_MIN;
+	}
+	return (int32_t)((nv*(1L<<BMS_ANALYTICS_Q))/1000000);
+}
+
+/**
+ * @brief Millivolts << BMS_ANALYTICS_Q to microvolts.
+ */
+static int32_t bms_analytics_uv(int32_t q){
+	return (int32_t)(((int64_t)q*1000)/(1L<<BMS_ANALYTICS_Q));
+}
+
+/**
+ * @brief Closes the capacity window once the SOC moved by BMS_ANALYTICS_SOC_WINDOW, the charge counted over it divided by the SOC change is a capacity sample.
+ * @retval uint8_t returns BMS_ANALYTICS_EV_CAPACITY if a sample was taken, 0 otherwise.
+ */
+static uint8_t bms_analytics_window(bms_analytics* an, uint16_t soc){
+	int32_t dsoc=(int32_t)soc-an->window_soc;
+	if(dsoc<BMS_ANALYTICS_SOC_WINDOW && dsoc>-BMS_ANALYTICS_SOC_WINDOW){
+		return 0;
+	}
+	int64_t dq=an->charge_mams-an->window_mams;
+	an->window_soc=soc;
+	an->window_mams=an->charge_mams;
+	if(dq==0 || (dq>0)!=(dsoc>0)){	// SOC recalibrated by the BMS (full charge, empty pack) against the current
+		an->rejected++;
+		return 0;
+	}
+	uint64_t cap=(uint64_t)((dq>0) ? dq : -dq)/(3600ULL*(uint64_t)((dsoc>0) ? dsoc : -dsoc));	// |dq|/3600000 mAh over |dsoc|/1000
+	if(an->rated_mah!=0 && (cap<an->rated_mah/2 || cap>(uint64_t)an->rated_mah*3/2)){
+		an->rejected++;
+		return 0;
+	}
+	an->capacity_mah=(an->capacity_samples==0) ? (uint32_t)cap : (uint32_t)bms_analytics_ewma((int32_t)an->capacity_mah, (int32_t)cap, BMS_ANALYTICS_CAPACITY_SHIFT);
+	an->capacity_samples+=(an->capacity_samples<UINT16_MAX) ? 1 : 0;
+	return BMS_ANALYTICS_EV_CAPACITY;
+}
+
+/**
+ * @brief Folds a step resistance sample into a moving mean.
+ * @retval uint8_t returns 1 if the sample was plausible and taken.
+ */
+static uint8_t bms_analytics_resistance(uint32_t* r_uohm, uint16_t* samples, int32_t dv_mv, int32_t di_ma, uint32_t max_uohm){
+	int64_t r=(int64_t)dv_mv*1000000/di_ma;
+	if(r<=0 || r>max_uohm){
+		return 0;
+	}
+	*r_uohm=(*samples==0) ? (uint32_t)r : (uint32_t)bms_analytics_ewma((int32_t)*r_uohm, (int32_t)r, BMS_ANALYTICS_R_SHIFT);
+	*samples+=(*samples<UINT16_MAX) ? 1 : 0;
+	return 1;
+}
+
+
+//==================================================================================== ROUTINE DEFINITIONS ======================================================================================
+
+
+/**
+ * @brief Initializes the analytics of a pack, the figures start with the next refresh.
+ * @param bms_analytics* an passes the analytics.
+ * @param uint8_t cells passes the cells of the pack, at most STRINGS_COUNT (bms_device::strings_count).
+ * @param uint32_t rated_mah passes the nominal capacity of the pack, 0 if unknown.
+ * @retval void
+ */
+void bms_analytics_init(bms_analytics* an, uint8_t cells, uint32_t rated_mah){
+	memset(an, 0x00, sizeof(bms_analytics));
+	an->cells=(cells<STRINGS_COUNT) ? cells : STRINGS_COUNT;
+	an->rated_mah=rated_mah;
+}
+
+/**
+ * @brief Folds a refresh into the figures, constant time and memory whatever the number of refreshes before it.
+ * @param bms_analytics* an passes the analytics.
+ * @param const RT_Battery_status* stat passes the status, its current and SOC are used.
+ * @param const bms_cell_view* view passes the cells of the same refresh decoded by bms_cells_decode().
+ * @param uint32_t time_ms passes the time of the refresh, HAL_GetTick() on the MCU, the capture time on the host.
+ * @retval uint8_t returns an OR of BMS_ANALYTICS_EV_x, 0 for an ordinary refresh.
+ */
+uint8_t bms_analytics_update(bms_analytics* an, const RT_Battery_status* stat, const bms_cell_view* view, uint32_t time_ms){
+	uint8_t cells=(view->cells<an->cells) ? view->cells : an->cells;
+	int32_t ma=((int32_t)stat->current-BMS_ANALYTICS_CURRENT_OFFSET)*100;
+	if(cells==0){
+		return 0;
+	}
+	uint32_t sum_mv=0;
+	uint64_t sum_r=0;
+	for(uint8_t i=0;i<cells;i++){
+		sum_mv+=view->cell_mv[i];
+		sum_r+=an->cell[i].r_uohm;
+	}
+	int32_t pack_q=(int32_t)(((uint64_t)sum_mv<<BMS_ANALYTICS_Q)/cells);
+	an->refreshes++;
+
+	if(!an->started){
+		for(uint8_t i=0;i<cells;i++){
+			bms_cell_trend* t=&an->cell[i];
+			t->mean_q=(int32_t)view->cell_mv[i]<<BMS_ANALYTICS_Q;
+			t->offset_q=t->mean_q-pack_q;
+			t->baseline_q=t->offset_q;
+			t->last_mv=view->cell_mv[i];
+		}
+		an->started=1;
+		an->last_ms=time_ms;
+		an->last_ma=ma;
+		an->window_soc=stat->soc;
+		an->window_mams=an->charge_mams;
+		return 0;
+	}
+
+	uint8_t events=0;
+	uint32_t dt=time_ms-an->last_ms;
+	if(dt>BMS_ANALYTICS_MAX_GAP_MS){
+		events|=BMS_ANALYTICS_EV_GAP;
+		an->gaps++;
+		an->window_soc=stat->soc;	// the charge of the gap is unknown, the window starts over
+		an->window_mams=an->charge_mams;
+	}
+	else{
+		int64_t q=(int64_t)(ma+an->last_ma)*dt/2;	// trapezoid between the two refreshes
+		an->charge_mams+=q;
+		if(q>0){
+			an->charged_mams+=(uint64_t)q;
+		}
+		else{
+			an->discharged_mams+=(uint64_t)-q;
+		}
+		events|=bms_analytics_window(an, stat->soc);
+	}
+
+	int32_t di=ma-an->last_ma;
+	uint8_t step=(!(events & BMS_ANALYTICS_EV_GAP) && dt<=BMS_ANALYTICS_STEP_MAX_MS && (di>=BMS_ANALYTICS_STEP_MA || di<=-BMS_ANALYTICS_STEP_MA));
+	int32_t comp_pack_q=bms_analytics_sat((int64_t)pack_q-bms_analytics_ir_q(ma, (uint32_t)(sum_r/cells)));
+	int32_t pack_dv=0;
+	for(uint8_t i=0;i<cells;i++){
+		bms_cell_trend* t=&an->cell[i];
+		uint16_t mv=view->cell_mv[i];
+		int32_t sample=(int32_t)mv<<BMS_ANALYTICS_Q;
+
+		int32_t d=sample-t->mean_q;
+		t->mean_q=bms_analytics_ewma(t->mean_q, sample, BMS_ANALYTICS_MEAN_SHIFT);
+		uint64_t d2=((uint64_t)((int64_t)d*d))>>(2*BMS_ANALYTICS_Q-8);
+		d2=(d2>UINT32_MAX) ? UINT32_MAX : d2;
+		t->var_q8=(uint32_t)((int64_t)t->var_q8+((int64_t)d2-(int64_t)t->var_q8)/(1L<<BMS_ANALYTICS_MEAN_SHIFT));
+
+		int32_t offset=bms_analytics_sat((int64_t)sample-bms_analytics_ir_q(ma, t->r_uohm)-comp_pack_q);	// the resistances of the previous steps, a weak cell sagging under load is not an imbalance
+		t->offset_q=bms_analytics_ewma(t->offset_q, offset, BMS_ANALYTICS_MEAN_SHIFT);
+		t->baseline_q=bms_analytics_ewma(t->baseline_q, t->offset_q, BMS_ANALYTICS_DRIFT_SHIFT);
+
+		if(step){
+			int32_t dv=(int32_t)mv-t->last_mv;
+			pack_dv+=dv;
+			an->rejected+=bms_analytics_resistance(&t->r_uohm, &t->r_samples, dv, di, BMS_ANALYTICS_R_MAX_UOHM) ? 0 : 1;
+		}
+		t->last_mv=mv;
+	}
+	if(step){
+		uint16_t pack_samples=(an->pack_r_uohm!=0) ? 1 : 0;
+		events|=BMS_ANALYTICS_EV_STEP;
+		an->steps++;
+		an->rejected+=bms_analytics_resistance(&an->pack_r_uohm, &pack_samples, pack_dv, di, (uint32_t)BMS_ANALYTICS_R_MAX_UOHM*cells) ? 0 : 1;
+	}
+
+	an->last_ms=time_ms;
+	an->last_ma=ma;
+	return events;
+}
+
+/**
+ * @brief Figures of one cell in plain units.
+ * @param const bms_analytics* an passes the analytics.
+ * @param uint8_t cell passes the cell index.
+ * @param bms_cell_health* health passes the memory where the figures are stored.
+ * @retval void
+ */
+void bms_analytics_cell(const bms_analytics* an, uint8_t cell, bms_cell_health* health){
+	memset(health, 0x00, sizeof(bms_cell_health));
+	if(cell>=an->cells){
+		return;
+	}
+	const bms_cell_trend* t=&an->cell[cell];
+	health->mean_uv=bms_analytics_uv(t->mean_q);
+	health->stddev_uv=bms_analytics_isqrt((uint64_t)t->var_q8*15625U/4U);	// sqrt(var_q8/256 mV^2) in uV
+	health->offset_uv=bms_analytics_uv(t->offset_q);
+	health->drift_uv=bms_analytics_uv(t->offset_q-t->baseline_q);
+	health->resistance_uohm=t->r_uohm;
+	health->resistance_samples=t->r_samples;
+}
+
+/**
+ * @brief Figures of the pack in plain units.
+ * @param const bms_analytics* an passes the analytics.
+ * @param bms_pack_health* health passes the memory where the figures are stored.
+ * @retval void
+ */
+void bms_analytics_pack(const bms_analytics* an, bms_pack_health* health){
+	memset(health, 0x00, sizeof(bms_pack_health));
+	health->charge_mah=(int32_t)(an->charge_mams/BMS_ANALYTICS_MAMS_PER_MAH);
+	health->charged_mah=(uint32_t)(an->charged_mams/BMS_ANALYTICS_MAMS_PER_MAH);
+	health->discharged_mah=(uint32_t)(an->discharged_mams/BMS_ANALYTICS_MAMS_PER_MAH);
+	health->capacity_mah=an->capacity_mah;
+	health->resistance_uohm=an->pack_r_uohm;
+	if(an->rated_mah!=0){
+		health->cycles_x100=(uint32_t)((uint64_t)health->discharged_mah*100U/an->rated_mah);
+		health->soh_permille=(uint16_t)((uint64_t)an->capacity_mah*1000U/an->rated_mah);
+	}
+	int32_t worst_drift=-1;
+	for(uint8_t i=0;i<an->cells;i++){
+		const bms_cell_trend* t=&an->cell[i];
+		int32_t drift=t->offset_q-t->baseline_q;
+		drift=(drift<0) ? -drift : drift;
+		if(t->r_uohm>an->cell[health->worst_cell].r_uohm){
+			health->worst_cell=i;
+		}
+		if(drift>worst_drift){
+			worst_drift=drift;
+			health->drift_cell=i;
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,186 @@
+#ifndef BMS_ANALYTICS_H
+#define BMS_ANALYTICS_H
+
+#include "bms_cells.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @file bms_analytics.h
+ * @brief Header file for the incremental pack analytics defined in bms_analytics.c
+ * 	  Every refresh of a pack is folded into running figures in constant time and memory : the coulomb counts of the pack, the capacity it shows between two SOC readings,
+ * 	  and for every cell an exponential moving mean and variance of its voltage, its offset from the pack once its IR drop is taken out, the drift of that offset, and its
+ * 	  internal resistance from the voltage change over every current step (dV/dI). Nothing is kept per refresh, a year of readings costs what one does.
+ * @author Piyush
+ * @date 12/01/25
+ * @version 1.0
+ *
+ *
+ * @note Integer arithmetic only, the same code runs next to the driver on cores without FPU and on the host replaying captures (Host/bms_capture_tool.c analytics).
+ *	 The moving averages use a weight of 1/2^shift per refresh, so their time constant is counted in refreshes : BMS_ANALYTICS_MEAN_SHIFT 4 follows the last 16 or so,
+ *	 BMS_ANALYTICS_DRIFT_SHIFT 10 the last thousand, and the drift of a cell is how far its recent offset moved away from that long term one.
+ *	 A step is the current changing by BMS_ANALYTICS_STEP_MA or more between two refreshes at most BMS_ANALYTICS_STEP_MAX_MS apart. 0x90 and 0x95 are requested one after
+ *	 the other, a load moving between the two responses gives a wrong sample that the plausibility check and the averaging absorb.
+ *	 Only the refreshes whose SOC_TOTAL_IV and CELL_VOLTAGE responses were both received are to be passed, refreshes further apart than BMS_ANALYTICS_MAX_GAP_MS are not
+ *	 integrated.
+ *
+ *	 Example :
+ *		bms_analytics_init(&an, dev.strings_count, 40000);	// 40 Ah pack
+ *		after every successful read : bms_cells_decode(&view, &stat, dev.strings_count, dev.temp_sensor_count); bms_analytics_update(&an, &stat, &view, HAL_GetTick());
+ *		bms_analytics_pack(&an, &pack); bms_analytics_cell(&an, pack.worst_cell, &cell);
+ */
+
+
+#if ((_FULL_READ_ACCESS | _SOC_IV_ACCESS) == 0x01) && ((_FULL_READ_ACCESS | _CELL_VOLT_ACCESS) == 0x01)
+
+// ====================================================================================================== MACROS ==========================================================================================================================
+
+#define BMS_ANALYTICS_Q			16		/**< fraction bits of the millivolt averages					*/
+#define BMS_ANALYTICS_CURRENT_OFFSET	30000		/**< offset of the current sent by the BMS, 0.1 A, above it the pack charges	*/
+
+#ifndef BMS_ANALYTICS_MEAN_SHIFT
+#define BMS_ANALYTICS_MEAN_SHIFT	4		/**< weight 1/16 of a refresh in the cell means, variances and offsets		*/
+#endif
+#ifndef BMS_ANALYTICS_DRIFT_SHIFT
+#define BMS_ANALYTICS_DRIFT_SHIFT	10		/**< weight 1/1024 of a refresh in the long term offsets				*/
+#endif
+#ifndef BMS_ANALYTICS_R_SHIFT
+#define BMS_ANALYTICS_R_SHIFT		3		/**< weight 1/8 of a step in the resistances					*/
+#endif
+#ifndef BMS_ANALYTICS_STEP_MA
+#define BMS_ANALYTICS_STEP_MA		5000		/**< smallest current step giving a resistance sample				*/
+#endif
+#ifndef BMS_ANALYTICS_STEP_MAX_MS
+#define BMS_ANALYTICS_STEP_MAX_MS	2000		/**< refreshes further apart see the cells relax, no resistance sample		*/
+#endif
+#ifndef BMS_ANALYTICS_MAX_GAP_MS
+#define BMS_ANALYTICS_MAX_GAP_MS	10000		/**< refreshes further apart are not integrated					*/
+#endif
+#ifndef BMS_ANALYTICS_SOC_WINDOW
+#define BMS_ANALYTICS_SOC_WINDOW	100		/**< SOC change (0.1 %) closing a capacity window, 10 %				*/
+#endif
+#define BMS_ANALYTICS_R_MAX_UOHM	100000		/**< step resistances above 100 mohm (or negative) are rejected, a cell is a few mohm	*/
+
+/**
+ * @brief macros for the events returned by bms_analytics_update().
+ */
+#define BMS_ANALYTICS_EV_GAP		0x01		/**< refresh too far from the previous one, not integrated			*/
+#define BMS_ANALYTICS_EV_STEP		0x02		/**< current step, the resistances were sampled					*/
+#define BMS_ANALYTICS_EV_CAPACITY	0x04		/**< capacity window closed, capacity_mah was sampled				*/
+
+
+//================================================================================== ANALYTICS STRUCTURES =======================================================================================================
+
+/**
+ * @brief structure of the running figures of one cell.
+ */
+typedef struct {
+	int32_t mean_q;			/**< moving mean of the voltage, mV << BMS_ANALYTICS_Q				*/
+	uint32_t var_q8;		/**< moving mean of the squared deviation from mean_q, mV^2 << 8		*/
+	int32_t offset_q;		/**< moving mean of the IR compensated voltage minus the pack mean, mV << BMS_ANALYTICS_Q	*/
+	int32_t baseline_q;		/**< long term moving mean of offset_q						*/
+	uint32_t r_uohm;		/**< moving mean of the step resistances, micro ohm, 0 before the first step	*/
+	uint16_t r_samples;		/**< steps accepted								*/
+	uint16_t last_mv;		/**< voltage of the previous refresh						*/
+} bms_cell_trend;
+
+/**
+ * @brief structure of the analytics of one pack.
+ */
+typedef struct {
+	bms_cell_trend cell[STRINGS_COUNT];
+	uint8_t cells;			/**< cells followed, at most STRINGS_COUNT					*/
+	uint8_t started;		/**< 1 once the first refresh was taken						*/
+	uint32_t rated_mah;		/**< nominal capacity, 0 if unknown						*/
+	uint32_t last_ms;		/**< time of the previous refresh						*/
+	int32_t last_ma;		/**< current of the previous refresh, mA, positive while charging		*/
+	int64_t charge_mams;		/**< net charge counted, mA.ms, positive while charging				*/
+	uint64_t charged_mams;		/**< charge taken in								*/
+	uint64_t discharged_mams;	/**< charge given out								*/
+	uint16_t window_soc;		/**< SOC at the start of the capacity window					*/
+	int64_t window_mams;		/**< charge_mams at the start of the capacity window				*/
+	uint32_t capacity_mah;		/**< moving mean of the window capacities, 0 before the first			*/
+	uint16_t capacity_samples;	/**< windows accepted								*/
+	uint32_t pack_r_uohm;		/**< moving mean of the pack step resistances (sum of the cell voltage steps)	*/
+	uint32_t refreshes;		/**< refreshes taken								*/
+	uint32_t gaps;			/**< refreshes not integrated (BMS_ANALYTICS_EV_GAP)				*/
+	uint32_t steps;			/**< current steps seen								*/
+	uint32_t rejected;		/**< step resistances and capacity windows found implausible			*/
+} bms_analytics;
+
+/**
+ * @brief structure of the figures of one cell in plain units, filled by bms_analytics_cell().
+ */
+typedef struct {
+	int32_t mean_uv;		/**< moving mean voltage, microvolt						*/
+	uint32_t stddev_uv;		/**< moving standard deviation of the voltage, noise and load together		*/
+	int32_t offset_uv;		/**< IR compensated voltage above (below) the pack mean				*/
+	int32_t drift_uv;		/**< recent offset minus long term offset, a cell falling behind goes negative	*/
+	uint32_t resistance_uohm;	/**< internal resistance, 0 before the first step				*/
+	uint16_t resistance_samples;	/**< steps behind resistance_uohm						*/
+} bms_cell_health;
+
+/**
+ * @brief structure of the figures of the pack, filled by bms_analytics_pack().
+ */
+typedef struct {
+	int32_t charge_mah;		/**< net charge counted since bms_analytics_init(), positive while charging	*/
+	uint32_t charged_mah;		/**< charge taken in								*/
+	uint32_t discharged_mah;	/**< charge given out								*/
+	uint32_t cycles_x100;		/**< equivalent full cycles x100, discharged over rated capacity, 0 without rated	*/
+	uint32_t capacity_mah;		/**< capacity seen between SOC readings, 0 before the first window		*/
+	uint16_t soh_permille;		/**< capacity_mah over rated_mah, 0 without either				*/
+	uint32_t resistance_uohm;	/**< pack internal resistance, 0 before the first step				*/
+	uint8_t worst_cell;		/**< cell of the highest resistance						*/
+	uint8_t drift_cell;		/**< cell of the largest drift, either way					*/
+} bms_pack_health;
+
+
+//======================================================================================== ROUTINE DECLARATION ===================================================================================================
+
+/**
+ * @brief Initializes the analytics of a pack, the figures start with the next refresh.
+ * @param bms_analytics* an passes the analytics.
+ * @param uint8_t cells passes the cells of the pack, at most STRINGS_COUNT (bms_device::strings_count).
+ * @param uint32_t rated_mah passes the nominal capacity of the pack, 0 if unknown.
+ * @retval void
+ */
+void bms_analytics_init(bms_analytics* an, uint8_t cells, uint32_t rated_mah);
+
+/**
+ * @brief Folds a refresh into the figures, constant time and memory whatever the number of refreshes before it.
+ * @param bms_analytics* an passes the analytics.
+ * @param const RT_Battery_status* stat passes the status, its current and SOC are used.
+ * @param const bms_cell_view* view passes the cells of the same refresh decoded by bms_cells_decode().
+ * @param uint32_t time_ms passes the time of the refresh, HAL_GetTick() on the MCU, the capture time on the host.
+ * @retval uint8_t returns an OR of BMS_ANALYTICS_EV_x, 0 for an ordinary refresh.
+ */
+uint8_t bms_analytics_update(bms_analytics* an, const RT_Battery_status* stat, const bms_cell_view* view, uint32_t time_ms);
+
+/**
+ * @brief Figures of one cell in plain units.
+ * @param const bms_analytics* an passes the analytics.
+ * @param uint8_t cell passes the cell index.
+ * @param bms_cell_health* health passes the memory where the figures are stored.
+ * @retval void
+ */
+void bms_analytics_cell(const bms_analytics* an, uint8_t cell, bms_cell_health* health);
+
+/**
+ * @brief Figures of the pack in plain units.
+ * @param const bms_analytics* an passes the analytics.
+ * @param bms_pack_health* health passes the memory where the figures are stored.
+ * @retval void
+ */
+void bms_analytics_pack(const bms_analytics* an, bms_pack_health* health);
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /**< BMS_ANALYTICS_H  */
@@ -0,0 +1,620 @@
+#include "bms_capture.h"
+#include "bms_stream.h"
+#include <string.h>
+
+/**
+ * @file bms_capture.c
+ * @brief Source code file for the UART capture format declared in bms_capture.h
+ * @author Piyush
+ * @date 12/01/25
+ * @version 1.0
+ */
+
+
+// ====================================================================================================== MACROS ==========================================================================================================================
+
+#define BMS_CAPTURE_RECORD_MAX		(1+5+5)		/**< type, time and length of a record, body excluded		*/
+#define BMS_CAPTURE_CHUNK_MAX		(BMS_CAPTURE_BLOCK_BYTES/2)	/**< longer RX/TX transfers are split over several records	*/
+
+_Static_assert(sizeof(bms_capture_header)==32, "bms_capture_header layout");
+_Static_assert(sizeof(bms_capture_block_header)==24, "bms_capture_block_header layout");
+_Static_assert(sizeof(bms_capture_index)==16 && sizeof(bms_capture_footer)==16, "bms_capture_index layout");
+_Static_assert(BMS_CAPTURE_BLOCK_BYTES>=256, "BMS_CAPTURE_BLOCK_BYTES does not hold a polling cycle");
+
+
+//================================================================================== DECODER STRUCTURES ========================================================================================================
+
+/**
+ * @brief structure of a request waiting for its response while decoding.
+ */
+typedef struct {
+	uint8_t data_id;
+	uint8_t frames;			/**< frames of the response				*/
+	uint16_t arrived;		/**< one bit per frame number received in the current response	*/
+	uint16_t stored;		/**< one bit per frame number stored, over the retries		*/
+} bms_capture_pending;
+
+/**
+ * @brief structure of the state of a block decode.
+ */
+typedef struct {
+	bms_device dev;				/**< sizes of the responses, stores the frames into status.stat	*/
+	bms_frame_parser parser;		/**< receive side, fed with the RX records				*/
+	bms_capture_pending pending[BMS_CAPTURE_PENDING_MAX];
+	uint8_t pending_count;
+	uint8_t open;				/**< 1 once the current cycle has a request				*/
+	bms_capture_status status;		/**< cycle being decoded						*/
+	bms_capture_stats* stats;
+	bms_capture_status_callback callback;
+	void* ctx;
+} bms_capture_decoder;
+
+
+//==================================================================================== PRIVATE ROUTINES =========================================================================================
+
+/**
+ * @brief Stores a varint (7 bits per byte, low bits first).
+ * @param uint32_t value passes the value.
+ * @param uint8_t* dst passes the destination.
+ * @retval uint8_t returns the number of bytes.
+ */
+static uint8_t bms_capture_put_varint(uint32_t value, uint8_t* dst){
+	uint8_t n=0;
+	while(value>=0x80){
+		dst[n++]=(uint8_t)(value|0x80);
+		value>>=7;
+	}
+	dst[n++]=(uint8_t)value;
+	return n;
+}
+
+/**
+ * @brief Reads a varint without reading past end.
+ * @param const uint8_t** p passes the read position, moved past the varint.
+ * @param const uint8_t* end passes the end of the block.
+ * @param uint32_t* value passes the memory where the value is stored.
+ * @retval uint8_t returns 1 on success and 0 on a truncated or overlong varint.
+ */
+static uint8_t bms_capture_get_varint(const uint8_t** p, const uint8_t* end, uint32_t* value){
+	uint32_t v=0;
+	for(uint8_t shift=0;shift<35;shift+=7){
+		if(*p>=end){
+			return 0;
+		}
+		uint8_t byte=*(*p)++;
+		v|=(uint32_t)(byte&0x7F)<<shift;
+		if((byte&0x80)==0){
+			*value=v;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * @brief Checks that 13 bytes are a whole frame with a correct checksum.
+ */
+static uint8_t bms_capture_is_frame(const uint8_t* buf){
+	uart_prot_packet frame;
+	memcpy(&frame, buf, sizeof(frame));
+	return frame.start_flag==START_FLAG && frame.data_len==MAX_DATA_SIZE && verify_checksum(&frame);
+}
+
+/**
+ * @brief Data ID bit of a read data ID, 0 for the commands.
+ */
+static uint16_t bms_capture_id_bit(uint8_t data_id){
+	return (data_id>=SOC_TOTAL_IV && data_id<=BATTERY_FAILURE_STATUS) ? BMS_DATA_ID_MASK(data_id) : 0;
+}
+
+/**
+ * @brief Starts a record, the current block is handed to the sink first if the record does not fit or its time difference does not fit 32 bit.
+ * @param bms_capture* cap passes the pointer to the capture.
+ * @param uint64_t time_us passes the time of the record.
+ * @param uint8_t type passes the record type.
+ * @param uint16_t body passes the bytes following the type and time.
+ * @retval uint8_t returns 0 on success and BMS_CAPTURE_ERR_SINK if a block was lost meanwhile, the record is written anyway.
+ */
+static uint8_t bms_capture_begin(bms_capture* cap, uint64_t time_us, uint8_t type, uint16_t body){
+	uint8_t ret=0;
+	if(time_us<cap->last_us){
+		time_us=cap->last_us;	// clock stepped back, keep the records ordered
+	}
+	if(cap->fill+BMS_CAPTURE_RECORD_MAX+body>BMS_CAPTURE_BLOCK_BYTES || (cap->records!=0 && time_us-cap->last_us>UINT32_MAX)){
+		ret=bms_capture_flush(cap);
+	}
+	if(cap->records==0){
+		cap->block_us=time_us;
+		cap->last_us=time_us;
+	}
+	cap->block[cap->fill++]=type;
+	cap->fill+=bms_capture_put_varint((uint32_t)(time_us-cap->last_us), cap->block+cap->fill);
+	cap->last_us=time_us;
+	cap->records++;
+	return ret;
+}
+
+/**
+ * @brief Writes a RX/TX record holding the bytes as they are.
+ */
+static uint8_t bms_capture_raw(bms_capture* cap, uint64_t time_us, uint8_t type, const uint8_t* buf, uint16_t len){
+	uint8_t ret=0;
+	while(len!=0){
+		uint16_t chunk=(len>BMS_CAPTURE_CHUNK_MAX) ? BMS_CAPTURE_CHUNK_MAX : len;
+		ret|=bms_capture_begin(cap, time_us, type, chunk);
+		cap->fill+=bms_capture_put_varint(chunk, cap->block+cap->fill);
+		memcpy(cap->block+cap->fill, buf, chunk);
+		cap->fill+=chunk;
+		buf+=chunk;
+		len-=chunk;
+	}
+	return ret;
+}
+
+/**
+ * @brief Transmit routine of the capture transport, records the bytes once sent.
+ */
+static uint8_t bms_capture_transmit(void* handle, const uint8_t* buf, uint16_t len, uint32_t timeout_ms){
+	bms_capture* cap=(bms_capture*)handle;
+	uint64_t now=cap->time_us();
+	uint8_t ret=bms_transport_transmit(cap->inner, buf, len, timeout_ms);
+	if(ret==BMS_TRANSPORT_OK){
+		bms_capture_tx(cap, now, buf, len);
+	}
+	return ret;
+}
+
+/**
+ * @brief Receive routine of the capture transport, records the bytes once received, bytes of a timed out transfer are not recorded.
+ */
+static uint8_t bms_capture_receive(void* handle, uint8_t* buf, uint16_t len, uint32_t timeout_ms){
+	bms_capture* cap=(bms_capture*)handle;
+	uint8_t ret=bms_transport_receive(cap->inner, buf, len, timeout_ms);
+	if(ret==BMS_TRANSPORT_OK){
+		bms_capture_rx(cap, cap->time_us(), buf, len);
+	}
+	return ret;
+}
+
+/**
+ * @brief Non blocking receive routine of the capture transport.
+ */
+static uint16_t bms_capture_receive_available(void* handle, uint8_t* buf, uint16_t max){
+	bms_capture* cap=(bms_capture*)handle;
+	uint16_t n=cap->inner->receive_available(cap->inner->handle, buf, max);
+	if(n!=0){
+		bms_capture_rx(cap, cap->time_us(), buf, n);
+	}
+	return n;
+}
+
+/**
+ * @brief Hands the current cycle to the callback and starts a new one.
+ */
+static void bms_capture_emit(bms_capture_decoder* dec){
+	if(dec->open){
+		dec->stats->statuses++;
+		if(dec->callback!=NULL){
+			dec->callback(dec->ctx, &dec->status);
+		}
+	}
+	memset(&dec->status.stat, 0x00, sizeof(RT_Battery_status));
+	dec->status.mask=0;
+	dec->open=0;
+}
+
+/**
+ * @brief Removes the first n requests waiting for a response, the ones left incomplete count as sequence errors.
+ */
+static void bms_capture_pop(bms_capture_decoder* dec, uint8_t n){
+	for(uint8_t i=0;i<n;i++){
+		if(dec->pending[i].stored!=(uint16_t)((1U<<dec->pending[i].frames)-1)){
+			dec->stats->sequence_errors++;
+		}
+	}
+	memmove(&dec->pending[0], &dec->pending[n], (dec->pending_count-n)*sizeof(bms_capture_pending));
+	dec->pending_count-=n;
+}
+
+/**
+ * @brief Decodes a request record.
+ */
+static void bms_capture_on_request(bms_capture_decoder* dec, uint64_t time_us, uint8_t data_id){
+	dec->stats->requests++;
+	for(uint8_t i=0;i<dec->pending_count;i++){
+		if(dec->pending[i].data_id==data_id){	// retry of an incomplete response, only the frames still missing are taken from the new one
+			dec->stats->retries++;
+			dec->pending[i].arrived=0;
+			return;
+		}
+	}
+
+	uint16_t bit=bms_capture_id_bit(data_id);
+	if(dec->status.mask & bit){
+		bms_capture_emit(dec);	// answered already, the next polling cycle starts
+	}
+	if(!dec->open){
+		dec->open=1;
+		dec->status.time_us=time_us;
+	}
+	if(dec->pending_count==BMS_CAPTURE_PENDING_MAX){
+		bms_capture_pop(dec, 1);	// more requests in flight than the driver allows, the oldest is given up
+	}
+	bms_capture_pending* req=&dec->pending[dec->pending_count++];
+	req->data_id=data_id;
+	req->frames=bms_device_frames(&dec->dev, data_id);
+	req->arrived=0;
+	req->stored=0;
+}
+
+/**
+ * @brief Decodes a received frame with a correct checksum, matched to the oldest request of its data ID.
+ */
+static void bms_capture_on_frame(bms_capture_decoder* dec, const uart_prot_packet* frame){
+	uint8_t k=0;
+	while(k<dec->pending_count && dec->pending[k].data_id!=frame->data_id){
+		k++;
+	}
+	if(k==dec->pending_count){
+		dec->stats->unexpected++;
+		return;
+	}
+	bms_capture_pop(dec, k);	// the BMS moved on to a later request
+
+	bms_capture_pending* req=&dec->pending[0];
+	uint16_t all=(uint16_t)((1U<<req->frames)-1);
+	uint8_t number=(frame->data_id==CELL_VOLTAGE || frame->data_id==CELL_TEMPERATURE) ? frame->data[0] : 0;
+	if(number>=req->frames || (req->arrived & (1U<<number))){
+		dec->stats->sequence_errors++;
+		return;
+	}
+	req->arrived|=(uint16_t)(1U<<number);
+	if(!(req->stored & (1U<<number))){
+		req->stored|=(uint16_t)(1U<<number);
+		bms_device_store_frame(&dec->dev, frame);
+	}
+	if(req->stored==all){
+		dec->status.mask|=bms_capture_id_bit(frame->data_id);
+	}
+	if(req->arrived==all){
+		bms_capture_pop(dec, 1);
+	}
+}
+
+/**
+ * @brief Feeds received bytes to the parser of the decoder.
+ */
+static void bms_capture_on_rx(bms_capture_decoder* dec, const uint8_t* buf, uint16_t len){
+	dec->stats->rx_bytes+=len;
+	for(uint16_t i=0;i<len;i++){
+		if(bms_parser_feed(&dec->parser, buf[i])){
+			bms_capture_on_frame(dec, &dec->parser.frame);
+		}
+	}
+}
+
+
+//==================================================================================== ROUTINE DEFINITIONS ======================================================================================
+
+
+/**
+ * @brief Starts a capture and hands its header to the sink.
+ * @param bms_capture* cap passes the pointer to the capture.
+ * @param bms_transport* inner passes the transport towards the BMS.
+ * @param bms_capture_sink sink passes the destination of the capture.
+ * @param void* ctx passes the context of the sink.
+ * @param uint64_t (*time_us)(void) passes the microsecond clock.
+ * @retval uint8_t returns 0 on success and BMS_CAPTURE_ERR_SINK if the sink failed.
+ */
+uint8_t bms_capture_init(bms_capture* cap, bms_transport* inner, bms_capture_sink sink, void* ctx, uint64_t (*time_us)(void)){
+	cap->inner=inner;
+	cap->sink=sink;
+	cap->ctx=ctx;
+	cap->time_us=time_us;
+	cap->index=NULL;
+	cap->index_max=0;
+	cap->blocks=0;
+	cap->lost_blocks=0;
+	cap->cycle_mask=0;
+	cap->last_id=0;
+	cap->records=0;
+	cap->fill=0;
+
+	memset(&cap->header, 0x00, sizeof(bms_capture_header));
+	memcpy(cap->header.magic, BMS_CAPTURE_MAGIC, sizeof(BMS_CAPTURE_MAGIC));
+	cap->header.version=BMS_CAPTURE_VERSION;
+	cap->header.header_size=sizeof(bms_capture_header);
+	cap->header.host_addr=UPPER_CMPTR_ADDR;
+	cap->header.bms_addr=BMS_MASTER_ADDR;
+	cap->header.strings_count=STRINGS_COUNT;
+	cap->header.temp_sensor_count=TEMP_SENSOR_COUNT;
+	cap->header.baudrate=(inner!=NULL) ? inner->baudrate : UART_DEFAULT_BAUDRATE;
+	cap->header.start_us=time_us();
+	cap->last_us=cap->header.start_us;
+	cap->offset=sizeof(bms_capture_header);
+	return (sink(ctx, (const uint8_t*)&cap->header, sizeof(bms_capture_header))==0) ? 0 : BMS_CAPTURE_ERR_SINK;
+}
+
+/**
+ * @brief Fills a transport that forwards to the inner transport of a capture and records the traffic.
+ * @param bms_transport* transport passes the pointer to the transport to be filled.
+ * @param bms_capture* cap passes the pointer to an initialized capture.
+ * @retval void
+ */
+void bms_capture_transport_init(bms_transport* transport, bms_capture* cap){
+	transport->handle=cap;
+	transport->transmit=bms_capture_transmit;
+	transport->receive=bms_capture_receive;
+	transport->receive_available=(cap->inner->receive_available!=NULL) ? bms_capture_receive_available : NULL;
+	transport->fd=cap->inner->fd;
+	transport->baudrate=cap->inner->baudrate;
+	transport->transmit_start=NULL;	// the request is recorded when its transmit returns
+}
+
+/**
+ * @brief Records sent bytes, a request frame becomes a request record.
+ * @param bms_capture* cap passes the pointer to the capture.
+ * @param uint64_t time_us passes the time of the transfer.
+ * @param const uint8_t* buf passes the bytes.
+ * @param uint16_t len passes the number of bytes.
+ * @retval uint8_t returns 0 on success and BMS_CAPTURE_ERR_SINK if a full block could not be handed to the sink.
+ */
+uint8_t bms_capture_tx(bms_capture* cap, uint64_t time_us, const uint8_t* buf, uint16_t len){
+	uint8_t ret=0;
+	static const uint8_t zero[MAX_DATA_SIZE]={0};
+	if(len%sizeof(uart_prot_packet)!=0){
+		return bms_capture_raw(cap, time_us, BMS_CAPTURE_REC_TX, buf, len);
+	}
+	for(uint16_t at=0;at<len;at+=sizeof(uart_prot_packet)){
+		const uart_prot_packet* frame=(const uart_prot_packet*)(buf+at);
+		if(!bms_capture_is_frame(buf+at) || memcmp(frame->data+1, zero, MAX_DATA_SIZE-1)!=0){	// only data[0] is kept
+			ret|=bms_capture_raw(cap, time_us, BMS_CAPTURE_REC_TX, buf+at, sizeof(uart_prot_packet));
+			continue;
+		}
+
+		uint16_t bit=bms_capture_id_bit(frame->data_id);
+		if((cap->cycle_mask & bit) && frame->data_id!=cap->last_id){
+			cap->cycle_mask=0;	// new polling cycle, the block is closed here if it is well filled so that blocks hold whole cycles
+			if(cap->fill>=BMS_CAPTURE_BLOCK_FILL){
+				ret|=bms_capture_flush(cap);
+			}
+		}
+		cap->cycle_mask|=bit;
+		cap->last_id=frame->data_id;
+
+		ret|=bms_capture_begin(cap, time_us, BMS_CAPTURE_REC_REQUEST, 3);
+		cap->block[cap->fill++]=frame->module_addr;
+		cap->block[cap->fill++]=frame->data_id;
+		cap->block[cap->fill++]=frame->data[0];
+	}
+	return ret;
+}
+
+/**
+ * @brief Records received bytes, every whole valid frame becomes a frame record.
+ * @param bms_capture* cap passes the pointer to the capture.
+ * @param uint64_t time_us passes the time of the transfer.
+ * @param const uint8_t* buf passes the bytes.
+ * @param uint16_t len passes the number of bytes.
+ * @retval uint8_t returns 0 on success and BMS_CAPTURE_ERR_SINK if a full block could not be handed to the sink.
+ */
+uint8_t bms_capture_rx(bms_capture* cap, uint64_t time_us, const uint8_t* buf, uint16_t len){
+	uint8_t ret=0;
+	uint16_t raw=0;		// start of the bytes not recorded yet
+	uint16_t at=0;
+	while(at+sizeof(uart_prot_packet)<=len){
+		if(buf[at+1]!=cap->header.bms_addr || !bms_capture_is_frame(buf+at)){
+			at+=sizeof(uart_prot_packet);
+			continue;
+		}
+		if(raw<at){
+			ret|=bms_capture_raw(cap, time_us, BMS_CAPTURE_REC_RX, buf+raw, at-raw);
+		}
+		ret|=bms_capture_begin(cap, time_us, BMS_CAPTURE_REC_FRAME, 1+MAX_DATA_SIZE);
+		cap->block[cap->fill++]=buf[at+offsetof(uart_prot_packet, data_id)];
+		memcpy(cap->block+cap->fill, buf+at+offsetof(uart_prot_packet, data), MAX_DATA_SIZE);
+		cap->fill+=MAX_DATA_SIZE;
+		at+=sizeof(uart_prot_packet);
+		raw=at;
+	}
+	if(raw<len){
+		ret|=bms_capture_raw(cap, time_us, BMS_CAPTURE_REC_RX, buf+raw, len-raw);
+	}
+	return ret;
+}
+
+/**
+ * @brief Hands the current block to the sink.
+ * @param bms_capture* cap passes the pointer to the capture.
+ * @retval uint8_t returns 0 on success and BMS_CAPTURE_ERR_SINK if the sink failed.
+ */
+uint8_t bms_capture_flush(bms_capture* cap){
+	if(cap->records==0){
+		return 0;
+	}
+	bms_capture_block_header head={ .magic=BMS_CAPTURE_BLOCK_MAGIC, .len=cap->fill, .records=cap->records, .reserved=0, .time_us=cap->block_us };
+	uint8_t ok=(cap->sink(cap->ctx, (const uint8_t*)&head, sizeof(head))==0 && cap->sink(cap->ctx, cap->block, cap->fill)==0);
+	cap->records=0;
+	cap->fill=0;
+	if(!ok){
+		cap->lost_blocks++;
+		return BMS_CAPTURE_ERR_SINK;
+	}
+	if(cap->index!=NULL && cap->blocks<cap->index_max){
+		cap->index[cap->blocks].offset=cap->offset;
+		cap->index[cap->blocks].time_us=head.time_us;
+	}
+	cap->blocks++;
+	cap->offset+=sizeof(head)+head.len;
+	return 0;
+}
+
+/**
+ * @brief Ends a capture, the current block is flushed and the index and footer are written when an index memory was given.
+ * @param bms_capture* cap passes the pointer to the capture.
+ * @retval uint8_t returns 0 on success, BMS_CAPTURE_ERR_SINK or BMS_CAPTURE_ERR_INDEX_FULL (the capture is complete but not indexed).
+ */
+uint8_t bms_capture_close(bms_capture* cap){
+	uint8_t ret=bms_capture_flush(cap);
+	if(ret!=0 || cap->index==NULL){
+		return ret;
+	}
+	if(cap->blocks>cap->index_max){
+		return BMS_CAPTURE_ERR_INDEX_FULL;
+	}
+	bms_capture_footer footer={ .index_offset=cap->offset, .blocks=cap->blocks, .magic=BMS_CAPTURE_FOOTER_MAGIC };
+	if(cap->sink(cap->ctx, (const uint8_t*)cap->index, cap->blocks*sizeof(bms_capture_index))!=0 || cap->sink(cap->ctx, (const uint8_t*)&footer, sizeof(footer))!=0){
+		return BMS_CAPTURE_ERR_SINK;
+	}
+	cap->offset+=cap->blocks*sizeof(bms_capture_index)+sizeof(footer);
+	return 0;
+}
+
+/**
+ * @brief Checks the header of a capture.
+ * @param const uint8_t* buf passes the first bytes of the capture.
+ * @param uint64_t len passes the number of bytes available.
+ * @retval uint8_t returns 0 on a valid header and BMS_CAPTURE_ERR_FORMAT otherwise.
+ */
+uint8_t bms_capture_check_header(const uint8_t* buf, uint64_t len){
+	bms_capture_header header;
+	if(len<sizeof(header)){
+		return BMS_CAPTURE_ERR_FORMAT;
+	}
+	memcpy(&header, buf, sizeof(header));
+	if(memcmp(header.magic, BMS_CAPTURE_MAGIC, sizeof(BMS_CAPTURE_MAGIC))!=0 || header.version!=BMS_CAPTURE_VERSION || header.header_size<sizeof(header) || header.header_size>len){
+		return BMS_CAPTURE_ERR_FORMAT;
+	}
+	return 0;
+}
+
+/**
+ * @brief Reads the record at a position of a block, for tools walking the records themselves (replay).
+ * @param const uint8_t* p passes the record.
+ * @param const uint8_t* end passes the end of the block.
+ * @param uint8_t* type passes the memory where the record type is stored.
+ * @param uint32_t* dt_us passes the memory where the time since the previous record is stored.
+ * @param const uint8_t** body passes the memory where the body of the record is stored, behind the length of RX/TX records.
+ * @param uint16_t* body_len passes the memory where the body length is stored.
+ * @retval const uint8_t* returns the next record, NULL on a damaged record.
+ */
+const uint8_t* bms_capture_next_record(const uint8_t* p, const uint8_t* end, uint8_t* type, uint32_t* dt_us, const uint8_t** body, uint16_t* body_len){
+	uint32_t len;
+	if(p>=end){
+		return NULL;
+	}
+	*type=*p++;
+	if(!bms_capture_get_varint(&p, end, dt_us)){
+		return NULL;
+	}
+	switch(*type){
+		case BMS_CAPTURE_REC_REQUEST:
+			len=3;
+			break;
+		case BMS_CAPTURE_REC_FRAME:
+			len=1+MAX_DATA_SIZE;
+			break;
+		case BMS_CAPTURE_REC_RX:
+		case BMS_CAPTURE_REC_TX:
+			if(!bms_capture_get_varint(&p, end, &len) || len>BMS_CAPTURE_CHUNK_MAX){
+				return NULL;
+			}
+			break;
+		default:
+			return NULL;
+	}
+	if((uint64_t)(end-p)<len){
+		return NULL;
+	}
+	*body=p;
+	*body_len=(uint16_t)len;
+	return p+len;
+}
+
+/**
+ * @brief Decodes the records of one block into polling cycles, a cycle ends when a data ID already answered in it is requested again.
+ * @param const bms_capture_header* header passes the header of the capture.
+ * @param const uint8_t* block passes the block, header included.
+ * @param uint64_t len passes the bytes available from block on.
+ * @param bms_capture_stats* stats passes the statistics to be added to.
+ * @param bms_capture_status_callback callback passes the routine receiving the cycles in order, can be NULL.
+ * @param void* ctx passes the context of the callback.
+ * @retval uint64_t returns the size of the block, header included, 0 if no valid block starts at block.
+ */
+uint64_t bms_capture_decode_block(const bms_capture_header* header, const uint8_t* block, uint64_t len, bms_capture_stats* stats, bms_capture_status_callback callback, void* ctx){
+	bms_capture_block_header head;
+	if(len<sizeof(head)){
+		return 0;
+	}
+	memcpy(&head, block, sizeof(head));
+	if(head.magic!=BMS_CAPTURE_BLOCK_MAGIC || head.len>len-sizeof(head)){
+		return 0;
+	}
+
+	bms_capture_decoder dec;
+	bms_device_init(&dec.dev, NULL, &dec.status.stat);
+	dec.dev.module_addr=header->host_addr;
+	dec.dev.strings_count=header->strings_count;		// the table clips them to the compile time sizes of RT_Battery_status
+	dec.dev.temp_sensor_count=header->temp_sensor_count;
+	memset(&dec.parser, 0x00, sizeof(dec.parser));
+	dec.pending_count=0;
+	dec.open=0;
+	dec.stats=stats;
+	dec.callback=callback;
+	dec.ctx=ctx;
+	memset(&dec.status, 0x00, sizeof(dec.status));
+
+	const uint8_t* p=block+sizeof(head);
+	const uint8_t* end=p+head.len;
+	uint64_t t=head.time_us;
+	uint32_t records=0;
+	while(p<end){
+		uint8_t type;
+		uint32_t dt;
+		const uint8_t* body;
+		uint16_t body_len;
+		p=bms_capture_next_record(p, end, &type, &dt, &body, &body_len);
+		if(p==NULL){
+			stats->bad_blocks++;
+			break;
+		}
+		t+=dt;
+		records++;
+
+		if(type==BMS_CAPTURE_REC_REQUEST){
+			bms_capture_on_request(&dec, t, body[1]);
+		}
+		else if(type==BMS_CAPTURE_REC_FRAME){
+			uart_prot_packet frame;
+			frame.start_flag=START_FLAG;
+			frame.module_addr=header->bms_addr;
+			frame.data_id=body[0];
+			frame.data_len=MAX_DATA_SIZE;
+			memcpy(frame.data, body+1, MAX_DATA_SIZE);
+			uint16_t sum=0;
+			for(uint8_t i=0;i<sizeof(frame)-1;i++){
+				sum+=((const uint8_t*)&frame)[i];
+			}
+			frame.chksum=(uint8_t)sum;
+			if(dec.parser.state!=BMS_PARSER_WAIT_START){	// a whole frame came in one transfer, the bytes before it were no frame
+				dec.parser.discarded+=dec.parser.fill;
+				bms_parser_reset(&dec.parser);
+			}
+			dec.parser.frames++;
+			stats->rx_bytes+=sizeof(frame);
+			bms_capture_on_frame(&dec, &frame);
+		}
+		else if(type==BMS_CAPTURE_REC_RX){
+			bms_capture_on_rx(&dec, body, body_len);
+		}
+	}
+	bms_capture_emit(&dec);
+
+	stats->blocks++;
+	stats->records+=records;
+	stats->frames+=dec.parser.frames;
+	stats->checksum_errors+=dec.parser.checksum_errors;
+	stats->length_errors+=dec.parser.length_errors;
+	stats->discarded+=dec.parser.discarded;
+	return sizeof(head)+head.len;
+}
@@ -0,0 +1,269 @@
+#ifndef BMS_CAPTURE_H
+#define BMS_CAPTURE_H
+
+#include "bms_uart_comm.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @file bms_capture.h
+ * @brief Header file for the UART capture format defined in bms_capture.c
+ * 	  A capture transport sits between the driver and the real transport and records every request and every received byte with its time, in blocks handed to a sink
+ * 	  (file, SD card, socket). The same file decodes the blocks back into RT_Battery_status records with the driver's own frame parser and data ID table, so that captures
+ * 	  are never re-decoded by hand.
+ * @author Piyush
+ * @date 12/01/25
+ * @version 1.0
+ *
+ *
+ * @note File layout, little endian :
+ *		bms_capture_header
+ *		blocks : bms_capture_block_header followed by len bytes of records, a block only starts on a polling cycle boundary unless a cycle outgrows it
+ *		index (optional) : one bms_capture_index per block, then bms_capture_footer, written by bms_capture_close() when an index memory was given
+ *	 Records : type, time since the previous record of the block in us (varint), then
+ *		BMS_CAPTURE_REC_REQUEST : module_addr, data_id, data[0] of a request frame
+ *		BMS_CAPTURE_REC_FRAME   : data_id, data[8] of a received frame with a correct checksum from header.bms_addr (9 bytes instead of 13)
+ *		BMS_CAPTURE_REC_RX      : length (varint) and the received bytes as they came, anything else (corrupted or misaligned frames)
+ *		BMS_CAPTURE_REC_TX      : length (varint) and the sent bytes, anything that is not a request frame
+ *	 Blocks decode independently of each other, a reader can seek by the index and spread the blocks over several cores (Host/bms_capture_linux.h).
+ *
+ *	 Example :
+ *		bms_capture_init(&cap, &uart_transport, sd_write, &file, time_us);
+ *		bms_capture_transport_init(&capturing, &cap);
+ *		attach_transport(&capturing);		// bms_read() now records its traffic
+ */
+
+
+// ====================================================================================================== MACROS ==========================================================================================================================
+
+#ifndef BMS_CAPTURE_BLOCK_BYTES
+#define BMS_CAPTURE_BLOCK_BYTES		4096		/**< records buffered before a block is handed to the sink		*/
+#endif
+#define BMS_CAPTURE_BLOCK_FILL		(BMS_CAPTURE_BLOCK_BYTES*3/4)	/**< fill from which a block is closed at the next cycle start	*/
+#define BMS_CAPTURE_PENDING_MAX		BMS_PIPELINE_MAX_DEPTH	/**< requests the decoder matches the frames against		*/
+
+#define BMS_CAPTURE_MAGIC		"DALYCAP"	/**< bms_capture_header::magic, NUL terminated			*/
+#define BMS_CAPTURE_VERSION		0x0001
+#define BMS_CAPTURE_BLOCK_MAGIC		0x4B4C4244U	/**< "DBLK"							*/
+#define BMS_CAPTURE_FOOTER_MAGIC	0x58444944U	/**< "DIDX"							*/
+
+/**
+ * @brief macros for the record types.
+ */
+#define BMS_CAPTURE_REC_REQUEST		0x01
+#define BMS_CAPTURE_REC_FRAME		0x02
+#define BMS_CAPTURE_REC_RX		0x03
+#define BMS_CAPTURE_REC_TX		0x04
+
+/**
+ * @brief error codes of the capture routines.
+ */
+#define BMS_CAPTURE_ERR_SINK		0x01		/**< the sink did not take a block, the block is lost			*/
+#define BMS_CAPTURE_ERR_FORMAT		0x02		/**< not a capture, or a damaged block				*/
+#define BMS_CAPTURE_ERR_INDEX_FULL	0x03		/**< more blocks than index entries, the capture has no index		*/
+
+
+//================================================================================ CAPTURE STRUCTURES ===========================================================================================================
+
+/**
+ * @brief structure of the header starting every capture.
+ */
+typedef struct {
+	char magic[8];			/**< BMS_CAPTURE_MAGIC						*/
+	uint16_t version;		/**< BMS_CAPTURE_VERSION					*/
+	uint16_t header_size;		/**< sizeof(bms_capture_header), the first block follows	*/
+	uint8_t host_addr;		/**< module_addr of the requests (UPPER_CMPTR_ADDR)		*/
+	uint8_t bms_addr;		/**< module_addr of the responses (BMS_MASTER_ADDR)		*/
+	uint8_t strings_count;		/**< cells of the pack, sizes the 0x95 responses		*/
+	uint8_t temp_sensor_count;	/**< sensors of the pack, sizes the 0x96 responses		*/
+	uint32_t baudrate;		/**< line speed of the captured bus				*/
+	uint32_t reserved;
+	uint64_t start_us;		/**< time of the capture start, time_us() time base		*/
+} bms_capture_header;
+
+/**
+ * @brief structure of the header of a block of records.
+ */
+typedef struct {
+	uint32_t magic;			/**< BMS_CAPTURE_BLOCK_MAGIC					*/
+	uint32_t len;			/**< bytes of records following the header			*/
+	uint32_t records;		/**< records of the block					*/
+	uint32_t reserved;
+	uint64_t time_us;		/**< time of the first record, the records hold differences	*/
+} bms_capture_block_header;
+
+/**
+ * @brief structure of an index entry, one per block.
+ */
+typedef struct {
+	uint64_t offset;		/**< file offset of the block header				*/
+	uint64_t time_us;		/**< time of the first record of the block			*/
+} bms_capture_index;
+
+/**
+ * @brief structure ending an indexed capture.
+ */
+typedef struct {
+	uint64_t index_offset;		/**< file offset of the first bms_capture_index		*/
+	uint32_t blocks;		/**< index entries						*/
+	uint32_t magic;			/**< BMS_CAPTURE_FOOTER_MAGIC					*/
+} bms_capture_footer;
+
+/**
+ * @brief routine type taking the bytes of a capture in order, returns 0 on success.
+ */
+typedef uint8_t (*bms_capture_sink)(void* ctx, const uint8_t* buf, uint32_t len);
+
+/**
+ * @brief structure of a capture being written.
+ */
+typedef struct {
+	bms_transport* inner;			/**< transport towards the BMS, the capture transport forwards to it		*/
+	bms_capture_sink sink;			/**< destination of the capture bytes						*/
+	void* ctx;				/**< context handed to the sink							*/
+	uint64_t (*time_us)(void);		/**< microsecond clock stamping the records					*/
+	bms_capture_header header;		/**< written by bms_capture_init(), counts taken from the compile time defaults	*/
+	bms_capture_index* index;		/**< optional, set after bms_capture_init() to get an indexed capture		*/
+	uint32_t index_max;			/**< entries of index								*/
+	uint32_t blocks;			/**< blocks handed to the sink							*/
+	uint64_t offset;			/**< bytes handed to the sink							*/
+	uint32_t lost_blocks;			/**< blocks the sink did not take						*/
+	uint16_t cycle_mask;			/**< data IDs requested since the current polling cycle started			*/
+	uint8_t last_id;			/**< data ID of the last request, a repeat of it is a retry and not a new cycle	*/
+	uint32_t records;			/**< records of the current block						*/
+	uint64_t block_us;			/**< time of the first record of the current block				*/
+	uint64_t last_us;			/**< time of the last record							*/
+	uint32_t fill;				/**< bytes of the current block							*/
+	uint8_t block[BMS_CAPTURE_BLOCK_BYTES];
+} bms_capture;
+
+/**
+ * @brief structure of the statistics of a decode, summed over the blocks.
+ */
+typedef struct {
+	uint64_t blocks;		/**< blocks decoded						*/
+	uint64_t bad_blocks;		/**< blocks with a damaged header or record, decoded up to the damage	*/
+	uint64_t records;		/**< records of the blocks					*/
+	uint64_t requests;		/**< request frames						*/
+	uint64_t retries;		/**< requests repeating a data ID whose response was incomplete	*/
+	uint64_t frames;		/**< received frames with a correct checksum			*/
+	uint64_t rx_bytes;		/**< bytes received						*/
+	uint64_t checksum_errors;	/**< received frames dropped for a wrong checksum		*/
+	uint64_t length_errors;		/**< received frames dropped for a wrong data_len		*/
+	uint64_t discarded;		/**< received bytes skipped while searching for START_FLAG	*/
+	uint64_t sequence_errors;	/**< frames repeated or out of range, responses given up incomplete	*/
+	uint64_t unexpected;		/**< frames answering no request				*/
+	uint64_t statuses;		/**< bms_capture_status records produced			*/
+} bms_capture_stats;
+
+/**
+ * @brief structure of a decoded polling cycle.
+ */
+typedef struct {
+	uint64_t time_us;		/**< time of the first request of the cycle			*/
+	uint16_t mask;			/**< data IDs whose response was complete, BMS_DATA_ID_MASK() bits, the other fields are 0	*/
+	RT_Battery_status stat;
+} bms_capture_status;
+
+/**
+ * @brief routine type receiving the decoded polling cycles.
+ */
+typedef void (*bms_capture_status_callback)(void* ctx, const bms_capture_status* status);
+
+
+//======================================================================================== ROUTINE DECLARATION ===================================================================================================
+
+/**
+ * @brief Starts a capture and hands its header to the sink.
+ * @param bms_capture* cap passes the pointer to the capture.
+ * @param bms_transport* inner passes the transport towards the BMS.
+ * @param bms_capture_sink sink passes the destination of the capture.
+ * @param void* ctx passes the context of the sink.
+ * @param uint64_t (*time_us)(void) passes the microsecond clock.
+ * @retval uint8_t returns 0 on success and BMS_CAPTURE_ERR_SINK if the sink failed.
+ */
+uint8_t bms_capture_init(bms_capture* cap, bms_transport* inner, bms_capture_sink sink, void* ctx, uint64_t (*time_us)(void));
+
+/**
+ * @brief Fills a transport that forwards to the inner transport of a capture and records the traffic.
+ * @param bms_transport* transport passes the pointer to the transport to be filled.
+ * @param bms_capture* cap passes the pointer to an initialized capture.
+ * @retval void
+ */
+void bms_capture_transport_init(bms_transport* transport, bms_capture* cap);
+
+/**
+ * @brief Records sent bytes, a request frame becomes a request record.
+ * @param bms_capture* cap passes the pointer to the capture.
+ * @param uint64_t time_us passes the time of the transfer.
+ * @param const uint8_t* buf passes the bytes.
+ * @param uint16_t len passes the number of bytes.
+ * @retval uint8_t returns 0 on success and BMS_CAPTURE_ERR_SINK if a full block could not be handed to the sink.
+ */
+uint8_t bms_capture_tx(bms_capture* cap, uint64_t time_us, const uint8_t* buf, uint16_t len);
+
+/**
+ * @brief Records received bytes, every whole valid frame becomes a frame record.
+ * @param bms_capture* cap passes the pointer to the capture.
+ * @param uint64_t time_us passes the time of the transfer.
+ * @param const uint8_t* buf passes the bytes.
+ * @param uint16_t len passes the number of bytes.
+ * @retval uint8_t returns 0 on success and BMS_CAPTURE_ERR_SINK if a full block could not be handed to the sink.
+ */
+uint8_t bms_capture_rx(bms_capture* cap, uint64_t time_us, const uint8_t* buf, uint16_t len);
+
+/**
+ * @brief Hands the current block to the sink.
+ * @param bms_capture* cap passes the pointer to the capture.
+ * @retval uint8_t returns 0 on success and BMS_CAPTURE_ERR_SINK if the sink failed.
+ */
+uint8_t bms_capture_flush(bms_capture* cap);
+
+/**
+ * @brief Ends a capture, the current block is flushed and the index and footer are written when an index memory was given.
+ * @param bms_capture* cap passes the pointer to the capture.
+ * @retval uint8_t returns 0 on success, BMS_CAPTURE_ERR_SINK or BMS_CAPTURE_ERR_INDEX_FULL (the capture is complete but not indexed).
+ */
+uint8_t bms_capture_close(bms_capture* cap);
+
+/**
+ * @brief Checks the header of a capture.
+ * @param const uint8_t* buf passes the first bytes of the capture.
+ * @param uint64_t len passes the number of bytes available.
+ * @retval uint8_t returns 0 on a valid header and BMS_CAPTURE_ERR_FORMAT otherwise.
+ */
+uint8_t bms_capture_check_header(const uint8_t* buf, uint64_t len);
+
+/**
+ * @brief Decodes the records of one block into polling cycles, a cycle ends when a data ID already answered in it is requested again.
+ * @param const bms_capture_header* header passes the header of the capture.
+ * @param const uint8_t* block passes the block, header included.
+ * @param uint64_t len passes the bytes available from block on.
+ * @param bms_capture_stats* stats passes the statistics to be added to.
+ * @param bms_capture_status_callback callback passes the routine receiving the cycles in order, can be NULL.
+ * @param void* ctx passes the context of the callback.
+ * @retval uint64_t returns the size of the block, header included, 0 if no valid block starts at block.
+ */
+uint64_t bms_capture_decode_block(const bms_capture_header* header, const uint8_t* block, uint64_t len, bms_capture_stats* stats, bms_capture_status_callback callback, void* ctx);
+
+/**
+ * @brief Reads the record at a position of a block, for tools walking the records themselves (replay).
+ * @param const uint8_t* p passes the record.
+ * @param const uint8_t* end passes the end of the block.
+ * @param uint8_t* type passes the memory where the record type is stored.
+ * @param uint32_t* dt_us passes the memory where the time since the previous record is stored.
+ * @param const uint8_t** body passes the memory where the body of the record is stored, behind the length of RX/TX records.
+ * @param uint16_t* body_len passes the memory where the body length is stored.
+ * @retval const uint8_t* returns the next record, NULL on a damaged record.
+ */
+const uint8_t* bms_capture_next_record(const uint8_t* p, const uint8_t* end, uint8_t* type, uint32_t* dt_us, const uint8_t** body, uint16_t* body_len);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /**< BMS_CAPTURE_H  */
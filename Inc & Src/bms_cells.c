@@ -0,0 +1,128 @@
+#include "bms_cells.h"
+#include <string.h>
+
+/**
+ * @file bms_cells.c
+ * @brief Source code file for the decoded cell view declared in bms_cells.h
+ * @author Piyush
+ * @date 12/01/25
+ * @version 1.0
+ */
+
+
+#if ((_FULL_READ_ACCESS | _CELL_VOLT_ACCESS) == 0x01)
+
+// ====================================================================================================== MACROS ==========================================================================================================================
+
+/**
+ * @brief the voltage kernel uses the GCC/Clang vector extensions where a 128 bit vector unit exists, the compiler lowers them to SSE2 or NEON.
+ * 	  Elsewhere (Cortex-M, big endian hosts) the fused scalar loop is used, which is what the vector unit-less cores run best.
+ */
+#if defined(__GNUC__) && (defined(__SSE2__) || defined(__ARM_NEON)) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__) && !defined(BMS_CELLS_NO_VECTOR)
+#define BMS_CELLS_VECTOR		1
+typedef uint16_t bms_v8u16 __attribute__((vector_size(BMS_CELLS_LANES*sizeof(uint16_t))));
+typedef uint32_t bms_v8u32 __attribute__((vector_size(BMS_CELLS_LANES*sizeof(uint32_t))));
+#else
+#define BMS_CELLS_VECTOR		0
+#endif
+
+
+//==================================================================================== PRIVATE ROUTINES =========================================================================================
+
+/**
+ * @brief Decodes the temperatures of a status into a view.
+ * @param bms_cell_view* view passes the view.
+ * @param const RT_Battery_status* stat passes the status.
+ * @param uint8_t sensors passes the temperature sensors of the pack.
+ * @retval void
+ */
+static void bms_cells_decode_temps(bms_cell_view* view, const RT_Battery_status* stat, uint8_t sensors){
+#if ((_FULL_READ_ACCESS | _CELL_TEMP_ACCESS) == 0x01)
+	int16_t min_c=INT16_MAX, max_c=INT16_MIN;
+	sensors=(sensors>TEMP_SENSOR_COUNT) ? TEMP_SENSOR_COUNT : sensors;
+	for(uint8_t i=0;i<sensors;i++){
+		int16_t c=(int16_t)(stat->cell_temperatures[i]-BMS_CELLS_TEMP_OFFSET);
+		view->temp_c[i]=c;
+		min_c=(c<min_c) ? c : min_c;
+		max_c=(c>max_c) ? c : max_c;
+	}
+	view->sensors=sensors;
+	view->min_c=(sensors!=0) ? min_c : 0;
+	view->max_c=(sensors!=0) ? max_c : 0;
+#else
+	(void)view;
+	(void)stat;
+	(void)sensors;
+#endif
+}
+
+
+//==================================================================================== ROUTINE DEFINITIONS ======================================================================================
+
+
+/**
+ * @brief Decodes the cell voltages (and temperatures when enabled) of a status into a view and computes the pack statistics in the same pass.
+ * @param bms_cell_view* view passes the memory where the view is stored.
+ * @param const RT_Battery_status* stat passes the status read from the BMS, a snapshot buffer (bms_snapshot_read_begin()) can be passed directly.
+ * @param uint8_t cells passes the cells of the pack, at most STRINGS_COUNT (bms_device::strings_count).
+ * @param uint8_t sensors passes the temperature sensors of the pack, at most TEMP_SENSOR_COUNT, ignored when the temperatures are disabled.
+ * @retval void
+ */
+void bms_cells_decode(bms_cell_view* view, const RT_Battery_status* stat, uint8_t cells, uint8_t sensors){
+	const uint8_t* restrict src=stat->cell_voltages;
+	uint16_t* restrict dst=view->cell_mv;
+	uint16_t min_mv=UINT16_MAX, max_mv=0;
+	uint8_t weakest=0;
+	uint32_t sum=0;
+	uint8_t i=0;
+
+	cells=(cells>STRINGS_COUNT) ? STRINGS_COUNT : cells;
+
+#if BMS_CELLS_VECTOR
+	bms_v8u16 lane_min={0}, lane_max={0}, lane_at={0}, lane_idx={0, 1, 2, 3, 4, 5, 6, 7};
+	bms_v8u32 lane_sum={0};
+	lane_min=~lane_min;
+	for(;i+BMS_CELLS_LANES<=cells;i+=BMS_CELLS_LANES){
+		bms_v8u16 mv;
+		memcpy(&mv, src+i*MONOMER_VOLTAGE_SIZE, sizeof(mv));
+		mv=(mv<<8) | (mv>>8);		// big endian pairs to millivolts
+		memcpy(dst+i, &mv, sizeof(mv));
+		bms_v8u16 lower=(bms_v8u16)(mv<lane_min);
+		bms_v8u16 higher=(bms_v8u16)(mv>lane_max);
+		lane_at=(lane_idx & lower) | (lane_at & ~lower);
+		lane_min=(mv & lower) | (lane_min & ~lower);
+		lane_max=(mv & higher) | (lane_max & ~higher);
+		lane_sum+=__builtin_convertvector(mv, bms_v8u32);
+		lane_idx+=BMS_CELLS_LANES;
+	}
+	for(uint8_t l=0;l<BMS_CELLS_LANES;l++){
+		if(lane_min[l]<min_mv || (lane_min[l]==min_mv && lane_at[l]<weakest)){
+			min_mv=lane_min[l];
+			weakest=(uint8_t)lane_at[l];
+		}
+		max_mv=(lane_max[l]>max_mv) ? lane_max[l] : max_mv;
+		sum+=lane_sum[l];
+	}
+#endif
+
+	for(;i<cells;i++){	// whole pack without vector unit, cells after the last block otherwise
+		uint16_t mv=(uint16_t)((src[i*MONOMER_VOLTAGE_SIZE]<<8) | src[i*MONOMER_VOLTAGE_SIZE+1]);
+		dst[i]=mv;
+		if(mv<min_mv){
+			min_mv=mv;
+			weakest=i;
+		}
+		max_mv=(mv>max_mv) ? mv : max_mv;
+		sum+=mv;
+	}
+
+	view->cells=cells;
+	view->weakest=weakest;
+	view->min_mv=(cells!=0) ? min_mv : 0;
+	view->max_mv=max_mv;
+	view->mean_mv=(cells!=0) ? (uint16_t)((sum+cells/2)/cells) : 0;
+	view->spread_mv=(uint16_t)(view->max_mv-view->min_mv);
+	bms_cells_decode_temps(view, stat, sensors);
+}
+
+#endif
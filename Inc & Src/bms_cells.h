@@ -0,0 +1,79 @@
+#ifndef BMS_CELLS_H
+#define BMS_CELLS_H
+
+#include "bms_uart_comm.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @file bms_cells.h
+ * @brief Header file for the decoded cell view defined in bms_cells.c
+ * 	  The cell voltages and temperatures of RT_Battery_status are kept as they come on the wire (big endian byte pairs, 40 degree offset), the view turns them once per refresh
+ * 	  into arrays of millivolts and degrees together with the pack statistics the balancing logic needs, so that consumers stop parsing the raw bytes themselves.
+ * @author Piyush
+ * @date 12/01/25
+ * @version 1.0
+ *
+ *
+ * @note The voltage kernel works on blocks of BMS_CELLS_LANES cells with one accumulator per lane and no dependency between the lanes, the byte swap, min, max, sum and
+ *	 weakest cell select of a block are single vector operations (SSE2/NEON through the GCC/Clang vector extensions), the lanes are reduced once at the end and the cells
+ *	 left over after the last full block go through the scalar loop. Cores without a vector unit run the scalar loop on the whole pack, -DBMS_CELLS_NO_VECTOR forces it.
+ *
+ *	 Example :
+ *		bms_cells_decode(&view, &stat, STRINGS_COUNT, TEMP_SENSOR_COUNT);
+ *		if(view.spread_mv>BALANCE_START_MV){ balance(view.weakest); }
+ */
+
+
+#if ((_FULL_READ_ACCESS | _CELL_VOLT_ACCESS) == 0x01)
+
+// ====================================================================================================== MACROS ==========================================================================================================================
+
+#define BMS_CELLS_LANES			8		/**< cells per block of the voltage kernel, 128 bit of millivolts		*/
+#define BMS_CELLS_TEMP_OFFSET		40		/**< offset of the temperatures sent by the BMS, degree celsius			*/
+
+
+//================================================================================== CELL VIEW STRUCTURES ========================================================================================================
+
+/**
+ * @brief structure of the decoded cells of one pack, one array per quantity.
+ */
+typedef struct {
+	uint16_t cell_mv[STRINGS_COUNT];	/**< cell voltages in millivolts						*/
+#if ((_FULL_READ_ACCESS | _CELL_TEMP_ACCESS) == 0x01)
+	int16_t temp_c[TEMP_SENSOR_COUNT];	/**< sensor temperatures in degree celsius				*/
+	int16_t min_c;				/**< lowest temperature							*/
+	int16_t max_c;				/**< highest temperature						*/
+	uint8_t sensors;			/**< valid entries of temp_c							*/
+#endif
+	uint8_t cells;				/**< valid entries of cell_mv							*/
+	uint8_t weakest;			/**< index of the lowest cell, the first one on a tie				*/
+	uint16_t min_mv;			/**< lowest cell voltage							*/
+	uint16_t max_mv;			/**< highest cell voltage							*/
+	uint16_t mean_mv;			/**< mean cell voltage, rounded							*/
+	uint16_t spread_mv;			/**< max_mv-min_mv, the imbalance of the pack					*/
+} bms_cell_view;
+
+
+//======================================================================================== ROUTINE DECLARATION ===================================================================================================
+
+/**
+ * @brief Decodes the cell voltages (and temperatures when enabled) of a status into a view and computes the pack statistics in the same pass.
+ * @param bms_cell_view* view passes the memory where the view is stored.
+ * @param const RT_Battery_status* stat passes the status read from the BMS, a snapshot buffer (bms_snapshot_read_begin()) can be passed directly.
+ * @param uint8_t cells passes the cells of the pack, at most STRINGS_COUNT (bms_device::strings_count).
+ * @param uint8_t sensors passes the temperature sensors of the pack, at most TEMP_SENSOR_COUNT, ignored when the temperatures are disabled.
+ * @retval void
+ */
+void bms_cells_decode(bms_cell_view* view, const RT_Battery_status* stat, uint8_t cells, uint8_t sensors);
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /**< BMS_CELLS_H  */
@@ -0,0 +1,427 @@
+#include "bms_delta.h"
+#include <stddef.h>
+#include <string.h>
+
+/**
+ * @file bms_delta.c
+ * @brief Source code file for the change detection and delta publishing declared in bms_delta.h
+ * @author Piyush
+ * @date 12/01/25
+ * @version 1.0
+ */
+
+
+//=================================================================================== DELTA FIELD TABLE ==========================================================================================================
+
+/**
+ * @brief macros for the per device item count limiting a group.
+ */
+#define BMS_DELTA_COUNT_NONE		0x00	/**< fixed number of fields			*/
+#define BMS_DELTA_COUNT_STRINGS		0x01	/**< one field per cell				*/
+#define BMS_DELTA_COUNT_SENSORS		0x02	/**< one field per temperature sensor		*/
+#define BMS_DELTA_COUNT_BALANCE		0x03	/**< one field per 8 cells			*/
+
+/**
+ * @brief macro telling whether the access macros leave any field in RT_Battery_status, without any the groups have no field and the accessors are compiled out.
+ */
+#define BMS_DELTA_FIELDS	(_FULL_READ_ACCESS | _SOC_IV_ACCESS | _MIN_MAX_VOLT_ACCESS | _MIN_MAX_TEMP_ACCESS | _MOS_CHRG_DISCHRG_STATUS_ACCESS | _STATUS_INFO1_ACCESS | \
+				 _CELL_VOLT_ACCESS | _CELL_TEMP_ACCESS | _CELL_BALANCE_STATE_ACCESS | _BATTERY_FAILURE_STATUS_ACCESS)
+
+/**
+ * @brief structure describing a group of consecutive tags, the groups of the data IDs disabled by the access macros keep their tags and sizes with no field.
+ */
+typedef struct {
+	uint8_t data_id;	/**< data ID carrying the group					*/
+	uint8_t first_tag;	/**< tag of the first field					*/
+	uint8_t tags;		/**< tags reserved, 0 ends the table				*/
+	uint8_t size;		/**< bytes per field, 1, 2 or 4					*/
+	uint8_t big_endian;	/**< 1 for the raw byte pairs of cell_voltages			*/
+	uint8_t counted_by;	/**< BMS_DELTA_COUNT_x						*/
+	uint8_t per_frame;	/**< fields per response frame of multi frame data IDs, 0 if the frame carries the whole group	*/
+	uint8_t count;		/**< fields compiled in RT_Battery_status, 0 for a disabled group	*/
+	uint16_t offset;	/**< first field inside RT_Battery_status			*/
+} bms_delta_group;
+
+/**
+ * @brief table of the groups in tag order.
+ */
+static const bms_delta_group delta_groups[]={
+#if ((_FULL_READ_ACCESS | _SOC_IV_ACCESS) == 0x01)
+	{ SOC_TOTAL_IV, BMS_DELTA_TAG_SOC_IV, 4, 2, 0, BMS_DELTA_COUNT_NONE, 0, 4, offsetof(RT_Battery_status, cum_total_voltage) },
+#else
+	{ SOC_TOTAL_IV, BMS_DELTA_TAG_SOC_IV, 4, 2, 0, BMS_DELTA_COUNT_NONE, 0, 0, 0 },
+#endif
+#if ((_FULL_READ_ACCESS | _MIN_MAX_VOLT_ACCESS) == 0x01)
+	{ MAX_MIN_VOLTAGE, BMS_DELTA_TAG_MIN_MAX_VOLT, 1, 2, 0, BMS_DELTA_COUNT_NONE, 0, 1, offsetof(RT_Battery_status, max_cell_voltage_value) },
+	{ MAX_MIN_VOLTAGE, BMS_DELTA_TAG_MIN_MAX_VOLT+1, 1, 1, 0, BMS_DELTA_COUNT_NONE, 0, 1, offsetof(RT_Battery_status, cell_count_with_max_voltage) },
+	{ MAX_MIN_VOLTAGE, BMS_DELTA_TAG_MIN_MAX_VOLT+2, 1, 2, 0, BMS_DELTA_COUNT_NONE, 0, 1, offsetof(RT_Battery_status, min_cell_voltage_value) },
+	{ MAX_MIN_VOLTAGE, BMS_DELTA_TAG_MIN_MAX_VOLT+3, 1, 1, 0, BMS_DELTA_COUNT_NONE, 0, 1, offsetof(RT_Battery_status, cell_count_with_min_voltage) },
+#else
+	{ MAX_MIN_VOLTAGE, BMS_DELTA_TAG_MIN_MAX_VOLT, 1, 2, 0, BMS_DELTA_COUNT_NONE, 0, 0, 0 },
+	{ MAX_MIN_VOLTAGE, BMS_DELTA_TAG_MIN_MAX_VOLT+1, 1, 1, 0, BMS_DELTA_COUNT_NONE, 0, 0, 0 },
+	{ MAX_MIN_VOLTAGE, BMS_DELTA_TAG_MIN_MAX_VOLT+2, 1, 2, 0, BMS_DELTA_COUNT_NONE, 0, 0, 0 },
+	{ MAX_MIN_VOLTAGE, BMS_DELTA_TAG_MIN_MAX_VOLT+3, 1, 1, 0, BMS_DELTA_COUNT_NONE, 0, 0, 0 },
+#endif
+#if ((_FULL_READ_ACCESS | _MIN_MAX_TEMP_ACCESS) == 0x01)
+	{ MAX_MIN_TEMPERATURE, BMS_DELTA_TAG_MIN_MAX_TEMP, 4, 1, 0, BMS_DELTA_COUNT_NONE, 0, 4, offsetof(RT_Battery_status, max_temp_val_40) },
+#else
+	{ MAX_MIN_TEMPERATURE, BMS_DELTA_TAG_MIN_MAX_TEMP, 4, 1, 0, BMS_DELTA_COUNT_NONE, 0, 0, 0 },
+#endif
+#if ((_FULL_READ_ACCESS | _MOS_CHRG_DISCHRG_STATUS_ACCESS) == 0x01)
+	{ CHRG_DISCHRG_MOS_STATUS, BMS_DELTA_TAG_MOS_STATUS, 4, 1, 0, BMS_DELTA_COUNT_NONE, 0, 4, offsetof(RT_Battery_status, mos_state) },
+	{ CHRG_DISCHRG_MOS_STATUS, BMS_DELTA_TAG_REMAIN_CAPACITY, 1, 4, 0, BMS_DELTA_COUNT_NONE, 0, 1, offsetof(RT_Battery_status, remain_capacity) },
+#else
+	{ CHRG_DISCHRG_MOS_STATUS, BMS_DELTA_TAG_MOS_STATUS, 4, 1, 0, BMS_DELTA_COUNT_NONE, 0, 0, 0 },
+	{ CHRG_DISCHRG_MOS_STATUS, BMS_DELTA_TAG_REMAIN_CAPACITY, 1, 4, 0, BMS_DELTA_COUNT_NONE, 0, 0, 0 },
+#endif
+#if ((_FULL_READ_ACCESS | _STATUS_INFO1_ACCESS) == 0x01)
+	{ STATUS_INFO_1, BMS_DELTA_TAG_STATUS_INFO_1, 5, 1, 0, BMS_DELTA_COUNT_NONE, 0, 5, offsetof(RT_Battery_status, battery_string_count) },
+#else
+	{ STATUS_INFO_1, BMS_DELTA_TAG_STATUS_INFO_1, 5, 1, 0, BMS_DELTA_COUNT_NONE, 0, 0, 0 },
+#endif
+#if ((_FULL_READ_ACCESS | _CELL_BALANCE_STATE_ACCESS) ==0x01)
+	{ CELL_BALANCE_STATE, BMS_DELTA_TAG_BALANCE, 6, 1, 0, BMS_DELTA_COUNT_BALANCE, 0, sizeof(((RT_Battery_status*)0)->cell_balance_states), offsetof(RT_Battery_status, cell_balance_states) },
+#else
+	{ CELL_BALANCE_STATE, BMS_DELTA_TAG_BALANCE, 6, 1, 0, BMS_DELTA_COUNT_BALANCE, 0, 0, 0 },
+#endif
+#if ((_FULL_READ_ACCESS | _BATTERY_FAILURE_STATUS_ACCESS) == 0x01)
+	{ BATTERY_FAILURE_STATUS, BMS_DELTA_TAG_FAILURE, 8, 1, 0, BMS_DELTA_COUNT_NONE, 0, 8, offsetof(RT_Battery_status, cell_sum_volt_level) },
+#else
+	{ BATTERY_FAILURE_STATUS, BMS_DELTA_TAG_FAILURE, 8, 1, 0, BMS_DELTA_COUNT_NONE, 0, 0, 0 },
+#endif
+#if ((_FULL_READ_ACCESS | _CELL_VOLT_ACCESS) == 0x01)
+	{ CELL_VOLTAGE, BMS_DELTA_TAG_CELL, MAX_BMS_STRING_COUNT, MONOMER_VOLTAGE_SIZE, 1, BMS_DELTA_COUNT_STRINGS, CELL_VOLTS_PER_FRAME, STRINGS_COUNT, offsetof(RT_Battery_status, cell_voltages) },
+#else
+	{ CELL_VOLTAGE, BMS_DELTA_TAG_CELL, MAX_BMS_STRING_COUNT, MONOMER_VOLTAGE_SIZE, 1, BMS_DELTA_COUNT_STRINGS, CELL_VOLTS_PER_FRAME, 0, 0 },
+#endif
+#if ((_FULL_READ_ACCESS | _CELL_TEMP_ACCESS) == 0x01)
+	{ CELL_TEMPERATURE, BMS_DELTA_TAG_TEMP, MAX_BMS_TEMPERATURE_SENSOR_COUNT, SENT_TEMPERATURE_SIZE, 0, BMS_DELTA_COUNT_SENSORS, CELL_TEMPS_PER_FRAME, TEMP_SENSOR_COUNT, offsetof(RT_Battery_status, cell_temperatures) },
+#else
+	{ CELL_TEMPERATURE, BMS_DELTA_TAG_TEMP, MAX_BMS_TEMPERATURE_SENSOR_COUNT, SENT_TEMPERATURE_SIZE, 0, BMS_DELTA_COUNT_SENSORS, CELL_TEMPS_PER_FRAME, 0, 0 },
+#endif
+	{ 0, 0, 0, 0, 0, 0, 0, 0, 0 }	// end of table
+};
+
+
+//==================================================================================== PRIVATE ROUTINES =========================================================================================
+
+/**
+ * @brief Group of a tag.
+ * @param uint8_t tag passes the tag.
+ * @param uint8_t* index passes the memory where the field index inside the group is stored.
+ * @retval const bms_delta_group* returns the group, NULL for an unused tag.
+ */
+static const bms_delta_group* bms_delta_group_of(uint8_t tag, uint8_t* index){
+	for(const bms_delta_group* g=delta_groups;g->tags!=0;g++){
+		if(tag>=g->first_tag && tag<g->first_tag+g->tags){
+			*index=(uint8_t)(tag-g->first_tag);
+			return g;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * @brief Fields of a group present in the pack of a tracker.
+ */
+static uint8_t bms_delta_items(const bms_delta* delta, const bms_delta_group* g){
+	uint8_t limit=g->count;
+	if(g->counted_by==BMS_DELTA_COUNT_STRINGS){
+		limit=delta->strings_count;
+	}
+	else if(g->counted_by==BMS_DELTA_COUNT_SENSORS){
+		limit=delta->temp_sensor_count;
+	}
+	else if(g->counted_by==BMS_DELTA_COUNT_BALANCE){
+		limit=(uint8_t)((delta->strings_count+CELL_BALANCE_STATE_PER_BYTE-1)/CELL_BALANCE_STATE_PER_BYTE);
+	}
+	return (limit<g->count) ? limit : g->count;
+}
+
+/**
+ * @brief Reads field i of a group from a status.
+ */
+static uint32_t bms_delta_get(const RT_Battery_status* stat, const bms_delta_group* g, uint8_t i){
+#if BMS_DELTA_FIELDS == 0x00
+	(void)stat; (void)g; (void)i;
+	return 0;
+#else
+	const uint8_t* p=(const uint8_t*)stat+g->offset+i*g->size;
+	if(g->size==1){
+		return p[0];
+	}
+	if(g->big_endian){
+		return ((uint32_t)p[0]<<8) | p[1];
+	}
+	if(g->size==2){
+		uint16_t v;
+		memcpy(&v, p, sizeof(v));
+		return v;
+	}
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+#endif
+}
+
+/**
+ * @brief Writes field i of a group into a status.
+ */
+static void bms_delta_set(RT_Battery_status* stat, const bms_delta_group* g, uint8_t i, uint32_t value){
+#if BMS_DELTA_FIELDS == 0x00
+	(void)stat; (void)g; (void)i; (void)value;
+#else
+	uint8_t* p=(uint8_t*)stat+g->offset+i*g->size;
+	if(g->size==1){
+		p[0]=(uint8_t)value;
+	}
+	else if(g->big_endian){
+		p[0]=(uint8_t)(value>>8);
+		p[1]=(uint8_t)value;
+	}
+	else if(g->size==2){
+		uint16_t v=(uint16_t)value;
+		memcpy(p, &v, sizeof(v));
+	}
+	else{
+		memcpy(p, &value, sizeof(value));
+	}
+#endif
+}
+
+/**
+ * @brief Marks dirty the fields from..to-1 of a group that moved further than their deadband from the value last sent.
+ */
+static void bms_delta_check(bms_delta* delta, const RT_Battery_status* stat, const bms_delta_group* g, uint8_t from, uint8_t to){
+	for(uint8_t i=from;i<to;i++){
+		uint32_t cur=bms_delta_get(stat, g, i);
+		uint32_t ref=bms_delta_get(&delta->sent, g, i);
+		uint32_t diff=(cur>ref) ? cur-ref : ref-cur;
+		if(diff>delta->deadband[g->first_tag+i]){
+			uint8_t tag=(uint8_t)(g->first_tag+i);
+			delta->dirty[tag>>5]|=1UL<<(tag&31);
+		}
+	}
+}
+
+/**
+ * @brief Tells whether a tag is dirty.
+ */
+static uint8_t bms_delta_is_dirty(const bms_delta* delta, uint8_t tag){
+	return (delta->dirty[tag>>5]>>(tag&31)) & 1U;
+}
+
+/**
+ * @brief Writes the value of a dirty field to a message and takes it as the new reference.
+ * @param bms_delta* delta passes the tracker.
+ * @param const RT_Battery_status* stat passes the status.
+ * @param uint8_t tag passes the dirty tag.
+ * @param uint8_t* dst passes the memory of the value, its size given by the tag.
+ * @retval uint8_t returns the size of the value.
+ */
+static uint8_t bms_delta_put(bms_delta* delta, const RT_Battery_status* stat, uint8_t tag, uint8_t* dst){
+	uint8_t i=0;
+	const bms_delta_group* g=bms_delta_group_of(tag, &i);
+	uint32_t value=bms_delta_get(stat, g, i);
+	for(uint8_t b=0;b<g->size;b++){
+		dst[b]=(uint8_t)(value>>(8*b));
+	}
+	bms_delta_set(&delta->sent, g, i, value);
+	delta->dirty[tag>>5]&=~(1UL<<(tag&31));
+	return g->size;
+}
+
+/**
+ * @brief Size of the value of a dirty tag.
+ */
+static uint8_t bms_delta_size(uint8_t tag){
+	uint8_t i;
+	return bms_delta_group_of(tag, &i)->size;
+}
+
+
+//==================================================================================== ROUTINE DEFINITIONS ======================================================================================
+
+
+/**
+ * @brief Initializes a tracker, every field dirty so that the first message carries the whole status.
+ * @param bms_delta* delta passes the tracker.
+ * @param uint8_t strings_count passes the cells of the pack, at most STRINGS_COUNT.
+ * @param uint8_t temp_sensor_count passes the sensors of the pack, at most TEMP_SENSOR_COUNT.
+ * @retval void
+ */
+void bms_delta_init(bms_delta* delta, uint8_t strings_count, uint8_t temp_sensor_count){
+	memset(delta, 0x00, sizeof(bms_delta));
+	delta->strings_count=(strings_count<STRINGS_COUNT) ? strings_count : STRINGS_COUNT;
+	delta->temp_sensor_count=(temp_sensor_count<TEMP_SENSOR_COUNT) ? temp_sensor_count : TEMP_SENSOR_COUNT;
+	bms_delta_force(delta);
+}
+
+/**
+ * @brief Sets the deadband of consecutive fields.
+ * @param bms_delta* delta passes the tracker.
+ * @param uint8_t tag passes the first field, one of BMS_DELTA_TAG_x or a tag inside a group.
+ * @param uint8_t count passes the number of fields.
+ * @param uint16_t band passes the largest change not sent, in the raw unit of the fields (mV, 0.1 A, 0.1 %, degree celsius ...).
+ * @retval void
+ */
+void bms_delta_set_deadband(bms_delta* delta, uint8_t tag, uint8_t count, uint16_t band){
+	for(uint16_t t=tag;t<(uint16_t)tag+count && t<BMS_DELTA_TAGS;t++){
+		delta->deadband[t]=band;
+	}
+}
+
+/**
+ * @brief Marks every field dirty, the next messages carry the whole status.
+ * @param bms_delta* delta passes the tracker.
+ * @retval void
+ */
+void bms_delta_force(bms_delta* delta){
+	for(const bms_delta_group* g=delta_groups;g->tags!=0;g++){
+		uint8_t items=bms_delta_items(delta, g);
+		for(uint8_t i=0;i<items;i++){
+			uint8_t tag=(uint8_t)(g->first_tag+i);
+			delta->dirty[tag>>5]|=1UL<<(tag&31);
+		}
+	}
+}
+
+/**
+ * @brief Compares the fields carried by a response frame with the values last sent, called by the driver as the frame is stored.
+ * @param bms_delta* delta passes the tracker.
+ * @param const RT_Battery_status* stat passes the status the frame was stored in.
+ * @param uint8_t data_id passes the data ID of the frame.
+ * @param uint8_t frame passes the frame number of the multi frame responses, 0 otherwise.
+ * @retval void
+ */
+void bms_delta_frame(bms_delta* delta, const RT_Battery_status* stat, uint8_t data_id, uint8_t frame){
+	for(const bms_delta_group* g=delta_groups;g->tags!=0;g++){
+		if(g->data_id!=data_id || g->count==0){
+			continue;
+		}
+		uint8_t items=bms_delta_items(delta, g);
+		uint16_t from=(g->per_frame!=0) ? (uint16_t)frame*g->per_frame : 0;
+		uint16_t to=(g->per_frame!=0) ? from+g->per_frame : items;
+		if(from<items){
+			bms_delta_check(delta, stat, g, (uint8_t)from, (uint8_t)((to<items) ? to : items));
+		}
+	}
+}
+
+/**
+ * @brief Compares every field of a status with the values last sent, for a tracker fed from a snapshot instead of the driver.
+ * @param bms_delta* delta passes the tracker.
+ * @param const RT_Battery_status* stat passes the status.
+ * @retval void
+ */
+void bms_delta_scan(bms_delta* delta, const RT_Battery_status* stat){
+	for(const bms_delta_group* g=delta_groups;g->tags!=0;g++){
+		bms_delta_check(delta, stat, g, 0, bms_delta_items(delta, g));
+	}
+}
+
+/**
+ * @brief Number of fields waiting to be sent.
+ * @param const bms_delta* delta passes the tracker.
+ * @retval uint16_t returns the number of dirty fields.
+ */
+uint16_t bms_delta_pending(const bms_delta* delta){
+	uint16_t n=0;
+	for(uint8_t w=0;w<BMS_DELTA_TAGS/32;w++){
+		n+=(uint16_t)__builtin_popcount(delta->dirty[w]);
+	}
+	return n;
+}
+
+/**
+ * @brief Encodes the dirty fields of a status in tag order, as many as fit, and takes their values as the new reference. The fields left over stay dirty for the next message.
+ * @param bms_delta* delta passes the tracker.
+ * @param const RT_Battery_status* stat passes the status, the one the frames were stored in.
+ * @param uint8_t* buf passes the memory of the message.
+ * @param uint16_t max passes the size of buf, at least BMS_DELTA_MIN_BUF.
+ * @retval uint16_t returns the message length, 0 when no field is dirty.
+ */
+uint16_t bms_delta_encode(bms_delta* delta, const RT_Battery_status* stat, uint8_t* buf, uint16_t max){
+	uint16_t len=0;
+	uint8_t tag=0;
+
+	while(tag<BMS_DELTA_TAGS){
+		if(!bms_delta_is_dirty(delta, tag)){
+			tag++;
+			continue;
+		}
+		uint8_t run=1;
+		while(tag+run<BMS_DELTA_TAGS && run<0xFF && bms_delta_is_dirty(delta, (uint8_t)(tag+run))){
+			run++;
+		}
+		if(run>=BMS_DELTA_MIN_RUN){
+			uint16_t bytes=2;
+			uint8_t fit=0;
+			while(fit<run && len+bytes+bms_delta_size((uint8_t)(tag+fit))<=max){
+				bytes+=bms_delta_size((uint8_t)(tag+fit));
+				fit++;
+			}
+			if(fit>=BMS_DELTA_MIN_RUN){
+				buf[len++]=(uint8_t)(tag | BMS_DELTA_RUN);
+				buf[len++]=fit;
+				for(uint8_t k=0;k<fit;k++){
+					len+=bms_delta_put(delta, stat, (uint8_t)(tag+k), buf+len);
+				}
+				if(fit<run){
+					break;	// message full
+				}
+				tag=(uint8_t)(tag+fit);
+				continue;
+			}
+		}
+		if(len+1+bms_delta_size(tag)>max){
+			break;
+		}
+		buf[len++]=tag;
+		len+=bms_delta_put(delta, stat, tag, buf+len);
+		tag++;
+	}
+
+	if(len!=0){
+		delta->messages++;
+		delta->bytes+=len;
+	}
+	return len;
+}
+
+/**
+ * @brief Applies a message to the status kept by a receiver.
+ * @param RT_Battery_status* stat passes the status of the receiver.
+ * @param const uint8_t* buf passes the message.
+ * @param uint16_t len passes the message length.
+ * @retval uint8_t returns 0 on success and BMS_DELTA_ERR_FORMAT for a malformed message.
+ */
+uint8_t bms_delta_apply(RT_Battery_status* stat, const uint8_t* buf, uint16_t len){
+	uint16_t pos=0;
+	while(pos<len){
+		uint8_t tag=buf[pos++];
+		uint8_t count=1;
+		if(tag & BMS_DELTA_RUN){
+			if(pos==len || buf[pos]==0){
+				return BMS_DELTA_ERR_FORMAT;
+			}
+			tag&=(uint8_t)~BMS_DELTA_RUN;
+			count=buf[pos++];
+		}
+		for(uint8_t k=0;k<count;k++,tag++){
+			uint8_t i;
+			const bms_delta_group* g=(tag<BMS_DELTA_TAGS) ? bms_delta_group_of(tag, &i) : NULL;
+			if(g==NULL || pos+g->size>len){
+				return BMS_DELTA_ERR_FORMAT;
+			}
+			uint32_t value=0;
+			for(uint8_t b=0;b<g->size;b++){
+				value|=(uint32_t)buf[pos++]<<(8*b);
+			}
+			if(i<g->count){	// fields the receiver does not have are skipped
+				bms_delta_set(stat, g, i, value);
+			}
+		}
+	}
+	return 0;
+}
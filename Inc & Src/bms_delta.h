@@ -0,0 +1,162 @@
+#ifndef BMS_DELTA_H
+#define BMS_DELTA_H
+
+#include "bms_uart_comm.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @file bms_delta.h
+ * @brief Header file for the change detection and delta publishing defined in bms_delta.c
+ * 	  A bms_delta tracker attached to a device (bms_device_attach_delta()) compares every field of a response frame with the value last published as the frame is stored,
+ * 	  a field moving further than its deadband is marked dirty, and bms_delta_encode() emits only the dirty fields in a compact tagged message for CAN or a cellular uplink,
+ * 	  so that a current changing on every refresh costs its 3 bytes instead of the whole RT_Battery_status.
+ * @author Piyush
+ * @date 12/01/25
+ * @version 1.0
+ *
+ *
+ * @note Message layout, entries back to back, values little endian with the size given by the tag (2 bytes for 0x90, the cell voltages and the min/max voltages, 4 for
+ *	 remain_capacity, 1 otherwise) :
+ *		single entry : tag (below 0x80), value.
+ *		run entry    : tag | 0x80, count, values of the count fields tag, tag+1 ... (taken for 3 fields or more).
+ *	 The tags do not depend on the access macros, a receiver built with other macros skips the fields it does not have. Values are absolute, a lost message costs the
+ *	 changes it carried until these fields move again, bms_delta_force() sends everything once (periodic keyframe, link reconnected).
+ *	 Fields are only marked dirty by the polling context and only cleared by bms_delta_encode(), which therefore runs in the polling context between reads, like bms_history_record().
+ *	 A task reading a snapshot (bms_snapshot_copy()) uses a tracker of its own through bms_delta_scan() instead.
+ *
+ *	 Example :
+ *		bms_delta_init(&delta, dev.strings_count, dev.temp_sensor_count);
+ *		bms_delta_set_deadband(&delta, BMS_DELTA_TAG_CELL, dev.strings_count, 5);	// +-5 mV
+ *		bms_delta_set_deadband(&delta, BMS_DELTA_TAG_CURRENT, 1, 1);			// +-0.1 A
+ *		bms_device_attach_delta(&dev, &delta);
+ *		after every read : while(bms_delta_pending(&delta)!=0){ len=bms_delta_encode(&delta, dev.stat, payload, 8); can_send(payload, len); }
+ */
+
+
+// ====================================================================================================== MACROS ==========================================================================================================================
+
+#define BMS_DELTA_TAGS			128		/**< tag space, one bit each in the dirty bitmap				*/
+#define BMS_DELTA_RUN			0x80		/**< tag flag of a run entry							*/
+#define BMS_DELTA_MIN_RUN		3		/**< consecutive dirty fields sent as a run					*/
+#define BMS_DELTA_MIN_BUF		5		/**< smallest message bms_delta_encode() can always fill			*/
+
+/**
+ * @brief macros for the tags, first tag of each field group.
+ */
+#define BMS_DELTA_TAG_SOC_IV		0		/**< cum_total_voltage, gath_total_voltage, current, soc			*/
+#define BMS_DELTA_TAG_CURRENT		2
+#define BMS_DELTA_TAG_SOC		3
+#define BMS_DELTA_TAG_MIN_MAX_VOLT	4		/**< max voltage, its cell, min voltage, its cell				*/
+#define BMS_DELTA_TAG_MIN_MAX_TEMP	8		/**< max temperature, its sensor, min temperature, its sensor			*/
+#define BMS_DELTA_TAG_MOS_STATUS	12		/**< mos_state, chrg_mos_state, dischrg_mos_state, bms_life			*/
+#define BMS_DELTA_TAG_REMAIN_CAPACITY	16
+#define BMS_DELTA_TAG_STATUS_INFO_1	17		/**< battery_string_count to DI_DO_state					*/
+#define BMS_DELTA_TAG_BALANCE		22		/**< cell_balance_states bytes, up to 6						*/
+#define BMS_DELTA_TAG_FAILURE		28		/**< cell_sum_volt_level to fault_code						*/
+#define BMS_DELTA_TAG_CELL		64		/**< cell voltages, up to 48							*/
+#define BMS_DELTA_TAG_TEMP		112		/**< cell temperatures, up to 16						*/
+
+/**
+ * @brief error codes of bms_delta_apply().
+ */
+#define BMS_DELTA_ERR_FORMAT		0x01		/**< unknown tag or truncated entry, the fields before it are applied		*/
+
+
+//=================================================================================== DELTA STRUCTURES ===========================================================================================================
+
+/**
+ * @brief structure of the change tracker of one device.
+ */
+typedef struct bms_delta {
+	RT_Battery_status sent;			/**< values of the last messages, reference of the deadbands			*/
+	uint16_t deadband[BMS_DELTA_TAGS];	/**< largest change of a field that is not sent, in its raw unit, 0 by default	*/
+	uint32_t dirty[BMS_DELTA_TAGS/32];	/**< bit set for a field to be sent						*/
+	uint8_t strings_count;			/**< cells of the pack, the fields beyond are never sent			*/
+	uint8_t temp_sensor_count;		/**< sensors of the pack							*/
+	uint32_t messages;			/**< messages encoded								*/
+	uint32_t bytes;				/**< bytes encoded								*/
+} bms_delta;
+
+
+//======================================================================================== ROUTINE DECLARATION ===================================================================================================
+
+/**
+ * @brief Initializes a tracker, every field dirty so that the first message carries the whole status.
+ * @param bms_delta* delta passes the tracker.
+ * @param uint8_t strings_count passes the cells of the pack, at most STRINGS_COUNT.
+ * @param uint8_t temp_sensor_count passes the sensors of the pack, at most TEMP_SENSOR_COUNT.
+ * @retval void
+ */
+void bms_delta_init(bms_delta* delta, uint8_t strings_count, uint8_t temp_sensor_count);
+
+/**
+ * @brief Sets the deadband of consecutive fields.
+ * @param bms_delta* delta passes the tracker.
+ * @param uint8_t tag passes the first field, one of BMS_DELTA_TAG_x or a tag inside a group.
+ * @param uint8_t count passes the number of fields.
+ * @param uint16_t band passes the largest change not sent, in the raw unit of the fields (mV, 0.1 A, 0.1 %, degree celsius ...).
+ * @retval void
+ */
+void bms_delta_set_deadband(bms_delta* delta, uint8_t tag, uint8_t count, uint16_t band);
+
+/**
+ * @brief Marks every field dirty, the next messages carry the whole status.
+ * @param bms_delta* delta passes the tracker.
+ * @retval void
+ */
+void bms_delta_force(bms_delta* delta);
+
+/**
+ * @brief Compares the fields carried by a response frame with the values last sent, called by the driver as the frame is stored.
+ * @param bms_delta* delta passes the tracker.
+ * @param const RT_Battery_status* stat passes the status the frame was stored in.
+ * @param uint8_t data_id passes the data ID of the frame.
+ * @param uint8_t frame passes the frame number of the multi frame responses, 0 otherwise.
+ * @retval void
+ */
+void bms_delta_frame(bms_delta* delta, const RT_Battery_status* stat, uint8_t data_id, uint8_t frame);
+
+/**
+ * @brief Compares every field of a status with the values last sent, for a tracker fed from a snapshot instead of the driver.
+ * @param bms_delta* delta passes the tracker.
+ * @param const RT_Battery_status* stat passes the status.
+ * @retval void
+ */
+void bms_delta_scan(bms_delta* delta, const RT_Battery_status* stat);
+
+/**
+ * @brief Number of fields waiting to be sent.
+ * @param const bms_delta* delta passes the tracker.
+ * @retval uint16_t returns the number of dirty fields.
+ */
+uint16_t bms_delta_pending(const bms_delta* delta);
+
+/**
+ * @brief Encodes the dirty fields of a status in tag order, as many as fit, and takes their values as the new reference. The fields left over stay dirty for the next message.
+ * @param bms_delta* delta passes the tracker.
+ * @param const RT_Battery_status* stat passes the status, the one the frames were stored in.
+ * @param uint8_t* buf passes the memory of the message.
+ * @param uint16_t max passes the size of buf, at least BMS_DELTA_MIN_BUF.
+ * @retval uint16_t returns the message length, 0 when no field is dirty.
+ */
+uint16_t bms_delta_encode(bms_delta* delta, const RT_Battery_status* stat, uint8_t* buf, uint16_t max);
+
+/**
+ * @brief Applies a message to the status kept by a receiver.
+ * @param RT_Battery_status* stat passes the status of the receiver.
+ * @param const uint8_t* buf passes the message.
+ * @param uint16_t len passes the message length.
+ * @retval uint8_t returns 0 on success and BMS_DELTA_ERR_FORMAT for a malformed message.
+ */
+uint8_t bms_delta_apply(RT_Battery_status* stat, const uint8_t* buf, uint16_t len);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /**< BMS_DELTA_H  */
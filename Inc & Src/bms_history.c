@@ -0,0 +1,631 @@
+#include "bms_history.h"
+#include <stddef.h>
+#include <string.h>
+
+/**
+ * @file bms_history.c
+ * @brief Source code file for the telemetry history declared in bms_history.h
+ * @author Piyush
+ * @date 12/01/25
+ * @version 1.0
+ */
+
+
+// ====================================================================================================== MACROS ==========================================================================================================================
+
+#define BMS_HISTORY_KEY_LEN		(BMS_HISTORY_KEY_HEADER+sizeof(RT_Battery_status))
+
+_Static_assert(sizeof(bms_history)<=BMS_HISTORY_BYTES, "bms_history exceeds BMS_HISTORY_BYTES");
+_Static_assert(BMS_HISTORY_STORE_BYTES>=BMS_HISTORY_KEY_LEN, "BMS_HISTORY_BYTES does not hold one keyframe");
+
+
+//================================================================================== HISTORY FIELD TABLE =========================================================================================================
+
+/**
+ * @brief structure describing a run of equal fields of RT_Battery_status, the unit of the delta encoding.
+ */
+typedef struct {
+	uint16_t offset;	/**< first field inside RT_Battery_status			*/
+	uint8_t size;		/**< bytes per field, 1, 2 or 4					*/
+	uint8_t count;		/**< consecutive fields of the run, 0 ends the table		*/
+	uint8_t big_endian;	/**< 1 for the raw byte pairs of cell_voltages			*/
+} bms_history_field;
+
+/**
+ * @brief table of the fields enabled by the access macros, in RT_Battery_status order.
+ */
+static const bms_history_field history_fields[]={
+#if ((_FULL_READ_ACCESS | _SOC_IV_ACCESS) == 0x01)
+	{ offsetof(RT_Battery_status, cum_total_voltage), 2, 4, 0 },
+#endif
+#if ((_FULL_READ_ACCESS | _MIN_MAX_VOLT_ACCESS) == 0x01)
+	{ offsetof(RT_Battery_status, max_cell_voltage_value), 2, 1, 0 },
+	{ offsetof(RT_Battery_status, cell_count_with_max_voltage), 1, 1, 0 },
+	{ offsetof(RT_Battery_status, min_cell_voltage_value), 2, 1, 0 },
+	{ offsetof(RT_Battery_status, cell_count_with_min_voltage), 1, 1, 0 },
+#endif
+#if ((_FULL_READ_ACCESS | _MIN_MAX_TEMP_ACCESS) == 0x01)
+	{ offsetof(RT_Battery_status, max_temp_val_40), 1, 4, 0 },
+#endif
+#if ((_FULL_READ_ACCESS | _MOS_CHRG_DISCHRG_STATUS_ACCESS) == 0x01)
+	{ offsetof(RT_Battery_status, mos_state), 1, 4, 0 },
+	{ offsetof(RT_Battery_status, remain_capacity), 4, 1, 0 },
+#endif
+#if ((_FULL_READ_ACCESS | _STATUS_INFO1_ACCESS) == 0x01)
+	{ offsetof(RT_Battery_status, battery_string_count), 1, 5, 0 },
+#endif
+#if ((_FULL_READ_ACCESS | _CELL_VOLT_ACCESS) == 0x01)
+	{ offsetof(RT_Battery_status, cell_voltages), MONOMER_VOLTAGE_SIZE, STRINGS_COUNT, 1 },
+#endif
+#if ((_FULL_READ_ACCESS | _CELL_TEMP_ACCESS) == 0x01)
+	{ offsetof(RT_Battery_status, cell_temperatures), 1, TEMP_SENSOR_COUNT, 0 },
+#endif
+#if ((_FULL_READ_ACCESS | _CELL_BALANCE_STATE_ACCESS) ==0x01)
+	{ offsetof(RT_Battery_status, cell_balance_states), 1, sizeof(((RT_Battery_status*)0)->cell_balance_states), 0 },
+#endif
+#if ((_FULL_READ_ACCESS | _BATTERY_FAILURE_STATUS_ACCESS) == 0x01)
+	{ offsetof(RT_Battery_status, cell_sum_volt_level), 1, 8, 0 },
+#endif
+	{ 0, 0, 0, 0 }	// end of table
+};
+
+
+//==================================================================================== PRIVATE ROUTINES =========================================================================================
+
+/**
+ * @brief Number of fields of the table, one bit each in the delta bitmap.
+ */
+static uint16_t bms_history_values(void){
+	uint16_t n=0;
+	for(const bms_history_field* f=history_fields;f->count!=0;f++){
+		n+=f->count;
+	}
+	return n;
+}
+
+/**
+ * @brief Reads field i of a run from a raw RT_Battery_status.
+ * @param const uint8_t* raw passes the status bytes.
+ * @param const bms_history_field* f passes the run.
+ * @param uint8_t i passes the field index in the run.
+ * @retval uint32_t returns the field value.
+ */
+static uint32_t bms_history_get_value(const uint8_t* raw, const bms_history_field* f, uint8_t i){
+	const uint8_t* p=raw+f->offset+i*f->size;
+	if(f->size==1){
+		return p[0];
+	}
+	if(f->big_endian){
+		return ((uint32_t)p[0]<<8) | p[1];
+	}
+	if(f->size==2){
+		uint16_t v;
+		memcpy(&v, p, sizeof(v));
+		return v;
+	}
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+/**
+ * @brief Writes field i of a run into a raw RT_Battery_status, truncated to the field size.
+ * @param uint8_t* raw passes the status bytes.
+ * @param const bms_history_field* f passes the run.
+ * @param uint8_t i passes the field index in the run.
+ * @param uint32_t value passes the value.
+ * @retval void
+ */
+static void bms_history_set_value(uint8_t* raw, const bms_history_field* f, uint8_t i, uint32_t value){
+	uint8_t* p=raw+f->offset+i*f->size;
+	if(f->size==1){
+		p[0]=(uint8_t)value;
+	}
+	else if(f->big_endian){
+		p[0]=(uint8_t)(value>>8);
+		p[1]=(uint8_t)value;
+	}
+	else if(f->size==2){
+		uint16_t v=(uint16_t)value;
+		memcpy(p, &v, sizeof(v));
+	}
+	else{
+		memcpy(p, &value, sizeof(value));
+	}
+}
+
+/**
+ * @brief Stores a varint (7 bits per byte, low bits first).
+ * @param uint32_t value passes the value.
+ * @param uint8_t* dst passes the destination, NULL only counts.
+ * @retval uint8_t returns the number of bytes.
+ */
+static uint8_t bms_history_put_varint(uint32_t value, uint8_t* dst){
+	uint8_t n=0;
+	do{
+		uint8_t byte=(uint8_t)(value&0x7F);
+		value>>=7;
+		if(dst!=NULL){
+			dst[n]=(value!=0) ? (byte|0x80) : byte;
+		}
+		n++;
+	}while(value!=0);
+	return n;
+}
+
+/**
+ * @brief Reads a varint and moves the pointer past it.
+ */
+static uint32_t bms_history_get_varint(const uint8_t** p){
+	uint32_t value=0;
+	uint8_t shift=0;
+	uint8_t byte;
+	do{
+		byte=*(*p)++;
+		value|=(uint32_t)(byte&0x7F)<<shift;
+		shift+=7;
+	}while((byte&0x80) && shift<35);
+	return value;
+}
+
+/**
+ * @brief Encodes a status as a delta record against a keyframe.
+ * @param const uint8_t* key_raw passes the status of the keyframe.
+ * @param const RT_Battery_status* stat passes the status to be encoded.
+ * @param uint32_t dt passes the time since the keyframe.
+ * @param uint8_t* dst passes the record memory, NULL only computes the length.
+ * @retval uint16_t returns the record length.
+ */
+static uint16_t bms_history_encode(const uint8_t* key_raw, const RT_Battery_status* stat, uint32_t dt, uint8_t* dst){
+	uint16_t bitmap_len=(uint16_t)((bms_history_values()+7)/8);
+	uint16_t len=3;
+	len+=bms_history_put_varint(dt, (dst!=NULL) ? dst+len : NULL);
+	uint8_t* bitmap=(dst!=NULL) ? dst+len : NULL;
+	if(bitmap!=NULL){
+		memset(bitmap, 0x00, bitmap_len);
+	}
+	len+=bitmap_len;
+
+	uint16_t vi=0;
+	for(const bms_history_field* f=history_fields;f->count!=0;f++){
+		for(uint8_t i=0;i<f->count;i++,vi++){
+			uint32_t diff=bms_history_get_value((const uint8_t*)stat, f, i)-bms_history_get_value(key_raw, f, i);
+			if(diff==0){
+				continue;
+			}
+			uint32_t zigzag=(diff<<1)^(uint32_t)((int32_t)diff>>31);	// small changes of either sign take one byte
+			if(bitmap!=NULL){
+				bitmap[vi>>3]|=(uint8_t)(1U<<(vi&7));
+			}
+			len+=bms_history_put_varint(zigzag, (dst!=NULL) ? dst+len : NULL);
+		}
+	}
+	if(dst!=NULL){
+		dst[0]=(uint8_t)len;
+		dst[1]=(uint8_t)(len>>8);
+		dst[2]=BMS_HISTORY_DELTA;
+	}
+	return len;
+}
+
+/**
+ * @brief Index entry of the i-th oldest keyframe.
+ */
+static const bms_history_key* bms_history_key_at(const bms_history* hist, uint16_t i){
+	return &hist->keys[(hist->key_tail+i)%BMS_HISTORY_MAX_KEYS];
+}
+
+/**
+ * @brief Length of the record at an offset.
+ */
+static uint16_t bms_history_len(const bms_history* hist, uint16_t offset){
+	return (uint16_t)(hist->store[offset] | (hist->store[offset+1]<<8));
+}
+
+/**
+ * @brief Offset of the record following the one at an offset.
+ */
+static uint16_t bms_history_next_offset(const bms_history* hist, uint16_t offset){
+	uint16_t next=(uint16_t)(offset+bms_history_len(hist, offset));
+	return (hist->wrapped && next==hist->wrap_end) ? 0 : next;
+}
+
+/**
+ * @brief Drops the oldest keyframe and its deltas.
+ * @param bms_history* hist passes the pointer to the history.
+ * @retval void
+ */
+static void bms_history_drop(bms_history* hist){
+	uint16_t old_tail=bms_history_key_at(hist, 0)->offset;
+	hist->key_tail=(uint16_t)((hist->key_tail+1)%BMS_HISTORY_MAX_KEYS);
+	hist->key_count--;
+	if(hist->key_count==0){
+		hist->head=0;
+		hist->wrapped=0;
+	}
+	else if(hist->wrapped && bms_history_key_at(hist, 0)->offset<old_tail){
+		hist->wrapped=0;	// the tail went past wrap_end, the records are contiguous again
+	}
+}
+
+/**
+ * @brief Finds room for a record at head, going back to the start of the store or dropping the oldest groups as needed.
+ * @param bms_history* hist passes the pointer to the history.
+ * @param uint16_t len passes the record length.
+ * @param uint8_t keep_current passes 1 if the newest group must not be dropped (its keyframe is the reference of the record).
+ * @param uint16_t* at passes the memory where the record offset is stored.
+ * @retval uint8_t returns 0 on success and 1 if there is no room.
+ */
+static uint8_t bms_history_alloc(bms_history* hist, uint16_t len, uint8_t keep_current, uint16_t* at){
+	if(len>BMS_HISTORY_STORE_BYTES){
+		return 1;
+	}
+	while(1){
+		if(hist->key_count==0){
+			*at=0;
+			return 0;
+		}
+		uint16_t tail=bms_history_key_at(hist, 0)->offset;
+		if(!hist->wrapped){
+			if(BMS_HISTORY_STORE_BYTES-hist->head>=len){
+				*at=hist->head;
+				return 0;
+			}
+			if(tail>=len){
+				hist->wrap_end=hist->head;
+				hist->wrapped=1;
+				*at=0;
+				return 0;
+			}
+		}
+		else if(tail-hist->head>=len){
+			*at=hist->head;
+			return 0;
+		}
+		if(keep_current && hist->key_count==1){
+			return 1;
+		}
+		bms_history_drop(hist);
+	}
+}
+
+/**
+ * @brief Relative index of the keyframe group holding a record.
+ * @param const bms_history* hist passes the pointer to the history.
+ * @param uint32_t seq passes the record number.
+ * @param uint16_t* group passes the memory where the index is stored.
+ * @retval uint8_t returns 0 on success, BMS_HISTORY_ERR_GONE or BMS_HISTORY_ERR_NOT_YET.
+ */
+static uint8_t bms_history_group(const bms_history* hist, uint32_t seq, uint16_t* group){
+	if(hist->key_count==0 || seq>=hist->next_seq){
+		return BMS_HISTORY_ERR_NOT_YET;
+	}
+	if(seq<bms_history_key_at(hist, 0)->seq){
+		return BMS_HISTORY_ERR_GONE;
+	}
+	uint16_t lo=0, hi=(uint16_t)(hist->key_count-1);
+	while(lo<hi){
+		uint16_t mid=(uint16_t)((lo+hi+1)/2);
+		if(bms_history_key_at(hist, mid)->seq<=seq){
+			lo=mid;
+		}
+		else{
+			hi=(uint16_t)(mid-1);
+		}
+	}
+	*group=lo;
+	return 0;
+}
+
+/**
+ * @brief Store offset of a record of a group, skipping the records before it by their length.
+ */
+static uint16_t bms_history_locate(const bms_history* hist, const bms_history_key* key, uint32_t seq){
+	uint16_t offset=key->offset;
+	for(uint32_t n=key->seq;n<seq;n++){
+		offset=bms_history_next_offset(hist, offset);
+	}
+	return offset;
+}
+
+/**
+ * @brief Time of a record.
+ */
+static uint32_t bms_history_time(const bms_history* hist, const bms_history_key* key, uint16_t offset){
+	const uint8_t* p=hist->store+offset+3;
+	return (hist->store[offset+2]==BMS_HISTORY_KEY) ? key->time_ms : key->time_ms+bms_history_get_varint(&p);
+}
+
+/**
+ * @brief Rebuilds the status of a record from its keyframe.
+ * @param const bms_history* hist passes the pointer to the history.
+ * @param const bms_history_key* key passes the keyframe of the record's group.
+ * @param uint16_t offset passes the record offset.
+ * @param RT_Battery_status* stat passes the memory where the status is rebuilt.
+ * @param uint32_t* time_ms passes the memory where its time is stored, can be NULL.
+ * @retval void
+ */
+static void bms_history_decode(const bms_history* hist, const bms_history_key* key, uint16_t offset, RT_Battery_status* stat, uint32_t* time_ms){
+	const uint8_t* key_raw=hist->store+key->offset+BMS_HISTORY_KEY_HEADER;
+	memcpy(stat, key_raw, sizeof(RT_Battery_status));
+	if(time_ms!=NULL){
+		*time_ms=bms_history_time(hist, key, offset);
+	}
+	if(hist->store[offset+2]==BMS_HISTORY_KEY){
+		return;
+	}
+
+	const uint8_t* p=hist->store+offset+3;
+	bms_history_get_varint(&p);
+	const uint8_t* bitmap=p;
+	p+=(bms_history_values()+7)/8;
+	uint16_t vi=0;
+	for(const bms_history_field* f=history_fields;f->count!=0;f++){
+		for(uint8_t i=0;i<f->count;i++,vi++){
+			if(bitmap[vi>>3] & (1U<<(vi&7))){
+				uint32_t zigzag=bms_history_get_varint(&p);
+				uint32_t diff=(zigzag>>1)^(0U-(zigzag&1U));
+				bms_history_set_value((uint8_t*)stat, f, i, bms_history_get_value(key_raw, f, i)+diff);
+			}
+		}
+	}
+}
+
+
+//==================================================================================== ROUTINE DEFINITIONS ======================================================================================
+
+
+/**
+ * @brief Initializes an empty history.
+ * @param bms_history* hist passes the pointer to the history.
+ * @retval void
+ */
+void bms_history_init(bms_history* hist){
+	hist->key_tail=0;
+	hist->key_count=0;
+	hist->head=0;
+	hist->wrap_end=0;
+	hist->wrapped=0;
+	hist->next_seq=0;
+}
+
+/**
+ * @brief Records a status, as a delta against the last keyframe or as a new keyframe every BMS_HISTORY_KEYFRAME_PERIOD records (or when the delta would not be smaller).
+ * @param bms_history* hist passes the pointer to the history.
+ * @param const RT_Battery_status* stat passes the status to be recorded.
+ * @param uint32_t time_ms passes the time of the status.
+ * @retval uint8_t returns 0 on success and BMS_HISTORY_ERR_TOO_SMALL if the budget does not hold one keyframe.
+ */
+uint8_t bms_history_record(bms_history* hist, const RT_Battery_status* stat, uint32_t time_ms){
+	uint16_t at;
+
+	if(hist->key_count!=0){
+		bms_history_key* cur=&hist->keys[(hist->key_tail+hist->key_count-1)%BMS_HISTORY_MAX_KEYS];
+		if(cur->records<BMS_HISTORY_KEYFRAME_PERIOD){
+			const uint8_t* key_raw=hist->store+cur->offset+BMS_HISTORY_KEY_HEADER;
+			uint16_t len=bms_history_encode(key_raw, stat, time_ms-cur->time_ms, NULL);
+			if(len<BMS_HISTORY_KEY_LEN && bms_history_alloc(hist, len, 1, &at)==0){
+				bms_history_encode(key_raw, stat, time_ms-cur->time_ms, hist->store+at);
+				hist->head=(uint16_t)(at+len);
+				cur->records++;
+				hist->next_seq++;
+				return 0;
+			}
+		}
+	}
+
+	if(hist->key_count==BMS_HISTORY_MAX_KEYS){
+		bms_history_drop(hist);
+	}
+	if(bms_history_alloc(hist, BMS_HISTORY_KEY_LEN, 0, &at)!=0){
+		return BMS_HISTORY_ERR_TOO_SMALL;
+	}
+	uint8_t* rec=hist->store+at;
+	rec[0]=(uint8_t)BMS_HISTORY_KEY_LEN;
+	rec[1]=(uint8_t)(BMS_HISTORY_KEY_LEN>>8);
+	rec[2]=BMS_HISTORY_KEY;
+	memcpy(rec+3, &time_ms, sizeof(time_ms));
+	memcpy(rec+BMS_HISTORY_KEY_HEADER, stat, sizeof(RT_Battery_status));
+	hist->head=(uint16_t)(at+BMS_HISTORY_KEY_LEN);
+
+	bms_history_key* key=&hist->keys[(hist->key_tail+hist->key_count)%BMS_HISTORY_MAX_KEYS];
+	key->offset=at;
+	key->records=1;
+	key->seq=hist->next_seq++;
+	key->time_ms=time_ms;
+	hist->key_count++;
+	return 0;
+}
+
+/**
+ * @brief Range of the records kept.
+ * @param const bms_history* hist passes the pointer to the history.
+ * @param uint32_t* first_seq passes the memory where the number of the oldest record is stored.
+ * @retval uint32_t returns the number of records kept, the newest one being first_seq+count-1.
+ */
+uint32_t bms_history_count(const bms_history* hist, uint32_t* first_seq){
+	uint32_t first=(hist->key_count!=0) ? bms_history_key_at(hist, 0)->seq : hist->next_seq;
+	if(first_seq!=NULL){
+		*first_seq=first;
+	}
+	return hist->next_seq-first;
+}
+
+/**
+ * @brief Rebuilds a past status.
+ * @param const bms_history* hist passes the pointer to the history.
+ * @param uint32_t seq passes the record number.
+ * @param RT_Battery_status* stat passes the memory where the status is rebuilt.
+ * @param uint32_t* time_ms passes the memory where its time is stored, can be NULL.
+ * @retval uint8_t returns 0 on success, BMS_HISTORY_ERR_GONE or BMS_HISTORY_ERR_NOT_YET.
+ */
+uint8_t bms_history_get(const bms_history* hist, uint32_t seq, RT_Battery_status* stat, uint32_t* time_ms){
+	uint16_t group;
+	uint8_t ret=bms_history_group(hist, seq, &group);
+	if(ret!=0){
+		return ret;
+	}
+	const bms_history_key* key=bms_history_key_at(hist, group);
+	bms_history_decode(hist, key, bms_history_locate(hist, key, seq), stat, time_ms);
+	return 0;
+}
+
+/**
+ * @brief Finds the newest record taken at or before a time.
+ * @param const bms_history* hist passes the pointer to the history.
+ * @param uint32_t time_ms passes the time.
+ * @param uint32_t* seq passes the memory where the record number is stored.
+ * @retval uint8_t returns 0 on success, BMS_HISTORY_ERR_GONE if the time is older than every record kept, BMS_HISTORY_ERR_NOT_YET if the history is empty.
+ */
+uint8_t bms_history_find(const bms_history* hist, uint32_t time_ms, uint32_t* seq){
+	if(hist->key_count==0){
+		return BMS_HISTORY_ERR_NOT_YET;
+	}
+	if((int32_t)(time_ms-bms_history_key_at(hist, 0)->time_ms)<0){
+		return BMS_HISTORY_ERR_GONE;
+	}
+	uint16_t lo=0, hi=(uint16_t)(hist->key_count-1);
+	while(lo<hi){
+		uint16_t mid=(uint16_t)((lo+hi+1)/2);
+		if((int32_t)(time_ms-bms_history_key_at(hist, mid)->time_ms)>=0){
+			lo=mid;
+		}
+		else{
+			hi=(uint16_t)(mid-1);
+		}
+	}
+
+	const bms_history_key* key=bms_history_key_at(hist, lo);
+	uint16_t offset=key->offset;
+	uint32_t found=key->seq;
+	for(uint16_t n=1;n<key->records;n++){
+		offset=bms_history_next_offset(hist, offset);
+		if((int32_t)(time_ms-bms_history_time(hist, key, offset))<0){
+			break;
+		}
+		found=key->seq+n;
+	}
+	*seq=found;
+	return 0;
+}
+
+/**
+ * @brief Starts an iteration at a record, the oldest one kept if seq is older.
+ * @param const bms_history* hist passes the pointer to the history.
+ * @param uint32_t seq passes the first record number.
+ * @param bms_history_iter* it passes the iterator.
+ * @retval void
+ */
+void bms_history_iter_begin(const bms_history* hist, uint32_t seq, bms_history_iter* it){
+	uint32_t first;
+	bms_history_count(hist, &first);
+	it->hist=hist;
+	it->seq=(seq<first) ? first : seq;
+	it->key_seq=UINT32_MAX;
+	it->offset=0;
+}
+
+/**
+ * @brief Rebuilds the next record of an iteration.
+ * @param bms_history_iter* it passes the iterator.
+ * @param RT_Battery_status* stat passes the memory where the status is rebuilt.
+ * @param uint32_t* time_ms passes the memory where its time is stored, can be NULL.
+ * @retval uint8_t returns 0 on success, BMS_HISTORY_ERR_NOT_YET past the newest record, BMS_HISTORY_ERR_GONE if the record was dropped meanwhile.
+ */
+uint8_t bms_history_iter_next(bms_history_iter* it, RT_Battery_status* stat, uint32_t* time_ms){
+	const bms_history* hist=it->hist;
+	uint16_t group;
+	uint8_t ret=bms_history_group(hist, it->seq, &group);
+	if(ret!=0){
+		return ret;
+	}
+	const bms_history_key* key=bms_history_key_at(hist, group);
+	if(key->seq!=it->key_seq){	// first call or new group, the offsets of a kept group never change
+		it->offset=bms_history_locate(hist, key, it->seq);
+		it->key_seq=key->seq;
+	}
+	bms_history_decode(hist, key, it->offset, stat, time_ms);
+
+	it->seq++;
+	if(it->seq-key->seq<key->records){
+		it->offset=bms_history_next_offset(hist, it->offset);
+	}
+	else{
+		it->key_seq=UINT32_MAX;	// next group, or a record not written yet whose place is not known
+	}
+	return 0;
+}
+
+/**
+ * @brief Time series of one cell voltage, decoded without rebuilding the statuses.
+ * @param const bms_history* hist passes the pointer to the history.
+ * @param uint8_t cell passes the cell index, below STRINGS_COUNT.
+ * @param uint32_t from_seq passes the first record number, the oldest one kept if older.
+ * @param uint16_t* mv passes the memory for the voltages in mV.
+ * @param uint32_t* time_ms passes the memory for the times, can be NULL.
+ * @param uint16_t max passes the size of the arrays.
+ * @retval uint16_t returns the number of points stored, 0 if the cell voltages are disabled.
+ */
+uint16_t bms_history_cell_series(const bms_history* hist, uint8_t cell, uint32_t from_seq, uint16_t* mv, uint32_t* time_ms, uint16_t max){
+#if ((_FULL_READ_ACCESS | _CELL_VOLT_ACCESS) == 0x01)
+	if(cell>=STRINGS_COUNT){
+		return 0;
+	}
+	const bms_history_field* f=history_fields;
+	uint16_t vi=cell;
+	while(f->offset!=offsetof(RT_Battery_status, cell_voltages)){
+		vi+=f->count;
+		f++;
+	}
+
+	uint16_t bitmap_len=(uint16_t)((bms_history_values()+7)/8);
+	uint16_t n=0;
+	uint32_t seq;
+	bms_history_count(hist, &seq);
+	seq=(from_seq>seq) ? from_seq : seq;
+	uint16_t group;
+	while(n<max && bms_history_group(hist, seq, &group)==0){
+		const bms_history_key* key=bms_history_key_at(hist, group);
+		const uint8_t* key_raw=hist->store+key->offset+BMS_HISTORY_KEY_HEADER;
+		uint16_t offset=bms_history_locate(hist, key, seq);
+
+		for(;seq<key->seq+key->records && n<max;seq++){
+			uint32_t value=bms_history_get_value(key_raw, f, cell);
+			if(hist->store[offset+2]==BMS_HISTORY_DELTA){
+				const uint8_t* p=hist->store+offset+3;
+				bms_history_get_varint(&p);
+				const uint8_t* bitmap=p;
+				p+=bitmap_len;
+				if(bitmap[vi>>3] & (1U<<(vi&7))){
+					uint16_t before=0;	// differences stored ahead of this cell's
+					for(uint16_t b=0;b<vi;b++){
+						before+=(bitmap[b>>3]>>(b&7))&1U;
+					}
+					while(before--){
+						bms_history_get_varint(&p);
+					}
+					uint32_t zigzag=bms_history_get_varint(&p);
+					value+=(zigzag>>1)^(0U-(zigzag&1U));
+				}
+			}
+			mv[n]=(uint16_t)value;
+			if(time_ms!=NULL){
+				time_ms[n]=bms_history_time(hist, key, offset);
+			}
+			n++;
+			if(seq+1<key->seq+key->records){
+				offset=bms_history_next_offset(hist, offset);
+			}
+		}
+	}
+	return n;
+#else
+	(void)hist;
+	(void)cell;
+	(void)from_seq;
+	(void)mv;
+	(void)time_ms;
+	(void)max;
+	return 0;
+#endif
+}
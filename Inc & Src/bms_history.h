@@ -0,0 +1,181 @@
+#ifndef BMS_HISTORY_H
+#define BMS_HISTORY_H
+
+#include "bms_uart_comm.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @file bms_history.h
+ * @brief Header file for the telemetry history defined in bms_history.c
+ * 	  Keeps the last statuses of a pack for post fault analysis in a fixed amount of memory, every status is stored as the field level difference with the last keyframe,
+ * 	  a full copy taken every BMS_HISTORY_KEYFRAME_PERIOD records, so that a cell moving by a few mV costs one byte instead of a whole RT_Battery_status.
+ * @author Piyush
+ * @date 12/01/25
+ * @version 1.0
+ *
+ *
+ * @note Record layout, stored back to back in a byte ring, the oldest keyframe and its deltas are dropped together when room is needed :
+ *		keyframe : length (2 bytes), BMS_HISTORY_KEY, time_ms (4 bytes), the RT_Battery_status as is.
+ *		delta    : length (2 bytes), BMS_HISTORY_DELTA, time since the keyframe (varint), one bit per field set if it differs from the keyframe, the differences (zigzag varints).
+ *	 Any record is rebuilt from its keyframe and itself, a query first finds the keyframe by binary search and then skips the deltas by their length.
+ *
+ *	 Example :
+ *		bms_history_init(&hist);
+ *		after every read : bms_history_record(&hist, &stat, HAL_GetTick());
+ *		after a fault : bms_history_find(&hist, fault_ms-60000, &seq); for(bms_history_iter_begin(&hist, seq, &it); bms_history_iter_next(&it, &past, &t)==0;){ ... }
+ */
+
+
+// ====================================================================================================== MACROS ==========================================================================================================================
+
+#ifndef BMS_HISTORY_BYTES
+#define BMS_HISTORY_BYTES		8192		/**< memory budget of one bms_history, structure included	*/
+#endif
+#ifndef BMS_HISTORY_KEYFRAME_PERIOD
+#define BMS_HISTORY_KEYFRAME_PERIOD	32		/**< records per keyframe, the first one being the keyframe	*/
+#endif
+
+#define BMS_HISTORY_KEY_HEADER		7		/**< length, type and time of a keyframe record			*/
+#define BMS_HISTORY_MAX_KEYS		(BMS_HISTORY_BYTES/(BMS_HISTORY_KEY_HEADER+sizeof(RT_Battery_status)+sizeof(bms_history_key))+1)	/**< keyframes that fit the budget, the oldest group is dropped beyond	*/
+#define BMS_HISTORY_STORE_BYTES		(BMS_HISTORY_BYTES-BMS_HISTORY_MAX_KEYS*sizeof(bms_history_key)-32)	/**< ring left after the index and counters	*/
+
+#if (BMS_HISTORY_BYTES > 65535)
+#error "BMS_HISTORY_BYTES must not exceed 65535, ring offsets are 16 bit"
+#endif
+
+/**
+ * @brief macros for the record types.
+ */
+#define BMS_HISTORY_KEY			0x00
+#define BMS_HISTORY_DELTA		0x01
+
+/**
+ * @brief error codes of the queries.
+ */
+#define BMS_HISTORY_ERR_GONE		0x01		/**< record older than the oldest one kept				*/
+#define BMS_HISTORY_ERR_NOT_YET		0x02		/**< record not recorded yet, or end of the iteration			*/
+#define BMS_HISTORY_ERR_TOO_SMALL	0x03		/**< the budget does not hold one keyframe				*/
+
+
+//================================================================================== HISTORY STRUCTURES =========================================================================================================
+
+/**
+ * @brief structure of the index entry of one keyframe.
+ */
+typedef struct {
+	uint16_t offset;		/**< keyframe record in bms_history::store			*/
+	uint16_t records;		/**< keyframe and deltas of the group				*/
+	uint32_t seq;			/**< record number of the keyframe				*/
+	uint32_t time_ms;		/**< time of the keyframe					*/
+} bms_history_key;
+
+/**
+ * @brief structure of the history of one pack, sizeof(bms_history) is at most BMS_HISTORY_BYTES.
+ */
+typedef struct {
+	bms_history_key keys[BMS_HISTORY_MAX_KEYS];	/**< ring of the keyframes kept, oldest at key_tail			*/
+	uint16_t key_tail;		/**< index of the oldest keyframe					*/
+	uint16_t key_count;		/**< keyframes kept, 0 when empty					*/
+	uint16_t head;			/**< store offset of the next record					*/
+	uint16_t wrap_end;		/**< end of the records before head went back to 0			*/
+	uint8_t wrapped;		/**< 1 while the records run from the tail to wrap_end and from 0 to head	*/
+	uint32_t next_seq;		/**< record number of the next record					*/
+	uint8_t store[BMS_HISTORY_STORE_BYTES];
+} bms_history;
+
+/**
+ * @brief structure of an iteration over the records, from any record to the newest one.
+ */
+typedef struct {
+	const bms_history* hist;
+	uint32_t seq;			/**< record returned by the next bms_history_iter_next()		*/
+	uint32_t key_seq;		/**< keyframe of the group of seq, checked against the drops		*/
+	uint16_t offset;		/**< store offset of record seq, valid while its group is kept		*/
+} bms_history_iter;
+
+
+//======================================================================================== ROUTINE DECLARATION ===================================================================================================
+
+/**
+ * @brief Initializes an empty history.
+ * @param bms_history* hist passes the pointer to the history.
+ * @retval void
+ */
+void bms_history_init(bms_history* hist);
+
+/**
+ * @brief Records a status, as a delta against the last keyframe or as a new keyframe every BMS_HISTORY_KEYFRAME_PERIOD records (or when the delta would not be smaller).
+ * @param bms_history* hist passes the pointer to the history.
+ * @param const RT_Battery_status* stat passes the status to be recorded.
+ * @param uint32_t time_ms passes the time of the status.
+ * @retval uint8_t returns 0 on success and BMS_HISTORY_ERR_TOO_SMALL if the budget does not hold one keyframe.
+ */
+uint8_t bms_history_record(bms_history* hist, const RT_Battery_status* stat, uint32_t time_ms);
+
+/**
+ * @brief Range of the records kept.
+ * @param const bms_history* hist passes the pointer to the history.
+ * @param uint32_t* first_seq passes the memory where the number of the oldest record is stored.
+ * @retval uint32_t returns the number of records kept, the newest one being first_seq+count-1.
+ */
+uint32_t bms_history_count(const bms_history* hist, uint32_t* first_seq);
+
+/**
+ * @brief Rebuilds a past status.
+ * @param const bms_history* hist passes the pointer to the history.
+ * @param uint32_t seq passes the record number.
+ * @param RT_Battery_status* stat passes the memory where the status is rebuilt.
+ * @param uint32_t* time_ms passes the memory where its time is stored, can be NULL.
+ * @retval uint8_t returns 0 on success, BMS_HISTORY_ERR_GONE or BMS_HISTORY_ERR_NOT_YET.
+ */
+uint8_t bms_history_get(const bms_history* hist, uint32_t seq, RT_Battery_status* stat, uint32_t* time_ms);
+
+/**
+ * @brief Finds the newest record taken at or before a time.
+ * @param const bms_history* hist passes the pointer to the history.
+ * @param uint32_t time_ms passes the time.
+ * @param uint32_t* seq passes the memory where the record number is stored.
+ * @retval uint8_t returns 0 on success, BMS_HISTORY_ERR_GONE if the time is older than every record kept, BMS_HISTORY_ERR_NOT_YET if the history is empty.
+ */
+uint8_t bms_history_find(const bms_history* hist, uint32_t time_ms, uint32_t* seq);
+
+/**
+ * @brief Starts an iteration at a record, the oldest one kept if seq is older.
+ * @param const bms_history* hist passes the pointer to the history.
+ * @param uint32_t seq passes the first record number.
+ * @param bms_history_iter* it passes the iterator.
+ * @retval void
+ */
+void bms_history_iter_begin(const bms_history* hist, uint32_t seq, bms_history_iter* it);
+
+/**
+ * @brief Rebuilds the next record of an iteration.
+ * @param bms_history_iter* it passes the iterator.
+ * @param RT_Battery_status* stat passes the memory where the status is rebuilt.
+ * @param uint32_t* time_ms passes the memory where its time is stored, can be NULL.
+ * @retval uint8_t returns 0 on success, BMS_HISTORY_ERR_NOT_YET past the newest record, BMS_HISTORY_ERR_GONE if the record was dropped meanwhile.
+ */
+uint8_t bms_history_iter_next(bms_history_iter* it, RT_Battery_status* stat, uint32_t* time_ms);
+
+/**
+ * @brief Time series of one cell voltage, decoded without rebuilding the statuses.
+ * @param const bms_history* hist passes the pointer to the history.
+ * @param uint8_t cell passes the cell index, below STRINGS_COUNT.
+ * @param uint32_t from_seq passes the first record number, the oldest one kept if older.
+ * @param uint16_t* mv passes the memory for the voltages in mV.
+ * @param uint32_t* time_ms passes the memory for the times, can be NULL.
+ * @param uint16_t max passes the size of the arrays.
+ * @retval uint16_t returns the number of points stored, 0 if the cell voltages are disabled.
+ */
+uint16_t bms_history_cell_series(const bms_history* hist, uint8_t cell, uint32_t from_seq, uint16_t* mv, uint32_t* time_ms, uint16_t max);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /**< BMS_HISTORY_H  */
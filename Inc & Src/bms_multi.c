@@ -0,0 +1,411 @@
+#if defined(__linux__)
+#define _GNU_SOURCE
+#include <sys/epoll.h>
+#include <unistd.h>
+#endif
+#include "bms_multi.h"
+#include <string.h>
+
+/**
+ * @file bms_multi.c
+ * @brief Source code file for the multi pack polling engine declared in bms_multi.h
+ * @author Piyush
+ * @date 12/01/25
+ * @version 1.0
+ */
+
+
+//==================================================================================== PRIVATE ROUTINES =========================================================================================
+
+/**
+ * @brief Ends the cycle of a slot.
+ * @param bms_multi* multi passes the pointer to the engine.
+ * @param bms_multi_slot* slot passes the slot.
+ * @param uint8_t error passes 0 on success or the bms_read() error code.
+ * @retval void
+ */
+static void bms_multi_finish(bms_multi* multi, bms_multi_slot* slot, uint8_t error){
+	slot->state=(error==0) ? BMS_MULTI_DONE : BMS_MULTI_FAILED;
+	slot->error=error;
+	multi->active--;
+	bms_device_publish(slot->dev);
+	bms_stats_read_done(slot->dev->stats, error, slot->data_id);
+	if(error!=BMS_ERR_PREEMPTED){
+		bms_device_report(slot->dev, multi->time_ms(), error);
+	}
+}
+
+/**
+ * @brief Sends the request of the data ID in flight of a slot.
+ * @param bms_multi* multi passes the pointer to the engine.
+ * @param bms_multi_slot* slot passes the slot.
+ * @retval void
+ */
+static void bms_multi_request(bms_multi* multi, bms_multi_slot* slot){
+	bms_stats* stats=slot->dev->stats;
+	bms_id_stats* id=bms_stats_id(stats, slot->data_id);
+	slot->arrived=0;
+	slot->seen=0;
+	slot->first_pending=1;
+	bms_device_build_request(slot->dev, slot->data_id, &slot->request);
+	uint32_t start=bms_stats_now(stats);
+	uint8_t ret=bms_transport_transmit_start(slot->dev->transport, (uint8_t*)&slot->request, sizeof(uart_prot_packet), bms_device_timeout_ms(slot->dev, 1));	// the request of the next port goes out while this one is on the wire
+	if(id!=NULL){
+		slot->sent_us=bms_stats_now(stats);
+		id->requests++;
+		id->retries+=(slot->retries!=0) ? 1 : 0;	// retries is counted up just before a request is sent again
+		id->tx_bytes+=sizeof(uart_prot_packet);
+		if(stats->time_us!=NULL){
+			bms_stats_latency(id, BMS_STATS_TX, slot->sent_us-start);
+		}
+	}
+	if(ret!=BMS_TRANSPORT_OK){
+		bms_multi_finish(multi, slot, bms_data_id_err_base(slot->data_id));
+		return;
+	}
+	slot->deadline_ms=multi->time_ms()+bms_device_timeout_ms(slot->dev, 2);	// request and first frame
+}
+
+/**
+ * @brief Sends the next request of a slot, or ends its cycle when every data ID has been received.
+ * @param bms_multi* multi passes the pointer to the engine.
+ * @param bms_multi_slot* slot passes the slot.
+ * @retval void
+ */
+static void bms_multi_request_next(bms_multi* multi, bms_multi_slot* slot){
+	if(slot->next==multi->id_count || (slot->probe && slot->next!=0)){
+		bms_multi_finish(multi, slot, 0);
+		return;
+	}
+	slot->data_id=slot->probe ? multi->probe_id : multi->ids[slot->next];
+	slot->next++;
+	slot->frames=bms_device_frames(slot->dev, slot->data_id);
+	slot->missing=(uint16_t)((1UL<<slot->frames)-1);
+	slot->retries=0;
+	slot->last_error=3;
+	bms_multi_request(multi, slot);
+}
+
+/**
+ * @brief Counts the end of a response of a slot once its last frame arrived, valid or not.
+ * @param bms_multi_slot* slot passes the slot, its arrived count updated.
+ * @retval void
+ */
+static void bms_multi_count_response(bms_multi_slot* slot){
+	bms_id_stats* id=bms_stats_id(slot->dev->stats, slot->data_id);
+	if(id==NULL || slot->arrived!=slot->frames){
+		return;
+	}
+	id->responses++;
+	if(slot->dev->stats->time_us!=NULL){
+		bms_stats_latency(id, BMS_STATS_RESPONSE, slot->dev->stats->time_us()-slot->sent_us);
+	}
+}
+
+/**
+ * @brief Moves a slot on once the current response is over, to the next data ID when no frame is missing, otherwise requests the data ID again.
+ * @param bms_multi* multi passes the pointer to the engine.
+ * @param bms_multi_slot* slot passes the slot.
+ * @retval void
+ */
+static void bms_multi_check(bms_multi* multi, bms_multi_slot* slot){
+	if(slot->missing==0 && slot->arrived>=slot->frames){	// a repeated response is consumed to its end so that its remaining frames are not taken for the next data ID
+		bms_multi_request_next(multi, slot);
+	}
+	else if(slot->missing!=0 && slot->arrived>=slot->frames){
+		if(slot->retries>=slot->dev->policy.retries){
+			bms_multi_finish(multi, slot, bms_data_id_err_base(slot->data_id)+slot->last_error);
+			return;
+		}
+		slot->retries++;
+		bms_multi_request(multi, slot);
+	}
+	else{
+		slot->deadline_ms=multi->time_ms()+bms_device_timeout_ms(slot->dev, 1);
+	}
+}
+
+/**
+ * @brief Handles a verified frame received by a slot, frames of multi frame responses are placed by their frame number data[0] in any order.
+ * @param bms_multi* multi passes the pointer to the engine.
+ * @param bms_multi_slot* slot passes the slot.
+ * @param const uart_prot_packet* frame passes the frame.
+ * @retval void
+ */
+static void bms_multi_on_frame(bms_multi* multi, bms_multi_slot* slot, const uart_prot_packet* frame){
+	if(frame->data_id!=slot->data_id){	// stale frame of a timed out or preempted request, dropped, the deadline of the slot still runs
+		if(slot->dev->stats!=NULL){
+			slot->dev->stats->unexpected_ids++;
+		}
+		return;
+	}
+	uint8_t seq=(frame->data_id==CELL_VOLTAGE || frame->data_id==CELL_TEMPERATURE) ? frame->data[0] : 0;
+	bms_id_stats* id=bms_stats_id(slot->dev->stats, slot->data_id);
+	if(id!=NULL){
+		id->frames++;
+		id->sequence_errors+=(seq>=slot->frames || (slot->seen & (1U<<seq))) ? 1 : 0;
+	}
+	if(seq>=slot->frames){
+		slot->last_error=3;	// incorrect frame sequence.
+	}
+	else{
+		if(slot->missing & (1U<<seq)){
+			bms_device_store_frame(slot->dev, frame);
+			slot->missing&=(uint16_t)~(1U<<seq);
+		}
+		slot->seen|=(uint16_t)(1U<<seq);
+	}
+	slot->arrived++;
+	bms_multi_count_response(slot);
+	bms_multi_check(multi, slot);
+}
+
+/**
+ * @brief Drains the bytes received on the port of a slot through its parser.
+ * @param bms_multi* multi passes the pointer to the engine.
+ * @param bms_multi_slot* slot passes the slot.
+ * @retval void
+ */
+static void bms_multi_service(bms_multi* multi, bms_multi_slot* slot){
+	uint8_t buf[BMS_MULTI_RX_CHUNK];
+	uint16_t n;
+
+	while(slot->state==BMS_MULTI_WAIT && (n=slot->dev->transport->receive_available(slot->dev->transport->handle, buf, sizeof(buf)))!=0){
+		bms_id_stats* id=bms_stats_id(slot->dev->stats, slot->data_id);
+		if(id!=NULL){
+			id->rx_bytes+=n;	// the whole chunk goes to the data ID in flight, a chunk ending one response and starting the next is rare
+			if(slot->first_pending && slot->dev->stats->time_us!=NULL){
+				bms_stats_latency(id, BMS_STATS_FIRST_BYTE, slot->dev->stats->time_us()-slot->sent_us);
+			}
+			slot->first_pending=0;
+		}
+		for(uint16_t i=0;i<n && slot->state==BMS_MULTI_WAIT;i++){
+			uint32_t checksum_errors=slot->parser.checksum_errors;
+			if(bms_parser_feed(&slot->parser, buf[i])){
+				bms_multi_on_frame(multi, slot, &slot->parser.frame);
+			}
+			else if(slot->parser.checksum_errors!=checksum_errors){
+				slot->arrived++;	// responses come in request order, the corrupted frame belongs to data_id
+				slot->last_error=2;
+				bms_id_stats* cur=bms_stats_id(slot->dev->stats, slot->data_id);	// the chunk may have moved the slot to the next data ID
+				if(cur!=NULL){
+					cur->checksum_errors++;
+				}
+				bms_multi_count_response(slot);
+				bms_multi_check(multi, slot);
+			}
+		}
+	}
+	if(slot->state==BMS_MULTI_WAIT && slot->parser.state==BMS_PARSER_WAIT_START && __atomic_load_n(&slot->dev->cmd_state, __ATOMIC_ACQUIRE)==BMS_CMD_PENDING){
+		bms_device_service_command(slot->dev, (uint8_t)(slot->frames-slot->arrived));	// frame boundary, blocking on this port only for the command
+		bms_multi_finish(multi, slot, BMS_ERR_PREEMPTED);
+		return;
+	}
+	if(slot->state==BMS_MULTI_WAIT && (int32_t)(multi->time_ms()-slot->deadline_ms)>=0){
+		if(slot->missing==0){
+			bms_multi_request_next(multi, slot);
+			return;
+		}
+		bms_id_stats* id=bms_stats_id(slot->dev->stats, slot->data_id);
+		if(id!=NULL){
+			id->timeouts++;
+		}
+		if(slot->retries>=slot->dev->policy.retries){
+			bms_multi_finish(multi, slot, bms_data_id_err_base(slot->data_id)+1);
+			return;
+		}
+		slot->retries++;	// frames lost on the line, only the missing ones are taken from the new response
+		bms_multi_request(multi, slot);
+	}
+}
+
+
+//==================================================================================== ROUTINE DEFINITIONS ======================================================================================
+
+
+/**
+ * @brief Initializes an empty engine.
+ * @param bms_multi* multi passes the pointer to the engine.
+ * @param uint32_t (*time_ms)(void) passes the millisecond tick, HAL_GetTick on the MCU.
+ * @retval uint8_t returns 0 on success and BMS_MULTI_ERR_EPOLL if the epoll instance can't be created.
+ */
+uint8_t bms_multi_init(bms_multi* multi, uint32_t (*time_ms)(void)){
+	memset(multi, 0x00, sizeof(bms_multi));
+	multi->time_ms=time_ms;
+#if defined(__linux__)
+	multi->epoll_fd=epoll_create1(EPOLL_CLOEXEC);
+	if(multi->epoll_fd<0){
+		return BMS_MULTI_ERR_EPOLL;
+	}
+#endif
+	return 0;
+}
+
+/**
+ * @brief Adds a pack to the engine.
+ * @param bms_multi* multi passes the pointer to the engine.
+ * @param bms_device* dev passes the initialized device, its transport must provide receive_available().
+ * @retval uint8_t returns 0 on success and one of the BMS_MULTI_ERR_x codes on failure.
+ */
+uint8_t bms_multi_add(bms_multi* multi, bms_device* dev){
+	if(multi->count==BMS_MULTI_MAX_DEVICES){
+		return BMS_MULTI_ERR_FULL;
+	}
+	if(dev->transport==NULL || dev->transport->receive_available==NULL){
+		return BMS_MULTI_ERR_TRANSPORT;
+	}
+#if defined(__linux__)
+	if(dev->transport->fd>=0){
+		struct epoll_event ev={ .events=EPOLLIN, .data.u32=multi->count };
+		if(epoll_ctl(multi->epoll_fd, EPOLL_CTL_ADD, dev->transport->fd, &ev)!=0){
+			return BMS_MULTI_ERR_EPOLL;
+		}
+	}
+#endif
+	bms_multi_slot* slot=&multi->slots[multi->count++];
+	memset(slot, 0x00, sizeof(bms_multi_slot));
+	slot->dev=dev;
+	bms_parser_reset(&slot->parser);
+	return 0;
+}
+
+/**
+ * @brief Starts a refresh cycle, sends the first request to every pack admitted by its health (bms_device_admit()), offline packs whose probe is due get the probe request only.
+ * @param bms_multi* multi passes the pointer to the engine.
+ * @param uint16_t mask passes the selected data IDs, OR of BMS_DATA_ID_MASK(data_id) values, BMS_MASK_ALL selects every enabled group.
+ * @retval uint8_t returns 0 on success and BMS_ERR_DATA_ID_DISABLED if the mask selects a disabled group.
+ */
+uint8_t bms_multi_start(bms_multi* multi, uint16_t mask){
+	uint16_t enabled=bms_enabled_mask();
+	if(mask!=BMS_MASK_ALL && (mask & ~enabled)!=0){
+		return BMS_ERR_DATA_ID_DISABLED;
+	}
+	multi->id_count=0;
+	for(uint8_t data_id=SOC_TOTAL_IV;data_id<=BATTERY_FAILURE_STATUS;data_id++){
+		if(mask & enabled & BMS_DATA_ID_MASK(data_id)){
+			multi->ids[multi->id_count++]=data_id;
+		}
+	}
+
+	multi->probe_id=SOC_TOTAL_IV;
+	while(multi->probe_id<BATTERY_FAILURE_STATUS && !(bms_probe_mask() & BMS_DATA_ID_MASK(multi->probe_id))){
+		multi->probe_id++;
+	}
+
+	uint32_t now=multi->time_ms();
+	multi->active=0;
+	for(uint8_t i=0;i<multi->count;i++){
+		bms_multi_slot* slot=&multi->slots[i];
+		uint8_t admit=bms_device_admit(slot->dev, now);
+		if(admit!=BMS_ADMIT_POLL && admit!=BMS_ADMIT_PROBE){
+			slot->state=BMS_MULTI_SKIPPED;
+			slot->error=admit;
+			continue;
+		}
+		multi->active++;
+		slot->state=BMS_MULTI_WAIT;
+		slot->error=0;
+		slot->next=0;
+		slot->probe=(admit==BMS_ADMIT_PROBE) ? 1 : 0;
+		bms_parser_reset(&slot->parser);
+		bms_device_begin_update(slot->dev);
+		bms_multi_request_next(multi, slot);
+	}
+	return 0;
+}
+
+/**
+ * @brief Processes the bytes received on every port, sends the following requests and handles the timeouts.
+ * @param bms_multi* multi passes the pointer to the engine.
+ * @param uint32_t wait_ms passes the maximum time to wait for a port to become readable (Linux only, the MCU never waits).
+ * @retval uint8_t returns the number of packs still waiting for a response, 0 once the cycle is over.
+ */
+uint8_t bms_multi_step(bms_multi* multi, uint32_t wait_ms){
+#if defined(__linux__)
+	struct epoll_event events[BMS_MULTI_MAX_DEVICES];
+	uint32_t now=multi->time_ms();
+	for(uint8_t i=0;i<multi->count;i++){
+		if(multi->slots[i].state==BMS_MULTI_WAIT){
+			int32_t left=(int32_t)(multi->slots[i].deadline_ms-now);
+			if(left<0){
+				left=0;
+			}
+			wait_ms=((uint32_t)left<wait_ms) ? (uint32_t)left : wait_ms;
+		}
+	}
+	int n=epoll_wait(multi->epoll_fd, events, BMS_MULTI_MAX_DEVICES, (int)wait_ms);
+	for(int i=0;i<n;i++){
+		bms_multi_service(multi, &multi->slots[events[i].data.u32]);
+	}
+	for(uint8_t i=0;i<multi->count;i++){
+		bms_multi_slot* slot=&multi->slots[i];
+		if(slot->state==BMS_MULTI_WAIT && (slot->dev->transport->fd<0 || (int32_t)(multi->time_ms()-slot->deadline_ms)>=0)){
+			bms_multi_service(multi, slot);	// ports without fd are polled, and late ones get their timeout
+		}
+	}
+#else
+	(void)wait_ms;
+	for(uint8_t i=0;i<multi->count;i++){
+		if(multi->slots[i].state==BMS_MULTI_WAIT){
+			bms_multi_service(multi, &multi->slots[i]);
+		}
+	}
+#endif
+	return multi->active;
+}
+
+/**
+ * @brief Runs a complete refresh cycle of the rack.
+ * @param bms_multi* multi passes the pointer to the engine.
+ * @param uint16_t mask passes the selected data IDs, OR of BMS_DATA_ID_MASK(data_id) values.
+ * @retval uint8_t returns the number of packs not refreshed, failed or skipped for their health (see bms_multi_slot::error), all of them if the mask selects a disabled group.
+ * 	   Never takes longer than bms_multi_worst_case_ms().
+ */
+uint8_t bms_multi_run_cycle(bms_multi* multi, uint16_t mask){
+	if(bms_multi_start(multi, mask)!=0){
+		for(uint8_t i=0;i<multi->count;i++){
+			multi->slots[i].state=BMS_MULTI_FAILED;
+			multi->slots[i].error=BMS_ERR_DATA_ID_DISABLED;
+		}
+		return multi->count;
+	}
+	while(bms_multi_step(multi, BMS_MULTI_MAX_WAIT_MS)!=0){
+	}
+
+	uint8_t failed=0;
+	for(uint8_t i=0;i<multi->count;i++){
+		failed+=(multi->slots[i].state!=BMS_MULTI_DONE) ? 1 : 0;
+	}
+	return failed;
+}
+
+/**
+ * @brief Upper bound of the time of bms_multi_run_cycle(), the packs being read in parallel it is the bound of the slowest one.
+ * @param const bms_multi* multi passes the pointer to the engine.
+ * @param uint16_t mask passes the selected data IDs.
+ * @retval uint32_t returns the bound in milliseconds.
+ */
+uint32_t bms_multi_worst_case_ms(const bms_multi* multi, uint16_t mask){
+	uint32_t worst=0;
+	for(uint8_t i=0;i<multi->count;i++){
+		uint32_t t=bms_device_worst_case_ms(multi->slots[i].dev, mask, 1);
+		worst=(t>worst) ? t : worst;
+	}
+	return worst;
+}
+
+/**
+ * @brief Releases the resources of the engine (epoll instance on Linux), the ports stay open.
+ * @param bms_multi* multi passes the pointer to the engine.
+ * @retval void
+ */
+void bms_multi_close(bms_multi* multi){
+#if defined(__linux__)
+	if(multi->epoll_fd>=0){
+		close(multi->epoll_fd);
+		multi->epoll_fd=-1;
+	}
+#else
+	(void)multi;
+#endif
+}
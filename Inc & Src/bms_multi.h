@@ -0,0 +1,167 @@
+#ifndef BMS_MULTI_H
+#define BMS_MULTI_H
+
+#include "bms_stream.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @file bms_multi.h
+ * @brief Header file for the multi pack polling engine defined in bms_multi.c
+ * 	  A rack of packs, each on its own port, is read by keeping one request outstanding on every port at the same time, so that the rack refresh time is the one of the slowest pack
+ * 	  instead of the sum of all of them.
+ * @author Piyush
+ * @date 12/01/25
+ * @version 1.0
+ *
+ *
+ * @note Every pack is a bms_device (bms_uart_comm.h) whose transport provides receive_available(), the engine never blocks on a single port.
+ *	 On Linux the ports are waited on with epoll, on the MCU bms_multi_step() is a non-blocking state machine to be called from the main loop, the ports being bms_transport_stream_init()
+ *	 transports fed by their UART ISR/DMA.
+ *	 The requests are sent with the transmit_start() of the ports (DMA/IT on the MCU), so they go out on all the ports together. A transport without transmit_start falls back to its blocking
+ *	 transmit : the requests are then sent one pack after the other, each costing the wire time of a frame (13 bytes, about 13.5 ms at 9600 bps) before the next pack is served.
+ *	 This is the case of a bms_transport_stream_init() transport whose tx has no transmit_start, the Linux ports don't wait since write(2) returns once the frame is in the tty buffer.
+ *
+ *	 Example :
+ *		bms_multi_init(&rack, tick_ms);
+ *		for(i=0;i<packs;i++){ bms_multi_add(&rack, &pack[i]); }
+ *		bms_multi_run_cycle(&rack, BMS_MASK_ALL);			// blocking, or
+ *		bms_multi_start(&rack, BMS_MASK_ALL); while(bms_multi_step(&rack, 0)!=0){ ... }	// from a super loop
+ */
+
+
+// ====================================================================================================== MACROS ==========================================================================================================================
+
+#ifndef BMS_MULTI_MAX_DEVICES
+#define BMS_MULTI_MAX_DEVICES		0x20		/**< packs handled by one engine				*/
+#endif
+#define BMS_MULTI_MAX_IDS		0x09		/**< data IDs 0x90 to 0x98					*/
+#define BMS_MULTI_RX_CHUNK		64		/**< bytes taken from a port per receive_available() call	*/
+#define BMS_MULTI_MAX_WAIT_MS		1000		/**< epoll wait of bms_multi_run_cycle(), shortened to the nearest frame deadline	*/
+
+/**
+ * @brief macros for the per device states.
+ */
+#define BMS_MULTI_IDLE			0x00		/**< no cycle running						*/
+#define BMS_MULTI_WAIT			0x01		/**< request sent, waiting for its response frames		*/
+#define BMS_MULTI_DONE			0x02		/**< every selected data ID received				*/
+#define BMS_MULTI_FAILED		0x03		/**< cycle aborted, see bms_multi_slot::error, BMS_ERR_PREEMPTED when a posted command took the port	*/
+#define BMS_MULTI_SKIPPED		0x04		/**< not polled this cycle, error holds BMS_ERR_BACKOFF or BMS_ERR_OFFLINE	*/
+
+/**
+ * @brief error codes of bms_multi_init() and bms_multi_add().
+ */
+#define BMS_MULTI_ERR_FULL		0x01
+#define BMS_MULTI_ERR_TRANSPORT		0x02		/**< transport without receive_available()			*/
+#define BMS_MULTI_ERR_EPOLL		0x03
+
+
+//================================================================================ MULTI PACK STRUCTURES ========================================================================================================
+
+/**
+ * @brief structure holding the progress of one pack.
+ */
+typedef struct {
+	bms_device* dev;		/**< pack read by this slot							*/
+	bms_frame_parser parser;	/**< frame parser of the pack's port						*/
+	uint8_t state;			/**< one of BMS_MULTI_x states							*/
+	uint8_t error;			/**< bms_read() error code of the last failed cycle, 0 otherwise		*/
+	uint8_t next;			/**< index of the next data ID of bms_multi::ids to be requested		*/
+	uint8_t probe;			/**< 1 if this cycle only probes the offline pack with bms_multi::probe_id	*/
+	uint8_t data_id;		/**< data ID in flight								*/
+	uint8_t frames;			/**< frames of one response of data_id						*/
+	uint8_t arrived;		/**< frames of the current response received					*/
+	uint8_t retries;		/**< extra requests sent for data_id, at most policy.retries of the device		*/
+	uint8_t last_error;		/**< 2 checksum or 3 sequence, added to the error code base of data_id		*/
+	uint16_t missing;		/**< bit n set while frame n of data_id has not been stored			*/
+	uint16_t seen;			/**< bit n set once frame n of the current response arrived			*/
+	uint8_t first_pending;		/**< 1 until a byte of the current response arrived, for the instrumentation	*/
+	uint32_t deadline_ms;		/**< time at which the expected frame is late					*/
+	uint32_t sent_us;		/**< end of the request, tick of the device's instrumentation block		*/
+	uart_prot_packet request;	/**< request frame, kept here while the transmit_start of the port sends it	*/
+} bms_multi_slot;
+
+/**
+ * @brief structure of the multi pack engine.
+ */
+typedef struct {
+	bms_multi_slot slots[BMS_MULTI_MAX_DEVICES];
+	uint8_t count;			/**< number of used slots						*/
+	uint8_t active;			/**< slots in BMS_MULTI_WAIT						*/
+	uint8_t ids[BMS_MULTI_MAX_IDS];	/**< data IDs of the running cycle, in request order			*/
+	uint8_t id_count;		/**< number of data IDs of the running cycle				*/
+	uint8_t probe_id;		/**< data ID requested from the offline packs				*/
+	uint32_t (*time_ms)(void);	/**< millisecond tick used for the timeouts				*/
+#if defined(__linux__)
+	int epoll_fd;			/**< epoll instance waiting on all the ports				*/
+#endif
+} bms_multi;
+
+
+//======================================================================================== ROUTINE DECLARATION ===================================================================================================
+
+/**
+ * @brief Initializes an empty engine.
+ * @param bms_multi* multi passes the pointer to the engine.
+ * @param uint32_t (*time_ms)(void) passes the millisecond tick, HAL_GetTick on the MCU.
+ * @retval uint8_t returns 0 on success and BMS_MULTI_ERR_EPOLL if the epoll instance can't be created.
+ */
+uint8_t bms_multi_init(bms_multi* multi, uint32_t (*time_ms)(void));
+
+/**
+ * @brief Adds a pack to the engine.
+ * @param bms_multi* multi passes the pointer to the engine.
+ * @param bms_device* dev passes the initialized device, its transport must provide receive_available().
+ * @retval uint8_t returns 0 on success and one of the BMS_MULTI_ERR_x codes on failure.
+ */
+uint8_t bms_multi_add(bms_multi* multi, bms_device* dev);
+
+/**
+ * @brief Starts a refresh cycle, sends the first request to every pack admitted by its health (bms_device_admit()), offline packs whose probe is due get the probe request only.
+ * @param bms_multi* multi passes the pointer to the engine.
+ * @param uint16_t mask passes the selected data IDs, OR of BMS_DATA_ID_MASK(data_id) values, BMS_MASK_ALL selects every enabled group.
+ * @retval uint8_t returns 0 on success and BMS_ERR_DATA_ID_DISABLED if the mask selects a disabled group.
+ */
+uint8_t bms_multi_start(bms_multi* multi, uint16_t mask);
+
+/**
+ * @brief Processes the bytes received on every port, sends the following requests and handles the timeouts.
+ * @param bms_multi* multi passes the pointer to the engine.
+ * @param uint32_t wait_ms passes the maximum time to wait for a port to become readable (Linux only, the MCU never waits).
+ * @retval uint8_t returns the number of packs still waiting for a response, 0 once the cycle is over.
+ */
+uint8_t bms_multi_step(bms_multi* multi, uint32_t wait_ms);
+
+/**
+ * @brief Runs a complete refresh cycle of the rack.
+ * @param bms_multi* multi passes the pointer to the engine.
+ * @param uint16_t mask passes the selected data IDs, OR of BMS_DATA_ID_MASK(data_id) values.
+ * @retval uint8_t returns the number of packs not refreshed, failed or skipped for their health (see bms_multi_slot::error), all of them if the mask selects a disabled group.
+ * 	   Never takes longer than bms_multi_worst_case_ms().
+ */
+uint8_t bms_multi_run_cycle(bms_multi* multi, uint16_t mask);
+
+/**
+ * @brief Upper bound of the time of bms_multi_run_cycle(), the packs being read in parallel it is the bound of the slowest one.
+ * @param const bms_multi* multi passes the pointer to the engine.
+ * @param uint16_t mask passes the selected data IDs.
+ * @retval uint32_t returns the bound in milliseconds.
+ */
+uint32_t bms_multi_worst_case_ms(const bms_multi* multi, uint16_t mask);
+
+/**
+ * @brief Releases the resources of the engine (epoll instance on Linux), the ports stay open.
+ * @param bms_multi* multi passes the pointer to the engine.
+ * @retval void
+ */
+void bms_multi_close(bms_multi* multi);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /**< BMS_MULTI_H  */
@@ -0,0 +1,278 @@
+#include "bms_scheduler.h"
+#include <string.h>
+
+/**
+ * @file bms_scheduler.c
+ * @brief Source code file for the per data ID polling scheduler declared in bms_scheduler.h
+ * @author Piyush
+ * @date 12/01/25
+ * @version 1.0
+ */
+
+
+//==================================================================================== PRIVATE ROUTINES =========================================================================================
+
+/**
+ * @brief Returns 1 if entry a must be served before entry b under the given policy.
+ * @param const bms_sched_entry* a passes the first candidate.
+ * @param uint64_t deadline_a passes the deadline of the first candidate.
+ * @param const bms_sched_entry* b passes the second candidate.
+ * @param uint64_t deadline_b passes the deadline of the second candidate.
+ * @param uint8_t policy passes one of the BMS_SCHED_POLICY_x values.
+ * @retval uint8_t returns 1 if a goes first and 0 otherwise.
+ */
+static uint8_t bms_sched_before(const bms_sched_entry* a, uint64_t deadline_a, const bms_sched_entry* b, uint64_t deadline_b, uint8_t policy){
+	if(policy==BMS_SCHED_POLICY_PRIORITY && a->priority!=b->priority){
+		return (a->priority>b->priority) ? 1 : 0;
+	}
+	if(deadline_a!=deadline_b){
+		return (deadline_a<deadline_b) ? 1 : 0;
+	}
+	return (a->priority>b->priority) ? 1 : 0;
+}
+
+/**
+ * @brief Greatest common divisor, used for the hyperperiod.
+ */
+static uint64_t bms_sched_gcd(uint64_t a, uint64_t b){
+	while(b!=0){
+		uint64_t t=a%b;
+		a=b;
+		b=t;
+	}
+	return a;
+}
+
+/**
+ * @brief Least common multiple of all the periods, capped at BMS_SCHED_MAX_HYPERPERIOD_MS.
+ * @param const bms_scheduler* sched passes the pointer to the scheduler.
+ * @retval uint32_t returns the window in milliseconds.
+ */
+static uint32_t bms_sched_hyperperiod(const bms_scheduler* sched){
+	uint64_t lcm=1;
+	for(uint8_t i=0;i<sched->count;i++){
+		lcm=lcm/bms_sched_gcd(lcm, sched->entries[i].period_ms)*sched->entries[i].period_ms;
+		if(lcm>BMS_SCHED_MAX_HYPERPERIOD_MS){
+			return BMS_SCHED_MAX_HYPERPERIOD_MS;
+		}
+	}
+	return (uint32_t)lcm;
+}
+
+/**
+ * @brief Simulates the non-preemptive bus over a window, all data IDs released at time 0.
+ * @param const bms_scheduler* sched passes the pointer to the scheduler.
+ * @param uint8_t policy passes one of the BMS_SCHED_POLICY_x values.
+ * @param uint32_t window_ms passes the simulated time.
+ * @param bms_sched_report* report passes the report to be filled, can be NULL.
+ * @param bms_sched_slot* slots passes the memory for the command sequence, can be NULL.
+ * @param uint16_t max_slots passes the number of slots available.
+ * @retval uint16_t returns the number of slots written.
+ */
+static uint16_t bms_sched_simulate(const bms_scheduler* sched, uint8_t policy, uint32_t window_ms, bms_sched_report* report, bms_sched_slot* slots, uint16_t max_slots){
+	uint64_t release[BMS_SCHED_MAX_ENTRIES];
+	uint64_t window_us=(uint64_t)window_ms*1000U;
+	uint64_t t=0;
+	uint16_t n_slots=0;
+
+	for(uint8_t i=0;i<sched->count;i++){
+		release[i]=0;
+	}
+
+	while(t<window_us){
+		int8_t pick=-1;
+		uint64_t next_release=UINT64_MAX;
+		for(uint8_t i=0;i<sched->count;i++){
+			if(release[i]>t){
+				next_release=(release[i]<next_release) ? release[i] : next_release;
+				continue;
+			}
+			uint64_t deadline=release[i]+(uint64_t)sched->entries[i].period_ms*1000U;
+			if(pick<0 || bms_sched_before(&sched->entries[i], deadline, &sched->entries[pick], release[pick]+(uint64_t)sched->entries[pick].period_ms*1000U, policy)){
+				pick=(int8_t)i;
+			}
+		}
+		if(pick<0){
+			t=next_release;
+			continue;
+		}
+
+		const bms_sched_entry* e=&sched->entries[pick];
+		uint64_t period_us=(uint64_t)e->period_ms*1000U;
+		uint64_t end=t+e->cost_us;
+		if(slots!=NULL && n_slots<max_slots){
+			slots[n_slots].start_us=(uint32_t)t;
+			slots[n_slots].data_id=e->data_id;
+			n_slots++;
+		}
+		if(report!=NULL){
+			report->polls++;
+			if(end-release[pick]>report->worst_response_us[pick]){
+				report->worst_response_us[pick]=(uint32_t)(end-release[pick]);
+			}
+			if(end>release[pick]+period_us){
+				report->deadline_misses++;
+			}
+		}
+		release[pick]+=period_us;
+		while(release[pick]+period_us<=t){
+			release[pick]+=period_us;	// releases that passed while the data ID was waiting are lost
+			if(report!=NULL){
+				report->deadline_misses++;
+			}
+		}
+		t=end;
+	}
+	return n_slots;
+}
+
+
+//==================================================================================== ROUTINE DEFINITIONS ======================================================================================
+
+
+/**
+ * @brief Initializes an empty scheduler.
+ * @param bms_scheduler* sched passes the pointer to the scheduler.
+ * @param const bms_device* dev passes the polled BMS, it must outlive the scheduler.
+ * @param uint32_t baudrate passes the line speed in bps.
+ * @param uint32_t turnaround_us passes the BMS turnaround time.
+ * @retval void
+ */
+void bms_sched_init(bms_scheduler* sched, const bms_device* dev, uint32_t baudrate, uint32_t turnaround_us){
+	memset(sched, 0x00, sizeof(bms_scheduler));
+	sched->dev=dev;
+	sched->baudrate=baudrate;
+	sched->turnaround_us=turnaround_us;
+	sched->policy=BMS_SCHED_POLICY_EDF;
+}
+
+/**
+ * @brief Adds or updates the period and priority of a data ID.
+ * @param bms_scheduler* sched passes the pointer to the scheduler.
+ * @param uint8_t data_id passes a data ID enabled by the access macros (bms_enabled_mask()), BMS_SCHED_ERR_DATA_ID otherwise.
+ * @param uint32_t period_ms passes the refresh period, must not be 0.
+ * @param uint8_t priority passes the priority, higher value is more important.
+ * @retval uint8_t returns 0 on success and one of the BMS_SCHED_ERR_x codes on failure.
+ */
+uint8_t bms_sched_add(bms_scheduler* sched, uint8_t data_id, uint32_t period_ms, uint8_t priority){
+	if(data_id<SOC_TOTAL_IV || data_id>BATTERY_FAILURE_STATUS || (bms_enabled_mask() & BMS_DATA_ID_MASK(data_id))==0){	// a disabled group is never requested, its cost would be made up
+		return BMS_SCHED_ERR_DATA_ID;
+	}
+	if(period_ms==0){
+		return BMS_SCHED_ERR_PERIOD;
+	}
+
+	uint8_t i=0;
+	while(i<sched->count && sched->entries[i].data_id!=data_id){
+		i++;
+	}
+	if(i==BMS_SCHED_MAX_ENTRIES){
+		return BMS_SCHED_ERR_FULL;
+	}
+	if(i==sched->count){
+		sched->count++;
+	}
+
+	bms_transport line={ .baudrate=sched->baudrate };
+	bms_sched_entry* e=&sched->entries[i];
+	e->data_id=data_id;
+	e->priority=priority;
+	e->period_ms=period_ms;
+	e->cost_us=bms_transport_wire_time_us(&line, (uint32_t)sizeof(uart_prot_packet)*(1+bms_device_frames(sched->dev, data_id)))+sched->turnaround_us;
+	e->next_due_ms=0;
+	return 0;
+}
+
+/**
+ * @brief Checks whether the schedule fits the bus by simulating one hyperperiod, and selects the policy accordingly.
+ * @param bms_scheduler* sched passes the pointer to the scheduler.
+ * @param bms_sched_report* report passes the memory where the report will be stored, can be NULL.
+ * @retval uint8_t returns 1 if the schedule fits and 0 otherwise.
+ */
+uint8_t bms_sched_check(bms_scheduler* sched, bms_sched_report* report){
+	bms_sched_report local;
+	if(report==NULL){
+		report=&local;
+	}
+	memset(report, 0x00, sizeof(bms_sched_report));
+
+	uint64_t util_ppm=0;
+	for(uint8_t i=0;i<sched->count;i++){
+		util_ppm+=((uint64_t)sched->entries[i].cost_us*1000U)/sched->entries[i].period_ms;
+	}
+	report->utilization_permille=(util_ppm/1000U>0xFFFF) ? 0xFFFF : (uint16_t)(util_ppm/1000U);
+	report->hyperperiod_ms=bms_sched_hyperperiod(sched);
+
+	bms_sched_simulate(sched, BMS_SCHED_POLICY_EDF, report->hyperperiod_ms, report, NULL, 0);
+	report->fits=(report->deadline_misses==0 && util_ppm<=1000000U) ? 1 : 0;
+	sched->policy=(report->fits) ? BMS_SCHED_POLICY_EDF : BMS_SCHED_POLICY_PRIORITY;
+	return report->fits;
+}
+
+/**
+ * @brief Builds the interleaved command sequence of one hyperperiod, for cyclic executives or for inspection.
+ * @param const bms_scheduler* sched passes the pointer to the scheduler.
+ * @param bms_sched_slot* slots passes the memory for the sequence.
+ * @param uint16_t max_slots passes the number of slots available.
+ * @retval uint16_t returns the number of slots written, the sequence is truncated at max_slots.
+ */
+uint16_t bms_sched_build_sequence(const bms_scheduler* sched, bms_sched_slot* slots, uint16_t max_slots){
+	return bms_sched_simulate(sched, sched->policy, bms_sched_hyperperiod(sched), NULL, slots, max_slots);
+}
+
+/**
+ * @brief Selects the data ID to be polled now and advances its release time.
+ * @param bms_scheduler* sched passes the pointer to the scheduler.
+ * @param uint32_t now_ms passes the current millisecond tick.
+ * @param uint32_t* wait_ms passes the memory where the time until the next release is stored when nothing is due, can be NULL.
+ * @retval uint8_t returns the data ID, BMS_RESET when nothing is due.
+ */
+uint8_t bms_sched_next(bms_scheduler* sched, uint32_t now_ms, uint32_t* wait_ms){
+	int8_t pick=-1;
+	uint32_t wait=UINT32_MAX;
+
+	for(uint8_t i=0;i<sched->count;i++){
+		bms_sched_entry* e=&sched->entries[i];
+		int32_t lateness=(int32_t)(now_ms-e->next_due_ms);
+		if(lateness<0){
+			wait=((uint32_t)(-lateness)<wait) ? (uint32_t)(-lateness) : wait;
+			continue;
+		}
+		if(pick<0 || bms_sched_before(e, (uint64_t)e->next_due_ms+e->period_ms, &sched->entries[pick], (uint64_t)sched->entries[pick].next_due_ms+sched->entries[pick].period_ms, sched->policy)){
+			pick=(int8_t)i;
+		}
+	}
+
+	if(pick<0){
+		if(wait_ms!=NULL){
+			*wait_ms=wait;
+		}
+		return BMS_RESET;
+	}
+
+	bms_sched_entry* e=&sched->entries[pick];
+	e->next_due_ms+=e->period_ms;
+	if((int32_t)(now_ms-e->next_due_ms)>=0){
+		e->next_due_ms=now_ms+e->period_ms;	// fell behind by more than one period, restart the phase instead of bursting
+	}
+	if(wait_ms!=NULL){
+		*wait_ms=0;
+	}
+	return e->data_id;
+}
+
+/**
+ * @brief Polls the next due data ID, to be called from the polling task loop.
+ * @param bms_scheduler* sched passes the pointer to the scheduler.
+ * @param RT_Battery_status* stat passes the address of the battery status structure.
+ * @param uint32_t now_ms passes the current millisecond tick.
+ * @param uint32_t* wait_ms passes the memory where the time until the next release is stored when nothing is due, can be NULL.
+ * @retval uint8_t returns 0 when a data ID was read or nothing was due, and the bms_read_data_id() error code otherwise.
+ */
+uint8_t bms_sched_poll(bms_scheduler* sched, RT_Battery_status* stat, uint32_t now_ms, uint32_t* wait_ms){
+	uint8_t data_id=bms_sched_next(sched, now_ms, wait_ms);
+	if(data_id==BMS_RESET){
+		return 0;
+	}
+	return bms_read_data_id(stat, data_id);
+}
@@ -0,0 +1,165 @@
+#ifndef BMS_SCHEDULER_H
+#define BMS_SCHEDULER_H
+
+#include "bms_uart_comm.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @file bms_scheduler.h
+ * @brief Header file for the per data ID polling scheduler defined in bms_scheduler.c
+ * 	  Every data ID gets its own refresh period and priority at runtime, the scheduler checks whether the requested rates fit the bus at the configured baud rate,
+ * 	  builds the interleaved command sequence of one hyperperiod and hands out the next data ID to be polled.
+ * @author Piyush
+ * @date 12/01/25
+ * @version 1.0
+ *
+ *
+ * @note The bus is a single non-preemptive resource, a transaction occupies it for the request frame, the BMS turnaround and all the response frames.
+ *	 When the schedule fits, data IDs are served earliest deadline first (optimal for the fitting case), priorities only break ties.
+ *	 When it does not fit, data IDs are served by priority so that the overload falls on the least important groups instead of on all of them.
+ *
+ *	 Example : SOC/current at 10 Hz and failure status at 5 Hz, cell voltages and temperatures at 1 Hz, status info once a minute.
+ *		bms_sched_init(&sched, &pack, UART_DEFAULT_BAUDRATE, BMS_SCHED_DEFAULT_TURNAROUND_US);
+ *		bms_sched_add(&sched, SOC_TOTAL_IV, 100, 3);
+ *		bms_sched_add(&sched, BATTERY_FAILURE_STATUS, 200, 3);
+ *		bms_sched_add(&sched, CELL_VOLTAGE, 1000, 2);
+ *		bms_sched_add(&sched, CELL_TEMPERATURE, 1000, 2);
+ *		bms_sched_add(&sched, STATUS_INFO_1, 60000, 0);
+ *		bms_sched_check(&sched, &report);
+ */
+
+
+// ====================================================================================================== MACROS ==========================================================================================================================
+
+#define BMS_SCHED_MAX_ENTRIES			0x09		/**< one entry per data ID 0x90 to 0x98						*/
+#define BMS_SCHED_DEFAULT_TURNAROUND_US		2000		/**< time the BMS needs between the end of the request and its first response byte	*/
+#define BMS_SCHED_MAX_HYPERPERIOD_MS		600000		/**< the fit check simulates at most 10 minutes of bus time				*/
+
+/**
+ * @brief macros for the selection policy.
+ */
+#define BMS_SCHED_POLICY_EDF			0x00		/**< earliest deadline first, priority breaks ties	*/
+#define BMS_SCHED_POLICY_PRIORITY		0x01		/**< highest priority first, deadline breaks ties	*/
+
+/**
+ * @brief error codes of bms_sched_add().
+ */
+#define BMS_SCHED_ERR_FULL			0x01
+#define BMS_SCHED_ERR_DATA_ID			0x02
+#define BMS_SCHED_ERR_PERIOD			0x03
+
+
+//================================================================================ SCHEDULER STRUCTURES =========================================================================================================
+
+/**
+ * @brief structure of one scheduled data ID.
+ */
+typedef struct {
+	uint8_t data_id;		/**< polled data ID						*/
+	uint8_t priority;		/**< higher value is more important				*/
+	uint32_t period_ms;		/**< requested refresh period					*/
+	uint32_t cost_us;		/**< bus time of one transaction				*/
+	uint32_t next_due_ms;		/**< release time of the next poll				*/
+} bms_sched_entry;
+
+/**
+ * @brief structure of the scheduler.
+ */
+typedef struct {
+	bms_sched_entry entries[BMS_SCHED_MAX_ENTRIES];
+	uint8_t count;			/**< number of used entries					*/
+	const bms_device* dev;		/**< polled BMS, its strings/sensors counts give the response frames	*/
+	uint8_t policy;			/**< one of BMS_SCHED_POLICY_x, set by bms_sched_check()	*/
+	uint32_t baudrate;		/**< line speed used for the transaction costs			*/
+	uint32_t turnaround_us;		/**< BMS turnaround added to every transaction			*/
+} bms_scheduler;
+
+/**
+ * @brief structure of one command of the built sequence.
+ */
+typedef struct {
+	uint32_t start_us;		/**< offset of the request from the start of the hyperperiod	*/
+	uint8_t data_id;		/**< data ID to be requested					*/
+} bms_sched_slot;
+
+/**
+ * @brief structure of the fit report.
+ */
+typedef struct {
+	uint16_t utilization_permille;	/**< bus time requested per bus time available			*/
+	uint32_t hyperperiod_ms;	/**< length of the simulated window				*/
+	uint32_t polls;			/**< transactions in the window					*/
+	uint32_t deadline_misses;	/**< polls finishing after the next release of their data ID	*/
+	uint32_t worst_response_us[BMS_SCHED_MAX_ENTRIES];	/**< release to end of transaction, per entry	*/
+	uint8_t fits;			/**< 1 if the schedule holds at the configured baud rate	*/
+} bms_sched_report;
+
+
+//======================================================================================== ROUTINE DECLARATION ===================================================================================================
+
+/**
+ * @brief Initializes an empty scheduler.
+ * @param bms_scheduler* sched passes the pointer to the scheduler.
+ * @param const bms_device* dev passes the polled BMS, it must outlive the scheduler.
+ * @param uint32_t baudrate passes the line speed in bps.
+ * @param uint32_t turnaround_us passes the BMS turnaround time.
+ * @retval void
+ */
+void bms_sched_init(bms_scheduler* sched, const bms_device* dev, uint32_t baudrate, uint32_t turnaround_us);
+
+/**
+ * @brief Adds or updates the period and priority of a data ID.
+ * @param bms_scheduler* sched passes the pointer to the scheduler.
+ * @param uint8_t data_id passes a data ID enabled by the access macros (bms_enabled_mask()), BMS_SCHED_ERR_DATA_ID otherwise.
+ * @param uint32_t period_ms passes the refresh period, must not be 0.
+ * @param uint8_t priority passes the priority, higher value is more important.
+ * @retval uint8_t returns 0 on success and one of the BMS_SCHED_ERR_x codes on failure.
+ */
+uint8_t bms_sched_add(bms_scheduler* sched, uint8_t data_id, uint32_t period_ms, uint8_t priority);
+
+/**
+ * @brief Checks whether the schedule fits the bus by simulating one hyperperiod, and selects the policy accordingly.
+ * @param bms_scheduler* sched passes the pointer to the scheduler.
+ * @param bms_sched_report* report passes the memory where the report will be stored, can be NULL.
+ * @retval uint8_t returns 1 if the schedule fits and 0 otherwise.
+ */
+uint8_t bms_sched_check(bms_scheduler* sched, bms_sched_report* report);
+
+/**
+ * @brief Builds the interleaved command sequence of one hyperperiod, for cyclic executives or for inspection.
+ * @param const bms_scheduler* sched passes the pointer to the scheduler.
+ * @param bms_sched_slot* slots passes the memory for the sequence.
+ * @param uint16_t max_slots passes the number of slots available.
+ * @retval uint16_t returns the number of slots written, the sequence is truncated at max_slots.
+ */
+uint16_t bms_sched_build_sequence(const bms_scheduler* sched, bms_sched_slot* slots, uint16_t max_slots);
+
+/**
+ * @brief Selects the data ID to be polled now and advances its release time.
+ * @param bms_scheduler* sched passes the pointer to the scheduler.
+ * @param uint32_t now_ms passes the current millisecond tick.
+ * @param uint32_t* wait_ms passes the memory where the time until the next release is stored when nothing is due, can be NULL.
+ * @retval uint8_t returns the data ID, BMS_RESET when nothing is due.
+ */
+uint8_t bms_sched_next(bms_scheduler* sched, uint32_t now_ms, uint32_t* wait_ms);
+
+/**
+ * @brief Polls the next due data ID, to be called from the polling task loop.
+ * @param bms_scheduler* sched passes the pointer to the scheduler.
+ * @param RT_Battery_status* stat passes the address of the battery status structure.
+ * @param uint32_t now_ms passes the current millisecond tick.
+ * @param uint32_t* wait_ms passes the memory where the time until the next release is stored when nothing is due, can be NULL.
+ * @retval uint8_t returns 0 when a data ID was read or nothing was due, and the bms_read_data_id() error code otherwise.
+ */
+uint8_t bms_sched_poll(bms_scheduler* sched, RT_Battery_status* stat, uint32_t now_ms, uint32_t* wait_ms);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /**< BMS_SCHEDULER_H  */
@@ -0,0 +1,185 @@
+#include "bms_stats.h"
+#include "bms_uart_comm.h"
+#include <string.h>
+
+/**
+ * @file bms_stats.c
+ * @brief Source code file for the driver instrumentation declared in bms_stats.h
+ * @author Piyush
+ * @date 12/01/25
+ * @version 1.0
+ */
+
+
+//==================================================================================== PRIVATE ROUTINES =========================================================================================
+
+/**
+ * @brief Histogram bucket of a latency, the position of its highest bit above BMS_STATS_MIN_LOG2.
+ */
+static uint8_t bms_stats_bucket(uint32_t us){
+	if(us<(1UL<<BMS_STATS_MIN_LOG2)){
+		return 0;
+	}
+	uint8_t bucket=(uint8_t)(31-__builtin_clz(us)-BMS_STATS_MIN_LOG2+1);
+	return (bucket<BMS_STATS_BUCKETS) ? bucket : BMS_STATS_BUCKETS-1;
+}
+
+
+//==================================================================================== ROUTINE DEFINITIONS ======================================================================================
+
+
+/**
+ * @brief Zeroes an instrumentation block.
+ * @param bms_stats* stats passes the block.
+ * @param uint32_t (*time_us)(void) passes the microsecond tick, NULL if the target has none.
+ * @retval void
+ */
+void bms_stats_init(bms_stats* stats, uint32_t (*time_us)(void)){
+	memset(stats, 0x00, sizeof(bms_stats));
+	stats->time_us=time_us;
+}
+
+/**
+ * @brief Zeroes the counters and histograms of a block, the tick is kept.
+ * @param bms_stats* stats passes the block.
+ * @retval void
+ */
+void bms_stats_reset(bms_stats* stats){
+	bms_stats_init(stats, stats->time_us);
+}
+
+/**
+ * @brief Current tick of a block.
+ * @param const bms_stats* stats passes the block, can be NULL.
+ * @retval uint32_t returns the microsecond tick, 0 without block or tick.
+ */
+uint32_t bms_stats_now(const bms_stats* stats){
+	return (stats!=NULL && stats->time_us!=NULL) ? stats->time_us() : 0;
+}
+
+/**
+ * @brief Counters of a data ID.
+ * @param bms_stats* stats passes the block, can be NULL.
+ * @param uint8_t data_id passes the data ID.
+ * @retval bms_id_stats* returns the counters, NULL without block or for a data ID outside 0x90 to 0x98.
+ */
+bms_id_stats* bms_stats_id(bms_stats* stats, uint8_t data_id){
+	if(stats==NULL || data_id<BMS_STATS_FIRST_ID || data_id>=BMS_STATS_FIRST_ID+BMS_STATS_IDS){
+		return NULL;
+	}
+	return &stats->ids[data_id-BMS_STATS_FIRST_ID];
+}
+
+/**
+ * @brief Counts a latency in a histogram.
+ * @param bms_id_stats* id passes the counters of the data ID, can be NULL.
+ * @param uint8_t hist passes one of BMS_STATS_TX, BMS_STATS_FIRST_BYTE or BMS_STATS_RESPONSE.
+ * @param uint32_t us passes the latency.
+ * @retval void
+ */
+void bms_stats_latency(bms_id_stats* id, uint8_t hist, uint32_t us){
+	if(id==NULL){
+		return;
+	}
+	id->hist[hist][bms_stats_bucket(us)]++;
+	if(hist==BMS_STATS_RESPONSE){
+		id->response_total_us+=us;
+		id->response_max_us=(us>id->response_max_us) ? us : id->response_max_us;
+	}
+}
+
+/**
+ * @brief Ends a read of a device.
+ * @param bms_stats* stats passes the block, can be NULL.
+ * @param uint8_t error passes the bms_read() error code, 0 on success.
+ * @param uint8_t data_id passes the data ID whose error code it is, 0 for the errors of no data ID.
+ * @retval void
+ */
+void bms_stats_read_done(bms_stats* stats, uint8_t error, uint8_t data_id){
+	if(stats==NULL){
+		return;
+	}
+	stats->reads++;
+	if(error==0){
+		return;
+	}
+	if(error==BMS_ERR_PREEMPTED){
+		stats->preempted++;	// not a failure, the command ran and the next read starts over
+		return;
+	}
+	stats->failed_reads++;
+	stats->last_error=error;
+	bms_id_stats* id=bms_stats_id(stats, data_id);
+	if(id!=NULL){
+		id->failures++;
+	}
+}
+
+/**
+ * @brief Sums the counters and histograms of the data IDs selected by a mask, the device totals with BMS_MASK_ALL.
+ * @param const bms_stats* stats passes the block.
+ * @param uint16_t mask passes the data IDs, OR of BMS_DATA_ID_MASK(data_id) values.
+ * @param bms_id_stats* total passes the memory where the sums are stored.
+ * @retval void
+ */
+void bms_stats_sum(const bms_stats* stats, uint16_t mask, bms_id_stats* total){
+	memset(total, 0x00, sizeof(bms_id_stats));
+	for(uint8_t i=0;i<BMS_STATS_IDS;i++){
+		const bms_id_stats* id=&stats->ids[i];
+		if(!(mask & BMS_DATA_ID_MASK(BMS_STATS_FIRST_ID+i))){
+			continue;
+		}
+		total->requests+=id->requests;
+		total->retries+=id->retries;
+		total->responses+=id->responses;
+		total->frames+=id->frames;
+		total->checksum_errors+=id->checksum_errors;
+		total->sequence_errors+=id->sequence_errors;
+		total->timeouts+=id->timeouts;
+		total->failures+=id->failures;
+		total->tx_bytes+=id->tx_bytes;
+		total->rx_bytes+=id->rx_bytes;
+		total->response_total_us+=id->response_total_us;
+		total->response_max_us=(id->response_max_us>total->response_max_us) ? id->response_max_us : total->response_max_us;
+		for(uint8_t h=0;h<BMS_STATS_HISTOGRAMS;h++){
+			for(uint8_t b=0;b<BMS_STATS_BUCKETS;b++){
+				total->hist[h][b]+=id->hist[h][b];
+			}
+		}
+	}
+}
+
+/**
+ * @brief Latency below which a share of the samples of a histogram lies, with the resolution of the buckets.
+ * @param const bms_id_stats* id passes the counters.
+ * @param uint8_t hist passes one of BMS_STATS_TX, BMS_STATS_FIRST_BYTE or BMS_STATS_RESPONSE.
+ * @param uint16_t permille passes the share, 500 for the median, 990 for p99.
+ * @retval uint32_t returns the upper bound of the bucket holding the share in microseconds, UINT32_MAX if it falls in the last bucket, 0 for an empty histogram.
+ */
+uint32_t bms_stats_percentile_us(const bms_id_stats* id, uint8_t hist, uint16_t permille){
+	uint64_t count=0;
+	for(uint8_t b=0;b<BMS_STATS_BUCKETS;b++){
+		count+=id->hist[hist][b];
+	}
+	if(count==0){
+		return 0;
+	}
+	uint64_t rank=(count*permille+999)/1000;
+	uint64_t seen=0;
+	for(uint8_t b=0;b<BMS_STATS_BUCKETS-1;b++){
+		seen+=id->hist[hist][b];
+		if(seen>=rank && seen!=0){
+			return bms_stats_bucket_us(b+1);
+		}
+	}
+	return UINT32_MAX;
+}
+
+/**
+ * @brief Lower bound of a histogram bucket.
+ * @param uint8_t bucket passes the bucket.
+ * @retval uint32_t returns the bound in microseconds.
+ */
+uint32_t bms_stats_bucket_us(uint8_t bucket){
+	return (bucket==0) ? 0 : (uint32_t)1UL<<(BMS_STATS_MIN_LOG2+bucket-1);
+}
@@ -0,0 +1,169 @@
+#ifndef BMS_STATS_H
+#define BMS_STATS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @file bms_stats.h
+ * @brief Header file for the driver instrumentation defined in bms_stats.c
+ * 	  A bms_stats block attached to a device (bms_device_attach_stats()) counts, per data ID, the requests, retries, timeouts, checksum and sequence failures and the bytes on the wire,
+ * 	  and keeps log2 histograms of the transmit, first byte and full response latencies, so that the packs and data IDs eating the bus budget show up without a logic analyser.
+ * @author Piyush
+ * @date 12/01/25
+ * @version 1.0
+ *
+ *
+ * @note Recording is a few increments per frame and nothing at all for a device without stats, the block can stay attached in production.
+ *	 Only the polling context writes the block, the counters are 32 bit words that other tasks read one by one without lock : a query running during a read may see the
+ *	 counters of a frame partly updated, never a torn counter. The exception is bms_id_stats::response_total_us, 64 bit so that it does not wrap after about 71 minutes
+ *	 of responses : on a 32 bit MCU it is written in two words and a reader may see the low word carried and not yet the high one, so a mean taken from another task can be
+ *	 off for one read. Take it from the polling context, or read it twice and keep the value when both reads agree.
+ *	 The latencies need a microsecond tick (bms_stats_init()), DWT->CYCCNT/(SystemCoreClock/1000000) or a free running timer on the MCU, without it only the counters are kept.
+ */
+
+
+// ====================================================================================================== MACROS ==========================================================================================================================
+
+#define BMS_STATS_FIRST_ID		0x90		/**< SOC_TOTAL_IV, data ID of ids[0]			*/
+#define BMS_STATS_IDS			0x09		/**< data IDs 0x90 to 0x98				*/
+
+/**
+ * @brief macros for the latency histograms, bucket 0 counts the latencies below 2^BMS_STATS_MIN_LOG2 us, bucket b the ones in [2^(BMS_STATS_MIN_LOG2+b-1), 2^(BMS_STATS_MIN_LOG2+b)) us
+ * 	  and the last bucket everything above, 128 us to 2.1 s with the defaults.
+ */
+#ifndef BMS_STATS_BUCKETS
+#define BMS_STATS_BUCKETS		16
+#endif
+#define BMS_STATS_MIN_LOG2		7
+
+/**
+ * @brief macros selecting a histogram of bms_id_stats.
+ */
+#define BMS_STATS_TX			0x00		/**< transmit call of the request					*/
+#define BMS_STATS_FIRST_BYTE		0x01		/**< end of the request to the first byte of its response, taken one frame wire time before the end of the first frame	*/
+#define BMS_STATS_RESPONSE		0x02		/**< end of the request to the last frame of its response		*/
+#define BMS_STATS_HISTOGRAMS		0x03
+
+
+//================================================================================ STATISTICS STRUCTURES ========================================================================================================
+
+/**
+ * @brief structure of the counters of one data ID.
+ */
+typedef struct {
+	uint32_t requests;		/**< requests sent, retries included						*/
+	uint32_t retries;		/**< requests sent again for an incomplete response				*/
+	uint32_t responses;		/**< responses received to their last frame					*/
+	uint32_t frames;		/**< valid frames received, repeated ones included				*/
+	uint32_t checksum_errors;	/**< frames failing the checksum						*/
+	uint32_t sequence_errors;	/**< frame numbers out of range or repeated within a response			*/
+	uint32_t timeouts;		/**< receive deadlines missed							*/
+	uint32_t failures;		/**< reads ended with the error code of this data ID				*/
+	uint32_t tx_bytes;		/**< bytes sent									*/
+	uint32_t rx_bytes;		/**< bytes received, garbage included when the engine sees it			*/
+	uint32_t response_max_us;	/**< longest full response							*/
+	uint64_t response_total_us;	/**< sum of the full responses, for the mean, may be read torn on a 32 bit MCU (see the note above)	*/
+	uint32_t hist[BMS_STATS_HISTOGRAMS][BMS_STATS_BUCKETS];	/**< latency histograms, indexed by BMS_STATS_x		*/
+} bms_id_stats;
+
+/**
+ * @brief structure of the instrumentation block of one device.
+ */
+typedef struct {
+	uint32_t (*time_us)(void);	/**< microsecond tick, NULL keeps the counters only				*/
+	uint32_t reads;			/**< reads started (bms_device_read_mask() calls and bms_multi cycles)		*/
+	uint32_t failed_reads;		/**< reads ended with an error code						*/
+	uint32_t unexpected_ids;	/**< valid frames matching no request in flight, dropped (stale responses) and charged to the oldest request	*/
+	uint32_t preempted;		/**< reads cut by a command (BMS_ERR_PREEMPTED)					*/
+	uint8_t last_error;		/**< error code of the last failed read						*/
+	bms_id_stats ids[BMS_STATS_IDS];	/**< indexed by data_id-BMS_STATS_FIRST_ID				*/
+} bms_stats;
+
+
+//======================================================================================== ROUTINE DECLARATION ===================================================================================================
+
+/**
+ * @brief Zeroes an instrumentation block.
+ * @param bms_stats* stats passes the block.
+ * @param uint32_t (*time_us)(void) passes the microsecond tick, NULL if the target has none.
+ * @retval void
+ */
+void bms_stats_init(bms_stats* stats, uint32_t (*time_us)(void));
+
+/**
+ * @brief Zeroes the counters and histograms of a block, the tick is kept.
+ * @param bms_stats* stats passes the block.
+ * @retval void
+ */
+void bms_stats_reset(bms_stats* stats);
+
+/**
+ * @brief Current tick of a block.
+ * @param const bms_stats* stats passes the block, can be NULL.
+ * @retval uint32_t returns the microsecond tick, 0 without block or tick.
+ */
+uint32_t bms_stats_now(const bms_stats* stats);
+
+/**
+ * @brief Counters of a data ID.
+ * @param bms_stats* stats passes the block, can be NULL.
+ * @param uint8_t data_id passes the data ID.
+ * @retval bms_id_stats* returns the counters, NULL without block or for a data ID outside 0x90 to 0x98.
+ */
+bms_id_stats* bms_stats_id(bms_stats* stats, uint8_t data_id);
+
+/**
+ * @brief Counts a latency in a histogram.
+ * @param bms_id_stats* id passes the counters of the data ID, can be NULL.
+ * @param uint8_t hist passes one of BMS_STATS_TX, BMS_STATS_FIRST_BYTE or BMS_STATS_RESPONSE.
+ * @param uint32_t us passes the latency.
+ * @retval void
+ */
+void bms_stats_latency(bms_id_stats* id, uint8_t hist, uint32_t us);
+
+/**
+ * @brief Ends a read of a device.
+ * @param bms_stats* stats passes the block, can be NULL.
+ * @param uint8_t error passes the bms_read() error code, 0 on success.
+ * @param uint8_t data_id passes the data ID whose error code it is, 0 for the errors of no data ID.
+ * @retval void
+ */
+void bms_stats_read_done(bms_stats* stats, uint8_t error, uint8_t data_id);
+
+/**
+ * @brief Sums the counters and histograms of the data IDs selected by a mask, the device totals with BMS_MASK_ALL.
+ * @param const bms_stats* stats passes the block.
+ * @param uint16_t mask passes the data IDs, OR of BMS_DATA_ID_MASK(data_id) values.
+ * @param bms_id_stats* total passes the memory where the sums are stored.
+ * @retval void
+ */
+void bms_stats_sum(const bms_stats* stats, uint16_t mask, bms_id_stats* total);
+
+/**
+ * @brief Latency below which a share of the samples of a histogram lies, with the resolution of the buckets.
+ * @param const bms_id_stats* id passes the counters.
+ * @param uint8_t hist passes one of BMS_STATS_TX, BMS_STATS_FIRST_BYTE or BMS_STATS_RESPONSE.
+ * @param uint16_t permille passes the share, 500 for the median, 990 for p99.
+ * @retval uint32_t returns the upper bound of the bucket holding the share in microseconds, UINT32_MAX if it falls in the last bucket, 0 for an empty histogram.
+ */
+uint32_t bms_stats_percentile_us(const bms_id_stats* id, uint8_t hist, uint16_t permille);
+
+/**
+ * @brief Lower bound of a histogram bucket.
+ * @param uint8_t bucket passes the bucket.
+ * @retval uint32_t returns the bound in microseconds.
+ */
+uint32_t bms_stats_bucket_us(uint8_t bucket);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /**< BMS_STATS_H  */
@@ -0,0 +1,267 @@
+#include "bms_stream.h"
+#include <string.h>
+
+/**
+ * @file bms_stream.c
+ * @brief Source code file for the interrupt/DMA fed receive path declared in bms_stream.h
+ * @author Piyush
+ * @date 12/01/25
+ * @version 1.0 (ISR/DMA feeds the ring, the parser runs in task context)
+ */
+
+
+//==================================================================================== ROUTINE DEFINITIONS ======================================================================================
+
+
+/**
+ * @brief Initializes the ring over a caller provided storage.
+ * @param bms_ring* ring passes the pointer to the ring.
+ * @param uint8_t* buf passes the storage.
+ * @param uint16_t size passes the storage size, must be a power of 2.
+ * @retval uint8_t returns 0 on success and 1 on a size that is not a power of 2.
+ */
+uint8_t bms_ring_init(bms_ring* ring, uint8_t* buf, uint16_t size){
+	if(size==0 || (size&(size-1))!=0 || size>32768U){
+		return 1;
+	}
+	ring->buf=buf;
+	ring->size=size;
+	ring->head=0;
+	ring->tail=0;
+	ring->overruns=0;
+	return 0;
+}
+
+/**
+ * @brief Producer side, stores one byte (to be called from the UART RX interrupt).
+ * @param bms_ring* ring passes the pointer to the ring.
+ * @param uint8_t byte passes the received byte.
+ * @retval void
+ */
+void bms_ring_push(bms_ring* ring, uint8_t byte){
+	uint16_t head=ring->head;
+	if((uint16_t)(head-__atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE))>=ring->size){
+		ring->overruns++;
+		return;
+	}
+	ring->buf[head&(ring->size-1)]=byte;
+	__atomic_store_n(&ring->head, (uint16_t)(head+1), __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Producer side, stores a block of bytes (for hosts reading a file descriptor).
+ * @param bms_ring* ring passes the pointer to the ring.
+ * @param const uint8_t* data passes the received bytes.
+ * @param uint16_t len passes the number of bytes.
+ * @retval void
+ */
+void bms_ring_write(bms_ring* ring, const uint8_t* data, uint16_t len){
+	for(uint16_t i=0;i<len;i++){
+		bms_ring_push(ring, data[i]);
+	}
+}
+
+/**
+ * @brief Producer side for circular DMA, publishes the bytes written by the DMA up to its current position.
+ * @param bms_ring* ring passes the pointer to the ring whose storage is the DMA buffer.
+ * @param uint16_t dma_pos passes the DMA write position in the buffer (Size argument of HAL_UARTEx_RxEventCallback).
+ * @retval void
+ */
+void bms_ring_dma_update(bms_ring* ring, uint16_t dma_pos){
+	uint16_t head=ring->head;
+	uint16_t delta=(uint16_t)((dma_pos-(head&(ring->size-1)))&(ring->size-1));
+	if((uint16_t)(head+delta-__atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE))>ring->size){
+		ring->overruns++;	// the DMA lapped the consumer, the oldest bytes are already overwritten
+	}
+	__atomic_store_n(&ring->head, (uint16_t)(head+delta), __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Consumer side, fetches one byte.
+ * @param bms_ring* ring passes the pointer to the ring.
+ * @param uint8_t* byte passes the memory where the byte will be stored.
+ * @retval uint8_t returns 1 if a byte was fetched and 0 if the ring is empty.
+ */
+uint8_t bms_ring_pop(bms_ring* ring, uint8_t* byte){
+	uint16_t tail=ring->tail;
+	if(tail==__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE)){
+		return 0;
+	}
+	*byte=ring->buf[tail&(ring->size-1)];
+	__atomic_store_n(&ring->tail, (uint16_t)(tail+1), __ATOMIC_RELEASE);
+	return 1;
+}
+
+/**
+ * @brief Resets the parser to the BMS_PARSER_WAIT_START state, counters are kept.
+ * @param bms_frame_parser* parser passes the pointer to the parser.
+ * @retval void
+ */
+void bms_parser_reset(bms_frame_parser* parser){
+	parser->state=BMS_PARSER_WAIT_START;
+	parser->fill=0;
+	parser->sum=0;
+}
+
+/**
+ * @brief Drops the current candidate frame and replays its bytes after the first one, so that a START_FLAG inside a corrupted frame is not missed.
+ * @param bms_frame_parser* parser passes the pointer to the parser.
+ * @retval void
+ */
+static void bms_parser_resync(bms_frame_parser* parser){
+	uint8_t pending[sizeof(uart_prot_packet)];
+	uint8_t count=parser->fill-1;
+	memcpy(pending, parser->raw+1, count);
+	bms_parser_reset(parser);
+	for(uint8_t i=0;i<count;i++){
+		bms_parser_feed(parser, pending[i]);	// fewer bytes than a frame, can't complete one
+	}
+}
+
+/**
+ * @brief Feeds one byte to the parser.
+ * @param bms_frame_parser* parser passes the pointer to the parser.
+ * @param uint8_t byte passes the next byte of the stream.
+ * @retval uint8_t returns 1 when the byte completed a valid frame (available in parser->frame) and 0 otherwise.
+ */
+uint8_t bms_parser_feed(bms_frame_parser* parser, uint8_t byte){
+	if(parser->state==BMS_PARSER_WAIT_START){
+		if(byte!=START_FLAG){
+			parser->discarded++;
+			return 0;
+		}
+		parser->state=BMS_PARSER_IN_FRAME;
+	}
+
+	parser->raw[parser->fill++]=byte;
+
+	if(parser->fill==offsetof(uart_prot_packet, data_len)+1 && byte!=MAX_DATA_SIZE){
+		parser->length_errors++;
+		bms_parser_resync(parser);
+		return 0;
+	}
+	if(parser->fill<sizeof(uart_prot_packet)){
+		parser->sum+=byte;
+		return 0;
+	}
+
+	if((uint8_t)(parser->sum&0xFF)!=byte){
+		parser->checksum_errors++;
+		bms_parser_resync(parser);
+		return 0;
+	}
+	parser->frames++;
+	parser->state=BMS_PARSER_WAIT_START;
+	parser->fill=0;
+	parser->sum=0;
+	return 1;
+}
+
+/**
+ * @brief Initializes the stream.
+ * @param bms_stream* stream passes the pointer to the stream.
+ * @param uint8_t* buf passes the ring storage (DMA buffer in circular mode).
+ * @param uint16_t size passes the ring storage size, must be a power of 2.
+ * @param bms_transport* tx passes the transport used to send requests.
+ * @param uint32_t (*time_ms)(void) passes the millisecond tick (HAL_GetTick on STM32), NULL if there is none : a receive with a timeout then returns BMS_TRANSPORT_TIMEOUT once the ring is empty instead of waiting.
+ * @retval uint8_t returns 0 on success and non zero on failure.
+ */
+uint8_t bms_stream_init(bms_stream* stream, uint8_t* buf, uint16_t size, bms_transport* tx, uint32_t (*time_ms)(void)){
+	memset(&stream->parser, 0x00, sizeof(bms_frame_parser));
+	stream->tx=tx;
+	stream->time_ms=time_ms;
+	return bms_ring_init(&stream->ring, buf, size);
+}
+
+/**
+ * @brief Consumer side, decodes all the bytes available in the ring and delivers each frame to the callback.
+ * @param bms_stream* stream passes the pointer to the stream.
+ * @param bms_frame_callback callback passes the routine receiving the frames.
+ * @param void* ctx passes the application context handed to the callback.
+ * @retval uint16_t returns the number of frames delivered.
+ */
+uint16_t bms_stream_poll(bms_stream* stream, bms_frame_callback callback, void* ctx){
+	uint16_t delivered=0;
+	uint8_t byte;
+	while(bms_ring_pop(&stream->ring, &byte)){
+		if(bms_parser_feed(&stream->parser, byte)){
+			callback(ctx, &stream->parser.frame);
+			delivered++;
+		}
+	}
+	return delivered;
+}
+
+/**
+ * @brief Sends the request through the transmit transport of the stream.
+ */
+static uint8_t bms_stream_transmit(void* handle, const uint8_t* buf, uint16_t len, uint32_t timeout_ms){
+	return bms_transport_transmit(((bms_stream*)handle)->tx, buf, len, timeout_ms);
+}
+
+/**
+ * @brief Starts sending the request through the transmit transport of the stream without waiting for the end of the transfer.
+ */
+static uint8_t bms_stream_transmit_start(void* handle, const uint8_t* buf, uint16_t len){
+	bms_transport* tx=((bms_stream*)handle)->tx;
+	return (tx!=NULL) ? tx->transmit_start(tx->handle, buf, len) : BMS_TRANSPORT_ERROR;
+}
+
+/**
+ * @brief Returns whole decoded frames from the stream, len must be a multiple of sizeof(uart_prot_packet), a stream without time_ms only returns the frames already in the ring.
+ */
+static uint8_t bms_stream_receive(void* handle, uint8_t* buf, uint16_t len, uint32_t timeout_ms){
+	bms_stream* stream=(bms_stream*)handle;
+	uint32_t start=(stream->time_ms!=NULL) ? stream->time_ms() : 0;
+	uint16_t done=0;
+
+	if(len%sizeof(uart_prot_packet)!=0){
+		return BMS_TRANSPORT_ERROR;
+	}
+	while(done<len){
+		uint8_t byte;
+		if(bms_ring_pop(&stream->ring, &byte)){
+			if(bms_parser_feed(&stream->parser, byte)){
+				memcpy(buf+done, &stream->parser.frame, sizeof(uart_prot_packet));
+				done+=sizeof(uart_prot_packet);
+			}
+			continue;
+		}
+		if(timeout_ms!=BMS_TRANSPORT_MAX_DELAY && (stream->time_ms==NULL || (uint32_t)(stream->time_ms()-start)>=timeout_ms)){	// without a tick the timeout can't be measured, waiting would never end on a silent BMS
+			return BMS_TRANSPORT_TIMEOUT;
+		}
+	}
+	return BMS_TRANSPORT_OK;
+}
+
+/**
+ * @brief Returns the raw bytes already stored in the ring without waiting, the multi pack engine runs its own parser on them.
+ * @param void* handle passes the bms_stream*.
+ * @param uint8_t* buf passes the memory where the bytes will be stored.
+ * @param uint16_t max passes the size of buf.
+ * @retval uint16_t returns the number of bytes stored.
+ */
+static uint16_t bms_stream_receive_available(void* handle, uint8_t* buf, uint16_t max){
+	bms_stream* stream=(bms_stream*)handle;
+	uint16_t n=0;
+	while(n<max && bms_ring_pop(&stream->ring, &buf[n])){
+		n++;
+	}
+	return n;
+}
+
+/**
+ * @brief Fills a transport whose receive side returns whole decoded frames from the stream, so that bms_read() can run on top of the ISR/DMA receive path.
+ * @param bms_transport* transport passes the pointer to the transport to be filled.
+ * @param bms_stream* stream passes the pointer to an initialized stream, its tx must be set first since the transmit_start of tx is forwarded.
+ * @retval void
+ */
+void bms_transport_stream_init(bms_transport* transport, bms_stream* stream){
+	transport->handle=stream;
+	transport->transmit=bms_stream_transmit;
+	transport->receive=bms_stream_receive;
+	transport->receive_available=bms_stream_receive_available;
+	transport->fd=-1;
+	transport->baudrate=(stream->tx!=NULL) ? stream->tx->baudrate : UART_DEFAULT_BAUDRATE;
+	transport->transmit_start=(stream->tx!=NULL && stream->tx->transmit_start!=NULL) ? bms_stream_transmit_start : NULL;
+}
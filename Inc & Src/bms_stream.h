@@ -0,0 +1,173 @@
+#ifndef BMS_STREAM_H
+#define BMS_STREAM_H
+
+#include "bms_uart_comm.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @file bms_stream.h
+ * @brief Header file for the interrupt/DMA fed receive path defined in bms_stream.c
+ * 	  An ISR (one byte at a time) or a circular DMA buffer feeds a lock-free single producer / single consumer ring, the consumer side runs a byte-at-a-time frame parser
+ * 	  resynchronizing on START_FLAG, validating data_len and computing the checksum incrementally, and delivers every decoded frame to the application.
+ * @author Piyush
+ * @date 12/01/25
+ * @version 1.0
+ *
+ *
+ * @note Only one producer (ISR/DMA callback) and one consumer (task/main loop) are allowed per ring, no lock is taken on either side.
+ *	 A dropped or corrupted byte costs at most the frame it belongs to, the parser resyncs on the next START_FLAG instead of misaligning all the following frames.
+ */
+
+
+// ====================================================================================================== MACROS ==========================================================================================================================
+
+/**
+ * @brief macros for the parser states.
+ */
+#define BMS_PARSER_WAIT_START	0x00	/**< waiting for START_FLAG			*/
+#define BMS_PARSER_IN_FRAME	0x01	/**< collecting the remaining frame bytes	*/
+
+
+//================================================================================ STREAM STRUCTURES ============================================================================================================
+
+/**
+ * @brief structure of the single producer / single consumer byte ring.
+ */
+typedef struct {
+	uint8_t* buf;			/**< storage, also used as DMA destination in circular mode			*/
+	uint16_t size;			/**< storage size, must be a power of 2 and at most 32768			*/
+	volatile uint16_t head;		/**< free running write index, only modified by the producer		*/
+	volatile uint16_t tail;		/**< free running read index, only modified by the consumer		*/
+	volatile uint32_t overruns;	/**< bytes dropped by the producer because the ring was full		*/
+} bms_ring;
+
+/**
+ * @brief structure of the streaming frame parser.
+ */
+typedef struct {
+	uint8_t state;			/**< one of BMS_PARSER_x states					*/
+	uint8_t fill;			/**< number of bytes of the current frame collected			*/
+	uint16_t sum;			/**< running checksum of the collected bytes				*/
+	union {
+		uart_prot_packet frame;				/**< last decoded frame				*/
+		uint8_t raw[sizeof(uart_prot_packet)];
+	};
+	uint32_t frames;		/**< frames decoded with a correct checksum				*/
+	uint32_t checksum_errors;	/**< frames dropped for a wrong checksum				*/
+	uint32_t length_errors;		/**< frames dropped for a data_len other than MAX_DATA_SIZE		*/
+	uint32_t discarded;		/**< bytes skipped while searching for START_FLAG			*/
+} bms_frame_parser;
+
+/**
+ * @brief routine type receiving the decoded frames.
+ */
+typedef void (*bms_frame_callback)(void* ctx, const uart_prot_packet* frame);
+
+/**
+ * @brief structure tying a ring, a parser and the transmit side of a port together.
+ */
+typedef struct {
+	bms_ring ring;			/**< bytes received from the ISR/DMA				*/
+	bms_frame_parser parser;	/**< frame parser run by the consumer				*/
+	bms_transport* tx;		/**< transport used to send the request frames			*/
+	uint32_t (*time_ms)(void);	/**< millisecond tick used for the receive timeouts, NULL : a receive with a timeout only takes the frames already in the ring	*/
+} bms_stream;
+
+
+//======================================================================================== ROUTINE DECLARATION ===================================================================================================
+
+/**
+ * @brief Initializes the ring over a caller provided storage.
+ * @param bms_ring* ring passes the pointer to the ring.
+ * @param uint8_t* buf passes the storage.
+ * @param uint16_t size passes the storage size, must be a power of 2.
+ * @retval uint8_t returns 0 on success and 1 on a size that is not a power of 2.
+ */
+uint8_t bms_ring_init(bms_ring* ring, uint8_t* buf, uint16_t size);
+
+/**
+ * @brief Producer side, stores one byte (to be called from the UART RX interrupt).
+ * @param bms_ring* ring passes the pointer to the ring.
+ * @param uint8_t byte passes the received byte.
+ * @retval void
+ */
+void bms_ring_push(bms_ring* ring, uint8_t byte);
+
+/**
+ * @brief Producer side, stores a block of bytes (for hosts reading a file descriptor).
+ * @param bms_ring* ring passes the pointer to the ring.
+ * @param const uint8_t* data passes the received bytes.
+ * @param uint16_t len passes the number of bytes.
+ * @retval void
+ */
+void bms_ring_write(bms_ring* ring, const uint8_t* data, uint16_t len);
+
+/**
+ * @brief Producer side for circular DMA, publishes the bytes written by the DMA up to its current position.
+ * @param bms_ring* ring passes the pointer to the ring whose storage is the DMA buffer.
+ * @param uint16_t dma_pos passes the DMA write position in the buffer (Size argument of HAL_UARTEx_RxEventCallback).
+ * @retval void
+ */
+void bms_ring_dma_update(bms_ring* ring, uint16_t dma_pos);
+
+/**
+ * @brief Consumer side, fetches one byte.
+ * @param bms_ring* ring passes the pointer to the ring.
+ * @param uint8_t* byte passes the memory where the byte will be stored.
+ * @retval uint8_t returns 1 if a byte was fetched and 0 if the ring is empty.
+ */
+uint8_t bms_ring_pop(bms_ring* ring, uint8_t* byte);
+
+/**
+ * @brief Resets the parser to the BMS_PARSER_WAIT_START state, counters are kept.
+ * @param bms_frame_parser* parser passes the pointer to the parser.
+ * @retval void
+ */
+void bms_parser_reset(bms_frame_parser* parser);
+
+/**
+ * @brief Feeds one byte to the parser.
+ * @param bms_frame_parser* parser passes the pointer to the parser.
+ * @param uint8_t byte passes the next byte of the stream.
+ * @retval uint8_t returns 1 when the byte completed a valid frame (available in parser->frame) and 0 otherwise.
+ */
+uint8_t bms_parser_feed(bms_frame_parser* parser, uint8_t byte);
+
+/**
+ * @brief Initializes the stream.
+ * @param bms_stream* stream passes the pointer to the stream.
+ * @param uint8_t* buf passes the ring storage (DMA buffer in circular mode).
+ * @param uint16_t size passes the ring storage size, must be a power of 2.
+ * @param bms_transport* tx passes the transport used to send requests.
+ * @param uint32_t (*time_ms)(void) passes the millisecond tick (HAL_GetTick on STM32), NULL if there is none : a receive with a timeout then returns BMS_TRANSPORT_TIMEOUT once the ring is empty instead of waiting.
+ * @retval uint8_t returns 0 on success and non zero on failure.
+ */
+uint8_t bms_stream_init(bms_stream* stream, uint8_t* buf, uint16_t size, bms_transport* tx, uint32_t (*time_ms)(void));
+
+/**
+ * @brief Consumer side, decodes all the bytes available in the ring and delivers each frame to the callback.
+ * @param bms_stream* stream passes the pointer to the stream.
+ * @param bms_frame_callback callback passes the routine receiving the frames.
+ * @param void* ctx passes the application context handed to the callback.
+ * @retval uint16_t returns the number of frames delivered.
+ */
+uint16_t bms_stream_poll(bms_stream* stream, bms_frame_callback callback, void* ctx);
+
+/**
+ * @brief Fills a transport whose receive side returns whole decoded frames from the stream, so that bms_read() can run on top of the ISR/DMA receive path.
+ * @param bms_transport* transport passes the pointer to the transport to be filled.
+ * @param bms_stream* stream passes the pointer to an initialized stream, its tx must be set first since the transmit_start of tx is forwarded.
+ * @retval void
+ */
+void bms_transport_stream_init(bms_transport* transport, bms_stream* stream);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /**< BMS_STREAM_H  */
@@ -0,0 +1,70 @@
+#include "bms_transport.h"
+#include "bms_uart_comm.h"
+
+/**
+ * @file bms_transport.c
+ * @brief Source code file for the transport routines declared in bms_transport.h
+ * @author Piyush
+ * @date 12/01/25
+ * @version 1.0
+ */
+
+
+//==================================================================================== ROUTINE DEFINITIONS ======================================================================================
+
+
+/**
+ * @brief Sends the bytes through the transport.
+ * @param bms_transport* transport passes the pointer to the transport to be used.
+ * @param const uint8_t* buf passes the bytes to be sent.
+ * @param uint16_t len passes the number of bytes to be sent.
+ * @param uint32_t timeout_ms passes the maximum time allowed for the transfer, BMS_TRANSPORT_MAX_DELAY blocks forever.
+ * @retval uint8_t returns one of the BMS_TRANSPORT_x codes.
+ */
+uint8_t bms_transport_transmit(bms_transport* transport, const uint8_t* buf, uint16_t len, uint32_t timeout_ms){
+	if(transport==NULL || transport->transmit==NULL){
+		return BMS_TRANSPORT_ERROR;
+	}
+	return transport->transmit(transport->handle, buf, len, timeout_ms);
+}
+
+/**
+ * @brief Starts sending the bytes through the transport without waiting for the end of the transfer, used by the multi pack engine (bms_multi.h).
+ * @param bms_transport* transport passes the pointer to the transport to be used.
+ * @param const uint8_t* buf passes the bytes to be sent, they must stay valid until the transfer ends.
+ * @param uint16_t len passes the number of bytes to be sent.
+ * @param uint32_t timeout_ms passes the maximum time allowed for the transfer when the backend has no transmit_start and the blocking transmit is used instead.
+ * @retval uint8_t returns one of the BMS_TRANSPORT_x codes.
+ */
+uint8_t bms_transport_transmit_start(bms_transport* transport, const uint8_t* buf, uint16_t len, uint32_t timeout_ms){
+	if(transport!=NULL && transport->transmit_start!=NULL){
+		return transport->transmit_start(transport->handle, buf, len);
+	}
+	return bms_transport_transmit(transport, buf, len, timeout_ms);
+}
+
+/**
+ * @brief Receives exactly len bytes through the transport.
+ * @param bms_transport* transport passes the pointer to the transport to be used.
+ * @param uint8_t* buf passes the memory where received bytes will be stored.
+ * @param uint16_t len passes the number of bytes to be received.
+ * @param uint32_t timeout_ms passes the maximum time allowed for the transfer, BMS_TRANSPORT_MAX_DELAY blocks forever.
+ * @retval uint8_t returns one of the BMS_TRANSPORT_x codes.
+ */
+uint8_t bms_transport_receive(bms_transport* transport, uint8_t* buf, uint16_t len, uint32_t timeout_ms){
+	if(transport==NULL || transport->receive==NULL){
+		return BMS_TRANSPORT_ERROR;
+	}
+	return transport->receive(transport->handle, buf, len, timeout_ms);
+}
+
+/**
+ * @brief Calculates the time a number of bytes occupies on the wire (8N1 framing, 10 bits per byte).
+ * @param bms_transport* transport passes the pointer to the transport whose baud rate is used.
+ * @param uint32_t bytes passes the number of bytes.
+ * @retval uint32_t returns the wire time in microseconds.
+ */
+uint32_t bms_transport_wire_time_us(const bms_transport* transport, uint32_t bytes){
+	uint32_t baud=(transport!=NULL && transport->baudrate!=0) ? transport->baudrate : UART_DEFAULT_BAUDRATE;
+	return (uint32_t)(((uint64_t)bytes*10U*1000000U+baud-1)/baud);
+}
@@ -0,0 +1,102 @@
+#ifndef BMS_TRANSPORT_H
+#define BMS_TRANSPORT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @file bms_transport.h
+ * @brief Transport abstraction used by the driver routines defined in bms_uart_comm.c
+ * 	  The driver never calls the UART peripheral directly, instead it goes through a bms_transport object holding a backend handle and the transmit/receive routines of that backend.
+ * @author Piyush
+ * @date 12/01/25
+ * @version 1.0
+ *
+ *
+ * @note Two backends are provided, bms_transport_hal.c for the STM32 HAL (compiled for the MCU targets) and bms_transport_linux.c for termios serial ports and pseudo terminals (compiled on Linux hosts only).
+ *	 Any other microcontroller can be targeted by filling a bms_transport structure with its own routines.
+ */
+
+
+// ====================================================================================================== MACROS ==========================================================================================================================
+
+/**
+ * @brief macros for transport return codes.
+ */
+#define BMS_TRANSPORT_OK		0x00	/**< transfer completed			*/
+#define BMS_TRANSPORT_ERROR		0x01	/**< backend reported an error		*/
+#define BMS_TRANSPORT_TIMEOUT		0x02	/**< transfer did not finish in time	*/
+
+/**
+ * @brief macro for blocking transfers, same meaning as HAL_MAX_DELAY.
+ */
+#define BMS_TRANSPORT_MAX_DELAY		0xFFFFFFFFU
+
+
+//================================================================================ TRANSPORT STRUCTURE ==========================================================================================================
+
+/**
+ * @brief structure describing a byte stream towards one BMS.
+ */
+typedef struct {
+	void* handle;	/**< Backend specific handle, UART_HandleTypeDef* for the HAL backend, bms_linux_port* for the Linux backend	*/
+	uint8_t (*transmit)(void* handle, const uint8_t* buf, uint16_t len, uint32_t timeout_ms);	/**< Sends len bytes, returns one of BMS_TRANSPORT_x codes	*/
+	uint8_t (*receive)(void* handle, uint8_t* buf, uint16_t len, uint32_t timeout_ms);		/**< Receives exactly len bytes, returns one of BMS_TRANSPORT_x codes	*/
+	uint16_t (*receive_available)(void* handle, uint8_t* buf, uint16_t max);	/**< Returns the bytes already received without waiting (at most max), NULL if the backend can't, used by the multi pack engine (bms_multi.h)	*/
+	int fd;			/**< File descriptor the multi pack engine waits on (epoll), -1 if the backend has none	*/
+	uint32_t baudrate;	/**< Line speed in bps, used for wire time estimations			*/
+	uint8_t (*transmit_start)(void* handle, const uint8_t* buf, uint16_t len);	/**< Starts sending len bytes and returns at once (DMA/IT), buf must stay valid until the transfer ends, NULL if the backend can't	*/
+} bms_transport;
+
+
+//======================================================================================== ROUTINE DECLARATION ===================================================================================================
+
+/**
+ * @brief Sends the bytes through the transport.
+ * @param bms_transport* transport passes the pointer to the transport to be used.
+ * @param const uint8_t* buf passes the bytes to be sent.
+ * @param uint16_t len passes the number of bytes to be sent.
+ * @param uint32_t timeout_ms passes the maximum time allowed for the transfer, BMS_TRANSPORT_MAX_DELAY blocks forever.
+ * @retval uint8_t returns one of the BMS_TRANSPORT_x codes.
+ */
+uint8_t bms_transport_transmit(bms_transport* transport, const uint8_t* buf, uint16_t len, uint32_t timeout_ms);
+
+/**
+ * @brief Starts sending the bytes through the transport without waiting for the end of the transfer, used by the multi pack engine (bms_multi.h).
+ * @param bms_transport* transport passes the pointer to the transport to be used.
+ * @param const uint8_t* buf passes the bytes to be sent, they must stay valid until the transfer ends.
+ * @param uint16_t len passes the number of bytes to be sent.
+ * @param uint32_t timeout_ms passes the maximum time allowed for the transfer when the backend has no transmit_start and the blocking transmit is used instead.
+ * @retval uint8_t returns one of the BMS_TRANSPORT_x codes.
+ */
+uint8_t bms_transport_transmit_start(bms_transport* transport, const uint8_t* buf, uint16_t len, uint32_t timeout_ms);
+
+/**
+ * @brief Receives exactly len bytes through the transport.
+ * @param bms_transport* transport passes the pointer to the transport to be used.
+ * @param uint8_t* buf passes the memory where received bytes will be stored.
+ * @param uint16_t len passes the number of bytes to be received.
+ * @param uint32_t timeout_ms passes the maximum time allowed for the transfer, BMS_TRANSPORT_MAX_DELAY blocks forever.
+ * @retval uint8_t returns one of the BMS_TRANSPORT_x codes.
+ */
+uint8_t bms_transport_receive(bms_transport* transport, uint8_t* buf, uint16_t len, uint32_t timeout_ms);
+
+/**
+ * @brief Calculates the time a number of bytes occupies on the wire (8N1 framing, 10 bits per byte).
+ * @param bms_transport* transport passes the pointer to the transport whose baud rate is used.
+ * @param uint32_t bytes passes the number of bytes.
+ * @retval uint32_t returns the wire time in microseconds.
+ */
+uint32_t bms_transport_wire_time_us(const bms_transport* transport, uint32_t bytes);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /**< BMS_TRANSPORT_H  */
@@ -0,0 +1,102 @@
+#if !defined(__linux__)
+
+#include "stm32f4xx_hal.h"	// must be modified by user as per the underlying microcontroller HAL.
+#include "bms_transport_hal.h"
+
+/**
+ * @file bms_transport_hal.c
+ * @brief Source code file for the STM32 HAL transport backend declared in bms_transport_hal.h
+ * @author Piyush
+ * @date 12/01/25
+ * @version 1.0 (uses polling methodology to transfer the data, DMA/IT for the requests of the multi pack engine)
+ */
+
+
+//==================================================================================== ROUTINE DEFINITIONS ======================================================================================
+
+
+/**
+ * @brief Sends the bytes through HAL_UART_Transmit.
+ * @param void* handle passes the UART_HandleTypeDef* of the port.
+ * @param const uint8_t* buf passes the bytes to be sent.
+ * @param uint16_t len passes the number of bytes to be sent.
+ * @param uint32_t timeout_ms passes the HAL timeout in ticks (ms).
+ * @retval uint8_t returns one of the BMS_TRANSPORT_x codes.
+ */
+static uint8_t bms_hal_transmit(void* handle, const uint8_t* buf, uint16_t len, uint32_t timeout_ms){
+	HAL_StatusTypeDef ret=HAL_UART_Transmit((UART_HandleTypeDef*)handle, (uint8_t*)buf, len, (timeout_ms==BMS_TRANSPORT_MAX_DELAY) ? HAL_MAX_DELAY : timeout_ms);
+	if(ret==HAL_OK){
+		return BMS_TRANSPORT_OK;
+	}
+	return (ret==HAL_TIMEOUT) ? BMS_TRANSPORT_TIMEOUT : BMS_TRANSPORT_ERROR;
+}
+
+/**
+ * @brief Starts sending the bytes through HAL_UART_Transmit_DMA, or HAL_UART_Transmit_IT when the port has no TX DMA channel, and returns at once.
+ * @param void* handle passes the UART_HandleTypeDef* of the port.
+ * @param const uint8_t* buf passes the bytes to be sent, they must stay valid until the transfer ends.
+ * @param uint16_t len passes the number of bytes to be sent.
+ * @retval uint8_t returns one of the BMS_TRANSPORT_x codes, BMS_TRANSPORT_ERROR while the previous transfer of the port is still running.
+ */
+static uint8_t bms_hal_transmit_start(void* handle, const uint8_t* buf, uint16_t len){
+	UART_HandleTypeDef* huart=(UART_HandleTypeDef*)handle;
+	HAL_StatusTypeDef ret=(huart->hdmatx!=NULL) ? HAL_UART_Transmit_DMA(huart, (uint8_t*)buf, len) : HAL_UART_Transmit_IT(huart, (uint8_t*)buf, len);
+	return (ret==HAL_OK) ? BMS_TRANSPORT_OK : BMS_TRANSPORT_ERROR;
+}
+
+/**
+ * @brief Receives exactly len bytes through HAL_UART_Receive.
+ * @param void* handle passes the UART_HandleTypeDef* of the port.
+ * @param uint8_t* buf passes the memory where received bytes will be stored.
+ * @param uint16_t len passes the number of bytes to be received.
+ * @param uint32_t timeout_ms passes the HAL timeout in ticks (ms).
+ * @retval uint8_t returns one of the BMS_TRANSPORT_x codes.
+ */
+static uint8_t bms_hal_receive(void* handle, uint8_t* buf, uint16_t len, uint32_t timeout_ms){
+	HAL_StatusTypeDef ret=HAL_UART_Receive((UART_HandleTypeDef*)handle, buf, len, (timeout_ms==BMS_TRANSPORT_MAX_DELAY) ? HAL_MAX_DELAY : timeout_ms);
+	if(ret==HAL_OK){
+		return BMS_TRANSPORT_OK;
+	}
+	return (ret==HAL_TIMEOUT) ? BMS_TRANSPORT_TIMEOUT : BMS_TRANSPORT_ERROR;
+}
+
+/**
+ * @brief Fills the transport structure for an already initialized HAL UART port.
+ * @param bms_transport* transport passes the pointer to the transport to be filled.
+ * @param void* uart_handle passes the UART_HandleTypeDef* of the port, usually UART_STRUCT_PTR.
+ * @retval void
+ */
+void bms_transport_hal_init(bms_transport* transport, void* uart_handle){
+	transport->handle=uart_handle;
+	transport->transmit=bms_hal_transmit;
+	transport->receive=bms_hal_receive;
+	transport->receive_available=NULL;	// the multi pack engine runs on bms_transport_stream_init() transports on the MCU
+	transport->fd=-1;
+	transport->baudrate=((UART_HandleTypeDef*)uart_handle)->Init.BaudRate;
+	transport->transmit_start=bms_hal_transmit_start;	// the UART TX interrupt must be enabled (HAL_UART_IRQHandler) for the multi pack engine
+}
+
+/**
+ * @brief Starts the circular DMA reception of a port into the ring of a stream.
+ * @param void* uart_handle passes the UART_HandleTypeDef* of the port, its RX DMA channel must be configured in circular mode.
+ * @param bms_stream* stream passes the pointer to an initialized stream, its ring storage is used as DMA buffer.
+ * @retval uint8_t returns one of the BMS_TRANSPORT_x codes.
+ *
+ * @note HAL_UARTEx_RxEventCallback(huart, Size) must call bms_ring_dma_update(&stream->ring, Size) for the port.
+ */
+uint8_t bms_transport_hal_start_dma(void* uart_handle, bms_stream* stream){
+	if(HAL_UARTEx_ReceiveToIdle_DMA((UART_HandleTypeDef*)uart_handle, stream->ring.buf, stream->ring.size)!=HAL_OK){
+		return BMS_TRANSPORT_ERROR;
+	}
+	return BMS_TRANSPORT_OK;
+}
+
+/**
+ * @brief Millisecond tick for the stream receive timeouts.
+ * @retval uint32_t returns HAL_GetTick().
+ */
+uint32_t bms_transport_hal_time_ms(void){
+	return HAL_GetTick();
+}
+
+#endif /**< !__linux__ */
@@ -0,0 +1,56 @@
+#ifndef BMS_TRANSPORT_HAL_H
+#define BMS_TRANSPORT_HAL_H
+
+#include "bms_transport.h"
+#include "bms_stream.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @file bms_transport_hal.h
+ * @brief Header file for the STM32 HAL transport backend defined in bms_transport_hal.c
+ * @author Piyush
+ * @date 12/01/25
+ * @version 1.0
+ *
+ *
+ * @note The UART peripheral must be initialized (MX_USARTx_UART_Init()) before the transport is filled.
+ */
+
+
+//======================================================================================== ROUTINE DECLARATION ===================================================================================================
+
+/**
+ * @brief Fills the transport structure for an already initialized HAL UART port.
+ * @param bms_transport* transport passes the pointer to the transport to be filled.
+ * @param void* uart_handle passes the UART_HandleTypeDef* of the port, usually UART_STRUCT_PTR.
+ * @retval void
+ */
+void bms_transport_hal_init(bms_transport* transport, void* uart_handle);
+
+/**
+ * @brief Starts the circular DMA reception of a port into the ring of a stream.
+ * @param void* uart_handle passes the UART_HandleTypeDef* of the port, its RX DMA channel must be configured in circular mode.
+ * @param bms_stream* stream passes the pointer to an initialized stream, its ring storage is used as DMA buffer.
+ * @retval uint8_t returns one of the BMS_TRANSPORT_x codes.
+ *
+ * @note HAL_UARTEx_RxEventCallback(huart, Size) must call bms_ring_dma_update(&stream->ring, Size) for the port. For byte interrupt reception,
+ *	 HAL_UART_RxCpltCallback() calls bms_ring_push() with the received byte and restarts HAL_UART_Receive_IT() for the next one.
+ */
+uint8_t bms_transport_hal_start_dma(void* uart_handle, bms_stream* stream);
+
+/**
+ * @brief Millisecond tick for the stream receive timeouts.
+ * @retval uint32_t returns HAL_GetTick().
+ */
+uint32_t bms_transport_hal_time_ms(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /**< BMS_TRANSPORT_HAL_H  */
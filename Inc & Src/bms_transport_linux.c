@@ -0,0 +1,200 @@
+#if defined(__linux__)
+
+#define _GNU_SOURCE
+#include "bms_transport_linux.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * @file bms_transport_linux.c
+ * @brief Source code file for the Linux transport backend declared in bms_transport_linux.h
+ * @author Piyush
+ * @date 12/01/25
+ * @version 1.0
+ */
+
+
+//==================================================================================== ROUTINE DEFINITIONS ======================================================================================
+
+
+/**
+ * @brief Returns a monotonic timestamp, used for deadlines and benchmarks on the host.
+ * @retval uint64_t returns the time in microseconds.
+ */
+uint64_t bms_linux_time_us(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec*1000000U+(uint64_t)ts.tv_nsec/1000U;
+}
+
+/**
+ * @brief Maps the numeric baud rate to the termios speed constant.
+ * @param uint32_t baudrate passes the line speed in bps.
+ * @retval speed_t returns the termios constant, B9600 for unsupported values.
+ */
+static speed_t bms_linux_speed(uint32_t baudrate){
+	switch(baudrate){
+		case 1200:	return B1200;
+		case 2400:	return B2400;
+		case 4800:	return B4800;
+		case 19200:	return B19200;
+		case 38400:	return B38400;
+		case 57600:	return B57600;
+		case 115200:	return B115200;
+		default:	return B9600;
+	}
+}
+
+/**
+ * @brief Waits until the fd is ready or the deadline passes.
+ * @param int fd passes the file descriptor.
+ * @param short events passes POLLIN or POLLOUT.
+ * @param uint64_t deadline_us passes the absolute deadline, 0 means no deadline.
+ * @retval uint8_t returns one of the BMS_TRANSPORT_x codes.
+ */
+static uint8_t bms_linux_wait(int fd, short events, uint64_t deadline_us){
+	struct pollfd pfd={ .fd=fd, .events=events };
+	int wait_ms=-1;
+	if(deadline_us!=0){
+		uint64_t now=bms_linux_time_us();
+		if(now>=deadline_us){
+			return BMS_TRANSPORT_TIMEOUT;
+		}
+		wait_ms=(int)((deadline_us-now+999)/1000);
+	}
+	int ret=poll(&pfd, 1, wait_ms);
+	if(ret==0){
+		return BMS_TRANSPORT_TIMEOUT;
+	}
+	if(ret<0){
+		return (errno==EINTR) ? BMS_TRANSPORT_OK : BMS_TRANSPORT_ERROR;
+	}
+	return (pfd.revents & (POLLERR | POLLNVAL)) ? BMS_TRANSPORT_ERROR : BMS_TRANSPORT_OK;
+}
+
+/**
+ * @brief Sends the bytes through write(2).
+ * @param void* handle passes the bms_linux_port* of the port.
+ * @param const uint8_t* buf passes the bytes to be sent.
+ * @param uint16_t len passes the number of bytes to be sent.
+ * @param uint32_t timeout_ms passes the maximum time allowed for the transfer.
+ * @retval uint8_t returns one of the BMS_TRANSPORT_x codes.
+ */
+static uint8_t bms_linux_transmit(void* handle, const uint8_t* buf, uint16_t len, uint32_t timeout_ms){
+	bms_linux_port* port=(bms_linux_port*)handle;
+	uint64_t deadline=(timeout_ms==BMS_TRANSPORT_MAX_DELAY) ? 0 : bms_linux_time_us()+(uint64_t)timeout_ms*1000U;
+	uint16_t done=0;
+	while(done<len){
+		ssize_t n=write(port->fd, buf+done, len-done);
+		if(n>0){
+			done+=(uint16_t)n;
+			continue;
+		}
+		if(n<0 && errno!=EAGAIN && errno!=EINTR){
+			return BMS_TRANSPORT_ERROR;
+		}
+		uint8_t ret=bms_linux_wait(port->fd, POLLOUT, deadline);
+		if(ret!=BMS_TRANSPORT_OK){
+			return ret;
+		}
+	}
+	return BMS_TRANSPORT_OK;
+}
+
+/**
+ * @brief Receives exactly len bytes through read(2).
+ * @param void* handle passes the bms_linux_port* of the port.
+ * @param uint8_t* buf passes the memory where received bytes will be stored.
+ * @param uint16_t len passes the number of bytes to be received.
+ * @param uint32_t timeout_ms passes the maximum time allowed for the transfer.
+ * @retval uint8_t returns one of the BMS_TRANSPORT_x codes.
+ */
+static uint8_t bms_linux_receive(void* handle, uint8_t* buf, uint16_t len, uint32_t timeout_ms){
+	bms_linux_port* port=(bms_linux_port*)handle;
+	uint64_t deadline=(timeout_ms==BMS_TRANSPORT_MAX_DELAY) ? 0 : bms_linux_time_us()+(uint64_t)timeout_ms*1000U;
+	uint16_t done=0;
+	while(done<len){
+		ssize_t n=read(port->fd, buf+done, len-done);
+		if(n>0){
+			done+=(uint16_t)n;
+			continue;
+		}
+		if(n==0 || (errno!=EAGAIN && errno!=EINTR)){
+			return BMS_TRANSPORT_ERROR;
+		}
+		uint8_t ret=bms_linux_wait(port->fd, POLLIN, deadline);
+		if(ret!=BMS_TRANSPORT_OK){
+			return ret;
+		}
+	}
+	return BMS_TRANSPORT_OK;
+}
+
+/**
+ * @brief Returns the bytes already received through read(2) without waiting.
+ * @param void* handle passes the bms_linux_port* of the port.
+ * @param uint8_t* buf passes the memory where received bytes will be stored.
+ * @param uint16_t max passes the size of buf.
+ * @retval uint16_t returns the number of bytes stored, 0 if nothing was pending.
+ */
+static uint16_t bms_linux_receive_available(void* handle, uint8_t* buf, uint16_t max){
+	bms_linux_port* port=(bms_linux_port*)handle;
+	ssize_t n;
+	do{
+		n=read(port->fd, buf, max);
+	}while(n<0 && errno==EINTR);
+	return (n>0) ? (uint16_t)n : 0;
+}
+
+/**
+ * @brief Opens and configures a tty in raw 8N1 mode and fills the transport structure.
+ * @param bms_transport* transport passes the pointer to the transport to be filled.
+ * @param bms_linux_port* port passes the pointer to the port state, must outlive the transport.
+ * @param const char* path passes the tty path.
+ * @param uint32_t baudrate passes the line speed in bps.
+ * @retval uint8_t returns one of the BMS_TRANSPORT_x codes.
+ */
+uint8_t bms_transport_linux_open(bms_transport* transport, bms_linux_port* port, const char* path, uint32_t baudrate){
+	port->fd=open(path, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+	if(port->fd<0){
+		return BMS_TRANSPORT_ERROR;
+	}
+
+	struct termios tio;
+	if(tcgetattr(port->fd, &tio)==0){
+		cfmakeraw(&tio);
+		tio.c_cflag|=(CLOCAL | CREAD);
+		tio.c_cflag&=~(CSTOPB | PARENB | CRTSCTS);
+		cfsetispeed(&tio, bms_linux_speed(baudrate));
+		cfsetospeed(&tio, bms_linux_speed(baudrate));
+		tcsetattr(port->fd, TCSANOW, &tio);
+		tcflush(port->fd, TCIOFLUSH);
+	}
+
+	transport->handle=port;
+	transport->transmit=bms_linux_transmit;
+	transport->receive=bms_linux_receive;
+	transport->receive_available=bms_linux_receive_available;
+	transport->fd=port->fd;
+	transport->baudrate=baudrate;
+	transport->transmit_start=NULL;	// write(2) returns once the frame is in the tty buffer, the blocking transmit does not wait for the wire
+	return BMS_TRANSPORT_OK;
+}
+
+/**
+ * @brief Closes the tty opened through bms_transport_linux_open().
+ * @param bms_linux_port* port passes the pointer to the port state.
+ * @retval void
+ */
+void bms_transport_linux_close(bms_linux_port* port){
+	if(port->fd>=0){
+		close(port->fd);
+		port->fd=-1;
+	}
+}
+
+#endif /**< __linux__ */
@@ -0,0 +1,61 @@
+#ifndef BMS_TRANSPORT_LINUX_H
+#define BMS_TRANSPORT_LINUX_H
+
+#include "bms_transport.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @file bms_transport_linux.h
+ * @brief Header file for the Linux transport backend defined in bms_transport_linux.c
+ * 	  Works with real serial ports (/dev/ttyUSBx, /dev/ttySx) as well as with pseudo terminals, the latter being used by the simulated BMS in Host/.
+ * @author Piyush
+ * @date 12/01/25
+ * @version 1.0
+ */
+
+
+//================================================================================ PORT STRUCTURE ===============================================================================================================
+
+/**
+ * @brief structure holding the state of an opened Linux serial port.
+ */
+typedef struct {
+	int fd;			/**< File descriptor of the opened tty, -1 when closed	*/
+} bms_linux_port;
+
+
+//======================================================================================== ROUTINE DECLARATION ===================================================================================================
+
+/**
+ * @brief Opens and configures a tty in raw 8N1 mode and fills the transport structure.
+ * @param bms_transport* transport passes the pointer to the transport to be filled.
+ * @param bms_linux_port* port passes the pointer to the port state, must outlive the transport.
+ * @param const char* path passes the tty path.
+ * @param uint32_t baudrate passes the line speed in bps.
+ * @retval uint8_t returns one of the BMS_TRANSPORT_x codes.
+ */
+uint8_t bms_transport_linux_open(bms_transport* transport, bms_linux_port* port, const char* path, uint32_t baudrate);
+
+/**
+ * @brief Closes the tty opened through bms_transport_linux_open().
+ * @param bms_linux_port* port passes the pointer to the port state.
+ * @retval void
+ */
+void bms_transport_linux_close(bms_linux_port* port);
+
+/**
+ * @brief Returns a monotonic timestamp, used for deadlines and benchmarks on the host.
+ * @retval uint64_t returns the time in microseconds.
+ */
+uint64_t bms_linux_time_us(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /**< BMS_TRANSPORT_LINUX_H  */
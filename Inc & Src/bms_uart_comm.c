@@ -1,4 +1,5 @@
 #include "bms_uart_comm.h"
+#include "bms_delta.h"
 #include<string.h>
 
 /**
@@ -18,6 +19,484 @@
  */
 
 
+//==================================================================================== PRIVATE VARIABLES ========================================================================================
+
+/**
+ * @brief retry policy built from the configuration macros.
+ */
+#define BMS_DEFAULT_POLICY	{ BMS_FRAME_RETRIES, BMS_RESPONSE_LATENCY_MS, BMS_BACKOFF_BASE_MS, BMS_BACKOFF_MAX_MS, BMS_OFFLINE_AFTER, BMS_PROBE_PERIOD_MS }
+
+/**
+ * @brief device used by the single BMS API (attach_transport(), bms_read() ...), kept for the existing firmware.
+ */
+static bms_device default_device={
+	.transport=NULL,
+	.module_addr=UPPER_CMPTR_ADDR,
+	.strings_count=STRINGS_COUNT,
+	.temp_sensor_count=TEMP_SENSOR_COUNT,
+	.stat=NULL,
+	.snapshot=NULL,
+	.policy=BMS_DEFAULT_POLICY,
+	.health=BMS_HEALTH_ONLINE,
+	.cmd_state=BMS_CMD_IDLE
+};
+
+
+//==================================================================================== PRIVATE ROUTINES =========================================================================================
+
+#if ((_FULL_READ_ACCESS | _SOC_IV_ACCESS | _MIN_MAX_VOLT_ACCESS | _MOS_CHRG_DISCHRG_STATUS_ACCESS) == 0x01)
+/**
+ * @brief Reads a big endian 16 bit value out of a data field.
+ */
+static uint16_t bms_be16(const uint8_t* src){
+	return (uint16_t)(((uint16_t)src[0]<<8) | src[1]);
+}
+#endif
+
+#if ((_FULL_READ_ACCESS | _SOC_IV_ACCESS) == 0x01)
+/**
+ * @brief Decodes the SOC_TOTAL_IV data field.
+ */
+static void bms_decode_soc_iv(RT_Battery_status* stat, const uint8_t* data){
+	stat->cum_total_voltage=bms_be16(data+0);
+	stat->gath_total_voltage=bms_be16(data+2);
+	stat->current=bms_be16(data+4);
+	stat->soc=bms_be16(data+6);
+}
+#endif
+
+#if ((_FULL_READ_ACCESS | _MIN_MAX_VOLT_ACCESS) == 0x01)
+/**
+ * @brief Decodes the MAX_MIN_VOLTAGE data field.
+ */
+static void bms_decode_min_max_volt(RT_Battery_status* stat, const uint8_t* data){
+	stat->max_cell_voltage_value=bms_be16(data+0);
+	stat->cell_count_with_max_voltage=data[2];
+	stat->min_cell_voltage_value=bms_be16(data+3);
+	stat->cell_count_with_min_voltage=data[5];
+}
+#endif
+
+#if ((_FULL_READ_ACCESS | _MOS_CHRG_DISCHRG_STATUS_ACCESS) == 0x01)
+/**
+ * @brief Decodes the CHRG_DISCHRG_MOS_STATUS data field.
+ */
+static void bms_decode_mos_status(RT_Battery_status* stat, const uint8_t* data){
+	stat->mos_state=data[0];
+	stat->chrg_mos_state=data[1];
+	stat->dischrg_mos_state=data[2];
+	stat->bms_life=data[3];
+	stat->remain_capacity=((uint32_t)bms_be16(data+4)<<16) | bms_be16(data+6);
+}
+#endif
+
+/**
+ * @brief macros for the per device item count giving the length of a multi frame response.
+ */
+#define BMS_COUNT_NONE		0x00	/**< fixed length				*/
+#define BMS_COUNT_STRINGS	0x01	/**< bms_device::strings_count items		*/
+#define BMS_COUNT_SENSORS	0x02	/**< bms_device::temp_sensor_count items	*/
+
+/**
+ * @brief structure describing how the response of one data ID is received and where it is stored.
+ */
+typedef struct {
+	uint8_t data_id;	/**< requested data ID												*/
+	uint8_t err_base;	/**< bms_read() error code of a transmit failure, +1 receive failure, +2 checksum failure, +3 frame sequence failure	*/
+	uint8_t multi_frame;	/**< 1 if data[0] carries the frame number and the payload follows it						*/
+	uint8_t frame_payload;	/**< useful bytes per frame											*/
+	uint16_t offset;	/**< destination offset inside RT_Battery_status								*/
+	uint16_t len;		/**< destination length, also gives the number of frames of multi frame responses				*/
+	uint8_t counted_by;	/**< BMS_COUNT_x, the device item count limiting len								*/
+	uint8_t item_size;	/**< bytes per counted item											*/
+	void (*decode)(RT_Battery_status* stat, const uint8_t* data);	/**< field decoder, NULL copies the payload to offset as is		*/
+} bms_data_id_desc;
+
+/**
+ * @brief table of the data IDs enabled by the access macros, in polling order.
+ */
+static const bms_data_id_desc data_id_table[]={
+#if ((_FULL_READ_ACCESS | _SOC_IV_ACCESS) == 0x01)
+	{ SOC_TOTAL_IV, BMS_ERR_BASE(SOC_TOTAL_IV), 0, MAX_DATA_SIZE, offsetof(RT_Battery_status, cum_total_voltage), MAX_DATA_SIZE, BMS_COUNT_NONE, 0, bms_decode_soc_iv },
+#endif
+#if ((_FULL_READ_ACCESS | _MIN_MAX_VOLT_ACCESS) == 0x01)
+	{ MAX_MIN_VOLTAGE, BMS_ERR_BASE(MAX_MIN_VOLTAGE), 0, MAX_DATA_SIZE-2, offsetof(RT_Battery_status, max_cell_voltage_value), MAX_DATA_SIZE-2, BMS_COUNT_NONE, 0, bms_decode_min_max_volt },
+#endif
+#if ((_FULL_READ_ACCESS | _MIN_MAX_TEMP_ACCESS) == 0x01)
+	{ MAX_MIN_TEMPERATURE, BMS_ERR_BASE(MAX_MIN_TEMPERATURE), 0, MAX_DATA_SIZE-4, offsetof(RT_Battery_status, max_temp_val_40), MAX_DATA_SIZE-4, BMS_COUNT_NONE, 0, NULL },
+#endif
+#if ((_FULL_READ_ACCESS | _MOS_CHRG_DISCHRG_STATUS_ACCESS) == 0x01)
+	{ CHRG_DISCHRG_MOS_STATUS, BMS_ERR_BASE(CHRG_DISCHRG_MOS_STATUS), 0, MAX_DATA_SIZE, offsetof(RT_Battery_status, mos_state), MAX_DATA_SIZE, BMS_COUNT_NONE, 0, bms_decode_mos_status },
+#endif
+#if ((_FULL_READ_ACCESS | _STATUS_INFO1_ACCESS) == 0x01)
+	{ STATUS_INFO_1, BMS_ERR_BASE(STATUS_INFO_1), 0, MAX_DATA_SIZE-3, offsetof(RT_Battery_status, battery_string_count), MAX_DATA_SIZE-3, BMS_COUNT_NONE, 0, NULL },
+#endif
+#if ((_FULL_READ_ACCESS | _CELL_VOLT_ACCESS) == 0x01)
+	{ CELL_VOLTAGE, BMS_ERR_BASE(CELL_VOLTAGE), 1, CELL_VOLTS_PER_FRAME*MONOMER_VOLTAGE_SIZE, offsetof(RT_Battery_status, cell_voltages), STRINGS_COUNT*MONOMER_VOLTAGE_SIZE, BMS_COUNT_STRINGS, MONOMER_VOLTAGE_SIZE, NULL },
+#endif
+#if ((_FULL_READ_ACCESS | _CELL_TEMP_ACCESS) == 0x01)
+	{ CELL_TEMPERATURE, BMS_ERR_BASE(CELL_TEMPERATURE), 1, CELL_TEMPS_PER_FRAME*SENT_TEMPERATURE_SIZE, offsetof(RT_Battery_status, cell_temperatures), TEMP_SENSOR_COUNT*SENT_TEMPERATURE_SIZE, BMS_COUNT_SENSORS, SENT_TEMPERATURE_SIZE, NULL },
+#endif
+#if ((_FULL_READ_ACCESS | _CELL_BALANCE_STATE_ACCESS) ==0x01)
+	{ CELL_BALANCE_STATE, BMS_ERR_BASE(CELL_BALANCE_STATE), 0, MAX_DATA_SIZE, offsetof(RT_Battery_status, cell_balance_states), sizeof(((RT_Battery_status*)0)->cell_balance_states), BMS_COUNT_NONE, 0, NULL },
+#endif
+#if ((_FULL_READ_ACCESS | _BATTERY_FAILURE_STATUS_ACCESS) == 0x01)
+	{ BATTERY_FAILURE_STATUS, BMS_ERR_BASE(BATTERY_FAILURE_STATUS), 0, MAX_DATA_SIZE, offsetof(RT_Battery_status, cell_sum_volt_level), MAX_DATA_SIZE, BMS_COUNT_NONE, 0, NULL },
+#endif
+	{ BMS_RESET, 0, 0, 0, 0, 0, BMS_COUNT_NONE, 0, NULL }	// end of table
+};
+
+#define DATA_ID_TABLE_SIZE	(sizeof(data_id_table)/sizeof(bms_data_id_desc)-1)
+
+/**
+ * @brief Looks up the table entry of a data ID.
+ * @param uint8_t data_id passes the data ID.
+ * @retval const bms_data_id_desc* returns the entry, NULL if the data ID is not enabled.
+ */
+static const bms_data_id_desc* bms_find_desc(uint8_t data_id){
+	for(uint8_t i=0;data_id_table[i].data_id!=BMS_RESET;i++){
+		if(data_id_table[i].data_id==data_id){
+			return &data_id_table[i];
+		}
+	}
+	return NULL;
+}
+
+/**
+ * @brief Destination length of a table entry for a device, multi frame responses shrink with the device item count.
+ */
+static uint16_t bms_desc_len(const bms_data_id_desc* desc, const bms_device* dev){
+	uint16_t len=desc->len;
+	if(desc->counted_by==BMS_COUNT_STRINGS){
+		len=(uint16_t)(dev->strings_count*desc->item_size);
+	}
+	else if(desc->counted_by==BMS_COUNT_SENSORS){
+		len=(uint16_t)(dev->temp_sensor_count*desc->item_size);
+	}
+	return (len<desc->len) ? len : desc->len;
+}
+
+/**
+ * @brief Number of response frames described by a table entry for a device.
+ */
+static uint8_t bms_desc_frames(const bms_data_id_desc* desc, const bms_device* dev){
+	if(!desc->multi_frame){
+		return 1;
+	}
+	uint16_t len=bms_desc_len(desc, dev);
+	return (len==0) ? 1 : (uint8_t)((len+desc->frame_payload-1)/desc->frame_payload);
+}
+
+/**
+ * @brief Stores the data field of a verified response frame as described by its table entry, multi frame responses are placed by their frame number data[0].
+ * @param bms_device* dev passes the device whose status buffer receives the data.
+ * @param const bms_data_id_desc* desc passes the table entry of the frame's data ID.
+ * @param const uart_prot_packet* frame passes the verified response frame.
+ * @retval void
+ */
+static void bms_store_frame(bms_device* dev, const bms_data_id_desc* desc, const uart_prot_packet* frame){
+	if(desc->decode!=NULL){
+		desc->decode(dev->stat, frame->data);
+	}
+	else{
+		uint16_t dev_len=bms_desc_len(desc, dev);
+		uint16_t offset=desc->multi_frame ? (uint16_t)(desc->frame_payload*frame->data[0]) : 0;
+		if(offset>=dev_len){
+			return;
+		}
+		uint16_t len=(dev_len-offset < desc->frame_payload) ? dev_len-offset : desc->frame_payload;
+		memcpy((uint8_t*)dev->stat+desc->offset+offset, frame->data+desc->multi_frame, len);
+	}
+	if(dev->delta!=NULL){
+		bms_delta_frame(dev->delta, dev->stat, frame->data_id, desc->multi_frame ? frame->data[0] : 0);	// only the fields of this frame are compared
+	}
+}
+
+/**
+ * @brief Sends a frame carrying a value in data[0] and waits for the BMS to echo its data ID, the frames still due for the requests in flight are skipped.
+ * @param bms_device* dev passes the device.
+ * @param uint8_t data_id passes the data ID of the frame.
+ * @param uint8_t value passes data[0].
+ * @param uint8_t backlog passes the number of frames the BMS still sends before the echo.
+ * @param uart_prot_packet* echo passes the memory where the echo is stored.
+ * @retval uint8_t returns 0 on success, BMS_ERR_CMD_TX or BMS_ERR_CMD_NO_ACK.
+ */
+static uint8_t bms_exchange(bms_device* dev, uint8_t data_id, uint8_t value, uint8_t backlog, uart_prot_packet* echo){
+	uart_prot_packet packet2send;
+	bms_device_build_request(dev, data_id, &packet2send);
+	packet2send.chksum=(uint8_t)(packet2send.chksum+value);
+	packet2send.data[0]=value;
+	if(bms_transport_transmit(dev->transport, (uint8_t*)&packet2send, sizeof(uart_prot_packet), bms_device_timeout_ms(dev, 1))!=BMS_TRANSPORT_OK){
+		return BMS_ERR_CMD_TX;
+	}
+	for(uint8_t i=0;i<=backlog;i++){
+		if(bms_transport_receive(dev->transport, (uint8_t*)echo, sizeof(uart_prot_packet), bms_device_timeout_ms(dev, (i==0) ? backlog+2 : 1))!=BMS_TRANSPORT_OK){
+			break;
+		}
+		if(verify_checksum(echo)==0x01 && echo->data_id==data_id){
+			return 0;
+		}
+	}
+	return BMS_ERR_CMD_NO_ACK;
+}
+
+/**
+ * @brief Takes the posted command of a device and runs it, a FET command is confirmed by reading back CHRG_DISCHRG_MOS_STATUS (stored in the status buffer when the group is enabled).
+ * @param bms_device* dev passes the device.
+ * @param uint8_t backlog passes the number of frames the BMS still sends for the requests in flight.
+ * @retval uint8_t returns 0 when nothing was posted or the command succeeded, one of the BMS_ERR_CMD_x codes otherwise.
+ */
+static uint8_t bms_run_command(bms_device* dev, uint8_t backlog){
+	uint8_t expected=BMS_CMD_PENDING;
+	if(!__atomic_compare_exchange_n(&dev->cmd_state, &expected, BMS_CMD_BUSY, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)){
+		return 0;
+	}
+	uint16_t cmd=__atomic_load_n(&dev->cmd, __ATOMIC_RELAXED);
+	uint8_t cmd_id=(uint8_t)(cmd>>8);
+	uint8_t value=(uint8_t)cmd;
+	uart_prot_packet frame;
+	uint8_t ret=BMS_ERR_CMD_NO_ACK;
+
+	for(uint8_t attempt=0;attempt<=dev->policy.retries && ret!=0;attempt++){
+		ret=bms_exchange(dev, cmd_id, value, (attempt==0) ? backlog : 0, &frame);
+	}
+	if(ret==0 && cmd_id!=BMS_RESET){
+		ret=bms_exchange(dev, CHRG_DISCHRG_MOS_STATUS, 0x00, 0, &frame);
+		if(ret==0){
+			uint8_t opened=bms_device_begin_update(dev);	// idle command, otherwise published with the preempted read
+			bms_device_store_frame(dev, &frame);
+			if(opened){
+				bms_device_publish(dev);
+			}
+			ret=(frame.data[(cmd_id==CHRG_FET) ? 1 : 2]==value) ? 0 : BMS_ERR_CMD_NOT_CONFIRMED;
+		}
+		else{
+			ret=BMS_ERR_CMD_NOT_CONFIRMED;
+		}
+	}
+
+	dev->cmd_error=ret;
+	expected=BMS_CMD_BUSY;
+	__atomic_compare_exchange_n(&dev->cmd_state, &expected, BMS_CMD_DONE, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED);	// stays pending if a new command was posted meanwhile
+	return ret;
+}
+
+/**
+ * @brief structure of a data ID in flight, the received frames are tracked per frame number so that a response can be completed across several requests.
+ */
+typedef struct {
+	const bms_data_id_desc* desc;
+	uint8_t frames;		/**< frames of one response					*/
+	uint8_t arrived;	/**< frames of the current response seen, valid or not	*/
+	uint8_t retries;	/**< extra requests sent for this data ID			*/
+	uint8_t last_error;	/**< 2 checksum or 3 sequence, added to err_base		*/
+	uint16_t missing;	/**< bit n set while frame n has not been stored		*/
+	uint16_t seen;		/**< bit n set once frame n of the current response arrived	*/
+	uint32_t sent_us;	/**< end of the request, instrumentation tick			*/
+} bms_inflight;
+
+/**
+ * @brief Sends the request of an in flight data ID and starts a new response for it, the frames already stored stay stored.
+ * @param bms_device* dev passes the device.
+ * @param bms_inflight* req passes the in flight data ID.
+ * @param uint32_t timeout passes the transmit timeout.
+ * @retval uint8_t returns one of the BMS_TRANSPORT_x codes.
+ */
+static uint8_t bms_request(bms_device* dev, bms_inflight* req, uint32_t timeout){
+	uart_prot_packet packet2send;
+	bms_device_build_request(dev, req->desc->data_id, &packet2send);
+	req->arrived=0;
+	req->seen=0;
+	bms_id_stats* id=bms_stats_id(dev->stats, req->desc->data_id);
+	if(id==NULL){
+		return bms_transport_transmit(dev->transport, (uint8_t*)&packet2send, sizeof(uart_prot_packet), timeout);
+	}
+	uint32_t start=bms_stats_now(dev->stats);
+	uint8_t ret=bms_transport_transmit(dev->transport, (uint8_t*)&packet2send, sizeof(uart_prot_packet), timeout);
+	req->sent_us=bms_stats_now(dev->stats);
+	id->requests++;
+	id->retries+=(req->retries!=0) ? 1 : 0;	// retries is counted up just before a request is sent again
+	id->tx_bytes+=sizeof(uart_prot_packet);
+	if(dev->stats->time_us!=NULL){
+		bms_stats_latency(id, BMS_STATS_TX, req->sent_us-start);
+	}
+	return ret;
+}
+
+/**
+ * @brief Receives a frame in one transfer, so that frame oriented transports (bms_stream.h, the capture transport) see whole frames. When the device is instrumented with a tick,
+ * 	  the arrival of the first byte is taken one frame wire time before the end of the transfer : a response is clocked in back to back, the last byte closes the frame.
+ * @param bms_device* dev passes the device.
+ * @param uart_prot_packet* frame passes the memory where the frame is stored.
+ * @param uint32_t timeout passes the receive timeout.
+ * @param uint32_t* first_us passes the memory where the tick of the first byte is stored, left as is without tick.
+ * @retval uint8_t returns one of the BMS_TRANSPORT_x codes.
+ */
+static uint8_t bms_receive(bms_device* dev, uart_prot_packet* frame, uint32_t timeout, uint32_t* first_us){
+	uint8_t ret=bms_transport_receive(dev->transport, (uint8_t*)frame, sizeof(uart_prot_packet), timeout);
+	if(ret==BMS_TRANSPORT_OK && dev->stats!=NULL && dev->stats->time_us!=NULL){
+		*first_us=dev->stats->time_us()-bms_transport_wire_time_us(dev->transport, sizeof(uart_prot_packet));
+	}
+	return ret;
+}
+
+/**
+ * @brief Counts a frame received for an in flight data ID, after its arrived count was updated : bytes, first byte latency of the response and the response once complete.
+ * @param bms_device* dev passes the device.
+ * @param const bms_inflight* req passes the in flight data ID.
+ * @param uint32_t first_us passes the tick of the frame's first byte.
+ * @retval void
+ */
+static void bms_count_frame(bms_device* dev, const bms_inflight* req, uint32_t first_us){
+	bms_id_stats* id=bms_stats_id(dev->stats, req->desc->data_id);
+	if(id==NULL){
+		return;
+	}
+	id->rx_bytes+=sizeof(uart_prot_packet);
+	if(req->arrived==req->frames){
+		id->responses++;
+	}
+	if(dev->stats->time_us==NULL){
+		return;
+	}
+	if(req->arrived==1){
+		int32_t first=(int32_t)(first_us-req->sent_us);	// a frame already buffered when the request ended gives a negative estimate
+		bms_stats_latency(id, BMS_STATS_FIRST_BYTE, (first>0) ? (uint32_t)first : 0);
+	}
+	if(req->arrived==req->frames){
+		bms_stats_latency(id, BMS_STATS_RESPONSE, dev->stats->time_us()-req->sent_us);
+	}
+}
+
+/**
+ * @brief Table driven request engine, requests the listed data IDs keeping up to depth requests in flight and matches every response frame back to its request by the echoed data_id.
+ * 	  Frames of multi frame responses are placed by their frame number data[0] in any order, once a response is over with frames still missing (corrupted, duplicated or out of range)
+ * 	  the data ID is requested again, up to policy.retries times, and only the missing frames are taken from the new response.
+ * 	  Every transfer is bounded by bms_device_timeout_ms(), a request left unanswered is retried like an incomplete response.
+ * 	  The in flight list is the FIFO of the responses still expected in send order, a data ID requested again moves to its tail, and timeouts, corrupted and stale frames are
+ * 	  charged to its head, the response on the wire.
+ * 	  A command posted meanwhile (bms_device_post_command()) is run at the next frame boundary and the read ends with BMS_ERR_PREEMPTED.
+ * @param bms_device* dev passes the device to be read.
+ * @param const bms_data_id_desc* const* descs passes the table entries in request order.
+ * @param uint8_t total passes the number of entries.
+ * @param uint8_t depth passes the number of requests allowed in flight, 1 for the plain request/response sequence.
+ * @retval uint8_t returns 0 on success, the error code of the failing data ID (err_base+x) or BMS_ERR_PREEMPTED.
+ */
+static uint8_t bms_transact(bms_device* dev, const bms_data_id_desc* const* descs, uint8_t total, uint8_t depth){
+	bms_inflight inflight[BMS_PIPELINE_MAX_DEPTH];
+	uint8_t inflight_count=0;
+	uint8_t sent=0;
+	uart_prot_packet packet2recv;
+
+	while(sent<total || inflight_count!=0){
+		if(__atomic_load_n(&dev->cmd_state, __ATOMIC_ACQUIRE)==BMS_CMD_PENDING){	// frame boundary, a posted command goes before the rest of the read
+			uint8_t backlog=0;
+			for(uint8_t i=0;i<inflight_count;i++){
+				backlog+=inflight[i].frames-inflight[i].arrived;
+			}
+			bms_run_command(dev, backlog);
+			return BMS_ERR_PREEMPTED;
+		}
+		while(sent<total && inflight_count<depth){
+			bms_inflight* req=&inflight[inflight_count];
+			req->desc=descs[sent];
+			req->frames=bms_desc_frames(descs[sent], dev);
+			req->retries=0;
+			req->last_error=3;
+			req->missing=(uint16_t)((1UL<<req->frames)-1);
+			if(bms_request(dev, req, bms_device_timeout_ms(dev, 1))!=BMS_TRANSPORT_OK){
+				return descs[sent]->err_base;
+			}
+			inflight_count++;
+			sent++;
+		}
+
+		// the requests just sent may still be on the wire ahead of the expected frame.
+		uint32_t timeout=bms_device_timeout_ms(dev, inflight_count+1);
+		uint32_t first_us=0;
+		uint8_t slot=0;
+
+		if(bms_receive(dev, &packet2recv, timeout, &first_us)!=BMS_TRANSPORT_OK){
+			bms_id_stats* id=bms_stats_id(dev->stats, inflight[0].desc->data_id);
+			if(id!=NULL){
+				id->timeouts++;
+			}
+			if(inflight[0].missing!=0 && inflight[0].retries>=dev->policy.retries){
+				return inflight[0].desc->err_base+1;
+			}
+			inflight[0].arrived=inflight[0].frames;	// the rest of the response is lost, requested again below if still needed
+		}
+		else if(verify_checksum(&packet2recv)!=0x01){
+			inflight[0].arrived++;	// responses come in send order, the corrupted frame belongs to the response at the head
+			inflight[0].last_error=2;
+			bms_id_stats* id=bms_stats_id(dev->stats, inflight[0].desc->data_id);
+			if(id!=NULL){
+				id->checksum_errors++;
+			}
+			bms_count_frame(dev, &inflight[0], first_us);
+		}
+		else{
+			while(slot<inflight_count && inflight[slot].desc->data_id!=packet2recv.data_id){
+				slot++;
+			}
+			if(slot==inflight_count){	// stale frame of a timed out or preempted request, dropped and charged to the oldest request like a corrupted frame, so that a peer repeating them cannot hold the read past bms_device_worst_case_ms()
+				if(dev->stats!=NULL){
+					dev->stats->unexpected_ids++;
+				}
+				slot=0;
+				inflight[0].arrived++;
+				inflight[0].last_error=3;
+			}
+			else{
+				bms_inflight* req=&inflight[slot];
+				uint8_t seq=req->desc->multi_frame ? packet2recv.data[0] : 0;
+				bms_id_stats* id=bms_stats_id(dev->stats, req->desc->data_id);
+				req->arrived++;
+				if(id!=NULL){
+					id->frames++;
+					id->sequence_errors+=(seq>=req->frames || (req->seen & (1U<<seq))) ? 1 : 0;
+				}
+				if(seq>=req->frames){
+					req->last_error=3;	// incorrect frame sequence.
+				}
+				else{
+					if(req->missing & (1U<<seq)){
+						bms_store_frame(dev, req->desc, &packet2recv);
+						req->missing&=(uint16_t)~(1U<<seq);
+					}
+					req->seen|=(uint16_t)(1U<<seq);
+				}
+				bms_count_frame(dev, req, first_us);
+			}
+		}
+
+		bms_inflight* req=&inflight[slot];
+		if(req->missing==0 && req->arrived>=req->frames){	// a repeated response is consumed to its end so that its remaining frames are not taken for the next data ID
+			inflight_count--;
+			for(uint8_t i=slot;i<inflight_count;i++){
+				inflight[i]=inflight[i+1];
+			}
+		}
+		else if(req->missing!=0 && req->arrived>=req->frames){
+			if(req->retries>=dev->policy.retries){
+				return req->desc->err_base+req->last_error;
+			}
+			bms_inflight retried=*req;	// its new response comes after the ones of the requests already in flight, it goes to the tail
+			for(uint8_t i=slot;i+1<inflight_count;i++){
+				inflight[i]=inflight[i+1];
+			}
+			req=&inflight[inflight_count-1];
+			*req=retried;
+			req->retries++;
+			if(bms_request(dev, req, bms_device_timeout_ms(dev, 1))!=BMS_TRANSPORT_OK){
+				return req->desc->err_base;
+			}
+		}
+	}
+	return 0;
+}
+
+
 //==================================================================================== ROUTINE DEFINITIONS ======================================================================================
 
 
@@ -27,7 +506,7 @@
  * @retval uint8_t returns the checksum value.
  */
 uint8_t get_checksum(uint8_t data_id){
-	return (((uint16_t)START_FLAG + (uint16_t)UPPER_CMPTR_ADDR + (uint16_t)MAX_DATA_SIZE + (uint16_t data_id))&(0xFF));
+	return (((uint16_t)START_FLAG + (uint16_t)UPPER_CMPTR_ADDR + (uint16_t)MAX_DATA_SIZE + (uint16_t)data_id)&(0xFF));
 }
 
 /**
@@ -41,201 +520,538 @@ uint8_t verify_checksum(uart_prot_packet* recvd_packet){
 		chksum+=(((uint8_t*)recvd_packet)[cnt]);
 	}
 	
-	return ((chksum&(0x00FF) == ((uint8_t*)recvd_packet)[sizeof(uart_prot_packet)-1]) ? 1 : 0) ;
+	return (((chksum&(0x00FF)) == ((uint8_t*)recvd_packet)[sizeof(uart_prot_packet)-1]) ? 1 : 0) ;
 
 }
 
 /**
- * @brief Send the UART command packets in order to read from the connected BMS, the data that will be read from BMS will depend on the above macro settings.
- * @param RT_Battery_status* passes the address of the battery status structure where the response of the sent command will be received.
- * @retval uint8_t returns error codes, 0 on success and non zero on failure.
+ * @brief Initializes a device context with the compile time defaults (UPPER_CMPTR_ADDR, STRINGS_COUNT, TEMP_SENSOR_COUNT, retry policy macros), online.
+ * @param bms_device* dev passes the pointer to the device context.
+ * @param bms_transport* transport passes the port towards this BMS.
+ * @param RT_Battery_status* stat passes the status buffer of this BMS.
+ * @retval void
  */
-uint8_t read(RT_Battery_status* stat){
+void bms_device_init(bms_device* dev, bms_transport* transport, RT_Battery_status* stat){
+	dev->transport=transport;
+	dev->module_addr=UPPER_CMPTR_ADDR;
+	dev->strings_count=STRINGS_COUNT;
+	dev->temp_sensor_count=TEMP_SENSOR_COUNT;
+	dev->stat=stat;
+	dev->snapshot=NULL;
+	dev->policy=(bms_retry_policy)BMS_DEFAULT_POLICY;
+	dev->health=BMS_HEALTH_ONLINE;
+	dev->fail_streak=0;
+	dev->next_attempt_ms=0;
+	dev->cmd_state=BMS_CMD_IDLE;
+	dev->cmd=0;
+	dev->cmd_error=0;
+	dev->stats=NULL;
+	dev->delta=NULL;
+}
 
-uart_prot_packet packet2send={
-	.start_flag=START_FLAG,
-	.module_addr=UPPER_CMPTR_ADDR,
-	.data_len=MAX_DATA_SIZE
-};
-memset(packet2send.data,MAX_DATA_SIZE,0x00);
+/**
+ * @brief Builds the request frame of a data ID for a device.
+ * @param const bms_device* dev passes the device, its module_addr is used.
+ * @param uint8_t data_id passes the requested data ID.
+ * @param uart_prot_packet* packet passes the memory where the frame will be built.
+ * @retval void
+ */
+void bms_device_build_request(const bms_device* dev, uint8_t data_id, uart_prot_packet* packet){
+	memset(packet,0x00,sizeof(uart_prot_packet));
+	packet->start_flag=START_FLAG;
+	packet->module_addr=dev->module_addr;
+	packet->data_id=data_id;
+	packet->data_len=MAX_DATA_SIZE;
+	packet->chksum=(uint8_t)(((uint16_t)START_FLAG + (uint16_t)dev->module_addr + (uint16_t)MAX_DATA_SIZE + (uint16_t)data_id)&(0xFF));
+}
 
-uart_prot_packet packet2recv;
+/**
+ * @brief Number of response frames a device sends for a data ID.
+ * @param const bms_device* dev passes the device, its strings/sensors counts are used.
+ * @param uint8_t data_id passes the requested data ID.
+ * @retval uint8_t returns the number of frames, 1 for the data IDs disabled by the access macros.
+ */
+uint8_t bms_device_frames(const bms_device* dev, uint8_t data_id){
+	const bms_data_id_desc* desc=bms_find_desc(data_id);
+	return (desc!=NULL) ? bms_desc_frames(desc, dev) : 1;
+}
 
+/**
+ * @brief Stores a verified response frame in the status buffer of a device, for engines receiving the frames themselves (bms_multi.h).
+ * @param bms_device* dev passes the device.
+ * @param const uart_prot_packet* frame passes the verified response frame.
+ * @retval uint8_t returns 0 on success and BMS_ERR_DATA_ID_DISABLED if the frame's group is disabled.
+ */
+uint8_t bms_device_store_frame(bms_device* dev, const uart_prot_packet* frame){
+	const bms_data_id_desc* desc=bms_find_desc(frame->data_id);
+	if(desc==NULL){
+		return BMS_ERR_DATA_ID_DISABLED;
+	}
+	bms_store_frame(dev, desc, frame);
+	return 0;
+}
 
-#if ((_FULL_READ_ACCESS | _SOC_IV_ACCESS) == 0x01)
-	packet2send.data_id=SOC_TOTAL_IV;
-	packet2send.chksum=get_checksum(SOC_TOTAL_IV);
-	if(HAL_UART_Transmit(UART_STRUCT_PTR, (uint8_t*)packet2send, sizeof(uart_prot_packet), HAL_MAX_DELAY)!=HAL_OK){
-		return 1;
+/**
+ * @brief Error code base of a data ID, see the error codes of bms_read().
+ * @param uint8_t data_id passes the data ID.
+ * @retval uint8_t returns the code of a transmit failure for the data ID, +1 receive, +2 checksum, +3 frame sequence, BMS_ERR_DATA_ID_DISABLED for disabled groups.
+ */
+uint8_t bms_data_id_err_base(uint8_t data_id){
+	const bms_data_id_desc* desc=bms_find_desc(data_id);
+	return (desc!=NULL) ? desc->err_base : BMS_ERR_DATA_ID_DISABLED;
+}
+
+/**
+ * @brief Data ID whose error code a bms_read() error code is.
+ * @param uint8_t error passes the error code.
+ * @retval uint8_t returns the data ID, 0 for 0 and the codes of no data ID (BMS_PIPE_UNEXPECTED_ID and above, except the STATUS_INFO_1 ones).
+ */
+uint8_t bms_error_data_id(uint8_t error){
+	for(uint8_t i=0;data_id_table[i].data_id!=BMS_RESET && error!=0;i++){
+		if(error>=data_id_table[i].err_base && error<=data_id_table[i].err_base+2+data_id_table[i].multi_frame){
+			return data_id_table[i].data_id;
+		}
 	}
-	if(HAL_UART_Receive(UART_STRUCT_PTR, (uint8_t*)packet2recv, sizeof(uart_prot_packet), HAL_MAX_DELAY)!=HAL_OK){
-		return 2;
+	return 0;
+}
+
+/**
+ * @brief Attaches an instrumentation block to a device, the following transfers are counted in it.
+ * @param bms_device* dev passes the device.
+ * @param bms_stats* stats passes the block initialized by bms_stats_init(), NULL detaches it.
+ * @retval void
+ */
+void bms_device_attach_stats(bms_device* dev, bms_stats* stats){
+	dev->stats=stats;
+}
+
+/**
+ * @brief Attaches a change tracker to a device, every frame stored from then on marks the fields it changed beyond their deadband (see bms_delta.h).
+ * @param bms_device* dev passes the device.
+ * @param struct bms_delta* delta passes the tracker initialized by bms_delta_init(), NULL detaches it.
+ * @retval void
+ */
+void bms_device_attach_delta(bms_device* dev, struct bms_delta* delta){
+	dev->delta=delta;
+}
+
+/**
+ * @brief Reads the data IDs selected at runtime from a device keeping up to depth requests in flight.
+ * @param bms_device* dev passes the device to be read.
+ * @param uint16_t mask passes the selected data IDs, OR of BMS_DATA_ID_MASK(data_id) values, BMS_MASK_ALL selects every enabled group.
+ * @param uint8_t depth passes the number of requests allowed in flight, 1 for the plain request/response sequence, at most BMS_PIPELINE_MAX_DEPTH.
+ * @retval uint8_t returns 0 on success, the bms_read() error code of the failing data ID or BMS_ERR_DATA_ID_DISABLED.
+ */
+uint8_t bms_device_read_mask(bms_device* dev, uint16_t mask, uint8_t depth){
+	const bms_data_id_desc* descs[DATA_ID_TABLE_SIZE+1];
+	uint8_t total=0;
+
+	if(mask!=BMS_MASK_ALL && (mask & ~bms_enabled_mask())!=0){
+		return BMS_ERR_DATA_ID_DISABLED;
 	}
-	
-	if(verify_checksum(&packet2recv)!=0x01){
-		return 3;
+	for(uint8_t i=0;data_id_table[i].data_id!=BMS_RESET;i++){
+		if(mask & BMS_DATA_ID_MASK(data_id_table[i].data_id)){
+			descs[total++]=&data_id_table[i];
+		}
 	}
-	memcpy(packet2recv.data,(uint8_t*)&(stat->cum_total_voltage),MAX_DATA_SIZE);
-	memset(&packet2recv,sizeof(uart_prot_packet),0x00);
-#endif
 
-#if ((_FULL_READ_ACCESS | _MIN_MAX_VOLT_ACCESS) == 0x01)
-	packet2send.data_id=MAX_MIN_VOLTAGE;
-	packet2send.chksum=get_checksum(MAX_MIN_VOLTAGE);
-	if(HAL_UART_Transmit(UART_STRUCT_PTR, (uint8_t*)packet2send, sizeof(uart_prot_packet), HAL_MAX_DELAY)!=HAL_OK){
-		return 4;
+	if(depth==0){
+		depth=1;
 	}
-	if(HAL_UART_Receive(UART_STRUCT_PTR, (uint8_t*)packet2recv, sizeof(uart_prot_packet), HAL_MAX_DELAY)!=HAL_OK){
-		return 5;
+	if(depth>BMS_PIPELINE_MAX_DEPTH){
+		depth=BMS_PIPELINE_MAX_DEPTH;
 	}
-	
-	if(verify_checksum(&packet2recv)!=0x01){
-		return 6;
-	}
-	memcpy(packet2recv.data,(uint8_t*)&(stat->max_cell_voltage_value),MAX_DATA_SIZE-2);
-	memset(&packet2recv,sizeof(uart_prot_packet),0x00);
-#endif
+	bms_device_begin_update(dev);
+	uint8_t ret=bms_transact(dev, descs, total, depth);
+	bms_device_publish(dev);	// groups read before a failure are published too, the others keep their previous values
+	bms_stats_read_done(dev->stats, ret, bms_error_data_id(ret));
+	return ret;
+}
 
-#if ((_FULL_READ_ACCESS | _MIN_MAX_TEMP_ACCESS) == 0x01)
-	packet2send.data_id=MAX_MIN_TEMPERATURE;
-	packet2send.chksum=get_checksum(MAX_MIN_TEMPERATURE);
-	if(HAL_UART_Transmit(UART_STRUCT_PTR, (uint8_t*)packet2send, sizeof(uart_prot_packet), HAL_MAX_DELAY)!=HAL_OK){
-		return 7;
+/**
+ * @brief Publishes the reads of a device to a snapshot instead of a plain status buffer, the device's stat is then managed by the driver.
+ * @param bms_device* dev passes the device.
+ * @param bms_snapshot* snap passes the snapshot, zeroed by this call, NULL goes back to dev->stat being set by the application.
+ * @retval void
+ */
+void bms_device_attach_snapshot(bms_device* dev, bms_snapshot* snap){
+	if(snap!=NULL){
+		memset(snap, 0x00, sizeof(bms_snapshot));
+		dev->stat=&snap->buf[0];
 	}
-	if(HAL_UART_Receive(UART_STRUCT_PTR, (uint8_t*)packet2recv, sizeof(uart_prot_packet), HAL_MAX_DELAY)!=HAL_OK){
-		return 8;
+	dev->snapshot=snap;
+}
+
+/**
+ * @brief Opens the update of the snapshot of a device, the back buffer takes the published values and becomes dev->stat. Does nothing without a snapshot or if already open.
+ * 	  For engines receiving the frames themselves (bms_multi.h), bms_device_read_mask() does it on its own.
+ * @param bms_device* dev passes the device.
+ * @retval uint8_t returns 1 if this call opened the update and 0 otherwise.
+ */
+uint8_t bms_device_begin_update(bms_device* dev){
+	bms_snapshot* snap=dev->snapshot;
+	if(snap==NULL || snap->writing){
+		return 0;
 	}
-	
-	if(verify_checksum(&packet2recv)!=0x01){
-		return 9;
+	uint32_t seq=snap->seq;	// only the polling context writes seq
+	__atomic_thread_fence(__ATOMIC_RELEASE);	// the flip of the last publish is ordered before the back buffer is written again, its late readers see seq moved and retry
+	RT_Battery_status* back=&snap->buf[(seq+1)&1];
+	memcpy(back, &snap->buf[seq&1], sizeof(RT_Battery_status));	// once per read, the readers of the previous publication are told to retry by the next flip
+	dev->stat=back;
+	snap->writing=1;
+	return 1;
+}
+
+/**
+ * @brief Publishes the back buffer of the snapshot of a device opened by bms_device_begin_update(). Does nothing without an open update.
+ * @param bms_device* dev passes the device.
+ * @retval void
+ */
+void bms_device_publish(bms_device* dev){
+	bms_snapshot* snap=dev->snapshot;
+	if(snap==NULL || !snap->writing){
+		return;
 	}
-	memcpy(packet2recv.data,(uint8_t*)&(stat->max_temp_val_40),MAX_DATA_SIZE-4);
-	memset(&packet2recv,sizeof(uart_prot_packet),0x00);
-#endif
+	__atomic_store_n(&snap->seq, snap->seq+1, __ATOMIC_RELEASE);
+	snap->writing=0;
+}
 
-#if ((_FULL_READ_ACCESS | _MOS_CHRG_DISCHRG_STATUS_ACCESS) == 0x01)
-	packet2send.data_id=CHRG_DISCHRG_MOS_STATUS;
-	packet2send.chksum=get_checksum(CHRG_DISCHRG_MOS_STATUS);
-	if(HAL_UART_Transmit(UART_STRUCT_PTR, (uint8_t*)packet2send, sizeof(uart_prot_packet), HAL_MAX_DELAY)!=HAL_OK){
-		return 10;
+/**
+ * @brief Starts reading a snapshot in place, to be closed by bms_snapshot_read_retry().
+ * 	  Example : do{ seq=bms_snapshot_read_begin(&snap, &s); soc=s->soc; current=s->current; }while(bms_snapshot_read_retry(&snap, seq));
+ * @param const bms_snapshot* snap passes the snapshot.
+ * @param const RT_Battery_status** stat passes the memory where the pointer to the published status is stored.
+ * @retval uint32_t returns the sequence number to be passed to bms_snapshot_read_retry(), it also tells how many reads were published.
+ */
+uint32_t bms_snapshot_read_begin(const bms_snapshot* snap, const RT_Battery_status** stat){
+	uint32_t seq=__atomic_load_n(&snap->seq, __ATOMIC_ACQUIRE);
+	*stat=&snap->buf[seq&1];
+	return seq;
+}
+
+/**
+ * @brief Ends reading a snapshot in place.
+ * @param const bms_snapshot* snap passes the snapshot.
+ * @param uint32_t seq passes the value returned by bms_snapshot_read_begin().
+ * @retval uint8_t returns 1 if the status was overwritten meanwhile and the values read must be discarded, 0 if they are consistent.
+ */
+uint8_t bms_snapshot_read_retry(const bms_snapshot* snap, uint32_t seq){
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);	// the values read are ordered before the check
+	return (__atomic_load_n(&snap->seq, __ATOMIC_RELAXED)!=seq) ? 1 : 0;	// the buffer read is only written again after the next flip
+}
+
+/**
+ * @brief Copies a consistent snapshot, for readers keeping the values.
+ * @param const bms_snapshot* snap passes the snapshot.
+ * @param RT_Battery_status* stat passes the memory where the status is copied.
+ * @retval uint32_t returns the sequence number of the copy.
+ */
+uint32_t bms_snapshot_copy(const bms_snapshot* snap, RT_Battery_status* stat){
+	const RT_Battery_status* src;
+	uint32_t seq;
+	do{
+		seq=bms_snapshot_read_begin(snap, &src);
+		memcpy(stat, src, sizeof(RT_Battery_status));
+	}while(bms_snapshot_read_retry(snap, seq));
+	return seq;
+}
+
+/**
+ * @brief Deadline of a transfer, wire time of the frames it waits for at the transport baud rate plus the response latency of the policy.
+ * @param const bms_device* dev passes the device whose transport and policy are used.
+ * @param uint8_t frames passes the number of frames the transfer may have to wait for.
+ * @retval uint32_t returns the timeout in milliseconds.
+ */
+uint32_t bms_device_timeout_ms(const bms_device* dev, uint8_t frames){
+	uint32_t wire_us=bms_transport_wire_time_us(dev->transport, (uint32_t)frames*sizeof(uart_prot_packet));
+	return (wire_us+999U)/1000U+dev->policy.latency_ms;
+}
+
+/**
+ * @brief Upper bound of the time bms_device_read_mask() can take, every retry exhausted and every transfer running to its deadline, for watchdog budgets.
+ * @param const bms_device* dev passes the device, its transport must be attached.
+ * @param uint16_t mask passes the selected data IDs.
+ * @param uint8_t depth passes the number of requests allowed in flight.
+ * @retval uint32_t returns the bound in milliseconds.
+ */
+uint32_t bms_device_worst_case_ms(const bms_device* dev, uint16_t mask, uint8_t depth){
+	uint32_t total_ms=0;
+	depth=(depth==0) ? 1 : (depth>BMS_PIPELINE_MAX_DEPTH) ? BMS_PIPELINE_MAX_DEPTH : depth;
+	for(uint8_t i=0;data_id_table[i].data_id!=BMS_RESET;i++){
+		if(mask & BMS_DATA_ID_MASK(data_id_table[i].data_id)){
+			uint32_t attempt_ms=bms_device_timeout_ms(dev, 1)+bms_desc_frames(&data_id_table[i], dev)*bms_device_timeout_ms(dev, depth+1);
+			total_ms+=(1U+dev->policy.retries)*attempt_ms;
+		}
 	}
-	if(HAL_UART_Receive(UART_STRUCT_PTR, (uint8_t*)packet2recv, sizeof(uart_prot_packet), HAL_MAX_DELAY)!=HAL_OK){
-		return 11;
+	return total_ms;
+}
+
+/**
+ * @brief Tells whether a device is to be polled now according to its health.
+ * @param const bms_device* dev passes the device.
+ * @param uint32_t now_ms passes the current millisecond tick.
+ * @retval uint8_t returns BMS_ADMIT_POLL, BMS_ADMIT_PROBE for an offline pack whose probe is due, BMS_ERR_BACKOFF or BMS_ERR_OFFLINE when the pack is to be skipped.
+ */
+uint8_t bms_device_admit(const bms_device* dev, uint32_t now_ms){
+	if(dev->health==BMS_HEALTH_ONLINE){
+		return BMS_ADMIT_POLL;
 	}
-	
-	if(verify_checksum(&packet2recv)!=0x01){
-		return 12;
+	if((int32_t)(now_ms-dev->next_attempt_ms)<0){
+		return (dev->health==BMS_HEALTH_OFFLINE) ? BMS_ERR_OFFLINE : BMS_ERR_BACKOFF;
 	}
-	memcpy(packet2recv.data,(uint8_t*)&(stat->mos_state),MAX_DATA_SIZE);
-	memset(&packet2recv,sizeof(uart_prot_packet),0x00);
-#endif
+	return (dev->health==BMS_HEALTH_OFFLINE) ? BMS_ADMIT_PROBE : BMS_ADMIT_POLL;
+}
 
-#if ((_FULL_READ_ACCESS | _STATUS_INFO1_ACCESS) == 0x01)
-	packet2send.data_id=STATUS_INFO_1;
-	packet2send.chksum=get_checksum(STATUS_INFO_1);
-	if(HAL_UART_Transmit(UART_STRUCT_PTR, (uint8_t*)packet2send, sizeof(uart_prot_packet), HAL_MAX_DELAY)!=HAL_OK){
-		return 10;
+/**
+ * @brief Updates the health of a device with the result of a poll or probe.
+ * @param bms_device* dev passes the device.
+ * @param uint32_t now_ms passes the current millisecond tick.
+ * @param uint8_t error passes the bms_read() error code of the poll, 0 on success.
+ * @retval void
+ */
+void bms_device_report(bms_device* dev, uint32_t now_ms, uint8_t error){
+	if(error==0){
+		dev->health=BMS_HEALTH_ONLINE;
+		dev->fail_streak=0;
+		return;
 	}
-	if(HAL_UART_Receive(UART_STRUCT_PTR, (uint8_t*)packet2recv, sizeof(uart_prot_packet), HAL_MAX_DELAY)!=HAL_OK){
-		return 11;
+	if(dev->fail_streak<0xFF){
+		dev->fail_streak++;
 	}
-	
-	if(verify_checksum(&packet2recv)!=0x01){
-		return 12;
+	if(dev->fail_streak>=dev->policy.offline_after){
+		dev->health=BMS_HEALTH_OFFLINE;
+		dev->next_attempt_ms=now_ms+dev->policy.probe_period_ms;
+		return;
 	}
-	memcpy(packet2recv.data,(uint8_t*)&(stat->battery_string_count),MAX_DATA_SIZE-3);
-	memset(&packet2recv,sizeof(uart_prot_packet),0x00);
-#endif
+	uint32_t backoff=(uint32_t)dev->policy.backoff_base_ms<<((dev->fail_streak<16) ? dev->fail_streak-1 : 15);
+	dev->health=BMS_HEALTH_DEGRADED;
+	dev->next_attempt_ms=now_ms+((backoff<dev->policy.backoff_max_ms) ? backoff : dev->policy.backoff_max_ms);
+}
 
-#if ((_FULL_READ_ACCESS | _CELL_VOLT_ACCESS) == 0x01)
-	packet2send.data_id=CELL_VOLTAGE;
-	packet2send.chksum=get_checksum(CELL_VOLTAGE);
+/**
+ * @brief Mask of the single frame request used to probe an offline pack, the first enabled data ID.
+ * @retval uint16_t returns the mask.
+ */
+uint16_t bms_probe_mask(void){
+	uint16_t enabled=bms_enabled_mask();
+	return (uint16_t)(enabled & (uint16_t)(~enabled+1U));
+}
 
-	if(HAL_UART_Transmit(UART_STRUCT_PTR, (uint8_t*)packet2send, sizeof(uart_prot_packet), HAL_MAX_DELAY)!=HAL_OK){
-		return 13;
+/**
+ * @brief Health aware read of a device : skips degraded packs during their backoff and offline packs between probes, probes offline packs with one data ID, and updates the health.
+ * 	  Never takes longer than bms_device_worst_case_ms(dev, mask, depth).
+ * @param bms_device* dev passes the device to be read.
+ * @param uint16_t mask passes the selected data IDs.
+ * @param uint8_t depth passes the number of requests allowed in flight.
+ * @param uint32_t now_ms passes the current millisecond tick.
+ * @retval uint8_t returns 0 on success, BMS_ERR_BACKOFF or BMS_ERR_OFFLINE for a skipped pack, the bms_device_read_mask() error code otherwise (a successful probe also returns 0, the full read follows on the next call).
+ */
+uint8_t bms_device_poll(bms_device* dev, uint16_t mask, uint8_t depth, uint32_t now_ms){
+	uint8_t admit=bms_device_admit(dev, now_ms);
+	if(admit!=BMS_ADMIT_POLL && admit!=BMS_ADMIT_PROBE){
+		return admit;
 	}
+	uint8_t ret=bms_device_read_mask(dev, (admit==BMS_ADMIT_PROBE) ? bms_probe_mask() : mask, depth);
+	if(ret!=BMS_ERR_DATA_ID_DISABLED && ret!=BMS_ERR_PREEMPTED){
+		bms_device_report(dev, now_ms, ret);
+	}
+	return ret;
+}
 
-	for(uint8_t i=0;i<(uint8_t)(STRINGS_COUNT/ CELL_VOLTS_PER_FRAME)+1;i++){
-		if(HAL_UART_Receive(UART_STRUCT_PTR, (uint8_t*)packet2recv, sizeof(uart_prot_packet), HAL_MAX_DELAY)!=HAL_OK){
-			return 14;
-		}
+/**
+ * @brief Posts a command to a device, safe from an ISR or another task than the polling one. The polling context runs it at the next frame boundary, preempting its read,
+ * 	  or through bms_device_service_command() when it is idle. A command posted before the previous one was taken replaces it, the last fault reaction wins.
+ * @param bms_device* dev passes the device.
+ * @param uint8_t cmd_id passes DISCHRG_FET, CHRG_FET or BMS_RESET.
+ * @param uint8_t value passes BMS_FET_ON/BMS_FET_OFF for the FET commands, 0 for BMS_RESET.
+ * @retval uint8_t returns 0 on success and BMS_ERR_CMD_INVALID for another data ID.
+ */
+uint8_t bms_device_post_command(bms_device* dev, uint8_t cmd_id, uint8_t value){
+	if(cmd_id!=DISCHRG_FET && cmd_id!=CHRG_FET && cmd_id!=BMS_RESET){
+		return BMS_ERR_CMD_INVALID;
+	}
+	__atomic_store_n(&dev->cmd, (uint16_t)((cmd_id<<8) | value), __ATOMIC_RELAXED);
+	__atomic_store_n(&dev->cmd_state, BMS_CMD_PENDING, __ATOMIC_RELEASE);
+	return 0;
+}
 
-		if(verify_checksum(&packet2recv)!=0x01){
-			return 15;
-		}
+/**
+ * @brief Runs the posted command of a device if any, to be called by the polling context between reads or at a frame boundary of its own read engine.
+ * 	  The FET commands are confirmed by reading back CHRG_DISCHRG_MOS_STATUS.
+ * @param bms_device* dev passes the device.
+ * @param uint8_t backlog passes the number of response frames the BMS still sends for a read in flight, skipped while waiting for the echo, 0 between reads.
+ * @retval uint8_t returns 0 when no command was pending or it succeeded, one of the BMS_ERR_CMD_x codes otherwise (also left in cmd_error).
+ */
+uint8_t bms_device_service_command(bms_device* dev, uint8_t backlog){
+	return bms_run_command(dev, backlog);
+}
 
-		if(packet2recv.data[0]!=i || packet2recv.data[0]==0xFF){
-			return 16;	// incorrect frame sequence.
-		}
-	
-		memcpy(packet2recv.data+1,(stat->cell_voltages)+(3*i),MAX_DATA_SIZE-2);	// will copy 6 bytes of data to the stat structure.
-		memset(&packet2recv,sizeof(uart_prot_packet),0x00);
-	}
-#endif
+/**
+ * @brief Posts and runs a command on a device, blocking, from the polling context.
+ * @param bms_device* dev passes the device.
+ * @param uint8_t cmd_id passes DISCHRG_FET, CHRG_FET or BMS_RESET.
+ * @param uint8_t value passes BMS_FET_ON/BMS_FET_OFF for the FET commands, 0 for BMS_RESET.
+ * @retval uint8_t returns 0 on success and one of the BMS_ERR_CMD_x codes on failure.
+ */
+uint8_t bms_device_command(bms_device* dev, uint8_t cmd_id, uint8_t value){
+	uint8_t ret=bms_device_post_command(dev, cmd_id, value);
+	return (ret!=0) ? ret : bms_run_command(dev, 0);
+}
 
-#if ((_FULL_READ_ACCESS | _CELL_TEMP_ACCESS) == 0x01)
-	packet2send.data_id=CELL_TEMPERATURE;
-	packet2send.chksum=get_checksum(CELL_TEMPERATURE);	
+/**
+ * @brief Selects the transport through which all the following read operations communicate with the BMS.
+ * @param bms_transport* transport passes the pointer to a filled transport (see bms_transport_hal.h / bms_transport_linux.h), must outlive the read operations.
+ * @retval void
+ */
+void attach_transport(bms_transport* transport){
+	default_device.transport=transport;
+}
 
-	if(HAL_UART_Transmit(UART_STRUCT_PTR, (uint8_t*)packet2send, sizeof(uart_prot_packet), HAL_MAX_DELAY)!=HAL_OK){
-		return 17;
-	}
-	
-	for(uint8_t i=0;i<(uint8_t)(TEMP_SENSOR_COUNT/CELL_TEMPS_PER_FRAME)+1;i++){
-		if(HAL_UART_Receive(UART_STRUCT_PTR, (uint8_t*)packet2recv, sizeof(uart_prot_packet), HAL_MAX_DELAY)!=HAL_OK){
-			return 18;
-		}
-		
-		if(verify_checksum(&packet2recv)!=0x01){
-			return 19;
-		}
+/**
+ * @brief Send the UART command packets in order to read from the connected BMS, the data that will be read from BMS will depend on the above macro settings.
+ * @param RT_Battery_status* passes the address of the battery status structure where the response of the sent command will be received.
+ * @retval uint8_t returns error codes, 0 on success and non zero on failure.
+ */
+uint8_t bms_read(RT_Battery_status* stat){
+	return bms_read_mask(stat, BMS_MASK_ALL);
+}
 
-		if(packet2recv.data[0]!=i || packet2recv.data[0]==0xFF){
-			return 20;	// incorrect frame sequence.
-		}
-		memcpy(packet2recv.data+1,(stat->cell_temperatures)+(7*i),MAX_DATA_SIZE-1);	// will copy 6 bytes of data to the stat structure.
-		memset(&packet2recv,sizeof(uart_prot_packet),0x00);
+/**
+ * @brief Reads only the data IDs selected at runtime, groups disabled by the access macros can't be selected.
+ * @param RT_Battery_status* stat passes the address of the battery status structure where the responses will be received.
+ * @param uint16_t mask passes the selected data IDs, OR of BMS_DATA_ID_MASK(data_id) values, BMS_MASK_ALL selects every enabled group.
+ * @retval uint8_t returns 0 on success, the bms_read() error code of the failing data ID, or BMS_ERR_DATA_ID_DISABLED if the mask selects a disabled group.
+ */
+uint8_t bms_read_mask(RT_Battery_status* stat, uint16_t mask){
+	return bms_read_mask_pipelined(stat, mask, 1);
+}
+
+/**
+ * @brief Pipelined variant of bms_read_mask(), keeps up to depth requests outstanding so that the next request is already queued in the BMS while the previous response is being sent.
+ * 	  Every response frame is matched back to its request by the echoed data_id.
+ * @param RT_Battery_status* stat passes the address of the battery status structure where the responses will be received.
+ * @param uint16_t mask passes the selected data IDs, OR of BMS_DATA_ID_MASK(data_id) values.
+ * @param uint8_t depth passes the number of requests allowed in flight, 1 gives the behaviour of bms_read_mask(), at most BMS_PIPELINE_MAX_DEPTH.
+ * @retval uint8_t returns 0 on success, the bms_read() error code of the failing data ID or BMS_ERR_DATA_ID_DISABLED.
+ */
+uint8_t bms_read_mask_pipelined(RT_Battery_status* stat, uint16_t mask, uint8_t depth){
+	if(default_device.snapshot==NULL){
+		default_device.stat=stat;
 	}
-#endif
+	return bms_device_read_mask(&default_device, mask, depth);
+}
 
-#if ((_FULL_READ_ACCESS | _CELL_BALANCE_STATE_ACCESS) ==0x01)
-	packet2send.data_id=CELL_BALANCE_STATE;
-	packet2send.chksum=get_checksum(CELL_BALANCE_STATE);
+/**
+ * @brief Pipelined variant of bms_read(), reads every enabled group keeping up to depth requests in flight.
+ * @param RT_Battery_status* stat passes the address of the battery status structure where the responses will be received.
+ * @param uint8_t depth passes the number of requests allowed in flight, 1 gives the behaviour of bms_read(), at most BMS_PIPELINE_MAX_DEPTH.
+ * @retval uint8_t returns 0 on success, the bms_read() error code of the failing data ID.
+ */
+uint8_t bms_read_pipelined(RT_Battery_status* stat, uint8_t depth){
+	return bms_read_mask_pipelined(stat, BMS_MASK_ALL, depth);
+}
 
-	if(HAL_UART_Transmit(UART_STRUCT_PTR, (uint8_t*)packet2send, sizeof(uart_prot_packet), HAL_MAX_DELAY)!=HAL_OK){
-		return 21;
+/**
+ * @brief Reads a single data ID, used by the polling scheduler (bms_scheduler.h) to refresh each group at its own rate.
+ * @param RT_Battery_status* stat passes the address of the battery status structure where the response will be received.
+ * @param uint8_t data_id passes the data ID.
+ * @retval uint8_t returns 0 on success, the bms_read() error code of the data ID or BMS_ERR_DATA_ID_DISABLED.
+ */
+uint8_t bms_read_data_id(RT_Battery_status* stat, uint8_t data_id){
+	if(data_id<SOC_TOTAL_IV || data_id>BATTERY_FAILURE_STATUS){
+		return BMS_ERR_DATA_ID_DISABLED;
 	}
+	return bms_read_mask(stat, BMS_DATA_ID_MASK(data_id));
+}
 
-	if(HAL_UART_Receive(UART_STRUCT_PTR, (uint8_t*)packet2recv, sizeof(uart_prot_packet), HAL_MAX_DELAY)!=HAL_OK){
-		return 22;
-	}
-	
-	if(verify_checksum(&packet2recv)!=0x01){
-		return 23;
+/**
+ * @brief Number of response frames the BMS sends for a data ID.
+ * @param uint8_t data_id passes the requested data ID.
+ * @retval uint8_t returns the number of frames, 1 for the data IDs disabled by the access macros.
+ */
+uint8_t bms_response_frames(uint8_t data_id){
+	return bms_device_frames(&default_device, data_id);
+}
+
+/**
+ * @brief Bitmask of the data IDs enabled by the access macros.
+ * @retval uint16_t returns the OR of BMS_DATA_ID_MASK(data_id) of every enabled group.
+ */
+uint16_t bms_enabled_mask(void){
+	uint16_t enabled=0;
+	for(uint8_t i=0;data_id_table[i].data_id!=BMS_RESET;i++){
+		enabled|=BMS_DATA_ID_MASK(data_id_table[i].data_id);
 	}
-	
-	memcpy(packet2recv.data,(stat->cell_balance_states),(uint8_t)(STRINGS_COUNT//CELL_BALANCE_STATE_PER_BYTE));	
-	memset(&packet2recv,sizeof(uart_prot_packet),0x00);
-#endif
+	return enabled;
+}
 
-#if ((_FULL_READ_ACCESS | _BATTERY_FAILURE_STATUS_ACCESS) == 0x01)
-	packet2send.data_id=BATTERY_FAILURE_STATUS;
-	packet2send.chksum=get_checksum(BATTERY_FAILURE_STATUS);
+/**
+ * @brief Same as bms_device_post_command() for the BMS selected by attach_transport().
+ * @param uint8_t cmd_id passes DISCHRG_FET, CHRG_FET or BMS_RESET.
+ * @param uint8_t value passes BMS_FET_ON/BMS_FET_OFF for the FET commands, 0 for BMS_RESET.
+ * @retval uint8_t returns 0 on success and BMS_ERR_CMD_INVALID for another data ID.
+ */
+uint8_t bms_post_command(uint8_t cmd_id, uint8_t value){
+	return bms_device_post_command(&default_device, cmd_id, value);
+}
 
-	if(HAL_UART_Transmit(UART_STRUCT_PTR, (uint8_t*)packet2send, sizeof(uart_prot_packet), HAL_MAX_DELAY)!=HAL_OK){
-		return 24;
-	}
+/**
+ * @brief Same as bms_device_command() for the BMS selected by attach_transport().
+ * @param uint8_t cmd_id passes DISCHRG_FET, CHRG_FET or BMS_RESET.
+ * @param uint8_t value passes BMS_FET_ON/BMS_FET_OFF for the FET commands, 0 for BMS_RESET.
+ * @retval uint8_t returns 0 on success and one of the BMS_ERR_CMD_x codes on failure.
+ */
+uint8_t bms_command(uint8_t cmd_id, uint8_t value){
+	return bms_device_command(&default_device, cmd_id, value);
+}
 
-	if(HAL_UART_Receive(UART_STRUCT_PTR, (uint8_t*)packet2recv, sizeof(uart_prot_packet), HAL_MAX_DELAY)!=HAL_OK){
-		return 25;
-	}
-	
-	if(verify_checksum(&packet2recv)!=0x01){
-		return 26;
+/**
+ * @brief Progress of the last command posted to the BMS selected by attach_transport().
+ * @param uint8_t* error passes the memory where the BMS_ERR_CMD_x code (0 on success) is stored once the state is BMS_CMD_DONE, can be NULL.
+ * @retval uint8_t returns one of the BMS_CMD_x states.
+ */
+uint8_t bms_command_status(uint8_t* error){
+	uint8_t state=__atomic_load_n(&default_device.cmd_state, __ATOMIC_ACQUIRE);
+	if(error!=NULL){
+		*error=default_device.cmd_error;
 	}
-	
-	memcpy(packet2recv.data,(uint8_t*)&(stat->cell_sum_volt_level),MAX_DATA_SIZE);	
-	memset(&packet2recv,sizeof(uart_prot_packet),0x00);
-#endif
+	return state;
+}
+
+/**
+ * @brief Same as bms_device_attach_snapshot() for the BMS selected by attach_transport(), the stat argument of the bms_read() functions is then ignored and can be NULL.
+ * @param bms_snapshot* snap passes the snapshot, NULL detaches it.
+ * @retval void
+ */
+void bms_attach_snapshot(bms_snapshot* snap){
+	bms_device_attach_snapshot(&default_device, snap);
 }
 
+/**
+ * @brief Same as bms_device_attach_stats() for the BMS selected by attach_transport().
+ * @param bms_stats* stats passes the block, NULL detaches it.
+ * @retval void
+ */
+void bms_attach_stats(bms_stats* stats){
+	bms_device_attach_stats(&default_device, stats);
+}
+
+/**
+ * @brief Same as bms_device_attach_delta() for the BMS selected by attach_transport().
+ * @param struct bms_delta* delta passes the tracker, NULL detaches it.
+ * @retval void
+ */
+void bms_attach_delta(struct bms_delta* delta){
+	bms_device_attach_delta(&default_device, delta);
+}
+
+#if !defined(__linux__)
+/**
+ * @brief Same as bms_read(), kept for the existing firmware, not available on Linux hosts where it would clash with read(2).
+ * @param RT_Battery_status* passes the address of the battery status structure where the response of the sent command will be received.
+ * @retval uint8_t returns error codes, 0 on success and non zero on failure.
+ */
+uint8_t read(RT_Battery_status* stat){
+	return bms_read(stat);
+}
+#endif
@@ -1,6 +1,9 @@
 #ifndef BMS_UART_COMM_H
 #define BMS_UART_COMM_H
 
+#include "bms_transport.h"
+#include "bms_stats.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -32,7 +35,7 @@ extern "C" {
 #define BMS_MASTER_ADDR		0x01	/**< Address for the microcontroller chip inside BMS		*/
 #define GPRS_ADDR		0x20	/**< Address for the GPRS chip inside BMS			*/
 #define UPPER_CMPTR_ADDR	0x40	/**< Address for the host computer/microcontroller inside BMS	*/
-#define BLUETOOTH_APP_ADDR	0x80	/**< Address for the bluetooth chip inside BMS
+#define BLUETOOTH_APP_ADDR	0x80	/**< Address for the bluetooth chip inside BMS			*/
 
 /**
  *@brief macros for custom protocol packet structure for UART since UART is a serial protocol, thus its responsibility of hardware designed to choose a specific protocol packet format.
@@ -66,20 +69,30 @@ extern "C" {
 /**
  * @brief macro for user's BMS strings count and temperature sensors count, must be modified by user as per needs.
  */
+#ifndef STRINGS_COUNT
 #define STRINGS_COUNT		16	// must be modified by user, default value assumed w.r.t. BMS with 16 strings.
+#endif
+#ifndef TEMP_SENSOR_COUNT
 #define TEMP_SENSOR_COUNT	4	// must be modified by user, default value assumed w.r.t. BMS with 4 temperature sensors, minimum 4 according to Indian government law for EV(s)
+#endif
+#if (STRINGS_COUNT > MAX_BMS_STRING_COUNT) || (TEMP_SENSOR_COUNT > MAX_BMS_TEMPERATURE_SENSOR_COUNT)
+#error "STRINGS_COUNT and TEMP_SENSOR_COUNT can't exceed the DALY BMS hardware limits"
+#endif
 
 
 /**
  * @brief macros for UART interface.
  */
 #define UART_DEFAULT_BAUDRATE		9600	/**< units : bps (bits per second)	*/
-#define UART_STRUCT_PTR (UART_HandleTypeDef*)(uart_handle_pointer)	// need to be set by programmer.
+#define UART_STRUCT_PTR (UART_HandleTypeDef*)(uart_handle_pointer)	// need to be set by programmer, passed to bms_transport_hal_init().
 
 /**
  * @brief macros for selecting only the required memory regions corresponding to the specific data field saving memory.
+ *	  These only decide which groups can be read by the firmware image, the groups actually read are selected at runtime through bms_read_mask().
  */
-#define _FULL_READ_ACCESS 	0x00		/**< Need to be selected by the programmer, 0x00 means this option is disabled, 0x01 means full access is enabled */
+#ifndef _FULL_READ_ACCESS
+#define _FULL_READ_ACCESS 	0x00		/**< Need to be selected by the programmer, 0x00 means this option is disabled, 0x01 means full access is enabled, can also be passed from the build command (-D_FULL_READ_ACCESS=0x01) */
+#endif
 
 #if _FULL_READ_ACCESS == 0x00
 	/* All folloing macro can be set to either 0x00 or 0x01, if set 0x00, corresponding memory can't be accessed and thus space won't be allocated to the data for that region in RT_Battery_status structure, 	  
@@ -104,6 +117,90 @@ extern "C" {
 #define SENT_TEMPERATURE_SIZE			0x01	// each temperature sensor requires 1 byte of the space for its data being sent.
 #define CELL_BALANCE_STATE_PER_BYTE		0x08
 
+/**
+ * @brief macros for the pipelined read mode (bms_read_pipelined()).
+ */
+#define BMS_PIPELINE_MAX_DEPTH		0x04	/**< upper limit of requests in flight									*/
+#ifndef BMS_PIPELINE_DEPTH
+#define BMS_PIPELINE_DEPTH		0x02	/**< requests in flight, 2 keeps one request waiting in the BMS while the previous one is answered, to be tuned with Host/bms_bench against what the firmware buffers	*/
+#endif
+
+/**
+ * @brief macros for the transaction deadlines, no transfer waits forever : every transmit and receive is bounded by the wire time of the frames it waits for at the transport baud rate
+ *	  plus the BMS response latency, so that a disconnected or browned-out BMS costs a known time (see bms_device_worst_case_ms()).
+ */
+#ifndef BMS_RESPONSE_LATENCY_MS
+#define BMS_RESPONSE_LATENCY_MS		10	/**< BMS processing time and OS/driver jitter allowed on top of the wire time of each transfer	*/
+#endif
+
+/**
+ * @brief macros for the frame reassembly, a response with corrupted, duplicated or missing frames is requested again and only the frames still missing are taken from the new response.
+ */
+#ifndef BMS_FRAME_RETRIES
+#define BMS_FRAME_RETRIES		0x02	/**< extra requests of a data ID before its error code is returned, 0 restores the abort on the first bad frame	*/
+#endif
+
+/**
+ * @brief macros for the device health (bms_device_poll()), a failing pack is backed off exponentially, then declared offline and only probed every BMS_PROBE_PERIOD_MS with one single frame request.
+ */
+#define BMS_HEALTH_ONLINE		0x00	/**< last poll succeeded						*/
+#define BMS_HEALTH_DEGRADED		0x01	/**< last polls failed, retried after an exponential backoff		*/
+#define BMS_HEALTH_OFFLINE		0x02	/**< BMS_OFFLINE_AFTER polls failed in a row, only probed		*/
+#ifndef BMS_BACKOFF_BASE_MS
+#define BMS_BACKOFF_BASE_MS		100	/**< wait after the first failed poll, doubled on each further failure	*/
+#endif
+#ifndef BMS_BACKOFF_MAX_MS
+#define BMS_BACKOFF_MAX_MS		2000	/**< upper limit of the backoff						*/
+#endif
+#ifndef BMS_OFFLINE_AFTER
+#define BMS_OFFLINE_AFTER		0x04	/**< failed polls in a row before the pack is declared offline		*/
+#endif
+#ifndef BMS_PROBE_PERIOD_MS
+#define BMS_PROBE_PERIOD_MS		5000	/**< period of the probes sent to an offline pack			*/
+#endif
+#define BMS_MAX_RESPONSE_FRAMES		((MAX_BMS_STRING_COUNT+CELL_VOLTS_PER_FRAME-1)/CELL_VOLTS_PER_FRAME)	/**< 16 frames of 0x95 for 48 strings, one bit each in the reassembly mask	*/
+
+/**
+ * @brief macros for the runtime group selection (bms_read_mask()), one bit per data ID.
+ */
+#define BMS_DATA_ID_MASK(data_id)	((uint16_t)(1U<<((data_id)-SOC_TOTAL_IV)))
+#define BMS_MASK_ALL			0x01FF	/**< every group enabled by the access macros	*/
+
+/**
+ * @brief error codes of bms_read() and its variants.
+ *	  1 to 26 and 36 to 38 identify the failing data ID and step : 0x90 -> 1 to 3, 0x91 -> 4 to 6, 0x92 -> 7 to 9, 0x93 -> 10 to 12, 0x94 -> 36 to 38, 0x95 -> 13 to 16,
+ *	  0x96 -> 17 to 20, 0x97 -> 21 to 23, 0x98 -> 24 to 26, in the order transmit failure, receive failure, checksum failure, frame sequence failure (bms_error_data_id() maps a code back).
+ *	  Receive, checksum and sequence failures are returned only once policy.retries (BMS_FRAME_RETRIES) extra requests of the data ID could not complete its response.
+ */
+#define BMS_ERR_BASE(data_id)		((uint8_t)(((data_id)==SOC_TOTAL_IV) ? 1 : ((data_id)==MAX_MIN_VOLTAGE) ? 4 : ((data_id)==MAX_MIN_TEMPERATURE) ? 7 : \
+					((data_id)==CHRG_DISCHRG_MOS_STATUS) ? 10 : ((data_id)==STATUS_INFO_1) ? 36 : ((data_id)==CELL_VOLTAGE) ? 13 : \
+					((data_id)==CELL_TEMPERATURE) ? 17 : ((data_id)==CELL_BALANCE_STATE) ? 21 : ((data_id)==BATTERY_FAILURE_STATUS) ? 24 : 0))	/**< transmit failure code of a data ID, the one definition of the C table and bms_variant.hpp	*/
+#define BMS_PIPE_UNEXPECTED_ID		27	/**< response data_id matches no request in flight, no longer returned : such stale frames are dropped, counted in bms_stats::unexpected_ids and charged to the oldest request in flight like a corrupted frame	*/
+#define BMS_ERR_DATA_ID_DISABLED	28	/**< the mask selects a group disabled by the access macros		*/
+#define BMS_ERR_BACKOFF			29	/**< poll skipped, the pack is degraded and its backoff has not elapsed	*/
+#define BMS_ERR_OFFLINE			30	/**< poll skipped, the pack is offline and no probe is due		*/
+#define BMS_ERR_PREEMPTED		31	/**< read interrupted at a frame boundary to run a posted command, the groups not read yet keep their old values	*/
+#define BMS_ERR_CMD_INVALID		32	/**< data ID is not DISCHRG_FET, CHRG_FET or BMS_RESET			*/
+#define BMS_ERR_CMD_TX			33	/**< command frame could not be sent					*/
+#define BMS_ERR_CMD_NO_ACK		34	/**< the BMS did not echo the command					*/
+#define BMS_ERR_CMD_NOT_CONFIRMED	35	/**< CHRG_DISCHRG_MOS_STATUS read back does not show the requested MOS state	*/
+
+/**
+ * @brief return values of bms_device_admit() besides BMS_ERR_BACKOFF and BMS_ERR_OFFLINE.
+ */
+#define BMS_ADMIT_POLL			0	/**< bms_device_admit() : poll the pack				*/
+#define BMS_ADMIT_PROBE			1	/**< bms_device_admit() : probe the offline pack with bms_probe_mask()	*/
+
+/**
+ * @brief macros for the command path (bms_device_post_command()), the command value is sent in data[0].
+ */
+#define BMS_FET_OFF			0x00	/**< DISCHRG_FET/CHRG_FET value opening the MOS			*/
+#define BMS_FET_ON			0x01	/**< DISCHRG_FET/CHRG_FET value closing the MOS			*/
+#define BMS_CMD_IDLE			0x00	/**< no command posted, or the last one was taken			*/
+#define BMS_CMD_PENDING			0x01	/**< posted, run at the next frame boundary of the polling context	*/
+#define BMS_CMD_BUSY			0x02	/**< on the wire							*/
+#define BMS_CMD_DONE			0x03	/**< finished, result in bms_device::cmd_error				*/
+
 /**
  * @brief MOS states macros
  */
@@ -147,8 +244,8 @@ typedef struct {
 
 #if ((_FULL_READ_ACCESS | _MIN_MAX_VOLT_ACCESS) == 0x01)
 	uint16_t max_cell_voltage_value;			// maximum cell voltage value (mV)
-	uint8_t cell_count_with_min_voltage;			// no. of cell with maximum voltage (mV)
-	uint16_t max_cell_voltage_value;			// minimum cell voltage value (mV)
+	uint8_t cell_count_with_max_voltage;			// no. of cell with maximum voltage (mV)
+	uint16_t min_cell_voltage_value;			// minimum cell voltage value (mV)
 	uint8_t cell_count_with_min_voltage;			// no. of cell with minimum voltage (mV)
 #endif
 
@@ -184,7 +281,7 @@ typedef struct {
 #endif
 
 #if ((_FULL_READ_ACCESS | _CELL_BALANCE_STATE_ACCESS) ==0x01)
-	uint8_t cell_balance_states[(uint8_t)(STRINGS_COUNT/CELL_BALANCE_STATE_PER_BYTE)];	// per byte contains cell states for 8 cells via 8 strings, the number of useful bit will be same as number of strings and since maximum strings can be 48, thus out of 8 bytes of data, only maximum 6 bytes are used for 48 cells via 48 strings, bit value 0 means closed and bit value 1 means open cell.
+	uint8_t cell_balance_states[(uint8_t)((STRINGS_COUNT+CELL_BALANCE_STATE_PER_BYTE-1)/CELL_BALANCE_STATE_PER_BYTE)];	// per byte contains cell states for 8 cells via 8 strings, the number of useful bit will be same as number of strings and since maximum strings can be 48, thus out of 8 bytes of data, only maximum 6 bytes are used for 48 cells via 48 strings, bit value 0 means closed and bit value 1 means open cell.
 #endif
 
 #if ((_FULL_READ_ACCESS | _BATTERY_FAILURE_STATUS_ACCESS) == 0x01)
@@ -192,13 +289,59 @@ typedef struct {
 	uint8_t chrg_dischrg_temp_level;
 	uint8_t chrg_dischrg_overI_soc_level;
 	uint8_t diff_volt_temp_level;
-	uint8_t chrg_dischrg_mos_info
+	uint8_t chrg_dischrg_mos_info;
 	uint8_t all_failures;
 	uint8_t all_faults;
 	uint8_t fault_code;
 #endif
 } RT_Battery_status;
 
+/**
+ * @brief structure of a status published to several reader tasks, double buffered behind a sequence counter (seqlock).
+ * 	  The polling context decodes a read into the back buffer and flips seq once the read is over, readers take buf[seq&1] in place and retry if seq moved meanwhile,
+ * 	  no lock is taken on either side and a reader never sees a half decoded read.
+ */
+typedef struct {
+	RT_Battery_status buf[2];	/**< buf[seq&1] is published, the other one is written by the polling context		*/
+	volatile uint32_t seq;		/**< number of reads published, readers check it did not move while reading		*/
+	uint8_t writing;		/**< 1 while the polling context fills the back buffer					*/
+} bms_snapshot;
+
+/**
+ * @brief structure of the retry policy of one BMS.
+ */
+typedef struct {
+	uint8_t retries;		/**< extra requests of a data ID whose response is incomplete, BMS_FRAME_RETRIES by default	*/
+	uint16_t latency_ms;		/**< added to the wire time of every transfer deadline, BMS_RESPONSE_LATENCY_MS by default	*/
+	uint16_t backoff_base_ms;	/**< wait after the first failed poll, doubled on each further failure			*/
+	uint16_t backoff_max_ms;	/**< upper limit of the backoff								*/
+	uint8_t offline_after;		/**< failed polls in a row before the pack is declared offline				*/
+	uint32_t probe_period_ms;	/**< period of the probes sent to an offline pack					*/
+} bms_retry_policy;
+
+struct bms_delta;	/**< change tracker, defined in bms_delta.h	*/
+
+/**
+ * @brief structure holding the context of one connected BMS, a rack of packs uses one device per pack (see bms_multi.h).
+ */
+typedef struct {
+	bms_transport* transport;	/**< port towards this BMS								*/
+	uint8_t module_addr;		/**< address placed in the request frames						*/
+	uint8_t strings_count;		/**< cells of this pack, at most STRINGS_COUNT, gives the number of 0x95 frames		*/
+	uint8_t temp_sensor_count;	/**< sensors of this pack, at most TEMP_SENSOR_COUNT, gives the number of 0x96 frames	*/
+	RT_Battery_status* stat;	/**< status buffer receiving the responses, the back buffer of snapshot during a read	*/
+	bms_snapshot* snapshot;		/**< NULL, or the snapshot the reads are published to (bms_device_attach_snapshot())	*/
+	bms_retry_policy policy;	/**< deadlines, retries and backoff, filled with the macro defaults by bms_device_init()	*/
+	uint8_t health;			/**< one of BMS_HEALTH_x								*/
+	uint8_t fail_streak;		/**< failed polls in a row								*/
+	uint32_t next_attempt_ms;	/**< time before which bms_device_poll() skips a degraded or offline pack		*/
+	volatile uint8_t cmd_state;	/**< one of BMS_CMD_x, written by bms_device_post_command() from any context		*/
+	volatile uint16_t cmd;		/**< posted command, data ID in the high byte and value in the low byte			*/
+	volatile uint8_t cmd_error;	/**< 0 or the BMS_ERR_CMD_x code of the last command run				*/
+	bms_stats* stats;		/**< NULL, or the instrumentation block the transfers are counted in (bms_device_attach_stats())	*/
+	struct bms_delta* delta;	/**< NULL, or the change tracker the stored frames are compared in (bms_device_attach_delta())	*/
+} bms_device;
+
 
 //======================================================================================== ROUTINE DECLARATION ===================================================================================================
 
@@ -216,12 +359,319 @@ uint8_t get_checksum(uint8_t data_id);
  */
 uint8_t verify_checksum(uart_prot_packet* recvd_packet);
 
+/**
+ * @brief Selects the transport through which all the following read operations communicate with the BMS.
+ * @param bms_transport* transport passes the pointer to a filled transport (see bms_transport_hal.h / bms_transport_linux.h), must outlive the read operations.
+ * @retval void
+ */
+void attach_transport(bms_transport* transport);
+
 /**
  * @brief Send the UART command packets in order to read from the connected BMS, the data that will be read from BMS will depend on the above macro settings.
  * @param RT_Battery_status* passes the address of the battery status structure where the response of the sent command will be received.
+ * @retval uint8_t returns error codes, 0 on success and non zero on failure.
+ */
+uint8_t bms_read(RT_Battery_status* stat);
+
+/**
+ * @brief Reads only the data IDs selected at runtime, groups disabled by the access macros can't be selected.
+ * @param RT_Battery_status* stat passes the address of the battery status structure where the responses will be received.
+ * @param uint16_t mask passes the selected data IDs, OR of BMS_DATA_ID_MASK(data_id) values, BMS_MASK_ALL selects every enabled group.
+ * @retval uint8_t returns 0 on success, the bms_read() error code of the failing data ID, or BMS_ERR_DATA_ID_DISABLED if the mask selects a disabled group.
+ */
+uint8_t bms_read_mask(RT_Battery_status* stat, uint16_t mask);
+
+/**
+ * @brief Pipelined variant of bms_read_mask(), keeps up to depth requests outstanding so that the next request is already queued in the BMS while the previous response is being sent.
+ * 	  Every response frame is matched back to its request by the echoed data_id.
+ * @param RT_Battery_status* stat passes the address of the battery status structure where the responses will be received.
+ * @param uint16_t mask passes the selected data IDs, OR of BMS_DATA_ID_MASK(data_id) values.
+ * @param uint8_t depth passes the number of requests allowed in flight, 1 gives the behaviour of bms_read_mask(), at most BMS_PIPELINE_MAX_DEPTH.
+ * @retval uint8_t returns 0 on success, the bms_read() error code of the failing data ID or BMS_ERR_DATA_ID_DISABLED.
+ */
+uint8_t bms_read_mask_pipelined(RT_Battery_status* stat, uint16_t mask, uint8_t depth);
+
+/**
+ * @brief Pipelined variant of bms_read(), reads every enabled group keeping up to depth requests in flight.
+ * @param RT_Battery_status* stat passes the address of the battery status structure where the responses will be received.
+ * @param uint8_t depth passes the number of requests allowed in flight, 1 gives the behaviour of bms_read(), at most BMS_PIPELINE_MAX_DEPTH.
+ * @retval uint8_t returns 0 on success, the bms_read() error code of the failing data ID.
+ */
+uint8_t bms_read_pipelined(RT_Battery_status* stat, uint8_t depth);
+
+/**
+ * @brief Reads a single data ID, used by the polling scheduler (bms_scheduler.h) to refresh each group at its own rate.
+ * @param RT_Battery_status* stat passes the address of the battery status structure where the response will be received.
+ * @param uint8_t data_id passes the data ID.
+ * @retval uint8_t returns 0 on success, the bms_read() error code of the data ID or BMS_ERR_DATA_ID_DISABLED.
+ */
+uint8_t bms_read_data_id(RT_Battery_status* stat, uint8_t data_id);
+
+/**
+ * @brief Number of response frames the BMS sends for a data ID.
+ * @param uint8_t data_id passes the requested data ID.
+ * @retval uint8_t returns the number of frames, 1 for the data IDs disabled by the access macros.
+ */
+uint8_t bms_response_frames(uint8_t data_id);
+
+/**
+ * @brief Bitmask of the data IDs enabled by the access macros.
+ * @retval uint16_t returns the OR of BMS_DATA_ID_MASK(data_id) of every enabled group.
+ */
+uint16_t bms_enabled_mask(void);
+
+/**
+ * @brief Initializes a device context with the compile time defaults (UPPER_CMPTR_ADDR, STRINGS_COUNT, TEMP_SENSOR_COUNT).
+ * @param bms_device* dev passes the pointer to the device context.
+ * @param bms_transport* transport passes the port towards this BMS.
+ * @param RT_Battery_status* stat passes the status buffer of this BMS.
+ * @retval void
+ */
+void bms_device_init(bms_device* dev, bms_transport* transport, RT_Battery_status* stat);
+
+/**
+ * @brief Reads the data IDs selected at runtime from a device keeping up to depth requests in flight.
+ * @param bms_device* dev passes the device to be read.
+ * @param uint16_t mask passes the selected data IDs, OR of BMS_DATA_ID_MASK(data_id) values, BMS_MASK_ALL selects every enabled group.
+ * @param uint8_t depth passes the number of requests allowed in flight, 1 for the plain request/response sequence, at most BMS_PIPELINE_MAX_DEPTH.
+ * @retval uint8_t returns 0 on success, the bms_read() error code of the failing data ID or BMS_ERR_DATA_ID_DISABLED.
+ */
+uint8_t bms_device_read_mask(bms_device* dev, uint16_t mask, uint8_t depth);
+
+/**
+ * @brief Builds the request frame of a data ID for a device.
+ * @param const bms_device* dev passes the device, its module_addr is used.
+ * @param uint8_t data_id passes the requested data ID.
+ * @param uart_prot_packet* packet passes the memory where the frame will be built.
+ * @retval void
+ */
+void bms_device_build_request(const bms_device* dev, uint8_t data_id, uart_prot_packet* packet);
+
+/**
+ * @brief Number of response frames a device sends for a data ID.
+ * @param const bms_device* dev passes the device, its strings/sensors counts are used.
+ * @param uint8_t data_id passes the requested data ID.
+ * @retval uint8_t returns the number of frames, 1 for the data IDs disabled by the access macros.
+ */
+uint8_t bms_device_frames(const bms_device* dev, uint8_t data_id);
+
+/**
+ * @brief Publishes the reads of a device to a snapshot instead of a plain status buffer, the device's stat is then managed by the driver.
+ * @param bms_device* dev passes the device.
+ * @param bms_snapshot* snap passes the snapshot, zeroed by this call, NULL goes back to dev->stat being set by the application.
  * @retval void
  */
-void read(RT_Battery_status* stat);
+void bms_device_attach_snapshot(bms_device* dev, bms_snapshot* snap);
+
+/**
+ * @brief Opens the update of the snapshot of a device, the back buffer takes the published values and becomes dev->stat. Does nothing without a snapshot or if already open.
+ * 	  For engines receiving the frames themselves (bms_multi.h), bms_device_read_mask() does it on its own.
+ * @param bms_device* dev passes the device.
+ * @retval uint8_t returns 1 if this call opened the update and 0 otherwise.
+ */
+uint8_t bms_device_begin_update(bms_device* dev);
+
+/**
+ * @brief Publishes the back buffer of the snapshot of a device opened by bms_device_begin_update(). Does nothing without an open update.
+ * @param bms_device* dev passes the device.
+ * @retval void
+ */
+void bms_device_publish(bms_device* dev);
+
+/**
+ * @brief Starts reading a snapshot in place, to be closed by bms_snapshot_read_retry().
+ * 	  Example : do{ seq=bms_snapshot_read_begin(&snap, &s); soc=s->soc; current=s->current; }while(bms_snapshot_read_retry(&snap, seq));
+ * @param const bms_snapshot* snap passes the snapshot.
+ * @param const RT_Battery_status** stat passes the memory where the pointer to the published status is stored.
+ * @retval uint32_t returns the sequence number to be passed to bms_snapshot_read_retry(), it also tells how many reads were published.
+ */
+uint32_t bms_snapshot_read_begin(const bms_snapshot* snap, const RT_Battery_status** stat);
+
+/**
+ * @brief Ends reading a snapshot in place.
+ * @param const bms_snapshot* snap passes the snapshot.
+ * @param uint32_t seq passes the value returned by bms_snapshot_read_begin().
+ * @retval uint8_t returns 1 if the status was overwritten meanwhile and the values read must be discarded, 0 if they are consistent.
+ */
+uint8_t bms_snapshot_read_retry(const bms_snapshot* snap, uint32_t seq);
+
+/**
+ * @brief Copies a consistent snapshot, for readers keeping the values.
+ * @param const bms_snapshot* snap passes the snapshot.
+ * @param RT_Battery_status* stat passes the memory where the status is copied.
+ * @retval uint32_t returns the sequence number of the copy.
+ */
+uint32_t bms_snapshot_copy(const bms_snapshot* snap, RT_Battery_status* stat);
+
+/**
+ * @brief Stores a verified response frame in the status buffer of a device, for engines receiving the frames themselves (bms_multi.h).
+ * @param bms_device* dev passes the device.
+ * @param const uart_prot_packet* frame passes the verified response frame.
+ * @retval uint8_t returns 0 on success and BMS_ERR_DATA_ID_DISABLED if the frame's group is disabled.
+ */
+uint8_t bms_device_store_frame(bms_device* dev, const uart_prot_packet* frame);
+
+/**
+ * @brief Error code base of a data ID, see the error codes of bms_read().
+ * @param uint8_t data_id passes the data ID.
+ * @retval uint8_t returns the code of a transmit failure for the data ID, +1 receive, +2 checksum, +3 frame sequence, BMS_ERR_DATA_ID_DISABLED for disabled groups.
+ */
+uint8_t bms_data_id_err_base(uint8_t data_id);
+
+/**
+ * @brief Data ID whose error code a bms_read() error code is.
+ * @param uint8_t error passes the error code.
+ * @retval uint8_t returns the data ID, 0 for 0 and the codes of no data ID (BMS_PIPE_UNEXPECTED_ID and above, except the STATUS_INFO_1 ones).
+ */
+uint8_t bms_error_data_id(uint8_t error);
+
+/**
+ * @brief Attaches an instrumentation block to a device, the following transfers are counted in it.
+ * @param bms_device* dev passes the device.
+ * @param bms_stats* stats passes the block initialized by bms_stats_init(), NULL detaches it.
+ * @retval void
+ */
+void bms_device_attach_stats(bms_device* dev, bms_stats* stats);
+
+/**
+ * @brief Attaches a change tracker to a device, every frame stored from then on marks the fields it changed beyond their deadband (see bms_delta.h).
+ * @param bms_device* dev passes the device.
+ * @param struct bms_delta* delta passes the tracker initialized by bms_delta_init(), NULL detaches it.
+ * @retval void
+ */
+void bms_device_attach_delta(bms_device* dev, struct bms_delta* delta);
+
+/**
+ * @brief Deadline of a transfer, wire time of the frames it waits for at the transport baud rate plus the response latency of the policy.
+ * @param const bms_device* dev passes the device whose transport and policy are used.
+ * @param uint8_t frames passes the number of frames the transfer may have to wait for.
+ * @retval uint32_t returns the timeout in milliseconds.
+ */
+uint32_t bms_device_timeout_ms(const bms_device* dev, uint8_t frames);
+
+/**
+ * @brief Upper bound of the time bms_device_read_mask() can take, every retry exhausted and every transfer running to its deadline, for watchdog budgets.
+ * @param const bms_device* dev passes the device, its transport must be attached.
+ * @param uint16_t mask passes the selected data IDs.
+ * @param uint8_t depth passes the number of requests allowed in flight.
+ * @retval uint32_t returns the bound in milliseconds.
+ */
+uint32_t bms_device_worst_case_ms(const bms_device* dev, uint16_t mask, uint8_t depth);
+
+/**
+ * @brief Tells whether a device is to be polled now according to its health.
+ * @param const bms_device* dev passes the device.
+ * @param uint32_t now_ms passes the current millisecond tick.
+ * @retval uint8_t returns BMS_ADMIT_POLL, BMS_ADMIT_PROBE for an offline pack whose probe is due, BMS_ERR_BACKOFF or BMS_ERR_OFFLINE when the pack is to be skipped.
+ */
+uint8_t bms_device_admit(const bms_device* dev, uint32_t now_ms);
+
+/**
+ * @brief Updates the health of a device with the result of a poll or probe.
+ * @param bms_device* dev passes the device.
+ * @param uint32_t now_ms passes the current millisecond tick.
+ * @param uint8_t error passes the bms_read() error code of the poll, 0 on success.
+ * @retval void
+ */
+void bms_device_report(bms_device* dev, uint32_t now_ms, uint8_t error);
+
+/**
+ * @brief Mask of the single frame request used to probe an offline pack, the first enabled data ID.
+ * @retval uint16_t returns the mask.
+ */
+uint16_t bms_probe_mask(void);
+
+/**
+ * @brief Health aware read of a device : skips degraded packs during their backoff and offline packs between probes, probes offline packs with one data ID, and updates the health.
+ * 	  Never takes longer than bms_device_worst_case_ms(dev, mask, depth).
+ * @param bms_device* dev passes the device to be read.
+ * @param uint16_t mask passes the selected data IDs.
+ * @param uint8_t depth passes the number of requests allowed in flight.
+ * @param uint32_t now_ms passes the current millisecond tick.
+ * @retval uint8_t returns 0 on success, BMS_ERR_BACKOFF or BMS_ERR_OFFLINE for a skipped pack, the bms_device_read_mask() error code otherwise (a successful probe also returns 0, the full read follows on the next call).
+ */
+uint8_t bms_device_poll(bms_device* dev, uint16_t mask, uint8_t depth, uint32_t now_ms);
+
+/**
+ * @brief Posts a command to a device, safe from an ISR or another task than the polling one. The polling context runs it at the next frame boundary, preempting its read,
+ * 	  or through bms_device_service_command() when it is idle. A command posted before the previous one was taken replaces it, the last fault reaction wins.
+ * @param bms_device* dev passes the device.
+ * @param uint8_t cmd_id passes DISCHRG_FET, CHRG_FET or BMS_RESET.
+ * @param uint8_t value passes BMS_FET_ON/BMS_FET_OFF for the FET commands, 0 for BMS_RESET.
+ * @retval uint8_t returns 0 on success and BMS_ERR_CMD_INVALID for another data ID.
+ */
+uint8_t bms_device_post_command(bms_device* dev, uint8_t cmd_id, uint8_t value);
+
+/**
+ * @brief Runs the posted command of a device if any, to be called by the polling context between reads or at a frame boundary of its own read engine.
+ * 	  The FET commands are confirmed by reading back CHRG_DISCHRG_MOS_STATUS.
+ * @param bms_device* dev passes the device.
+ * @param uint8_t backlog passes the number of response frames the BMS still sends for a read in flight, skipped while waiting for the echo, 0 between reads.
+ * @retval uint8_t returns 0 when no command was pending or it succeeded, one of the BMS_ERR_CMD_x codes otherwise (also left in cmd_error).
+ */
+uint8_t bms_device_service_command(bms_device* dev, uint8_t backlog);
+
+/**
+ * @brief Posts and runs a command on a device, blocking, from the polling context.
+ * @param bms_device* dev passes the device.
+ * @param uint8_t cmd_id passes DISCHRG_FET, CHRG_FET or BMS_RESET.
+ * @param uint8_t value passes BMS_FET_ON/BMS_FET_OFF for the FET commands, 0 for BMS_RESET.
+ * @retval uint8_t returns 0 on success and one of the BMS_ERR_CMD_x codes on failure.
+ */
+uint8_t bms_device_command(bms_device* dev, uint8_t cmd_id, uint8_t value);
+
+/**
+ * @brief Same as bms_device_post_command() for the BMS selected by attach_transport().
+ * @param uint8_t cmd_id passes DISCHRG_FET, CHRG_FET or BMS_RESET.
+ * @param uint8_t value passes BMS_FET_ON/BMS_FET_OFF for the FET commands, 0 for BMS_RESET.
+ * @retval uint8_t returns 0 on success and BMS_ERR_CMD_INVALID for another data ID.
+ */
+uint8_t bms_post_command(uint8_t cmd_id, uint8_t value);
+
+/**
+ * @brief Same as bms_device_command() for the BMS selected by attach_transport().
+ * @param uint8_t cmd_id passes DISCHRG_FET, CHRG_FET or BMS_RESET.
+ * @param uint8_t value passes BMS_FET_ON/BMS_FET_OFF for the FET commands, 0 for BMS_RESET.
+ * @retval uint8_t returns 0 on success and one of the BMS_ERR_CMD_x codes on failure.
+ */
+uint8_t bms_command(uint8_t cmd_id, uint8_t value);
+
+/**
+ * @brief Progress of the last command posted to the BMS selected by attach_transport().
+ * @param uint8_t* error passes the memory where the BMS_ERR_CMD_x code (0 on success) is stored once the state is BMS_CMD_DONE, can be NULL.
+ * @retval uint8_t returns one of the BMS_CMD_x states.
+ */
+uint8_t bms_command_status(uint8_t* error);
+
+/**
+ * @brief Same as bms_device_attach_snapshot() for the BMS selected by attach_transport(), the stat argument of the bms_read() functions is then ignored and can be NULL.
+ * @param bms_snapshot* snap passes the snapshot, NULL detaches it.
+ * @retval void
+ */
+void bms_attach_snapshot(bms_snapshot* snap);
+
+/**
+ * @brief Same as bms_device_attach_stats() for the BMS selected by attach_transport().
+ * @param bms_stats* stats passes the block, NULL detaches it.
+ * @retval void
+ */
+void bms_attach_stats(bms_stats* stats);
+
+/**
+ * @brief Same as bms_device_attach_delta() for the BMS selected by attach_transport().
+ * @param struct bms_delta* delta passes the tracker, NULL detaches it.
+ * @retval void
+ */
+void bms_attach_delta(struct bms_delta* delta);
+
+#if !defined(__linux__)
+/**
+ * @brief Same as bms_read(), kept for the existing firmware, not available on Linux hosts where it would clash with read(2).
+ * @param RT_Battery_status* passes the address of the battery status structure where the response of the sent command will be received.
+ * @retval uint8_t returns error codes, 0 on success and non zero on failure.
+ */
+uint8_t read(RT_Battery_status* stat);
+#endif
 
 
 #ifdef __cplusplus
@@ -0,0 +1,505 @@
+#ifndef BMS_VARIANT_HPP
+#define BMS_VARIANT_HPP
+
+#include "bms_uart_comm.h"
+#include <cstddef>
+#include <cstring>
+#include <utility>
+
+#if __cplusplus < 201703L
+#error "bms_variant.hpp requires C++17"
+#endif
+
+
+/**
+ * @file bms_variant.hpp
+ * @brief C++ front end of the driver specialized at compile time for one BMS variant.
+ * 	  A variant (bms::variant<strings, sensors, data ID mask, module address>) is a type, everything derived from it is computed by the compiler : the request frames with their
+ * 	  checksums are constants placed in flash, the number of frames of every response is known, bms::status<variant> holds exactly the enabled fields of that pack and nothing
+ * 	  else (no padding, no room for 48 cells on a 16S pack), and bms::device<variant>::read() is a straight sequence of the requests and frame receptions of the variant with no
+ * 	  table lookup and no loop left on the frame count.
+ * @author Piyush
+ * @date 12/01/25
+ * @version 1.0
+ *
+ *
+ * @note C++17, header only. The C API (bms_uart_comm.h) is untouched and can be used in the same image, both go through the same bms_transport objects.
+ *	 Nothing here depends on STRINGS_COUNT, TEMP_SENSOR_COUNT or the access macros, which only size RT_Battery_status : several variants are read by one build without editing
+ *	 any macro. Error codes and frame reassembly follow bms_read() : a response with corrupted, duplicated or missing frames is requested again up to retries times and only the
+ *	 frames still missing are taken, the codes are those of bms_read() (err_base of the data ID +0 transmit, +1 receive, +2 checksum, +3 frame sequence). Stale frames of
+ *	 another data ID are dropped, counted in unexpected_ids and take the place of a frame of the response like a corrupted one, so worst_case_ms() holds.
+ *	 The err_base of every data ID is BMS_ERR_BASE(), the definition the C data ID table uses.
+ *	 The cell voltages are stored decoded (mV, host order) in cell_mv[], the other fields keep the names and units of RT_Battery_status.
+ *	 Snapshots, instrumentation, delta tracking and the command path stay with the C device (bms_device), the front end is the plain polling read.
+ *
+ *	 Example :
+ *		using pack_16s=bms::variant<16, 4>;
+ *		using pack_24s=bms::variant<24, 8, BMS_DATA_ID_MASK(SOC_TOTAL_IV) | BMS_DATA_ID_MASK(CELL_VOLTAGE)>;	// 8 + 48 bytes of status
+ *		static bms::device<pack_24s> pack(&transport);
+ *		bms::status<pack_24s> stat;
+ *		if(pack.read(stat)==0){ ... stat.soc ... stat.cell_mv[23] ... }
+ */
+
+
+namespace bms {
+
+//==================================================================================== PRIVATE ROUTINES =========================================================================================
+
+namespace detail {
+
+constexpr uint8_t data_ids=BATTERY_FAILURE_STATUS-SOC_TOTAL_IV+1;	/**< data IDs 0x90 to 0x98, one bit each in a variant mask	*/
+
+/**
+ * @brief Reads a big endian 16 bit value out of a data field.
+ */
+constexpr uint16_t be16(const uint8_t* src){
+	return (uint16_t)(((uint16_t)src[0]<<8) | src[1]);
+}
+
+/**
+ * @brief Checksum of a request frame, the sum get_checksum() computes on every call.
+ */
+constexpr uint8_t checksum(uint8_t module_addr, uint8_t data_id){
+	return (uint8_t)(((uint16_t)START_FLAG + (uint16_t)module_addr + (uint16_t)MAX_DATA_SIZE + (uint16_t)data_id)&(0xFF));
+}
+
+/**
+ * @brief Number of response frames of a data ID for the given strings and sensors counts.
+ */
+constexpr uint8_t frames(uint8_t data_id, uint8_t strings, uint8_t sensors){
+	return (data_id==CELL_VOLTAGE) ? (uint8_t)((strings+CELL_VOLTS_PER_FRAME-1)/CELL_VOLTS_PER_FRAME) :
+		(data_id==CELL_TEMPERATURE) ? (uint8_t)((sensors+CELL_TEMPS_PER_FRAME-1)/CELL_TEMPS_PER_FRAME) : 1;
+}
+
+/**
+ * @brief Bytes of status the fields of a data ID take for the given strings and sensors counts.
+ */
+constexpr uint16_t group_size(uint8_t data_id, uint8_t strings, uint8_t sensors){
+	switch(data_id){
+		case SOC_TOTAL_IV:		return 8;
+		case MAX_MIN_VOLTAGE:		return 6;
+		case MAX_MIN_TEMPERATURE:	return 4;
+		case CHRG_DISCHRG_MOS_STATUS:	return 8;
+		case STATUS_INFO_1:		return 5;
+		case CELL_VOLTAGE:		return (uint16_t)(strings*MONOMER_VOLTAGE_SIZE);
+		case CELL_TEMPERATURE:		return (uint16_t)(sensors*SENT_TEMPERATURE_SIZE);
+		case CELL_BALANCE_STATE:	return (uint16_t)((strings+CELL_BALANCE_STATE_PER_BYTE-1)/CELL_BALANCE_STATE_PER_BYTE);
+		default:			return 8;	// BATTERY_FAILURE_STATUS
+	}
+}
+
+/**
+ * @brief Sum over the data IDs of a mask of their frames (sizes=false) or of their status bytes (sizes=true).
+ */
+constexpr uint16_t mask_sum(uint16_t mask, uint8_t strings, uint8_t sensors, bool sizes){
+	uint16_t sum=0;
+	for(uint8_t i=0;i<data_ids;i++){
+		if(mask & (1U<<i)){
+			sum+=sizes ? group_size((uint8_t)(SOC_TOTAL_IV+i), strings, sensors) : frames((uint8_t)(SOC_TOTAL_IV+i), strings, sensors);
+		}
+	}
+	return sum;
+}
+
+/**
+ * @brief Checksum check of a received frame, the 12 summed bytes are added without loop.
+ */
+template<std::size_t... I>
+inline bool frame_ok(const uint8_t* raw, std::index_sequence<I...>){
+	return (uint8_t)(raw[I] + ...)==raw[sizeof(uart_prot_packet)-1];
+}
+
+static_assert(checksum(UPPER_CMPTR_ADDR, SOC_TOTAL_IV)==0x7D, "request checksum differs from get_checksum()");
+
+}	// namespace detail
+
+
+//================================================================================== VARIANT STRUCTURES =======================================================================================================
+
+/**
+ * @brief descriptor of a BMS variant, every property of the pack the driver depends on is a template parameter.
+ * @param Strings cells of the pack, 1 to MAX_BMS_STRING_COUNT.
+ * @param Sensors temperature sensors of the pack, 1 to MAX_BMS_TEMPERATURE_SENSOR_COUNT.
+ * @param Mask data IDs read, OR of BMS_DATA_ID_MASK(data_id) values, BMS_MASK_ALL for all.
+ * @param ModuleAddr address the requests are sent to, UPPER_CMPTR_ADDR as for bms_device_init().
+ */
+template<uint8_t Strings, uint8_t Sensors, uint16_t Mask=BMS_MASK_ALL, uint8_t ModuleAddr=UPPER_CMPTR_ADDR>
+struct variant {
+	static_assert(Strings>=1 && Strings<=MAX_BMS_STRING_COUNT, "strings count exceeds the DALY BMS hardware limit");
+	static_assert(Sensors>=1 && Sensors<=MAX_BMS_TEMPERATURE_SENSOR_COUNT, "temperature sensors count exceeds the DALY BMS hardware limit");
+	static_assert(Mask!=0 && (Mask & ~BMS_MASK_ALL)==0, "mask selects no data ID or one outside 0x90 to 0x98");
+
+	static constexpr uint8_t strings=Strings;
+	static constexpr uint8_t sensors=Sensors;
+	static constexpr uint16_t mask=Mask;
+	static constexpr uint8_t module_addr=ModuleAddr;
+	static constexpr uint16_t response_frames=detail::mask_sum(Mask, Strings, Sensors, false);	/**< frames received by one read		*/
+	static constexpr uint16_t status_size=detail::mask_sum(Mask, Strings, Sensors, true);		/**< sizeof(bms::status<variant>)		*/
+
+	/**
+	 * @brief 1 if the variant reads the data ID.
+	 */
+	static constexpr bool has(uint8_t data_id){
+		return (Mask & BMS_DATA_ID_MASK(data_id))!=0;
+	}
+
+	/**
+	 * @brief Number of response frames the pack sends for a data ID.
+	 */
+	static constexpr uint8_t frames(uint8_t data_id){
+		return detail::frames(data_id, Strings, Sensors);
+	}
+
+	/**
+	 * @brief request frame of a data ID, checksum included, a constant sent as is.
+	 */
+	template<uint8_t DataId>
+	static constexpr uart_prot_packet request={ START_FLAG, ModuleAddr, DataId, MAX_DATA_SIZE, { 0 }, detail::checksum(ModuleAddr, DataId) };
+};
+
+#pragma pack(push, 1)
+
+/**
+ * @brief fields of one data ID, specialized per data ID. store() takes the payload of a verified frame (after the frame number of multi frame responses).
+ */
+template<uint8_t DataId, uint8_t Strings, uint8_t Sensors>
+struct fields;
+
+template<uint8_t Strings, uint8_t Sensors>
+struct fields<SOC_TOTAL_IV, Strings, Sensors> {
+	static constexpr uint8_t err_base=BMS_ERR_BASE(SOC_TOTAL_IV);
+	static constexpr uint8_t multi_frame=0;
+	uint16_t cum_total_voltage;				// cumulative total voltage (0.1 V)
+	uint16_t gath_total_voltage;				// gather total voltage (0.1 V)
+	uint16_t current;					// current (30000 offset, 0.1 A)
+	uint16_t soc;						// SOC (0.1%)
+	void store(uint8_t, const uint8_t* data){
+		cum_total_voltage=detail::be16(data+0);
+		gath_total_voltage=detail::be16(data+2);
+		current=detail::be16(data+4);
+		soc=detail::be16(data+6);
+	}
+};
+
+template<uint8_t Strings, uint8_t Sensors>
+struct fields<MAX_MIN_VOLTAGE, Strings, Sensors> {
+	static constexpr uint8_t err_base=BMS_ERR_BASE(MAX_MIN_VOLTAGE);
+	static constexpr uint8_t multi_frame=0;
+	uint16_t max_cell_voltage_value;			// maximum cell voltage value (mV)
+	uint8_t cell_count_with_max_voltage;			// no. of cell with maximum voltage
+	uint16_t min_cell_voltage_value;			// minimum cell voltage value (mV)
+	uint8_t cell_count_with_min_voltage;			// no. of cell with minimum voltage
+	void store(uint8_t, const uint8_t* data){
+		max_cell_voltage_value=detail::be16(data+0);
+		cell_count_with_max_voltage=data[2];
+		min_cell_voltage_value=detail::be16(data+3);
+		cell_count_with_min_voltage=data[5];
+	}
+};
+
+template<uint8_t Strings, uint8_t Sensors>
+struct fields<MAX_MIN_TEMPERATURE, Strings, Sensors> {
+	static constexpr uint8_t err_base=BMS_ERR_BASE(MAX_MIN_TEMPERATURE);
+	static constexpr uint8_t multi_frame=0;
+	uint8_t max_temp_val_40;				// maximum temperature value (40 offset, degree celsius)
+	uint8_t max_temp_cell_no;				// maximum temperature cell no.
+	uint8_t min_temp_val_40;				// minimum temperature value (40 offset, degree celsius)
+	uint8_t min_temp_cell_no;				// minimum temperature cell no.
+	void store(uint8_t, const uint8_t* data){
+		max_temp_val_40=data[0];
+		max_temp_cell_no=data[1];
+		min_temp_val_40=data[2];
+		min_temp_cell_no=data[3];
+	}
+};
+
+template<uint8_t Strings, uint8_t Sensors>
+struct fields<CHRG_DISCHRG_MOS_STATUS, Strings, Sensors> {
+	static constexpr uint8_t err_base=BMS_ERR_BASE(CHRG_DISCHRG_MOS_STATUS);
+	static constexpr uint8_t multi_frame=0;
+	uint8_t mos_state;					// mos state, stationary or charging or discharging
+	uint8_t chrg_mos_state;					// charge MOS state
+	uint8_t dischrg_mos_state;				// discharge MOS state
+	uint8_t bms_life;					// BMS life (0-255 cycles)
+	uint32_t remain_capacity;				// remain capacity (mAH)
+	void store(uint8_t, const uint8_t* data){
+		mos_state=data[0];
+		chrg_mos_state=data[1];
+		dischrg_mos_state=data[2];
+		bms_life=data[3];
+		remain_capacity=((uint32_t)detail::be16(data+4)<<16) | detail::be16(data+6);
+	}
+};
+
+template<uint8_t Strings, uint8_t Sensors>
+struct fields<STATUS_INFO_1, Strings, Sensors> {
+	static constexpr uint8_t err_base=BMS_ERR_BASE(STATUS_INFO_1);
+	static constexpr uint8_t multi_frame=0;
+	uint8_t battery_string_count;				// no. of battery strings
+	uint8_t temperature_count;				// no. of temperature sensors
+	uint8_t charger_status;					// charger status
+	uint8_t load_status;					// load status
+	uint8_t DI_DO_state;					// DIx and DOx states
+	void store(uint8_t, const uint8_t* data){
+		battery_string_count=data[0];
+		temperature_count=data[1];
+		charger_status=data[2];
+		load_status=data[3];
+		DI_DO_state=data[4];
+	}
+};
+
+template<uint8_t Strings, uint8_t Sensors>
+struct fields<CELL_VOLTAGE, Strings, Sensors> {
+	static constexpr uint8_t err_base=BMS_ERR_BASE(CELL_VOLTAGE);
+	static constexpr uint8_t multi_frame=1;
+	uint16_t cell_mv[Strings];				// cell voltages (mV), decoded
+	void store(uint8_t seq, const uint8_t* data){
+		for(uint8_t k=0;k<CELL_VOLTS_PER_FRAME;k++){	// constant trip count, unrolled by the compiler
+			uint16_t cell=(uint16_t)(seq*CELL_VOLTS_PER_FRAME+k);
+			if(cell<Strings){
+				cell_mv[cell]=detail::be16(data+k*MONOMER_VOLTAGE_SIZE);
+			}
+		}
+	}
+};
+
+template<uint8_t Strings, uint8_t Sensors>
+struct fields<CELL_TEMPERATURE, Strings, Sensors> {
+	static constexpr uint8_t err_base=BMS_ERR_BASE(CELL_TEMPERATURE);
+	static constexpr uint8_t multi_frame=1;
+	uint8_t cell_temperatures[Sensors];			// temperatures (40 offset, degree celsius)
+	void store(uint8_t seq, const uint8_t* data){
+		uint16_t first=(uint16_t)(seq*CELL_TEMPS_PER_FRAME);
+		if(first<Sensors){
+			std::memcpy(cell_temperatures+first, data, (Sensors-first<CELL_TEMPS_PER_FRAME) ? Sensors-first : CELL_TEMPS_PER_FRAME);
+		}
+	}
+};
+
+template<uint8_t Strings, uint8_t Sensors>
+struct fields<CELL_BALANCE_STATE, Strings, Sensors> {
+	static constexpr uint8_t err_base=BMS_ERR_BASE(CELL_BALANCE_STATE);
+	static constexpr uint8_t multi_frame=0;
+	uint8_t cell_balance_states[(Strings+CELL_BALANCE_STATE_PER_BYTE-1)/CELL_BALANCE_STATE_PER_BYTE];	// 1 bit per cell, 1 means open
+	void store(uint8_t, const uint8_t* data){
+		std::memcpy(cell_balance_states, data, sizeof(cell_balance_states));
+	}
+};
+
+template<uint8_t Strings, uint8_t Sensors>
+struct fields<BATTERY_FAILURE_STATUS, Strings, Sensors> {
+	static constexpr uint8_t err_base=BMS_ERR_BASE(BATTERY_FAILURE_STATUS);
+	static constexpr uint8_t multi_frame=0;
+	uint8_t cell_sum_volt_level;
+	uint8_t chrg_dischrg_temp_level;
+	uint8_t chrg_dischrg_overI_soc_level;
+	uint8_t diff_volt_temp_level;
+	uint8_t chrg_dischrg_mos_info;
+	uint8_t all_failures;
+	uint8_t all_faults;
+	uint8_t fault_code;
+	void store(uint8_t, const uint8_t* data){
+		std::memcpy(this, data, MAX_DATA_SIZE);	// 8 single byte fields in wire order
+	}
+};
+
+/**
+ * @brief fields of a data ID in the status of a variant, an empty base taking no room when the variant does not read the data ID.
+ */
+template<uint8_t DataId, class Variant, bool Enabled=Variant::has(DataId)>
+struct group : fields<DataId, Variant::strings, Variant::sensors> {};
+
+template<uint8_t DataId, class Variant>
+struct group<DataId, Variant, false> {};
+
+/**
+ * @brief status of a variant, exactly the fields of its data IDs, tightly packed (sizeof is Variant::status_size).
+ */
+template<class Variant>
+struct status : group<SOC_TOTAL_IV, Variant>, group<MAX_MIN_VOLTAGE, Variant>, group<MAX_MIN_TEMPERATURE, Variant>, group<CHRG_DISCHRG_MOS_STATUS, Variant>,
+		group<STATUS_INFO_1, Variant>, group<CELL_VOLTAGE, Variant>, group<CELL_TEMPERATURE, Variant>, group<CELL_BALANCE_STATE, Variant>,
+		group<BATTERY_FAILURE_STATUS, Variant> {
+};
+
+#pragma pack(pop)
+
+
+//================================================================================== DEVICE STRUCTURE =======================================================================================================
+
+/**
+ * @brief one BMS of a variant behind a transport, the counterpart of bms_device for the plain polling read.
+ */
+template<class Variant>
+struct device {
+	using variant_type=Variant;
+	using status_type=status<Variant>;
+	static_assert(sizeof(status_type)==Variant::status_size, "variant status is not tightly packed");
+	static_assert(Variant::frames(CELL_VOLTAGE)<=BMS_MAX_RESPONSE_FRAMES, "one bit per frame in the reassembly mask");
+
+	bms_transport* transport;	/**< port towards this BMS, its baud rate sets the deadlines				*/
+	uint8_t retries;		/**< extra requests of a data ID before its error code is returned, as policy.retries	*/
+	uint32_t tx_ms;			/**< request deadline, bms_device_timeout_ms() of 1 frame				*/
+	uint32_t rx_ms;			/**< frame deadline, bms_device_timeout_ms() of 2 frames				*/
+	uint32_t unexpected_ids;	/**< valid frames of another data ID dropped, as bms_stats::unexpected_ids		*/
+
+	/**
+	 * @brief Binds the device to its transport, the deadlines are computed once from the transport baud rate.
+	 * @param bms_transport* transport passes the port towards this BMS, its baud rate must be set.
+	 * @param uint8_t retries passes the extra requests of a data ID, BMS_FRAME_RETRIES as the C device.
+	 * @param uint32_t latency_ms passes the BMS response latency allowed on top of the wire time, BMS_RESPONSE_LATENCY_MS as the C device.
+	 */
+	explicit device(bms_transport* transport, uint8_t retries=BMS_FRAME_RETRIES, uint32_t latency_ms=BMS_RESPONSE_LATENCY_MS) :
+		transport(transport), retries(retries), tx_ms(timeout_ms(transport, 1, latency_ms)), rx_ms(timeout_ms(transport, 2, latency_ms)), unexpected_ids(0) {
+	}
+
+	/**
+	 * @brief Reads every data ID of the variant in order.
+	 * @param status_type& stat passes the status where the responses are decoded.
+	 * @retval uint8_t returns 0 on success or the bms_read() error code of the failing data ID.
+	 */
+	uint8_t read(status_type& stat){
+		return read_ids(stat, std::make_integer_sequence<uint8_t, detail::data_ids>{});
+	}
+
+	/**
+	 * @brief Reads one data ID of the variant, for a scheduler refreshing each group at its own rate.
+	 * @param status_type& stat passes the status where the response is decoded.
+	 * @retval uint8_t returns 0 on success or the bms_read() error code of the data ID.
+	 */
+	template<uint8_t DataId>
+	uint8_t read_data_id(status_type& stat){
+		static_assert(DataId>=SOC_TOTAL_IV && DataId<=BATTERY_FAILURE_STATUS && Variant::has(DataId), "data ID not read by this variant");
+		using fields_type=fields<DataId, Variant::strings, Variant::sensors>;
+		constexpr uint8_t frames=Variant::frames(DataId);
+		uint16_t missing=(uint16_t)((1UL<<frames)-1);
+		uint8_t last_error=3;
+		for(uint8_t attempt=0;;attempt++){
+			if(bms_transport_transmit(transport, reinterpret_cast<const uint8_t*>(&Variant::template request<DataId>), sizeof(uart_prot_packet), tx_ms)!=BMS_TRANSPORT_OK){
+				return fields_type::err_base;
+			}
+			uint8_t ret=receive<DataId>(stat, missing, last_error, std::make_index_sequence<frames>{});
+			if(missing==0){
+				return 0;
+			}
+			if(attempt>=retries){
+				return (uint8_t)(fields_type::err_base+((ret!=0) ? 1 : last_error));
+			}
+		}
+	}
+
+	/**
+	 * @brief Decodes a verified frame received by other means (bms_stream parser, capture replay) into the status.
+	 * @param status_type& stat passes the status.
+	 * @param const uart_prot_packet& frame passes the frame, its checksum already verified.
+	 * @retval uint8_t returns 0 on success and BMS_ERR_DATA_ID_DISABLED if the variant does not read the frame's data ID.
+	 */
+	uint8_t store_frame(status_type& stat, const uart_prot_packet& frame){
+		return store_ids(stat, frame, std::make_integer_sequence<uint8_t, detail::data_ids>{});
+	}
+
+	/**
+	 * @brief Upper bound of the time read() can take, every retry exhausted and every transfer running to its deadline, for watchdog budgets.
+	 * @retval uint32_t returns the bound in milliseconds.
+	 */
+	uint32_t worst_case_ms() const {
+		uint32_t total_ms=0;
+		for(uint8_t i=0;i<detail::data_ids;i++){
+			if(Variant::has((uint8_t)(SOC_TOTAL_IV+i))){
+				total_ms+=(uint32_t)(retries+1)*(tx_ms+Variant::frames((uint8_t)(SOC_TOTAL_IV+i))*rx_ms);
+			}
+		}
+		return total_ms;
+	}
+
+private:
+	/**
+	 * @brief Deadline of a transfer of a number of frames, as bms_device_timeout_ms().
+	 */
+	static uint32_t timeout_ms(const bms_transport* transport, uint8_t frames, uint32_t latency_ms){
+		uint32_t wire_us=bms_transport_wire_time_us(transport, (uint32_t)frames*sizeof(uart_prot_packet));
+		return (wire_us+999U)/1000U+latency_ms;
+	}
+
+	template<uint8_t... I>
+	uint8_t read_ids(status_type& stat, std::integer_sequence<uint8_t, I...>){
+		uint8_t ret=0;
+		(void)(((ret=read_enabled<SOC_TOTAL_IV+I>(stat))==0) && ...);	// stops at the first failing data ID
+		return ret;
+	}
+
+	template<uint8_t DataId>
+	uint8_t read_enabled(status_type& stat){
+		if constexpr (Variant::has(DataId)){
+			return read_data_id<DataId>(stat);
+		}
+		else{
+			return 0;
+		}
+	}
+
+	/**
+	 * @brief Receives the frames of one response, one reception per frame written out by the compiler, stops at the first timeout.
+	 * @retval uint8_t returns 0 once every frame arrived (valid or not) and 1 on timeout.
+	 */
+	template<uint8_t DataId, std::size_t... I>
+	uint8_t receive(status_type& stat, uint16_t& missing, uint8_t& last_error, std::index_sequence<I...>){
+		uint8_t ret=0;
+		(void)(((void)I, (ret=receive_frame<DataId>(stat, missing, last_error))==0) && ...);
+		return ret;
+	}
+
+	template<uint8_t DataId>
+	uint8_t receive_frame(status_type& stat, uint16_t& missing, uint8_t& last_error){
+		using fields_type=fields<DataId, Variant::strings, Variant::sensors>;
+		uart_prot_packet frame;
+		if(bms_transport_receive(transport, reinterpret_cast<uint8_t*>(&frame), sizeof(uart_prot_packet), rx_ms)!=BMS_TRANSPORT_OK){
+			return 1;
+		}
+		if(!detail::frame_ok(reinterpret_cast<const uint8_t*>(&frame), std::make_index_sequence<sizeof(uart_prot_packet)-1>{})){
+			last_error=2;	// corrupted, the frame is taken from the next response
+			return 0;
+		}
+		if(frame.data_id!=DataId){
+			unexpected_ids++;	// stale frame of a timed out request, dropped and counted as a failed frame, so that a stream of them cannot outlast worst_case_ms()
+			last_error=3;
+			return 0;
+		}
+		uint8_t seq=fields_type::multi_frame ? frame.data[0] : 0;
+		if(seq>=Variant::frames(DataId)){
+			last_error=3;	// incorrect frame sequence.
+			return 0;
+		}
+		if(missing & (1U<<seq)){
+			static_cast<fields_type&>(stat).store(seq, frame.data+fields_type::multi_frame);
+			missing&=(uint16_t)~(1U<<seq);
+		}
+		return 0;
+	}
+
+	template<uint8_t... I>
+	uint8_t store_ids(status_type& stat, const uart_prot_packet& frame, std::integer_sequence<uint8_t, I...>){
+		uint8_t ret=BMS_ERR_DATA_ID_DISABLED;
+		(void)((frame.data_id==SOC_TOTAL_IV+I && (ret=store_enabled<SOC_TOTAL_IV+I>(stat, frame), true)) || ...);
+		return ret;
+	}
+
+	template<uint8_t DataId>
+	uint8_t store_enabled(status_type& stat, const uart_prot_packet& frame){
+		if constexpr (Variant::has(DataId)){
+			using fields_type=fields<DataId, Variant::strings, Variant::sensors>;
+			uint8_t seq=fields_type::multi_frame ? frame.data[0] : 0;
+			if(seq<Variant::frames(DataId)){
+				static_cast<fields_type&>(stat).store(seq, frame.data+fields_type::multi_frame);
+			}
+			return 0;
+		}
+		else{
+			return BMS_ERR_DATA_ID_DISABLED;
+		}
+	}
+};
+
+}	// namespace bms
+
+#endif /**< BMS_VARIANT_HPP  */